@@ -22,6 +22,7 @@
 
 #include <cstddef>
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 #include <utility>
 
@@ -124,6 +125,30 @@ namespace
 	}
 	
 	
+	/**
+	 * Transforms interleaved x/y coordinates in a single call to PROJ.4.
+	 * 
+	 * Points which cannot be transformed are set to HUGE_VAL, and PROJ.4
+	 * skips such points in subsequent calls. If the call fails as a whole,
+	 * all points are set to HUGE_VAL.
+	 * Returns false if any point cannot be transformed.
+	 */
+	bool transformBatch(projPJ src, projPJ dst, std::vector<double>& buffer)
+	{
+		auto const count = buffer.size() / 2;
+		if (count == 0)
+			return true;
+		
+		if (pj_transform(src, dst, long(count), 2, &buffer[0], &buffer[1], nullptr) != 0)
+		{
+			std::fill(buffer.begin(), buffer.end(), HUGE_VAL);
+			return false;
+		}
+		
+		return std::none_of(buffer.begin(), buffer.end(), [](double value) { return value == HUGE_VAL; });
+	}
+	
+	
 	/**
 	 * List of substitutions for specifications which are known to be broken in Proj.4.
 	 */
@@ -813,6 +838,110 @@ MapCoordF Georeferencing::toMapCoordF(const Georeferencing* other, const MapCoor
 	}
 }
 
+void Georeferencing::toProjectedCoords(const MapCoordF* map_coords, QPointF* projected_coords, std::size_t count) const
+{
+	// The transformation is affine, so the matrix can be applied directly.
+	auto const& t = to_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = map_coords[i].x(), y = map_coords[i].y();
+		projected_coords[i] = { t.m11() * x + t.m21() * y + t.dx(), t.m12() * x + t.m22() * y + t.dy() };
+	}
+}
+
+void Georeferencing::toMapCoordF(const QPointF* projected_coords, MapCoordF* map_coords, std::size_t count) const
+{
+	// The transformation is affine, so the matrix can be applied directly.
+	auto const& t = from_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = projected_coords[i].x(), y = projected_coords[i].y();
+		map_coords[i] = { t.m11() * x + t.m21() * y + t.dx(), t.m12() * x + t.m22() * y + t.dy() };
+	}
+}
+
+bool Georeferencing::toGeographicCoords(const MapCoordF* map_coords, LatLon* lat_lon, std::size_t count) const
+{
+	auto buffer = std::vector<double>(2 * count);
+	auto const& t = to_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = map_coords[i].x(), y = map_coords[i].y();
+		buffer[2*i]   = t.m11() * x + t.m21() * y + t.dx();
+		buffer[2*i+1] = t.m12() * x + t.m22() * y + t.dy();
+	}
+	
+	auto ok = projected_crs && geographic_crs && transformBatch(projected_crs, geographic_crs, buffer);
+	for (std::size_t i = 0; i < count; ++i)
+		lat_lon[i] = LatLon::fromRadiant(buffer[2*i+1], buffer[2*i]);
+	return ok;
+}
+
+bool Georeferencing::toMapCoordF(const LatLon* lat_lon, MapCoordF* map_coords, std::size_t count) const
+{
+	auto buffer = std::vector<double>(2 * count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		buffer[2*i]   = degToRad(lat_lon[i].longitude());
+		buffer[2*i+1] = degToRad(lat_lon[i].latitude());
+	}
+	
+	auto ok = projected_crs && geographic_crs && transformBatch(geographic_crs, projected_crs, buffer);
+	auto const& t = from_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = buffer[2*i], y = buffer[2*i+1];
+		map_coords[i] = { t.m11() * x + t.m21() * y + t.dx(), t.m12() * x + t.m22() * y + t.dy() };
+	}
+	return ok;
+}
+
+bool Georeferencing::toMapCoordF(const Georeferencing* other, const MapCoordF* in, MapCoordF* out, std::size_t count) const
+{
+	if (!other)
+	{
+		std::copy(in, in + count, out);
+		return true;
+	}
+	
+	auto buffer = std::vector<double>(2 * count);
+	auto const& t = other->to_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = in[i].x(), y = in[i].y();
+		buffer[2*i]   = t.m11() * x + t.m21() * y + t.dx();
+		buffer[2*i+1] = t.m12() * x + t.m22() * y + t.dy();
+	}
+	
+	auto ok = true;
+	if (!isLocal() && !other->isLocal())
+	{
+		if (!projected_crs || !other->projected_crs)
+		{
+			ok = false;
+		}
+		else
+		{
+			// Use geographic coordinates as intermediate step, cf. the single point variant.
+			// Both steps are run for all points which did not fail yet.
+			auto const to_geographic = transformBatch(other->projected_crs, geographic_crs, buffer);
+			auto const to_projected = transformBatch(geographic_crs, projected_crs, buffer);
+			ok = to_geographic && to_projected;
+		}
+	}
+	
+	auto const& f = from_projected;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto const x = buffer[2*i], y = buffer[2*i+1];
+		if (x == HUGE_VAL || y == HUGE_VAL)
+			out[i] = { HUGE_VAL, HUGE_VAL };
+		else
+			out[i] = { f.m11() * x + f.m21() * y + f.dx(), f.m12() * x + f.m22() * y + f.dy() };
+	}
+	return ok;
+}
+
 QString Georeferencing::getErrorText() const
 {
 	int err_no = *pj_get_errno_ref();
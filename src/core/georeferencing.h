@@ -22,6 +22,7 @@
 #define OPENORIENTEERING_GEOREFERENCING_H
 
 #include <cmath>
+#include <cstddef>
 #include <vector>
 
 #include <QObject>
@@ -458,6 +459,48 @@ public:
 	MapCoordF toMapCoordF(const Georeferencing* other, const MapCoordF& map_coords, bool* ok = nullptr) const;
 	
 	
+	/**
+	 * Transforms a sequence of map (paper) coordinates to projected coordinates.
+	 * 
+	 * The output array must provide space for count elements.
+	 */
+	void toProjectedCoords(const MapCoordF* map_coords, QPointF* projected_coords, std::size_t count) const;
+	
+	/**
+	 * Transforms a sequence of projected coordinates to map (paper) coordinates.
+	 * 
+	 * The output array must provide space for count elements.
+	 */
+	void toMapCoordF(const QPointF* projected_coords, MapCoordF* map_coords, std::size_t count) const;
+	
+	/**
+	 * Transforms a sequence of map (paper) coordinates to geographic coordinates.
+	 * 
+	 * All points are passed to PROJ in a single call.
+	 * Returns true if all points were transformed successfully.
+	 */
+	bool toGeographicCoords(const MapCoordF* map_coords, LatLon* lat_lon, std::size_t count) const;
+	
+	/**
+	 * Transforms a sequence of geographic coordinates to map coordinates.
+	 * 
+	 * All points are passed to PROJ in a single call.
+	 * Returns true if all points were transformed successfully.
+	 */
+	bool toMapCoordF(const LatLon* lat_lon, MapCoordF* map_coords, std::size_t count) const;
+	
+	/**
+	 * Transforms a sequence of map coordinates from the other georeferencing
+	 * to map coordinates of this georeferencing, if possible.
+	 * 
+	 * All points are passed to PROJ in a single call per step.
+	 * Points which cannot be transformed are set to HUGE_VAL, the other
+	 * points are still transformed.
+	 * Returns true if all points were transformed successfully.
+	 */
+	bool toMapCoordF(const Georeferencing* other, const MapCoordF* in, MapCoordF* out, std::size_t count) const;
+	
+	
 	/**
 	 * Returns the current error text.
 	 */
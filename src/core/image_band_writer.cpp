@@ -0,0 +1,547 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "image_band_writer.h"
+
+#include <initializer_list>
+#include <limits>
+
+#include <QFileInfo>
+#include <QIODevice>
+#include <QImage>
+#include <QLatin1String>
+#include <QRgb>
+
+#include <zlib.h>
+
+
+namespace OpenOrienteering {
+
+namespace {
+
+/// The uncompressed size of a TIFF strip, in bytes
+constexpr int tiff_strip_size = 256 * 1024;
+
+/// The size of the PNG image data chunks, in bytes
+constexpr int png_chunk_size = 64 * 1024;
+
+/// The memory size of a 32 bit image above which the image is written in bands
+constexpr qint64 streaming_image_bytes = 256 * 1024 * 1024;
+
+// TIFF field types
+constexpr quint16 tiff_short = 3;
+constexpr quint16 tiff_long = 4;
+constexpr quint16 tiff_rational = 5;
+constexpr quint16 tiff_long8 = 16;
+
+
+/**
+ * Writes the RGB values of a row of an ARGB32 image to data.
+ *
+ * For BMP, the order of the components is reversed.
+ */
+void convertRow(const QImage& image, int y, char* data, bool bgr)
+{
+	auto pixel = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+	auto const end = pixel + image.width();
+	if (bgr)
+	{
+		for (; pixel != end; ++pixel)
+		{
+			*data++ = char(qBlue(*pixel));
+			*data++ = char(qGreen(*pixel));
+			*data++ = char(qRed(*pixel));
+		}
+	}
+	else
+	{
+		for (; pixel != end; ++pixel)
+		{
+			*data++ = char(qRed(*pixel));
+			*data++ = char(qGreen(*pixel));
+			*data++ = char(qBlue(*pixel));
+		}
+	}
+}
+
+/**
+ * Returns the given values in little endian byte order.
+ */
+template< class T >
+QByteArray tiffValues(std::initializer_list<T> values)
+{
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	for (auto value : values)
+		stream << value;
+	return data;
+}
+
+/**
+ * Returns the given offsets or counts in little endian byte order,
+ * as LONG8 values for BigTIFF, or as LONG values otherwise.
+ */
+QByteArray tiffValues(const std::vector<quint64>& values, bool big_tiff)
+{
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	for (auto value : values)
+	{
+		if (big_tiff)
+			stream << value;
+		else
+			stream << quint32(value);
+	}
+	return data;
+}
+
+}  // namespace
+
+
+
+struct ImageBandWriter::ZStream
+{
+	z_stream stream = {};
+	bool initialized = false;
+	
+	~ZStream()
+	{
+		if (initialized)
+			deflateEnd(&stream);
+	}
+};
+
+
+
+ImageBandWriter::ImageBandWriter(const QString& path, QSize size, int dots_per_meter)
+: path(path)
+, file(path)
+, size(size)
+, dots_per_meter(dots_per_meter)
+, format(formatForPath(path))
+{
+	// nothing else
+}
+
+ImageBandWriter::~ImageBandWriter()
+{
+	// Don't leave incomplete files.
+	if (file.isOpen())
+	{
+		file.close();
+		file.remove();
+	}
+}
+
+
+bool ImageBandWriter::supportsFormat(const QString& path)
+{
+	return formatForPath(path) != Unsupported;
+}
+
+bool ImageBandWriter::isStreamingNeeded(QSize size)
+{
+	return 4 * qint64(size.width()) * qint64(size.height()) > streaming_image_bytes;
+}
+
+
+bool ImageBandWriter::open()
+{
+	if (format == Unsupported)
+		return setError(tr("Unsupported image format."));
+	
+	if (size.isEmpty())
+		return setError(tr("The image is empty."));
+	
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return setError(file.errorString());
+	
+	out.setDevice(&file);
+	rows_written = 0;
+	
+	bool result = false;
+	switch (format)
+	{
+	case Png:
+		result = openPng();
+		break;
+	case Tiff:
+		result = openTiff();
+		break;
+	case Bmp:
+		result = openBmp();
+		break;
+	case Unsupported:
+		Q_UNREACHABLE();
+	}
+	
+	if (result && out.status() != QDataStream::Ok)
+		result = setError(file.errorString());
+	return result;
+}
+
+
+bool ImageBandWriter::write(const QImage& band)
+{
+	Q_ASSERT(band.format() == QImage::Format_RGB32 || band.format() == QImage::Format_ARGB32_Premultiplied);
+	
+	if (!file.isOpen())
+		return setError(tr("The file is not open."));
+	
+	if (band.width() != size.width() || rows_written + band.height() > size.height())
+		return setError(tr("The image data does not match the image size."));
+	
+	if (format == Bmp)
+		return writeBmpRows(band);
+	
+	auto const row_size = 3 * size.width();
+	QByteArray row(1 + row_size, Qt::Uninitialized);
+	row[0] = 0;  // PNG filter type: None
+	for (int y = 0; y < band.height(); ++y)
+	{
+		convertRow(band, y, row.data() + 1, false);
+		if (format == Png)
+		{
+			if (!writePngRows(row, false))
+				return false;
+		}
+		else
+		{
+			strip.append(row.constData() + 1, row_size);
+			if (strip.size() == rows_per_strip * row_size && !writeTiffStrip())
+				return false;
+		}
+		++rows_written;
+	}
+	
+	if (out.status() != QDataStream::Ok)
+		return setError(file.errorString());
+	return true;
+}
+
+
+bool ImageBandWriter::close()
+{
+	if (!file.isOpen())
+		return setError(tr("The file is not open."));
+	
+	if (rows_written != size.height())
+		return setError(tr("The image data does not match the image size."));
+	
+	bool result = true;
+	switch (format)
+	{
+	case Png:
+		result = closePng();
+		break;
+	case Tiff:
+		result = closeTiff();
+		break;
+	case Bmp:
+	case Unsupported:
+		break;
+	}
+	
+	if (!result)
+		return false;
+	
+	if (out.status() != QDataStream::Ok || !file.flush())
+		return setError(file.errorString());
+	
+	file.close();
+	return true;
+}
+
+
+QString ImageBandWriter::errorString() const
+{
+	return error_string;
+}
+
+
+ImageBandWriter::Format ImageBandWriter::formatForPath(const QString& path)
+{
+	auto const suffix = QFileInfo(path).suffix().toLower();
+	if (suffix == QLatin1String("png"))
+		return Png;
+	if (suffix == QLatin1String("tif") || suffix == QLatin1String("tiff"))
+		return Tiff;
+	if (suffix == QLatin1String("bmp"))
+		return Bmp;
+	return Unsupported;
+}
+
+
+
+bool ImageBandWriter::openPng()
+{
+	out.setByteOrder(QDataStream::BigEndian);
+	out.writeRawData("\x89PNG\r\n\x1a\n", 8);
+	
+	QByteArray header;
+	{
+		QDataStream stream(&header, QIODevice::WriteOnly);
+		stream << quint32(size.width()) << quint32(size.height())
+		       << quint8(8)   // bit depth
+		       << quint8(2)   // color type: RGB
+		       << quint8(0)   // compression method
+		       << quint8(0)   // filter method
+		       << quint8(0);  // interlace method
+	}
+	writePngChunk("IHDR", header);
+	
+	if (dots_per_meter > 0)
+	{
+		QByteArray physical_dimensions;
+		QDataStream stream(&physical_dimensions, QIODevice::WriteOnly);
+		stream << quint32(dots_per_meter) << quint32(dots_per_meter)
+		       << quint8(1);  // unit: meter
+		writePngChunk("pHYs", physical_dimensions);
+	}
+	
+	png_buffer.resize(png_chunk_size);
+	zstream = std::make_unique<ZStream>();
+	if (deflateInit(&zstream->stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return setError(tr("Failed to initialize the compression."));
+	zstream->initialized = true;
+	return true;
+}
+
+bool ImageBandWriter::writePngRows(const QByteArray& rows, bool finish)
+{
+	auto& stream = zstream->stream;
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(rows.constData()));
+	stream.avail_in = uInt(rows.size());
+	
+	int result;
+	do
+	{
+		stream.next_out = reinterpret_cast<Bytef*>(png_buffer.data());
+		stream.avail_out = uInt(png_buffer.size());
+		result = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+		if (result == Z_STREAM_ERROR)
+			return setError(tr("Failed to compress the image data."));
+		
+		auto const produced = png_buffer.size() - int(stream.avail_out);
+		if (produced > 0)
+			writePngChunk("IDAT", QByteArray::fromRawData(png_buffer.constData(), produced));
+	}
+	while (stream.avail_out == 0 || (finish && result != Z_STREAM_END));
+	
+	return true;
+}
+
+void ImageBandWriter::writePngChunk(const char* type, const QByteArray& data)
+{
+	auto crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+	crc = crc32(crc, reinterpret_cast<const Bytef*>(data.constData()), uInt(data.size()));
+	
+	out << quint32(data.size());
+	out.writeRawData(type, 4);
+	out.writeRawData(data.constData(), data.size());
+	out << quint32(crc);
+}
+
+bool ImageBandWriter::closePng()
+{
+	if (!writePngRows({}, true))
+		return false;
+	
+	writePngChunk("IEND", {});
+	return true;
+}
+
+
+
+bool ImageBandWriter::openTiff()
+{
+	auto const row_size = 3 * qint64(size.width());
+	
+	// Classic TIFF uses 32 bit offsets. Leave some room for the directory
+	// and for data which doesn't compress well.
+	big_tiff = row_size * size.height() > qint64(std::numeric_limits<quint32>::max()) - (qint64(1) << 28);
+	rows_per_strip = int(qBound(qint64(1), tiff_strip_size / row_size, qint64(size.height())));
+	strip.clear();
+	strip.reserve(int(rows_per_strip * row_size));
+	strip_offsets.clear();
+	strip_byte_counts.clear();
+	
+	out.setByteOrder(QDataStream::LittleEndian);
+	out.writeRawData("II", 2);
+	if (big_tiff)
+		out << quint16(43) << quint16(8) << quint16(0) << quint64(0);
+	else
+		out << quint16(42) << quint32(0);
+	return true;
+}
+
+bool ImageBandWriter::writeTiffStrip()
+{
+	auto compressed_size = compressBound(uLong(strip.size()));
+	QByteArray compressed(int(compressed_size), Qt::Uninitialized);
+	if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+	              reinterpret_cast<const Bytef*>(strip.constData()), uLong(strip.size()),
+	              Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		return setError(tr("Failed to compress the image data."));
+	}
+	
+	strip_offsets.push_back(quint64(file.pos()));
+	strip_byte_counts.push_back(quint64(compressed_size));
+	out.writeRawData(compressed.constData(), int(compressed_size));
+	strip.resize(0);
+	return true;
+}
+
+bool ImageBandWriter::closeTiff()
+{
+	if (!strip.isEmpty() && !writeTiffStrip())
+		return false;
+	
+	auto const offset_type = big_tiff ? tiff_long8 : tiff_long;
+	auto const resolution = quint32(qMax(1, dots_per_meter));
+	std::vector<TiffEntry> entries = {
+	    { 256, tiff_long, 1, tiffValues({ quint32(size.width()) }) },        // ImageWidth
+	    { 257, tiff_long, 1, tiffValues({ quint32(size.height()) }) },       // ImageLength
+	    { 258, tiff_short, 3, tiffValues({ quint16(8), quint16(8), quint16(8) }) },  // BitsPerSample
+	    { 259, tiff_short, 1, tiffValues({ quint16(8) }) },                  // Compression: Deflate
+	    { 262, tiff_short, 1, tiffValues({ quint16(2) }) },                  // PhotometricInterpretation: RGB
+	    { 273, offset_type, strip_offsets.size(), tiffValues(strip_offsets, big_tiff) },  // StripOffsets
+	    { 277, tiff_short, 1, tiffValues({ quint16(3) }) },                  // SamplesPerPixel
+	    { 278, tiff_long, 1, tiffValues({ quint32(rows_per_strip) }) },      // RowsPerStrip
+	    { 279, offset_type, strip_byte_counts.size(), tiffValues(strip_byte_counts, big_tiff) },  // StripByteCounts
+	    { 282, tiff_rational, 1, tiffValues({ resolution, quint32(100) }) }, // XResolution
+	    { 283, tiff_rational, 1, tiffValues({ resolution, quint32(100) }) }, // YResolution
+	    { 284, tiff_short, 1, tiffValues({ quint16(1) }) },                  // PlanarConfiguration: chunky
+	    { 296, tiff_short, 1, tiffValues({ quint16(3) }) },                  // ResolutionUnit: centimeter
+	};
+	
+	// Values which don't fit into the directory entry are written first.
+	auto const inline_size = big_tiff ? 8 : 4;
+	std::vector<quint64> value_offsets(entries.size(), 0);
+	for (std::size_t i = 0; i < entries.size(); ++i)
+	{
+		if (entries[i].value.size() <= inline_size)
+			continue;
+		
+		if (file.pos() % 2)
+			out << quint8(0);
+		value_offsets[i] = quint64(file.pos());
+		out.writeRawData(entries[i].value.constData(), entries[i].value.size());
+	}
+	
+	if (file.pos() % 2)
+		out << quint8(0);
+	auto const directory_offset = quint64(file.pos());
+	if (big_tiff)
+		out << quint64(entries.size());
+	else
+		out << quint16(entries.size());
+	for (std::size_t i = 0; i < entries.size(); ++i)
+	{
+		auto const& entry = entries[i];
+		out << entry.tag << entry.type;
+		if (big_tiff)
+			out << entry.count;
+		else
+			out << quint32(entry.count);
+		
+		if (value_offsets[i])
+		{
+			if (big_tiff)
+				out << value_offsets[i];
+			else
+				out << quint32(value_offsets[i]);
+		}
+		else
+		{
+			auto value = entry.value;
+			value.append(QByteArray(inline_size - value.size(), 0));
+			out.writeRawData(value.constData(), value.size());
+		}
+	}
+	if (big_tiff)
+		out << quint64(0);
+	else
+		out << quint32(0);
+	
+	// Patch the header
+	if (!file.seek(big_tiff ? 8 : 4))
+		return setError(file.errorString());
+	if (big_tiff)
+		out << directory_offset;
+	else
+		out << quint32(directory_offset);
+	return true;
+}
+
+
+
+bool ImageBandWriter::openBmp()
+{
+	auto const row_size = (3 * qint64(size.width()) + 3) & ~qint64(3);
+	auto const image_size = row_size * size.height();
+	auto const file_size = 54 + image_size;
+	if (file_size > std::numeric_limits<quint32>::max())
+		return setError(tr("The image is too large for this file format."));
+	
+	out.setByteOrder(QDataStream::LittleEndian);
+	out.writeRawData("BM", 2);
+	out << quint32(file_size) << quint16(0) << quint16(0) << quint32(54);
+	out << quint32(40)                      // header size
+	    << qint32(size.width())
+	    << qint32(-size.height())           // top-down
+	    << quint16(1)                       // planes
+	    << quint16(24)                      // bits per pixel
+	    << quint32(0)                       // compression: none
+	    << quint32(image_size)
+	    << qint32(dots_per_meter) << qint32(dots_per_meter)
+	    << quint32(0) << quint32(0);        // colors
+	return true;
+}
+
+bool ImageBandWriter::writeBmpRows(const QImage& band)
+{
+	auto const row_size = (3 * size.width() + 3) & ~3;
+	QByteArray row(row_size, 0);
+	for (int y = 0; y < band.height(); ++y)
+	{
+		convertRow(band, y, row.data(), true);
+		out.writeRawData(row.constData(), row.size());
+		++rows_written;
+	}
+	
+	if (out.status() != QDataStream::Ok)
+		return setError(file.errorString());
+	return true;
+}
+
+
+
+bool ImageBandWriter::setError(const QString& message)
+{
+	error_string = message;
+	return false;
+}
+
+
+}  // namespace OpenOrienteering
@@ -0,0 +1,165 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_IMAGE_BAND_WRITER_H
+#define OPENORIENTEERING_IMAGE_BAND_WRITER_H
+
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QSize>
+#include <QString>
+
+class QImage;
+
+namespace OpenOrienteering {
+
+
+/**
+ * A writer for image files which receives the image in horizontal bands.
+ *
+ * Unlike QImageWriter, this writer never needs the full image in memory.
+ * The rows of each band are encoded and written to the file immediately.
+ * The supported formats are PNG, TIFF (deflate compressed strips, BigTIFF
+ * if necessary) and BMP. The format is determined from the file name.
+ *
+ * All formats are written as 24 bit RGB. Alpha is ignored.
+ *
+ * This writer is meant for images which are too large to be held in memory
+ * as a whole. Smaller images should be written by QImageWriter, which
+ * supports more formats and options, cf. isStreamingNeeded().
+ */
+class ImageBandWriter
+{
+	Q_DECLARE_TR_FUNCTIONS(OpenOrienteering::ImageBandWriter)
+
+public:
+	/**
+	 * Constructs a writer for the given file, image size and resolution.
+	 */
+	ImageBandWriter(const QString& path, QSize size, int dots_per_meter);
+	
+	ImageBandWriter(const ImageBandWriter&) = delete;
+	~ImageBandWriter();
+	
+	ImageBandWriter& operator=(const ImageBandWriter&) = delete;
+	
+	
+	/**
+	 * Returns true if the writer supports the format of the given file name.
+	 */
+	static bool supportsFormat(const QString& path);
+	
+	/**
+	 * Returns true if an image of the given size is large enough to be
+	 * written in bands.
+	 */
+	static bool isStreamingNeeded(QSize size);
+	
+	
+	/**
+	 * Opens the file and writes the header.
+	 */
+	bool open();
+	
+	/**
+	 * Appends the rows of a band to the image.
+	 *
+	 * The band must have the width of the image. Its format must be
+	 * QImage::Format_RGB32 or QImage::Format_ARGB32_Premultiplied.
+	 */
+	bool write(const QImage& band);
+	
+	/**
+	 * Writes the remaining data and closes the file.
+	 *
+	 * This fails if less rows were written than the height of the image.
+	 */
+	bool close();
+	
+	/**
+	 * Returns the error string of the last failed operation.
+	 */
+	QString errorString() const;
+
+
+private:
+	enum Format
+	{
+		Png,
+		Tiff,
+		Bmp,
+		Unsupported
+	};
+	
+	/** A TIFF directory entry, with the value in file byte order. */
+	struct TiffEntry
+	{
+		quint16 tag;
+		quint16 type;
+		quint64 count;
+		QByteArray value;
+	};
+	
+	static Format formatForPath(const QString& path);
+	
+	bool openPng();
+	bool writePngRows(const QByteArray& rows, bool finish);
+	void writePngChunk(const char* type, const QByteArray& data);
+	bool closePng();
+	
+	bool openTiff();
+	bool writeTiffStrip();
+	bool closeTiff();
+	
+	bool openBmp();
+	bool writeBmpRows(const QImage& band);
+	
+	bool setError(const QString& message);
+	
+	QString path;
+	QString error_string;
+	QFile file;
+	QDataStream out;
+	QSize size;
+	int dots_per_meter;
+	int rows_written = 0;
+	Format format;
+	
+	struct ZStream;
+	std::unique_ptr<ZStream> zstream;    ///< The PNG deflate state
+	QByteArray png_buffer;               ///< The output buffer of the PNG deflate stream
+	
+	QByteArray strip;                    ///< The pending rows of the current TIFF strip
+	int rows_per_strip = 0;
+	bool big_tiff = false;
+	std::vector<quint64> strip_offsets;
+	std::vector<quint64> strip_byte_counts;
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif
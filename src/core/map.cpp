@@ -24,10 +24,13 @@
 #include <algorithm>
 #include <cmath>
 #include <exception>
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <unordered_map>
 
 #include <Qt>
+#include <QtConcurrentMap>
 #include <QtGlobal>
 #include <QtMath>
 #include <QByteArray>
@@ -59,6 +62,7 @@
 #include "core/objects/object.h"
 #include "core/objects/object_operations.h"
 #include "core/renderables/renderable.h"
+#include "core/symbols/area_symbol.h"
 #include "core/symbols/combined_symbol.h"
 #include "core/symbols/line_symbol.h"
 #include "core/symbols/point_symbol.h"
@@ -140,6 +144,56 @@ void showMessageBox(QWidget* parent, const QString& title, const QString& headli
 }
 
 
+/**
+ * Returns true if the symbol's renderables are created from point symbol elements.
+ * 
+ * The element objects of a point symbol are shared by all objects using
+ * the symbol, so these renderables must not be created concurrently.
+ */
+bool usesPointElements(const Symbol* symbol)
+{
+	if (!symbol)
+		return false;
+	
+	switch (symbol->getType())
+	{
+	case Symbol::Point:
+		return symbol->asPoint()->getNumElements() > 0;
+	case Symbol::Line:
+		{
+			auto const line = symbol->asLine();
+			return usesPointElements(line->getStartSymbol())
+			       || usesPointElements(line->getMidSymbol())
+			       || usesPointElements(line->getEndSymbol())
+			       || usesPointElements(line->getDashSymbol());
+		}
+	case Symbol::Area:
+		{
+			auto const area = symbol->asArea();
+			for (int i = 0; i < area->getNumFillPatterns(); ++i)
+			{
+				auto const& pattern = area->getFillPattern(i);
+				if (pattern.type == AreaSymbol::FillPattern::PointPattern && usesPointElements(pattern.point))
+					return true;
+			}
+			return false;
+		}
+	case Symbol::Combined:
+		{
+			auto const combined = symbol->asCombined();
+			for (int i = 0; i < combined->getNumParts(); ++i)
+			{
+				if (usesPointElements(combined->getPart(i)))
+					return true;
+			}
+			return false;
+		}
+	default:
+		return false;
+	}
+}
+
+
 }  // namespace
 
 
@@ -428,7 +482,6 @@ MapColorMap Map::MapColorSet::importSet(const Map::MapColorSet& other, std::vect
 
 // ### Map ###
 
-bool Map::static_initialized = false;
 MapColor Map::covering_white(MapColor::CoveringWhite);
 MapColor Map::covering_red(MapColor::CoveringRed);
 MapColor Map::undefined_symbol_color(MapColor::Undefined);
@@ -449,8 +502,9 @@ Map::Map()
  , renderable_options(Symbol::RenderNormal)
  , printer_config(nullptr)
 {
-	if (!static_initialized)
-		initStatic();
+	// Maps may be created on multiple threads.
+	static bool const initialized = (initStatic(), true);
+	Q_UNUSED(initialized)
 	
 	georeferencing.reset(new Georeferencing());
 	init();
@@ -488,11 +542,14 @@ void Map::clear()
 	for (MapPart* part : parts)
 		delete part;
 	parts.clear();
+	dirty_objects.clear();
+	++render_revision;
 	current_part_index = 0;
 	
 	for (auto symbol : symbols)
 		delete symbol;
 	symbols.clear();
+	symbol_positions.clear();
 	
 	// Don't clear() color_set: It is shared.
 }
@@ -716,18 +773,28 @@ bool Map::exportTo(const QString& path, MapView* view, const FileFormat* format)
 }
 
 bool Map::loadFrom(const QString& path, QWidget* dialog_parent, MapView* view, bool load_symbols_only, bool show_error_messages)
+{
+	QString error_message;
+	auto importer = importFrom(path, view, load_symbols_only, nullptr, error_message);
+	if (!importer)
+	{
+		if (show_error_messages)
+			QMessageBox::warning(dialog_parent, tr("Error"), error_message);
+		return false;
+	}
+	
+	finishLoading(*importer, path, show_error_messages);
+	return true;
+}
+
+std::unique_ptr<Importer> Map::importFrom(const QString& path, MapView* view, bool load_symbols_only, ImportProgress* progress, QString& error_message)
 {
 	// Ensure the file exists and is readable.
 	QFile file(path);
 	if (!file.open(QIODevice::ReadOnly))
 	{
-		if (show_error_messages)
-			QMessageBox::warning(
-			  dialog_parent,
-			  tr("Error"),
-			  tr("Cannot open file:\n%1\nfor reading.").arg(path)
-			);
-		return false;
+		error_message = tr("Cannot open file:\n%1\nfor reading.").arg(path);
+		return {};
 	}
 	
 	// Delete previous objects
@@ -738,21 +805,21 @@ bool Map::loadFrom(const QString& path, QWidget* dialog_parent, MapView* view, b
 	size_t total_read = file.read((char *)buffer, 256);
 	file.seek(0);
 
-	bool import_complete = false;
+	std::unique_ptr<Importer> importer;
 	QString error_msg = tr("Invalid file type.");
 	for (auto format : FileFormats.formats())
 	{
 		// If the format supports import, and thinks it can understand the file header, then proceed.
 		if (format->supportsImport() && format->understands(buffer, total_read))
 		{
-			Importer *importer = nullptr;
 			// Wrap everything in a try block, so we can gracefully recover if the importer balks.
 			try {
 				// Create an importer instance for this file and map.
-				importer = format->createImporter(&file, this, view);
+				importer.reset(format->createImporter(&file, this, view));
+				importer->setProgress(progress);
 
 				// Run the first pass.
-				importer->doImport(load_symbols_only, QFileInfo(path).absolutePath());
+				importer->doImportData(load_symbols_only);
 
 				// Are there any actions the user must take to complete the import?
 				if (!importer->actions().empty())
@@ -762,19 +829,10 @@ bool Map::loadFrom(const QString& path, QWidget* dialog_parent, MapView* view, b
 
 				// Finish the import.
 				importer->finishImport();
+				importer->setProgress(nullptr);
 				
 				file.close();
-
-				// Display any warnings.
-				if (!importer->warnings().empty() && show_error_messages)
-				{
-					showMessageBox(nullptr,
-					               tr("Warning"),
-					               tr("The map import generated warnings."),
-					               importer->warnings() );
-				}
-
-				import_complete = true;
+				break;
 			}
 			catch (FileFormatException &e)
 			{
@@ -785,10 +843,12 @@ bool Map::loadFrom(const QString& path, QWidget* dialog_parent, MapView* view, b
 				qDebug() << "Exception:" << e.what();
 				error_msg = QString::fromLatin1(e.what());
 			}
-			if (importer) delete importer;
+			importer.reset();
 		}
-		// If the last importer finished successfully
-		if (import_complete) break;
+		
+		// Don't try other formats when canceled.
+		if (progress && progress->canceled)
+			break;
 	}
 	
 	if (view)
@@ -796,23 +856,43 @@ bool Map::loadFrom(const QString& path, QWidget* dialog_parent, MapView* view, b
 		view->setPanOffset(QPoint(0, 0));
 	}
 
-	if (!import_complete)
+	if (!importer)
 	{
-		if (show_error_messages)
-			QMessageBox::warning(
-			 dialog_parent,
-			 tr("Error"),
-			 tr("Cannot open file:\n%1\n\n%2").arg(path, error_msg)
-			);
-		return false;
+		error_message = tr("Cannot open file:\n%1\n\n%2").arg(path, error_msg);
+		return {};
 	}
 
 	// Update all objects without trying to remove their renderables first, this gives a significant speedup when loading large files
 	updateAllObjects(); // TODO: is the comment above still applicable?
 	
+	return importer;
+}
+
+void Map::finishLoading(Importer& importer, const QString& path, bool show_error_messages)
+{
+	importer.loadTemplates(QFileInfo(path).absolutePath());
+	
+	// Display any warnings.
+	if (!importer.warnings().empty() && show_error_messages)
+	{
+		showMessageBox(nullptr,
+		               tr("Warning"),
+		               tr("The map import generated warnings."),
+		               importer.warnings() );
+	}
+	
 	setHasUnsavedChanges(false);
+}
 
-	return true;
+void Map::moveAllToThread(QThread* thread)
+{
+	moveToThread(thread);
+	undo_manager->moveToThread(thread);
+	georeferencing->moveToThread(thread);
+	for (auto temp : templates)
+		temp->moveToThread(thread);
+	for (auto temp : closed_templates)
+		temp->moveToThread(thread);
 }
 
 void Map::importMap(
@@ -1049,6 +1129,11 @@ void Map::draw(QPainter* painter, const RenderConfig& config)
 	updateObjects();
 	
 	// The actual drawing
+	drawWithoutUpdate(painter, config);
+}
+
+void Map::drawWithoutUpdate(QPainter* painter, const RenderConfig& config) const
+{
 	renderables->draw(painter, config);
 }
 
@@ -1058,6 +1143,11 @@ void Map::drawOverprintingSimulation(QPainter* painter, const RenderConfig& conf
 	updateObjects();
 	
 	// The actual drawing
+	drawOverprintingSimulationWithoutUpdate(painter, config);
+}
+
+void Map::drawOverprintingSimulationWithoutUpdate(QPainter* painter, const RenderConfig& config) const
+{
 	renderables->drawOverprintingSimulation(painter, config);
 }
 
@@ -1101,8 +1191,33 @@ void Map::drawTemplates(QPainter* painter, const QRectF& bounding_box, int first
 
 void Map::updateObjects()
 {
-	// TODO: It maybe would be better if the objects entered themselves into a separate list when they get dirty so not all objects have to be traversed here
-	applyOnAllObjects(&Object::update);
+	if (dirty_objects.empty())
+		return;
+	
+	// Objects may become dirty again while updating.
+	std::vector<const Object*> objects;
+	objects.swap(dirty_objects);
+	for (auto object : objects)
+	{
+		++object_update_counters.visited;
+		// Enlisted objects may have been removed from the map, or deleted.
+		auto const in_map = std::any_of(begin(parts), end(parts), [object](auto part) {
+			return part->containsObject(object);
+		});
+		if (in_map && object->update())
+			++object_update_counters.updated;
+	}
+}
+
+void Map::enlistDirtyObject(const Object* object)
+{
+	dirty_objects.push_back(object);
+	++object_update_counters.enlisted;
+}
+
+void Map::resetObjectUpdateCounters()
+{
+	object_update_counters = {};
 }
 
 void Map::removeRenderablesOfObject(const Object* object, bool mark_area_as_dirty)
@@ -1116,6 +1231,8 @@ void Map::insertRenderablesOfObject(const Object* object)
 	renderables->insertRenderablesOfObject(object);
 	if (isObjectSelected(object))
 		addSelectionRenderables(object);
+	for (auto part : parts)
+		part->updateObjectExtent(object);
 }
 
 
@@ -1176,26 +1293,21 @@ void Map::getSelectionToSymbolCompatibility(const Symbol* symbol, bool& out_comp
 
 void Map::deleteSelectedObjects()
 {
-	auto obj = selectedObjectsBegin();
-	auto end = selectedObjectsEnd();
-	if (obj != end)
+	if (!object_selection.empty())
 	{
 		// FIXME: this is not ready for multiple map parts.
 		auto undo_step = new AddObjectsUndoStep(this);
 		MapPart* part = getCurrentPart();
-	
-		for (; obj != end; ++obj)
+		
+		auto const selection = std::vector<Object*>(begin(object_selection), end(object_selection));
+		auto const deleted = part->deleteObjects(selection, true);
+		for (auto const& entry : deleted)
+			undo_step->addObject(entry.first, entry.second);
+		
+		if (deleted.size() != selection.size())
 		{
-			int index = part->findObjectIndex(*obj);
-			if (index >= 0)
-			{
-				undo_step->addObject(index, *obj);
-				part->deleteObject(index, true);
-			}
-			else
-			{
-				qDebug() << this << "::deleteSelectedObjects(): Object" << *obj << "not found in current map part.";
-			}
+			qDebug() << this << "::deleteSelectedObjects():" << selection.size() - deleted.size()
+			         << "objects not found in current map part.";
 		}
 		
 		setObjectsDirty();
@@ -1335,6 +1447,7 @@ void Map::removeMapWidget(MapWidget* widget)
 
 void Map::updateAllMapWidgets()
 {
+	++render_revision;
 	for (MapWidget* widget : widgets)
 		widget->updateEverything();
 }
@@ -1721,8 +1834,6 @@ void Map::removeSelectionRenderables(const Object* object)
 
 void Map::initStatic()
 {
-	static_initialized = true;
-	
 	covering_white_line = new LineSymbol();
 	covering_white_line->setColor(&covering_white);
 	covering_white_line->setLineWidth(3.0);
@@ -1755,6 +1866,10 @@ void Map::initStatic()
 void Map::addSymbol(Symbol* symbol, int pos)
 {
 	symbols.insert(symbols.begin() + pos, symbol);
+	if (std::size_t(pos) + 1 == symbols.size() && !symbol_positions.empty())
+		symbol_positions[symbol] = pos;
+	else
+		symbol_positions.clear();
 	if (symbols.size() == 1)
 	{
 		// This is the first symbol - the help text in the map widget(s) should be updated
@@ -1771,6 +1886,7 @@ void Map::moveSymbol(int from, int to)
 	if (from > to)
 		++from;
 	symbols.erase(symbols.begin() + from);
+	symbol_positions.clear();
 	// TODO: emit symbolChanged(pos, symbol); ?
 	setSymbolsDirty();
 }
@@ -1826,6 +1942,8 @@ void Map::setSymbol(Symbol* symbol, int pos)
 	
 	// Change the symbol
 	symbols[pos] = symbol;
+	if (symbol_positions.erase(old_symbol))
+		symbol_positions[symbol] = pos;
 	emit symbolChanged(pos, symbol, old_symbol);
 	setSymbolsDirty();
 	delete old_symbol;
@@ -1853,6 +1971,7 @@ void Map::deleteSymbol(int pos)
 	Symbol* temp = symbols[pos];
 	delete symbols[pos];
 	symbols.erase(symbols.begin() + pos);
+	symbol_positions.clear();
 	
 	if (symbols.empty())
 	{
@@ -1868,12 +1987,20 @@ int Map::findSymbolIndex(const Symbol* symbol) const
 {
 	if (!symbol)
 		return -1;
-	int size = (int)symbols.size();
-	for (int i = 0; i < size; ++i)
+	
+	// Every change to the symbol list clears the positions.
+	if (symbol_positions.empty())
 	{
-		if (symbols[i] == symbol)
-			return i;
+		symbol_positions.reserve(symbols.size());
+		for (std::size_t i = 0; i < symbols.size(); ++i)
+		{
+			if (symbols[i])
+				symbol_positions[symbols[i]] = int(i);
+		}
 	}
+	auto const found = symbol_positions.find(symbol);
+	if (found != symbol_positions.end())
+		return found->second;
 	
 	if (symbol == undefined_point)
 		return -2;
@@ -1926,16 +2053,8 @@ void Map::scaleAllSymbols(double factor)
 void Map::determineSymbolsInUse(std::vector< bool >& out) const
 {
 	out.assign(symbols.size(), false);
-	for (auto part : parts)
-	{
-		for (int o = 0; o < part->getNumObjects(); ++o)
-		{
-			const Symbol* symbol = part->getObject(o)->getSymbol();
-			int index = findSymbolIndex(symbol);
-			if (index >= 0)
-				out[index] = true;
-		}
-	}
+	for (std::size_t i = 0; i < symbols.size(); ++i)
+		out[i] = existsObjectWithSymbol(symbols[i]);
 	
 	determineSymbolUseClosure(out);
 }
@@ -2508,36 +2627,122 @@ void Map::rotateAllObjects(double rotation, const MapCoord& center)
 
 void Map::updateAllObjects()
 {
-	applyOnAllObjects(&Object::forceUpdate);
+	// All objects will be up-to-date, so none needs to stay enlisted.
+	dirty_objects.clear();
+	
+	std::vector<const Object*> objects;
+	objects.reserve(std::size_t(getNumObjects()));
+	applyOnAllObjects([&objects](const Object* object) { objects.push_back(object); });
+	forceUpdateObjects(objects);
 }
 
 void Map::updateAllObjectsWithSymbol(const Symbol* symbol)
 {
-	applyOnMatchingObjects(&Object::forceUpdate, ObjectOp::HasSymbol{symbol});
+	std::vector<const Object*> objects;
+	for (auto part : parts)
+	{
+		auto const part_objects = part->objectsWithSymbol(symbol);
+		objects.insert(end(objects), begin(part_objects), end(part_objects));
+	}
+	forceUpdateObjects(objects);
+}
+
+void Map::forceUpdateObjects(std::vector<const Object*>& objects)
+{
+	auto const options = Symbol::RenderableOptions(QFlag(renderableOptions()));
+	
+	// The objects will be up-to-date, so they need not stay enlisted.
+	if (!dirty_objects.empty())
+	{
+		auto updated = objects;
+		std::sort(begin(updated), end(updated));
+		dirty_objects.erase(std::remove_if(begin(dirty_objects), end(dirty_objects), [&updated](const Object* object) {
+			return std::binary_search(begin(updated), end(updated), object);
+		}), end(dirty_objects));
+	}
+	
+	// Renderables are created concurrently only from state which is owned
+	// by the object or read-only. Text layout, baseline rendering and point
+	// symbol elements rely on shared state, so these objects are updated
+	// sequentially. Objects which are not attached to this map are not
+	// drawn by it.
+	auto concurrent_end = begin(objects);
+	if (!options.testFlag(Symbol::RenderBaselines))
+	{
+		std::unordered_map<const Symbol*, bool> concurrent_symbols;
+		auto const is_concurrent = [&concurrent_symbols](const Symbol* symbol) {
+			auto found = concurrent_symbols.find(symbol);
+			if (found == concurrent_symbols.end())
+				found = concurrent_symbols.emplace(symbol, !usesPointElements(symbol)).first;
+			return found->second;
+		};
+		concurrent_end = std::stable_partition(begin(objects), end(objects), [this, &is_concurrent](const Object* object) {
+			return object->getMap() == this
+			       && object->getType() != Object::Text
+			       && is_concurrent(object->getSymbol());
+		});
+	}
+	
+	for (auto object = begin(objects); object != concurrent_end; ++object)
+	{
+		if ((*object)->getExtent().isValid())
+			setObjectAreaDirty((*object)->getExtent());
+	}
+	
+	QtConcurrent::blockingMap(begin(objects), concurrent_end, [options](const Object* object) {
+		object->regenerateOutput(options);
+	});
+	
+	for (auto object = begin(objects); object != concurrent_end; ++object)
+	{
+		insertRenderablesOfObject(*object);
+		if ((*object)->getExtent().isValid())
+			setObjectAreaDirty((*object)->getExtent());
+	}
+	
+	std::for_each(concurrent_end, end(objects), std::mem_fn(&Object::forceUpdate));
 }
 
 void Map::changeSymbolForAllObjects(const Symbol* old_symbol, const Symbol* new_symbol)
 {
-	applyOnMatchingObjects(ObjectOp::ChangeSymbol{new_symbol}, ObjectOp::HasSymbol{old_symbol});
+	for (auto part : parts)
+	{
+		std::vector<Object*> incompatible_objects;
+		for (auto object : part->objectsWithSymbol(old_symbol))
+		{
+			if (!object->setSymbol(new_symbol, false))
+				incompatible_objects.push_back(object);
+			else
+				object->update();
+		}
+		part->deleteObjects(incompatible_objects, false);
+	}
 }
 
 bool Map::deleteAllObjectsWithSymbol(const Symbol* symbol)
 {
-	bool exists = existsObject(ObjectOp::HasSymbol{symbol});
+	bool exists = existsObjectWithSymbol(symbol);
 	if (exists)
 	{
 		// Remove objects from selection
 		removeSymbolFromSelection(symbol, true);
 	
 		// Delete objects from map
-		applyOnMatchingObjects(ObjectOp::Delete(), ObjectOp::HasSymbol{symbol});
+		for (auto part : parts)
+			part->deleteObjects(part->objectsWithSymbol(symbol), false);
 	}
 	return exists;
 }
 
 bool Map::existsObjectWithSymbol(const Symbol* symbol) const
 {
-	return existsObject(ObjectOp::HasSymbol{symbol});
+	return std::any_of(begin(parts), end(parts), [symbol](auto part) { return part->existsObjectWithSymbol(symbol); });
+}
+
+void Map::updateObjectSymbol(const Object* object, const Symbol* old_symbol)
+{
+	for (auto part : parts)
+		part->updateObjectSymbol(object, old_symbol);
 }
 
 void Map::setGeoreferencing(const Georeferencing& georeferencing)
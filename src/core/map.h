@@ -25,7 +25,9 @@
 #include <algorithm>
 #include <cstddef>
 #include <functional>
+#include <memory>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include <QtGlobal>
@@ -47,6 +49,7 @@
 
 class QIODevice;
 class QPainter;
+class QThread;
 class QTranslator;
 class QWidget;
 // IWYU pragma: no_forward_declare QRectF
@@ -56,6 +59,8 @@ namespace OpenOrienteering {
 class CombinedSymbol;
 class FileFormat;
 class Georeferencing;
+struct ImportProgress;
+class Importer;
 class LineSymbol;
 class MapColor;
 class MapColorMap;
@@ -194,6 +199,41 @@ public:
 	              MapView* view = nullptr,
 	              bool load_symbols_only = false, bool show_error_messages = true);
 	
+	/**
+	 * Reads the map from the specified path, without any user interaction.
+	 * 
+	 * This is the first part of loadFrom(). It may run on a worker thread,
+	 * for a map and view which belong to this thread. Templates are not
+	 * loaded yet.
+	 * 
+	 * On success, returns the importer which must be passed to finishLoading().
+	 * On failure, returns nullptr and sets the error message. The import
+	 * may be canceled via the optional progress object.
+	 */
+	std::unique_ptr<Importer> importFrom(const QString& path,
+	                                     MapView* view,
+	                                     bool load_symbols_only,
+	                                     ImportProgress* progress,
+	                                     QString& error_message);
+	
+	/**
+	 * Completes loading the map after importFrom().
+	 * 
+	 * This loads the templates and shows the warnings. It must run on the
+	 * thread which owns the map.
+	 */
+	void finishLoading(Importer& importer,
+	                   const QString& path,
+	                   bool show_error_messages = true);
+	
+	/**
+	 * Changes the thread affinity of the map and of the objects it owns.
+	 * 
+	 * This must be called from the map's current thread. Child objects,
+	 * such as a MapView created with the map as parent, are moved, too.
+	 */
+	void moveAllToThread(QThread* thread);
+	
 	/**
 	 * Imports the other map into this map with the following strategy:
 	 *  - if the other map contains objects, import all objects with the minimum
@@ -253,11 +293,27 @@ public:
 	/**
 	 * Draws the part of the map which is visible in the bounding box.
 	 * 
+	 * This function updates dirty objects first. It must not be called
+	 * concurrently. Use drawWithoutUpdate() for concurrent drawing.
+	 * 
 	 * @param painter The QPainter used for drawing.
 	 * @param config  The rendering configuration
 	 */
 	void draw(QPainter* painter, const RenderConfig& config);
 	
+	/**
+	 * Draws the part of the map which is visible in the bounding box,
+	 * without updating dirty objects.
+	 * 
+	 * This function does not modify the map. After updateObjects(), it may
+	 * be called concurrently from multiple threads, as long as the map is
+	 * not modified meanwhile.
+	 * 
+	 * @param painter The QPainter used for drawing.
+	 * @param config  The rendering configuration
+	 */
+	void drawWithoutUpdate(QPainter* painter, const RenderConfig& config) const;
+	
 	/**
 	 * Draws a spot color overprinting simulation for the part of the map
 	 * which is visible in the given bounding box.
@@ -267,6 +323,14 @@ public:
 	 */
 	void drawOverprintingSimulation(QPainter* painter, const RenderConfig& config);
 	
+	/**
+	 * Draws a spot color overprinting simulation like
+	 * drawOverprintingSimulation(), but without updating dirty objects.
+	 * 
+	 * Like drawWithoutUpdate(), this function does not modify the map.
+	 */
+	void drawOverprintingSimulationWithoutUpdate(QPainter* painter, const RenderConfig& config) const;
+	
 	/**
 	 * Draws the separation for a particular spot color for the part of the
 	 * map which is visible in the given bounding box.
@@ -316,10 +380,41 @@ public:
 	
 	/**
 	 * Updates the renderables and extent of all objects which have changed.
+	 * 
+	 * Only the objects enlisted by enlistDirtyObject() are visited.
 	 * This is automatically called by draw(), you normally do not need to call it directly.
 	 */
 	void updateObjects();
 	
+	/**
+	 * Enlists an object for the next call of updateObjects().
+	 * 
+	 * This is called by Object when its output becomes dirty. The object
+	 * will only be updated if it is contained in a map part at that time.
+	 * Thus the object may be deleted before it is updated.
+	 */
+	void enlistDirtyObject(const Object* object);
+	
+	/**
+	 * Counters for the work done by updateObjects().
+	 */
+	struct ObjectUpdateCounters
+	{
+		std::size_t enlisted = 0;  ///< The number of objects enlisted as dirty.
+		std::size_t visited  = 0;  ///< The number of enlisted objects visited by updateObjects().
+		std::size_t updated  = 0;  ///< The number of objects updated by updateObjects().
+	};
+	
+	/**
+	 * Returns the counters for the work done by updateObjects().
+	 */
+	const ObjectUpdateCounters& objectUpdateCounters() const;
+	
+	/**
+	 * Resets the counters for the work done by updateObjects().
+	 */
+	void resetObjectUpdateCounters();
+	
 	/** 
 	 * Calculates the extent of all map elements. 
 	 * 
@@ -344,9 +439,20 @@ public:
 	/**
 	 * Redraws all map widgets completely - this can be slow!
 	 * Try to avoid this and do partial redraws instead, if possible.
+	 * 
+	 * This increments the map's revision.
 	 */
 	void updateAllMapWidgets();
 	
+	/**
+	 * Returns a counter which changes when the map needs to be redrawn completely.
+	 * 
+	 * Caches of rendered map content which are invalidated only for the
+	 * areas passed to setObjectAreaDirty() must be discarded when this
+	 * revision changes.
+	 */
+	quint64 revision() const;
+	
 	/**
 	 * Makes sure that the selected object(s) are visible in all map widgets
 	 * by moving the views in the widgets to the selected objects.
@@ -551,9 +657,12 @@ public:
 	void deleteSymbol(int pos);
 	
 	/**
-	 * Loops over all symbols, looking for the given symbol pointer.
-	 * Returns the index of the symbol, or -1 if the symbol is not found.
+	 * Returns the index of the given symbol pointer.
+	 * Returns -1 if the symbol is not found.
 	 * For the "undefined" symbols, returns special indices smaller than -1.
+	 * 
+	 * The lookup uses a hash table which is rebuilt after changes to the
+	 * symbol list.
 	 */
 	int findSymbolIndex(const Symbol* symbol) const;
 	
@@ -890,6 +999,9 @@ public:
 	 *     an object has been found and is taken from Symbol::Type. This is e.g.
 	 *     important for combined symbols, which can be found from a line or
 	 *     an area.
+	 * 
+	 * Objects are found at the extent of their last update. Callers must call
+	 * updateObjects() first if objects may have been edited.
 	 */
 	void findObjectsAt(MapCoordF coord, float tolerance, bool treat_areas_as_paths,
 		bool extended_selection, bool include_hidden_objects,
@@ -912,6 +1024,8 @@ public:
 	 * @param include_hidden_objects Set to true if you want to find hidden objects.
 	 * @param include_protected_objects Set to true if you want to find protected objects.
 	 * @param out Output parameter. Will be filled with an object list.
+	 * 
+	 * Like findObjectsAt(), this requires up-to-date objects.
 	 */
 	void findObjectsAtBox(MapCoordF corner1, MapCoordF corner2,
 		bool include_hidden_objects, bool include_protected_objects,
@@ -925,6 +1039,8 @@ public:
 	 * 
 	 * @param map_coord_rect The query rect.
 	 * @param include_hidden_objects Set to true if you want to find hidden objects.
+	 * 
+	 * Like findObjectsAt(), this requires up-to-date objects.
 	 */
 	int countObjectsInRect(const QRectF& map_coord_rect, bool include_hidden_objects);
 	
@@ -963,10 +1079,18 @@ public:
 	/** Rotates all objects by the given rotation angle (in radians). */
 	void rotateAllObjects(double rotation, const MapCoord& center);
 	
-	/** Forces an update of all objects, i.e. calls update(true) on each map object. */
+	/**
+	 * Forces an update of all objects, i.e. calls forceUpdate() on each map object.
+	 * 
+	 * The renderables are generated in parallel where possible.
+	 */
 	void updateAllObjects();
 	
-	/** Forces an update of all objects with the given symbol. */
+	/**
+	 * Forces an update of all objects with the given symbol.
+	 * 
+	 * The renderables are generated in parallel where possible.
+	 */
 	void updateAllObjectsWithSymbol(const Symbol* symbol);
 	
 	/** For all symbols with old_symbol, replaces the symbol by new_symbol. */
@@ -979,6 +1103,13 @@ public:
 	 */
 	bool deleteAllObjectsWithSymbol(const Symbol* symbol);
 	
+	/**
+	 * Updates the lookup of objects by symbol after an object's symbol has changed.
+	 * 
+	 * This is called by Object when the symbol is changed.
+	 */
+	void updateObjectSymbol(const Object* object, const Symbol* old_symbol);
+	
 	/**
 	 * Returns if at least one object with the given symbol exists in the map.
 	 * WARNING: Even if no objects exist directly, the symbol could still be
@@ -995,6 +1126,8 @@ public:
 	
 	/**
 	 * Inserts the renderables of the given object, so they will be displayed.
+	 * 
+	 * Also updates the spatial index of the part containing the object.
 	 */
 	void insertRenderablesOfObject(const Object* object);
 	
@@ -1501,6 +1634,16 @@ private:
 	);
 	
 	
+	/**
+	 * Forces an update of the given objects.
+	 * 
+	 * The output of the objects is generated in parallel where possible.
+	 * The map itself is only modified on the calling thread, in the order
+	 * of the given objects, so the result is the same as for calling
+	 * Object::forceUpdate() on each object.
+	 */
+	void forceUpdateObjects(std::vector<const Object*>& objects);
+	
 	void addSelectionRenderables(const Object* object);
 	void updateSelectionRenderables(const Object* object);
 	void removeSelectionRenderables(const Object* object);
@@ -1511,6 +1654,8 @@ private:
 	bool has_spot_colors;
 	QString symbol_set_id;
 	SymbolVector symbols;
+	/// The positions of the symbols in the list. Cleared on every change to the list.
+	mutable std::unordered_map<const Symbol*, int> symbol_positions;
 	mutable qreal symbol_icon_scale = 0;
 	TemplateVector templates;
 	TemplateVector closed_templates;
@@ -1548,9 +1693,12 @@ private:
 	
 	std::set<Object*> irregular_objects;
 	
+	std::vector<const Object*> dirty_objects;
+	ObjectUpdateCounters object_update_counters;
+	quint64 render_revision = 0;
+	
 	// Static
 	
-	static bool static_initialized;
 	static MapColor covering_white;
 	static MapColor covering_red;
 	static MapColor undefined_symbol_color;
@@ -1613,6 +1761,20 @@ const MapColor* Map::getColor(int i) const
 
 
 
+inline
+const Map::ObjectUpdateCounters& Map::objectUpdateCounters() const
+{
+	return object_update_counters;
+}
+
+inline
+quint64 Map::revision() const
+{
+	return render_revision;
+}
+
+
+
 inline
 QString Map::symbolSetId() const
 {
@@ -1630,6 +1792,7 @@ template<typename T>
 void Map::sortSymbols(T compare)
 {
 	std::stable_sort(symbols.begin(), symbols.end(), compare);
+	symbol_positions.clear();
 	// TODO: emit symbolChanged(pos, symbol); ? s/b same choice as for moveSymbol()
 	setSymbolsDirty();
 }
@@ -139,7 +139,8 @@ namespace
 constexpr qint64 min_coord = -50000000;
 constexpr qint64 max_coord = +50000000;
 
-MapCoord::BoundsOffset bounds_offset;
+// Per thread, because maps may be imported on multiple threads at the same time.
+thread_local MapCoord::BoundsOffset bounds_offset;
 
 inline
 void applyBoundsOffset(qint64& x64, qint64& y64)
@@ -254,6 +255,13 @@ MapCoord MapCoord::load(QPointF p, MapCoord::Flags flags)
 	return MapCoord::load(p.x(), p.y(), flags);
 }
 
+MapCoord MapCoord::loadNative(qint64 x64, qint64 y64, MapCoord::Flags flags)
+{
+	handleBoundsOffset(x64, y64);
+	ensureBoundsForQint32(x64, y64);
+	return MapCoord { static_cast<qint32>(x64), static_cast<qint32>(y64), flags };
+}
+
 #ifndef NO_NATIVE_FILE_FORMAT
 	
 MapCoord::MapCoord(const LegacyMapCoord& coord) noexcept
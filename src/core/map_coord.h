@@ -157,7 +157,7 @@ private:
 	Flags  fp;
 	
 public:
-	/** Returns the global bounds offset.
+	/** Returns the current thread's bounds offset.
 	 *
 	 * It is returned as a non-const reference, so that it can be used in
 	 * QScopedValueRollack.
@@ -454,6 +454,14 @@ public:
 	
 	static MapCoord load(QPointF p, int flags) = delete;
 	
+	/** Creates a MapCoord from native map coordinates, with offset handling.
+	 * 
+	 * This will initialize the boundsOffset() if neccessary. Otherwise it will
+	 * apply the BoundsOffset() and throw a std::range_error if the adjusted
+	 * coordinates are out of bounds for qint32.
+	 */
+	static MapCoord loadNative(qint64 x64, qint64 y64, MapCoord::Flags flags);
+	
 	
 	friend constexpr bool operator==(const MapCoord& lhs, const MapCoord& rhs);
 	friend constexpr MapCoord operator+(const MapCoord& lhs, const MapCoord& rhs);
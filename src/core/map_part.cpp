@@ -22,7 +22,10 @@
 #include "map_part.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+#include <memory>
+#include <unordered_set>
 
 #include <QtGlobal>
 #include <QIODevice>
@@ -96,6 +99,8 @@ bool MapPart::load(QIODevice* file, int version, Map* map)
 			return false;
 		object->load(file, version, map);
 	}
+	spatial_index_valid = false;
+	object_positions_built = false;
 	return true;
 }
 
@@ -117,12 +122,13 @@ void MapPart::save(QXmlStreamWriter& xml) const
 	}
 }
 
-MapPart* MapPart::load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol_dict)
+MapPart* MapPart::load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol_dict, const std::function<void ()>& object_loaded)
 {
 	Q_ASSERT(xml.name() == literal::part);
 	
 	XmlElementReader part_element(xml);
-	auto part = new MapPart(part_element.attribute<QString>(literal::name), &map);
+	// The part is released only when complete, e.g. when the import is canceled.
+	auto part = std::make_unique<MapPart>(part_element.attribute<QString>(literal::name), &map);
 	
 	while (xml.readNextStartElement())
 	{
@@ -137,7 +143,11 @@ MapPart* MapPart::load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol
 			while (xml.readNextStartElement())
 			{
 				if (xml.name() == literal::object)
+				{
 					part->objects.push_back(Object::load(xml, &map, symbol_dict));
+					if (object_loaded)
+						object_loaded();
+				}
 				else
 					xml.skipCurrentElement(); // unknown
 			}
@@ -146,30 +156,38 @@ MapPart* MapPart::load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol
 			xml.skipCurrentElement(); // unknown
 	}
 	
-	return part;
+	return part.release();
 }
 
 int MapPart::findObjectIndex(const Object* object) const
 {
-	int size = objects.size();
-	for (int i = size - 1; i >= 0; --i)
+	if (!containsObject(object))
 	{
-		if (objects[i] == object)
-			return i;
+		Q_ASSERT(false);
+		return -1;
 	}
-	Q_ASSERT(false);
-	return -1;
+	return int(objectPosition(object));
 }
 
 void MapPart::setObject(Object* object, int pos, bool delete_old)
 {
 	map->removeRenderablesOfObject(objects[pos], true);
+	if (spatial_index_valid)
+		spatial_index.remove(objects[pos]);
+	if (object_positions_built)
+		object_positions.erase(objects[pos]);
+	unindexSymbol(objects[pos]);
 	if (delete_old)
 		delete objects[pos];
 	
 	objects[pos] = object;
 	object->setMap(map);
 	object->update();
+	if (spatial_index_valid)
+		spatial_index.insert(object, object->getExtent());
+	if (object_positions_built)
+		object_positions[object] = std::size_t(pos);
+	indexSymbol(object);
 	map->setObjectsDirty(); // TODO: remove from here, dirty state handling should be separate
 }
 
@@ -183,6 +201,7 @@ void MapPart::addObject(Object* object, int pos)
 	objects.insert(objects.begin() + pos, object);
 	object->setMap(map);
 	object->update();
+	indexObject(object, std::size_t(pos));
 	
 	if (objects.size() == 1 && map->getNumObjects() == 1)
 		map->updateAllMapWidgets();
@@ -191,6 +210,7 @@ void MapPart::addObject(Object* object, int pos)
 void MapPart::deleteObject(int pos, bool remove_only)
 {
 	map->removeRenderablesOfObject(objects[pos], true);
+	unindexObject(objects[pos], std::size_t(pos));
 	if (remove_only)
 		objects[pos]->setMap(nullptr);
 	else
@@ -203,16 +223,91 @@ void MapPart::deleteObject(int pos, bool remove_only)
 
 bool MapPart::deleteObject(Object* object, bool remove_only)
 {
-	int size = objects.size();
-	for (int i = size - 1; i >= 0; --i)
+	if (!containsObject(object))
+		return false;
+	
+	deleteObject(int(objectPosition(object)), remove_only);
+	return true;
+}
+
+std::vector<std::pair<int, Object*>> MapPart::deleteObjects(const std::vector<Object*>& objects_to_delete, bool remove_only)
+{
+	auto result = std::vector<std::pair<int, Object*>>();
+	if (objects_to_delete.empty())
+		return result;
+	
+	auto const deleted = std::unordered_set<const Object*>(begin(objects_to_delete), end(objects_to_delete));
+	result.reserve(deleted.size());
+	
+	auto const first = begin(objects);
+	auto kept = first;
+	for (auto current = first; current != end(objects); ++current)
+	{
+		auto object = *current;
+		if (deleted.find(object) == deleted.end())
+		{
+			*kept = object;
+			++kept;
+			continue;
+		}
+		
+		result.emplace_back(int(current - first), object);
+		map->removeRenderablesOfObject(object, true);
+		if (spatial_index_valid)
+			spatial_index.remove(object);
+		if (object_positions_built)
+			object_positions.erase(object);
+		unindexSymbol(object);
+		if (remove_only)
+			object->setMap(nullptr);
+		else
+			delete object;
+	}
+	objects.erase(kept, end(objects));
+	
+	if (!result.empty())
 	{
-		if (objects[i] == object)
+		renumberObjects(std::size_t(result.front().first));
+		if (objects.empty() && map->getNumObjects() == 0)
+			map->updateAllMapWidgets();
+	}
+	return result;
+}
+
+void MapPart::addObjects(const std::vector<std::pair<int, Object*>>& objects_to_add)
+{
+	if (objects_to_add.empty())
+		return;
+	
+	auto merged = ObjectList();
+	merged.reserve(objects.size() + objects_to_add.size());
+	auto old_object = begin(objects);
+	for (auto const& entry : objects_to_add)
+	{
+		Q_ASSERT(entry.first >= int(merged.size()));
+		while (int(merged.size()) < entry.first && old_object != end(objects))
 		{
-			deleteObject(i, remove_only);
-			return true;
+			merged.push_back(*old_object);
+			++old_object;
 		}
+		merged.push_back(entry.second);
 	}
-	return false;
+	merged.insert(end(merged), old_object, end(objects));
+	objects.swap(merged);
+	
+	for (auto const& entry : objects_to_add)
+	{
+		auto object = entry.second;
+		object->setMap(map);
+		object->update();
+		if (spatial_index_valid)
+			spatial_index.insert(object, object->getExtent());
+		indexSymbol(object);
+	}
+	renumberObjects(std::size_t(objects_to_add.front().first));
+	
+	if (objects.size() == objects_to_add.size() && map->getNumObjects() == int(objects.size()))
+		map->updateAllMapWidgets();
 }
 
 void MapPart::importPart(const MapPart* other, const QHash<const Symbol*, Symbol*>& symbol_map, const QTransform& transform, bool select_new_objects)
@@ -236,6 +331,7 @@ void MapPart::importPart(const MapPart* other, const QHash<const Symbol*, Symbol
 		objects.push_back(new_object);
 		new_object->setMap(map);
 		new_object->update();
+		indexObject(new_object, objects.size() - 1);
 		
 		undo_step->addObject((int)objects.size() - 1);
 		if (select_new_objects)
@@ -263,7 +359,10 @@ void MapPart::findObjectsAt(
         bool include_protected_objects,
         SelectionInfoVector& out ) const
 {
-	for (Object* object : objects)
+	// Points are tested by squared distance, other objects by distance.
+	auto const margin = std::max(qreal(tolerance), std::sqrt(qreal(tolerance)));
+	auto const rect = QRectF(coord.x() - margin, coord.y() - margin, 2 * margin, 2 * margin);
+	for (Object* object : objectsInRect(rect))
 	{
 		if (!include_hidden_objects && object->getSymbol()->isHidden())
 			continue;
@@ -285,7 +384,7 @@ void MapPart::findObjectsAtBox(
         std::vector< Object* >& out ) const
 {
 	auto rect = QRectF(corner1, corner2).normalized();
-	for (Object* object : objects)
+	for (Object* object : objectsInRect(rect))
 	{
 		if (!include_hidden_objects && object->getSymbol()->isHidden())
 			continue;
@@ -301,7 +400,7 @@ void MapPart::findObjectsAtBox(
 int MapPart::countObjectsInRect(const QRectF& map_coord_rect, bool include_hidden_objects) const
 {
 	int count = 0;
-	for (const Object* object : objects)
+	for (const Object* object : spatialIndex().query(map_coord_rect))
 	{
 		if (object->getSymbol()->isHidden() && !include_hidden_objects)
 			continue;
@@ -328,6 +427,194 @@ QRectF MapPart::calculateExtent(bool include_helper_symbols) const
 }
 
 
+bool MapPart::existsObjectWithSymbol(const Symbol* symbol) const
+{
+	auto const& lookup = symbolObjects();
+	return lookup.find(symbol) != lookup.end();
+}
+
+
+std::vector<Object*> MapPart::objectsWithSymbol(const Symbol* symbol) const
+{
+	auto result = std::vector<Object*>();
+	auto const& lookup = symbolObjects();
+	auto const found = lookup.find(symbol);
+	if (found != lookup.end())
+	{
+		result.assign(begin(found->second), end(found->second));
+		std::sort(begin(result), end(result), [this](const Object* a, const Object* b) {
+			return objectPosition(a) < objectPosition(b);
+		});
+	}
+	return result;
+}
+
+
+void MapPart::updateObjectSymbol(const Object* object, const Symbol* old_symbol)
+{
+	if (!symbol_objects_built)
+		return;
+	
+	auto const found = symbol_objects.find(old_symbol);
+	auto const item = const_cast<Object*>(object);
+	if (found != symbol_objects.end() && found->second.erase(item))
+	{
+		if (found->second.empty())
+			symbol_objects.erase(found);
+		symbol_objects[object->getSymbol()].insert(item);
+	}
+}
+
+
+void MapPart::updateObjectExtent(const Object* object)
+{
+	auto const item = const_cast<Object*>(object);
+	if (spatial_index_valid && spatial_index.contains(item))
+		spatial_index.insert(item, object->getExtent());
+}
+
+
+const SpatialGrid<Object*>& MapPart::spatialIndex() const
+{
+	if (!spatial_index_valid)
+	{
+		spatial_index.clear();
+		for (auto object : objects)
+		{
+			object->update();
+			spatial_index.insert(object, object->getExtent());
+		}
+		spatial_index_valid = true;
+	}
+	return spatial_index;
+}
+
+
+std::vector<Object*> MapPart::objectsInRect(const QRectF& rect) const
+{
+	auto result = spatialIndex().query(rect);
+	std::sort(begin(result), end(result), [this](const Object* a, const Object* b) {
+		return objectPosition(a) < objectPosition(b);
+	});
+	return result;
+}
+
+
+bool MapPart::containsObject(const Object* object) const
+{
+	auto const& positions = objectPositions();
+	return positions.find(object) != positions.end();
+}
+
+
+const MapPart::SymbolObjects& MapPart::symbolObjects() const
+{
+	if (!symbol_objects_built)
+	{
+		symbol_objects.clear();
+		for (auto object : objects)
+			symbol_objects[object->getSymbol()].insert(object);
+		symbol_objects_built = true;
+	}
+	return symbol_objects;
+}
+
+
+const MapPart::ObjectPositions& MapPart::objectPositions() const
+{
+	if (!object_positions_built)
+	{
+		object_positions.clear();
+		object_positions.reserve(objects.size());
+		for (std::size_t i = 0; i < objects.size(); ++i)
+			object_positions[objects[i]] = i;
+		valid_positions = objects.size();
+		object_positions_built = true;
+	}
+	return object_positions;
+}
+
+
+std::size_t MapPart::objectPosition(const Object* object) const
+{
+	auto pos = objectPositions().at(object);
+	if (pos >= valid_positions)
+	{
+		// Renumber the objects from the first changed position
+		for (auto i = valid_positions; i < objects.size(); ++i)
+			object_positions[objects[i]] = i;
+		valid_positions = objects.size();
+		pos = object_positions.at(object);
+	}
+	return pos;
+}
+
+
+void MapPart::indexObject(Object* object, std::size_t pos)
+{
+	if (spatial_index_valid)
+		spatial_index.insert(object, object->getExtent());
+	indexSymbol(object);
+	
+	if (object_positions_built)
+	{
+		valid_positions = std::min(valid_positions, pos);
+		object_positions[object] = pos;
+		// Appending doesn't move other objects.
+		if (valid_positions == pos && pos + 1 == objects.size())
+			valid_positions = objects.size();
+	}
+}
+
+
+void MapPart::renumberObjects(std::size_t first)
+{
+	if (object_positions_built)
+	{
+		first = std::min(first, valid_positions);
+		for (auto i = first; i < objects.size(); ++i)
+			object_positions[objects[i]] = i;
+		valid_positions = objects.size();
+	}
+}
+
+
+void MapPart::unindexObject(Object* object, std::size_t pos)
+{
+	if (spatial_index_valid)
+		spatial_index.remove(object);
+	unindexSymbol(object);
+	
+	if (object_positions_built)
+	{
+		object_positions.erase(object);
+		valid_positions = std::min(valid_positions, pos);
+	}
+}
+
+
+void MapPart::indexSymbol(Object* object)
+{
+	if (symbol_objects_built)
+		symbol_objects[object->getSymbol()].insert(object);
+}
+
+
+void MapPart::unindexSymbol(Object* object)
+{
+	if (symbol_objects_built)
+	{
+		auto const found = symbol_objects.find(object->getSymbol());
+		if (found != symbol_objects.end())
+		{
+			found->second.erase(object);
+			if (found->second.empty())
+				symbol_objects.erase(found);
+		}
+	}
+}
+
+
 
 bool MapPart::existsObject(const std::function<bool(const Object*)>& condition) const
 {
@@ -24,6 +24,8 @@
 
 #include <cstddef>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 
@@ -31,6 +33,8 @@
 #include <QRectF>
 #include <QString>
 
+#include "util/spatial_grid.h"
+
 class QIODevice;
 class QTransform;
 class QXmlStreamReader;
@@ -66,6 +70,7 @@ using SelectionInfoVector = std::vector<std::pair<int, Object*>> ;
 class MapPart
 {
 friend class OCAD8FileImport;
+friend class XMLFileImporter;
 public:
 	/**
 	 * Creates a new map part with the given name for a map.
@@ -97,8 +102,9 @@ public:
 	 * Loads the map part in xml format from the given stream.
 	 * 
 	 * Needs a dictionary to map symbol ids to symbol pointers.
+	 * The optional function is called after each object which was loaded.
 	 */
-	static MapPart* load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol_dict);
+	static MapPart* load(QXmlStreamReader& xml, Map& map, SymbolDictionary& symbol_dict, const std::function<void ()>& object_loaded = {});
 	
 	/**
 	 * Returns the part's name.
@@ -129,13 +135,18 @@ public:
 	/**
 	 * Returns the index of the object.
 	 * 
-	 * Loops over all objects in the part and looks for the given pointer.
+	 * The index is taken from a lookup table of object positions.
 	 * The object must be contained in this part,
 	 * otherwise an assert is triggered (in debug builds),
 	 * or -1 is returned (release builds).
 	 */
 	int findObjectIndex(const Object* object) const;
 	
+	/**
+	 * Returns true if the object is contained in this part.
+	 */
+	bool containsObject(const Object* object) const;
+	
 	/**
 	 * Replaces the object at the given index with another.
 	 * 
@@ -172,6 +183,26 @@ public:
 	 */
 	bool deleteObject(Object* object, bool remove_only);
 	
+	/**
+	 * Deletes the given objects from this part.
+	 * 
+	 * If remove_only is set, does not call "delete object".
+	 * Objects which are not contained in this part are ignored.
+	 * This takes linear time in the number of objects in the part.
+	 * 
+	 * Returns the former indices of the deleted objects, in ascending order.
+	 */
+	std::vector<std::pair<int, Object*>> deleteObjects(const std::vector<Object*>& objects_to_delete, bool remove_only);
+	
+	/**
+	 * Adds the objects at the given indices.
+	 * 
+	 * The indices must be the final indices of the objects, in ascending
+	 * order, as returned by deleteObjects().
+	 * This takes linear time in the number of objects in the part.
+	 */
+	void addObjects(const std::vector<std::pair<int, Object*>>& objects_to_add);
+	
 	
 	/**
 	 * Imports the contents another part into this part.
@@ -208,6 +239,34 @@ public:
 	 */
 	QRectF calculateExtent(bool include_helper_symbols) const;
 	
+	/**
+	 * Returns true if there is at least one object with the given symbol.
+	 */
+	bool existsObjectWithSymbol(const Symbol* symbol) const;
+	
+	/**
+	 * Returns the objects with the given symbol, in z-order.
+	 * 
+	 * This takes time proportional to the number of matching objects.
+	 */
+	std::vector<Object*> objectsWithSymbol(const Symbol* symbol) const;
+	
+	/**
+	 * Updates the symbol lookup after the symbol of an object has changed.
+	 * 
+	 * Does nothing if the object is not contained in this part.
+	 * This is called by the map when the symbol of an object was changed.
+	 */
+	void updateObjectSymbol(const Object* object, const Symbol* old_symbol);
+	
+	/**
+	 * Updates the spatial index after the extent of an object has changed.
+	 * 
+	 * Does nothing if the object is not contained in this part.
+	 * This is called by the map when an object was updated.
+	 */
+	void updateObjectExtent(const Object* object);
+	
 	
 	/**
 	 * Applies a condition on all objects (until the first match is found).
@@ -243,10 +302,88 @@ public:
 	
 private:
 	typedef std::vector<Object*> ObjectList;
-
+	typedef std::unordered_map<const Object*, std::size_t> ObjectPositions;
+	typedef std::unordered_map<const Symbol*, std::unordered_set<Object*>> SymbolObjects;
+	
+	/**
+	 * Returns the lookup of object positions, building it first if necessary.
+	 * 
+	 * The set of keys is always up-to-date, but positions may be outdated.
+	 */
+	const ObjectPositions& objectPositions() const;
+	
+	/**
+	 * Returns the current position of an object in this part.
+	 * 
+	 * The object must be contained in this part.
+	 */
+	std::size_t objectPosition(const Object* object) const;
+	
+	/**
+	 * Returns the lookup of objects by symbol, building it first if necessary.
+	 */
+	const SymbolObjects& symbolObjects() const;
+	
+	/**
+	 * Returns the spatial index, building it first if necessary.
+	 */
+	const SpatialGrid<Object*>& spatialIndex() const;
+	
+	/**
+	 * Returns the objects which may intersect the rect, in z-order.
+	 * 
+	 * This is a superset of the objects which actually intersect the rect.
+	 * The objects are found at the extent of their last update.
+	 */
+	std::vector<Object*> objectsInRect(const QRectF& rect) const;
+	
+	/**
+	 * Adds an object to the spatial index and to the position lookup.
+	 * 
+	 * The object must already be inserted at the given position in objects.
+	 */
+	void indexObject(Object* object, std::size_t pos);
+	
+	/**
+	 * Adds an object to the symbol lookup.
+	 */
+	void indexSymbol(Object* object);
+	
+	/**
+	 * Removes an object from the symbol lookup.
+	 */
+	void unindexSymbol(Object* object);
+	
+	/**
+	 * Updates the position lookup for the objects from the given position.
+	 */
+	void renumberObjects(std::size_t first);
+	
+	/**
+	 * Removes an object from the spatial index and from the position lookup.
+	 * 
+	 * The object must still be at the given position in objects.
+	 */
+	void unindexObject(Object* object, std::size_t pos);
+	
+	
 	QString name;
-	ObjectList objects;  ///< @todo This could be a spatial representation optimized for quick access
+	ObjectList objects;  ///< The objects, in z-order.
 	Map* const map;
+	
+	/// The extents of the objects, built on first use.
+	mutable SpatialGrid<Object*> spatial_index;
+	mutable bool spatial_index_valid = false;
+	
+	/// The positions of the objects in the list, built on first use.
+	/// Only positions lower than valid_positions are known to be up-to-date.
+	mutable ObjectPositions object_positions;
+	mutable std::size_t valid_positions = 0;
+	mutable bool object_positions_built = false;
+	
+	/// The objects for each symbol, built on first use.
+	mutable SymbolObjects symbol_objects;
+	mutable bool symbol_objects_built = false;
 };
 
 
@@ -21,12 +21,16 @@
 
 #include "map_printer.h"
 
+#include <algorithm>
 #include <cmath>
+#include <deque>
+#include <iterator>
 
 #include <Qt>
 #include <QtMath>
 #include <QColor>
 #include <QDebug>
+#include <QFuture>
 #include <QHash>
 #include <QImage>
 #include <QLatin1String>
@@ -36,8 +40,11 @@
 #include <QPainter>
 #include <QPointF>
 #include <QStringRef>
+#include <QThread>
 #include <QTransform>
 #include <QXmlStreamReader>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
 
 
 #if defined(QT_PRINTSUPPORT_LIB)
@@ -829,6 +836,12 @@ void drawBuffer(QPainter* device_painter, const QImage* page_buffer, qreal pixel
 }
 
 void MapPrinter::drawPage(QPainter* device_painter, float units_per_inch, const QRectF& page_extent, bool white_background, QImage* page_buffer) const
+{
+	map.updateObjects();
+	drawPageWithoutUpdate(device_painter, units_per_inch, page_extent, white_background, page_buffer);
+}
+
+void MapPrinter::drawPageWithoutUpdate(QPainter* device_painter, float units_per_inch, const QRectF& page_extent, bool white_background, QImage* page_buffer) const
 {
 	device_painter->save();
 	
@@ -902,22 +915,7 @@ void MapPrinter::drawPage(QPainter* device_painter, float units_per_inch, const
 	if (use_page_buffer && !page_buffer)
 	{
 		scale = pixel_per_mm;
-		int w = qCeil(page_format.paper_dimensions.width() * scale);
-		int h = qCeil(page_format.paper_dimensions.height() * scale);
-#if defined (Q_OS_MACOS)
-		if (device_painter->device()->physicalDpiX() == 0)
-		{
-			// Possible Qt bug, since according to QPaintDevice documentation,
-			// "if the physicalDpiX() doesn't equal the logicalDpiX(),
-			// the corresponding QPaintEngine must handle the resolution mapping"
-			// which doesn't seem to happen here.
-			qreal corr = device_painter->device()->logicalDpiX() / 72.0;
-			w = qCeil(page_format.paper_dimensions.width() * scale * corr);
-			h = qCeil(page_format.paper_dimensions.height() * scale * corr);
-		}
-#endif
-		
-		scoped_buffer = QImage(w, h, QImage::Format_RGB32);
+		scoped_buffer = QImage(pageBufferSize(device_painter->device()), QImage::Format_RGB32);
 		if (scoped_buffer.isNull())
 		{
 			// Allocation failed
@@ -1022,14 +1020,14 @@ void MapPrinter::drawPage(QPainter* device_painter, float units_per_inch, const
 		
 		if (rasterModeSelected() && options.simulate_overprinting)
 		{
-			map.drawOverprintingSimulation(map_painter, config);
+			map.drawOverprintingSimulationWithoutUpdate(map_painter, config);
 		}
 		else
 		{
 			if (vectorModeSelected() && view)
 				config.opacity = view->effectiveMapVisibility().opacity;
 		
-			map.draw(map_painter, config);
+			map.drawWithoutUpdate(map_painter, config);
 		}
 			
 		if (map_painter != painter)
@@ -1095,6 +1093,43 @@ void MapPrinter::drawPage(QPainter* device_painter, float units_per_inch, const
 	device_painter->restore();
 }
 
+QSize MapPrinter::pageBufferSize(const QPaintDevice* device) const
+{
+	auto const pixel_per_mm = options.resolution / 25.4;
+	int w = qCeil(page_format.paper_dimensions.width() * pixel_per_mm);
+	int h = qCeil(page_format.paper_dimensions.height() * pixel_per_mm);
+#if defined (Q_OS_MACOS)
+	if (device->physicalDpiX() == 0)
+	{
+		// Possible Qt bug, since according to QPaintDevice documentation,
+		// "if the physicalDpiX() doesn't equal the logicalDpiX(),
+		// the corresponding QPaintEngine must handle the resolution mapping"
+		// which doesn't seem to happen here.
+		qreal corr = device->logicalDpiX() / 72.0;
+		w = qCeil(page_format.paper_dimensions.width() * pixel_per_mm * corr);
+		h = qCeil(page_format.paper_dimensions.height() * pixel_per_mm * corr);
+	}
+#else
+	Q_UNUSED(device)
+#endif
+	return { w, h };
+}
+
+QImage MapPrinter::drawPageBuffer(QSize size, const QRectF& page_extent) const
+{
+	QImage page_buffer(size, QImage::Format_RGB32);
+	if (page_buffer.isNull())
+		return page_buffer;
+	
+	QPainter painter(&page_buffer);
+	drawPageWithoutUpdate(&painter, options.resolution, page_extent, false, &page_buffer);
+	if (!painter.isActive())
+		return {};
+	
+	painter.end();
+	return page_buffer;
+}
+
 void MapPrinter::drawSeparationPages(QPrinter* printer, QPainter* device_painter, float dpi, const QRectF& page_extent) const
 {
 	Q_ASSERT(printer->colorMode() == QPrinter::GrayScale);
@@ -1234,9 +1269,39 @@ bool MapPrinter::printMap(QPrinter* printer)
 	}
 #endif
 	
+	std::vector<QRectF> page_extents;
+	page_extents.reserve(v_page_pos.size() * h_page_pos.size());
+	for (auto vpos : v_page_pos)
+	{
+		for (auto hpos : h_page_pos)
+			page_extents.emplace_back(QPointF(hpos, vpos), extent_size);
+	}
+	
+	/*
+	 * In raster mode, the page buffers are drawn by a bounded number of
+	 * concurrent tasks, ahead of the sequential output to the printer.
+	 * The number of pending buffers is limited by threads and memory.
+	 * When templates are printed, all pages are drawn on this thread.
+	 */
+	auto const concurrent = rasterModeSelected() && !options.show_templates && page_extents.size() > 1;
+	auto const buffer_size = pageBufferSize(painter.device());
+	std::size_t max_pending = 0;
+	if (concurrent)
+	{
+		// The page buffers are drawn without modifying the map.
+		map.updateObjects();
+		
+		// drawPage() needs another buffer of the same size for the map.
+		constexpr qint64 memory_budget = 1024 * 1024 * 1024;
+		auto const buffer_bytes = 2 * 4 * qint64(buffer_size.width()) * qint64(buffer_size.height());
+		max_pending = std::size_t(qBound(qint64(1), memory_budget / std::max(qint64(1), buffer_bytes), qint64(std::max(1, QThread::idealThreadCount()))));
+	}
+	std::deque<QFuture<QImage>> pending;
+	auto next_buffer = begin(page_extents);
+	
 	cancel_print_map = false;
 	int step = 0;
-	auto num_steps = v_page_pos.size() * h_page_pos.size();
+	auto num_steps = page_extents.size();
 	const QString message_template( (options.mode == MapPrinterOptions::Separations) ?
 	  ::OpenOrienteering::MapPrinter::tr("Processing separations of page %1...") :
 	  ::OpenOrienteering::MapPrinter::tr("Processing page %1...") );
@@ -1244,49 +1309,67 @@ bool MapPrinter::printMap(QPrinter* printer)
 	emit printProgress(0, message);
 	
 	bool need_new_page = false;
-	for (auto vpos : v_page_pos)
+	for (const auto& page_extent : page_extents)
 	{
 		if (!painter.isActive())
 		{
 			break;
 		}
 		
-		for (auto hpos : h_page_pos)
+		++step;
+		auto progress = qMin(99, qMax(1, int((100 * static_cast<decltype(num_steps)>(step) - 50) / num_steps)));
+		emit printProgress(progress, message_template.arg(step));
+		
+		if (cancel_print_map) /* during printProgress handling */
+		{
+			painter.end();
+			break;
+		}
+		
+		if (need_new_page)
 		{
-			if (!painter.isActive())
+			printer->newPage();
+		}
+		
+		if (concurrent)
+		{
+			for (; next_buffer != end(page_extents) && pending.size() < max_pending; ++next_buffer)
 			{
-				break;
+				auto const extent = *next_buffer;
+				pending.push_back(QtConcurrent::run([this, buffer_size, extent]() {
+					return drawPageBuffer(buffer_size, extent);
+				}));
 			}
 			
-			++step;
-			auto progress = qMin(99, qMax(1, int((100 * static_cast<decltype(num_steps)>(step) - 50) / num_steps)));
-			emit printProgress(progress, message_template.arg(step));
-			
-			if (cancel_print_map) /* during printProgress handling */
+			auto const page_buffer = pending.front().result();
+			pending.pop_front();
+			if (page_buffer.isNull())
 			{
-				painter.end();
+				painter.end(); // Signal error
 				break;
 			}
-				
-			if (need_new_page)
-			{
-				printer->newPage();
-			}
-			
-			QRectF page_extent = QRectF(QPointF(hpos, vpos), extent_size);
-			if (separationsModeSelected())
-			{
-				drawSeparationPages(printer, &painter, resolution, page_extent);
-			}
-			else
-			{
-				drawPage(&painter, resolution, page_extent, false);
-			}
 			
-			need_new_page = true;
+			painter.save();
+			painter.resetTransform();
+			drawBuffer(&painter, &page_buffer, resolution / options.resolution);
+			painter.restore();
 		}
+		else if (separationsModeSelected())
+		{
+			drawSeparationPages(printer, &painter, resolution, page_extent);
+		}
+		else
+		{
+			drawPage(&painter, resolution, page_extent, false);
+		}
+		
+		need_new_page = true;
 	}
 	
+	// Pending tasks must not outlive this object.
+	for (auto& buffer : pending)
+		buffer.waitForFinished();
+	
 	if (cancel_print_map)
 	{
 		emit printProgress(100, ::OpenOrienteering::MapPrinter::tr("Canceled"));
@@ -1303,6 +1386,115 @@ bool MapPrinter::printMap(QPrinter* printer)
 	return true;
 }
 
+QSize MapPrinter::imageSize() const
+{
+	auto const pixel_per_mm = options.resolution / 25.4;
+	auto const paper_size = getPrintAreaPaperSize();
+	return { qRound(paper_size.width() * pixel_per_mm), qRound(paper_size.height() * pixel_per_mm) };
+}
+
+bool MapPrinter::drawBands(const std::function<bool (const QImage&)>& write_band)
+{
+	struct Band
+	{
+		int top;
+		QImage image;
+	};
+	
+	auto const size = imageSize();
+	if (size.isEmpty())
+		return false;
+	
+	// drawPage() allocates another buffer of the same size for the map.
+	constexpr qint64 band_bytes = 16 * 1024 * 1024;
+	auto const band_height = int(qBound(qint64(1), band_bytes / (4 * qint64(size.width())), qint64(size.height())));
+	
+	std::vector<Band> bands;
+	for (int top = 0; top < size.height(); top += band_height)
+		bands.push_back({ top, {} });
+	
+	auto const map_mm_per_pixel = 25.4 / options.resolution / scale_adjustment;
+	auto const dots_per_meter = qRound(options.resolution / 0.0254);
+	auto const render_band = [this, size, band_height, map_mm_per_pixel, dots_per_meter](Band& band) {
+		auto const height = std::min(band_height, size.height() - band.top);
+		band.image = QImage(size.width(), height, QImage::Format_ARGB32_Premultiplied);
+		if (band.image.isNull())
+			return;
+		
+		band.image.setDotsPerMeterX(dots_per_meter);
+		band.image.setDotsPerMeterY(dots_per_meter);
+		auto const band_extent = QRectF(print_area.left(), print_area.top() + band.top * map_mm_per_pixel,
+		                                print_area.width(), height * map_mm_per_pixel);
+		QPainter painter(&band.image);
+		drawPageWithoutUpdate(&painter, options.resolution, band_extent, true, &band.image);
+		if (!painter.isActive())
+			band.image = {};
+	};
+	
+	// The bands are drawn without modifying the map.
+	map.updateObjects();
+	
+	cancel_print_map = false;
+	const QString message_template(::OpenOrienteering::MapPrinter::tr("Processing band %1 of %2..."));
+	emit printProgress(0, message_template.arg(1).arg(bands.size()));
+	
+	// Templates are drawn on this thread, one band at a time.
+	auto const batch_size = options.show_templates ? 1 : std::max(1, QThread::idealThreadCount());
+	for (auto band = begin(bands); band != end(bands); )
+	{
+		auto const batch_end = band + std::min(std::ptrdiff_t(batch_size), std::distance(band, end(bands)));
+		if (batch_size == 1)
+			render_band(*band);
+		else
+			QtConcurrent::blockingMap(band, batch_end, render_band);
+		
+		for (; band != batch_end; ++band)
+		{
+			if (band->image.isNull() || !write_band(band->image))
+			{
+				emit printProgress(100, ::OpenOrienteering::MapPrinter::tr("Error"));
+				return false;
+			}
+			band->image = {};
+		}
+		
+		auto const step = std::distance(begin(bands), band);
+		auto const progress = qMin(99, int(100 * step / std::ptrdiff_t(bands.size())));
+		emit printProgress(progress, message_template.arg(step + 1).arg(bands.size()));
+		if (cancel_print_map) /* during printProgress handling */
+		{
+			emit printProgress(100, ::OpenOrienteering::MapPrinter::tr("Canceled"));
+			return false;
+		}
+	}
+	
+	emit printProgress(100, ::OpenOrienteering::MapPrinter::tr("Finished"));
+	return true;
+}
+
+bool MapPrinter::drawTransformed(QImage& image, const QTransform& map_to_image) const
+{
+	if (image.isNull() || !map_to_image.isInvertible())
+		return false;
+	
+	// The pixels per map millimeter, for an angle-preserving transformation
+	auto const pixel_per_mm = std::sqrt(std::abs(map_to_image.determinant()));
+	auto const units_per_inch = pixel_per_mm * 25.4 / scale_adjustment;
+	auto const extent = map_to_image.inverted().mapRect(QRectF(QPointF(0, 0), image.size()));
+	
+	// drawPage() applies this transformation on top of the painter's transformation.
+	QTransform page_transform;
+	page_transform.scale(units_per_inch / 25.4, units_per_inch / 25.4);
+	page_transform.translate(page_format.page_rect.left(), page_format.page_rect.top());
+	page_transform.scale(scale_adjustment, scale_adjustment);
+	page_transform.translate(-extent.left(), -extent.top());
+	
+	QPainter painter(&image);
+	painter.setTransform(page_transform.inverted() * map_to_image);
+	drawPageWithoutUpdate(&painter, float(units_per_inch), extent, true, &image);
+	return painter.isActive();
+}
+
 void MapPrinter::cancelPrintMap()
 {
 	cancel_print_map = true;
@@ -22,6 +22,7 @@
 #ifndef OPENORIENTEERING_MAP_PRINTER_H
 #define OPENORIENTEERING_MAP_PRINTER_H
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -42,8 +43,10 @@
 template <class Key, class T>
 class QHash;
 class QImage;
+class QPaintDevice;
 class QPainter;
 class QPrinter;
+class QTransform;
 class QXmlStreamReader;
 class QXmlStreamWriter;
 
@@ -283,7 +286,8 @@ public:
 	
 	/** Draws a single page to the painter.
 	 * 
-	 *  In case of an error, the painter will be inactive when returning from
+	 *  This updates the map's dirty objects first, so it must not run
+	 *  concurrently. In case of an error, the painter will be inactive when returning from
 	 *  this function.
 	 * 
 	 *  When the actual paint device is a QImage, pass it as page_buffer.
@@ -297,6 +301,37 @@ public:
 	/** Draws the separations as distinct pages to the printer. */
 	void drawSeparationPages(QPrinter* printer, QPainter* device_painter, float dpi, const QRectF& page_extent) const;
 	
+	/** Returns the size of the image which is exported from the print area. */
+	QSize imageSize() const;
+	
+	/** Draws the print area to images of horizontal bands.
+	 * 
+	 *  This is meant for exporting large images. Unlike drawPage(), it never
+	 *  allocates an image of the full print area. Each band has the width of
+	 *  imageSize(), and a height which keeps its size to a few megabytes.
+	 *  The bands are passed to write_band in top-to-bottom order.
+	 *  When templates are not printed, several bands are rendered concurrently.
+	 * 
+	 *  Progress is reported via printProgress(), and the operation may be
+	 *  canceled by cancelPrintMap().
+	 * 
+	 *  @return false if write_band returned false, if memory allocation failed,
+	 *          or if the operation was canceled. */
+	bool drawBands(const std::function<bool (const QImage&)>& write_band);
+	
+	/** Draws the print area to an image with an arbitrary transformation.
+	 * 
+	 *  The transformation maps map coordinates to image pixels. Unlike the
+	 *  page transformation of drawPage(), it may include rotation and shear.
+	 *  This is meant for rendering tiles in another projection. The image is
+	 *  filled with white first, and only the print area is drawn.
+	 *  Unlike drawPage(), this does not update the map's objects. After
+	 *  Map::updateObjects(), it may run concurrently when templates are not
+	 *  printed.
+	 * 
+	 *  @return false if the image is null or if drawing failed. */
+	bool drawTransformed(QImage& image, const QTransform& map_to_image) const;
+	
 	/** Returns the current configuration. */
 	const MapPrinterConfig& config() const;
 	
@@ -395,6 +430,20 @@ protected:
 	/** Updates the scale adjustment and page breaks. */
 	void mapScaleChanged();
 	
+	/** Draws a single page like drawPage(), but without updating the map's objects.
+	 * 
+	 *  This does not modify the map. After Map::updateObjects(), it may run
+	 *  concurrently when templates are not printed. */
+	void drawPageWithoutUpdate(QPainter* device_painter, float units_per_inch, const QRectF& page_extent, bool white_background, QImage* page_buffer) const;
+	
+	/** Returns the size of the page buffer which drawPage() uses for the device. */
+	QSize pageBufferSize(const QPaintDevice* device) const;
+	
+	/** Draws a single page to a new page buffer of the given size.
+	 *  Like drawPageWithoutUpdate(), this does not modify the map.
+	 *  Returns a null image on error. */
+	QImage drawPageBuffer(QSize size, const QRectF& page_extent) const;
+	
 	Map& map;
 	const MapView* view;
 	const QPrinterInfo* target;
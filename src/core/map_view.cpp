@@ -469,6 +469,7 @@ void MapView::setTemplateVisibility(Template* temp, TemplateVisibility vis)
 	auto visible = vis.visible && vis.opacity > 0;
 	if (visible
 	    && temp->getTemplateState() != Template::Loaded
+	    && temp->getTemplateState() != Template::Loading
 	    && !templateLoadingBlocked())
 	{
 		vis.visible = visible = temp->loadTemplateFile(false);
@@ -542,5 +543,10 @@ void MapView::setTemplateLoadingBlocked(bool blocked)
 	template_loading_blocked = blocked;
 }
 
+void MapView::setTemplateLoadingAsync(bool async)
+{
+	template_loading_async = async;
+}
+
 
 }  // namespace OpenOrienteering
@@ -329,6 +329,12 @@ public:
 	/** Returns true when template loading on visibility changes is disabled. */
 	bool templateLoadingBlocked() const { return template_loading_blocked; }
 	
+	/** Sets whether template files are loaded on worker threads when the map is opened. */
+	void setTemplateLoadingAsync(bool async);
+	
+	/** Returns true when template files are loaded on worker threads. */
+	bool templateLoadingAsync() const { return template_loading_async; }
+
 	
 signals:
 	/**
@@ -422,6 +428,7 @@ private:
 	bool overprinting_simulation_enabled;
 	
 	bool template_loading_blocked;
+	bool template_loading_async = false;
 };
 
 
@@ -88,7 +88,8 @@ Object::Object(Object::Type type, const Symbol* symbol, const MapCoordVector& co
    extent(),
    output(*this)
 {
-	// nothing
+	if (map)
+		map->enlistDirtyObject(this);
 }
 
 Object::Object(const Object& proto)
@@ -117,12 +118,15 @@ void Object::copyFrom(const Object& other)
 	if (type != other.type)
 		throw std::invalid_argument(Q_FUNC_INFO);
 	
+	auto const old_symbol = symbol;
 	symbol = other.symbol;
 	coords = other.coords;
 	// map unchanged!
 	object_tags = other.object_tags;
-	output_dirty = true;
+	setOutputDirty();
 	extent = other.extent;
+	if (map && symbol != old_symbol)
+		map->updateObjectSymbol(this, old_symbol);
 }
 
 bool Object::equals(const Object* other, bool compare_symbol) const
@@ -360,6 +364,8 @@ void Object::load(QIODevice* file, int version, Map* map)
 	}
 	
 	output_dirty = true;
+	if (map)
+		map->enlistDirtyObject(this);
 }
 
 #endif
@@ -559,6 +565,8 @@ Object* Object::load(QXmlStreamReader& xml, Map* map, const SymbolDictionary& sy
 		path->recalculateParts();
 	}
 	object->output_dirty = true;
+	if (map)
+		map->enlistDirtyObject(object);
 	
 	if (map &&
 	    ( object->coords.empty()
@@ -571,6 +579,22 @@ Object* Object::load(QXmlStreamReader& xml, Map* map, const SymbolDictionary& sy
 	return object;
 }
 
+void Object::setOutputDirty(bool dirty)
+{
+	// Clean objects with a map are not enlisted, dirty ones are.
+	if (dirty && !output_dirty && map)
+		map->enlistDirtyObject(this);
+	output_dirty = dirty;
+}
+
+void Object::setMap(Map* map)
+{
+	this->map = map;
+	output_dirty = true;
+	if (map)
+		map->enlistDirtyObject(this);
+}
+
 void Object::forceUpdate() const
 {
 	output_dirty = true;
@@ -590,6 +614,20 @@ bool Object::update() const
 			map->setObjectAreaDirty(extent);
 	}
 	
+	regenerateOutput(options);
+	
+	if (map)
+	{
+		map->insertRenderablesOfObject(this);
+		if (extent.isValid())
+			map->setObjectAreaDirty(extent);
+	}
+	
+	return true;
+}
+
+void Object::regenerateOutput(Symbol::RenderableOptions options) const
+{
 	output.deleteRenderables();
 	
 	extent = QRectF();
@@ -600,15 +638,6 @@ bool Object::update() const
 	
 	Q_ASSERT(extent.right() < 60000000);	// assert if bogus values are returned
 	output_dirty = false;
-	
-	if (map)
-	{
-		map->insertRenderablesOfObject(this);
-		if (extent.isValid())
-			map->setObjectAreaDirty(extent);
-	}
-	
-	return true;
 }
 
 void Object::updateEvent() const
@@ -777,8 +806,11 @@ bool Object::setSymbol(const Symbol* new_symbol, bool no_checks)
 			return false;
 	}
 	
+	auto const old_symbol = symbol;
 	symbol = new_symbol;
 	setOutputDirty();
+	if (map && symbol != old_symbol)
+		map->updateObjectSymbol(this, old_symbol);
 	return true;
 }
 
@@ -176,6 +176,16 @@ public:
 	 */
 	void forceUpdate() const;
 	
+	/**
+	 * Regenerates output and extent, but does not update the object's map.
+	 * 
+	 * This is the part of update() which does not depend on shared state,
+	 * so it may run concurrently for different non-text objects. The caller
+	 * is responsible for marking the old and new extent as dirty, and for
+	 * inserting the new renderables into the map.
+	 */
+	void regenerateOutput(Symbol::RenderableOptions options) const;
+	
 	
 	/** Moves the whole object
 	 * @param dx X offset in native map coordinates.
@@ -243,7 +253,12 @@ public:
 	 */
 	const MapCoordVector& getRawCoordinateVector() const;
 	
-	/** Sets the object output's dirty state. */
+	/**
+	 * Sets the object output's dirty state.
+	 * 
+	 * When the output becomes dirty, the object is enlisted in its map
+	 * for the next Map::updateObjects().
+	 */
 	void setOutputDirty(bool dirty = true);
 	/** Returns if the object's output must be regenerated. */
 	bool isOutputDirty() const;
@@ -1090,12 +1105,6 @@ const MapCoordVector& Object::getRawCoordinateVector() const
 	return coords;
 }
 
-inline
-void Object::setOutputDirty(bool dirty)
-{
-	output_dirty = dirty;
-}
-
 inline
 bool Object::isOutputDirty() const
 {
@@ -1114,13 +1123,6 @@ const QRectF& Object::getExtent() const
 	return extent;
 }
 
-inline
-void Object::setMap(Map* map)
-{
-	this->map = map;
-	setOutputDirty();
-}
-
 inline
 Map* Object::getMap() const
 {
@@ -21,6 +21,7 @@
 #include "renderable.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <iterator>
 #include <utility>
 
@@ -32,7 +33,9 @@
 #include <QPainterPath>
 #include <QPen>
 #include <QRgb>
+#include <QThread>
 #include <QTransform>
+#include <QtConcurrentMap>
 
 #include "core/image_transparency_fixup.h"
 #include "core/map_color.h"
@@ -237,8 +240,6 @@ MapRenderables::MapRenderables(Map* map)
 
 void MapRenderables::draw(QPainter *painter, const RenderConfig &config) const
 {
-	// TODO: improve performance by using some spatial acceleration structure?
-	
 #ifdef Q_OS_ANDROID
 	const qreal min_dimension = 1.0/config.scaling;
 #endif
@@ -261,19 +262,19 @@ void MapRenderables::draw(QPainter *painter, const RenderConfig &config) const
 			continue;
 		}
 		
-		for (const auto& object : color->second)
+		for (const auto object : objectsInRect(color->first, color->second, config.bounding_box))
 		{
 			// Settings check
-			const Symbol* symbol = object.first->getSymbol();
+			const Symbol* symbol = object->first->getSymbol();
 			if (!config.testFlag(RenderConfig::HelperSymbols) && symbol->isHelperSymbol())
 				continue;
 			if (symbol->isHidden())
 				continue;
 			
-			if (!object.first->getExtent().intersects(config.bounding_box))
+			if (!object->first->getExtent().intersects(config.bounding_box))
 				continue;
 			
-			for (const auto& renderables : *object.second)
+			for (const auto& renderables : *object->second)
 			{
 				// Render the renderables
 				const PainterConfig& state = renderables.first;
@@ -324,36 +325,98 @@ void MapRenderables::drawOverprintingSimulation(QPainter* painter, const RenderC
 	painter->resetTransform();
 	painter->setCompositionMode(QPainter::CompositionMode_Multiply); // Alternative: CompositionMode_Darken
 	
-	QImage separation(image->size(), QImage::Format_ARGB32_Premultiplied);
+	struct Separation
+	{
+		const MapColor* spot_color;
+		std::vector<SeparationColor> colors;
+		QImage image;
+		bool has_text;
+	};
 	
+	auto const contains_text = [](const std::vector<SeparationColor>& colors) {
+		for (auto const& color : colors)
+		{
+			for (auto const& object : color.objects->second)
+			{
+				if (object.first->getSymbol()->getType() == Symbol::Text)
+					return true;
+			}
+		}
+		return false;
+	};
+	
+	// The color lists are determined once, before drawing.
+	std::vector<Separation> separations;
 	for (auto map_color = map->color_set->colors.rbegin();
 	     map_color != map->color_set->colors.rend();
 	     map_color++)
 	{
 		if ((*map_color)->getSpotColorMethod() == MapColor::SpotColor)
 		{
-			separation.fill(Qt::GlobalColor(Qt::transparent));
-			
-			// Collect all halftones and knockouts of a single color
-			QPainter p(&separation);
-			p.setRenderHints(hints);
-			p.setWorldTransform(t, false);
-			drawColorSeparation(&p, config, *map_color, true);
-			p.end();
+			auto colors = separationColors(*map_color);
+			auto const has_text = contains_text(colors);
+			separations.push_back({ *map_color, std::move(colors), {}, has_text });
+		}
+	}
+	
+	// Collect all halftones and knockouts of a single color
+	auto const draw_separation = [this, image, hints, &t, &config](Separation& separation) {
+		separation.image = QImage(image->size(), QImage::Format_ARGB32_Premultiplied);
+		if (separation.image.isNull())
+			return;
+		
+		separation.image.fill(Qt::GlobalColor(Qt::transparent));
+		QPainter p(&separation.image);
+		p.setRenderHints(hints);
+		p.setWorldTransform(t, false);
+		drawSeparation(&p, config, separation.colors, true);
+	};
+	
+	// The separations are drawn concurrently, in batches which are limited
+	// by the number of threads and by memory, and composed in regular order.
+	constexpr qint64 memory_budget = 512 * 1024 * 1024;
+	auto const image_bytes = std::max(qint64(1), qint64(image->bytesPerLine()) * image->height());
+	auto const batch_size = int(qBound(qint64(1), memory_budget / image_bytes, qint64(std::max(1, QThread::idealThreadCount()))));
+	for (auto separation = begin(separations); separation != end(separations); )
+	{
+		auto const batch_end = separation + std::min(std::ptrdiff_t(batch_size), std::distance(separation, end(separations)));
+		if (batch_size == 1)
+		{
+			draw_separation(*separation);
+		}
+		else
+		{
+			// Text rendering uses fonts which must not be used by worker
+			// threads, so separations with text are drawn on this thread.
+			QtConcurrent::blockingMap(separation, batch_end, [&draw_separation](Separation& current) {
+				if (!current.has_text)
+					draw_separation(current);
+			});
+			for (auto current = separation; current != batch_end; ++current)
+			{
+				if (current->has_text)
+					draw_separation(*current);
+			}
+		}
+		
+		for (; separation != batch_end; ++separation)
+		{
+			if (separation->image.isNull())
+				continue;
 			
 			// Add this separation to the composition with multiplication.
 			painter->setCompositionMode(QPainter::CompositionMode_Multiply);
-			painter->drawImage(0, 0, separation);
+			painter->drawImage(0, 0, separation->image);
 			image_fixup();
 			
 #if MAPPER_OVERPRINTING_CORRECTION == -1
 			// Add some opacity to the multiplication, but not for black,
 			// since halftones (i.e. grey) might unduly lighten the composition.
-			if (static_cast<QRgb>(**map_color) != 0xff000000)
+			if (static_cast<QRgb>(*separation->spot_color) != 0xff000000)
 			{
 				// FIXME: Implement this for Format_ARGB32_Premultiplied,
 				//        if efficiently possible.
-				QImage copy = separation.convertToFormat(QImage::Format_ARGB32);
+				QImage copy = separation->image.convertToFormat(QImage::Format_ARGB32);
 				QRgb* dest = (QRgb*)copy.bits();
 				const QRgb* dest_end = dest + copy.byteCount() / sizeof(QRgb);
 				for (QRgb* px = dest; px < dest_end; ++px)
@@ -365,12 +428,14 @@ void MapRenderables::drawOverprintingSimulation(QPainter* painter, const RenderC
 				painter->drawImage(0, 0, copy);
 			}
 #endif
+			separation->image = {};
 		}
 	}
 	
 	painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
 	
 #if MAPPER_OVERPRINTING_CORRECTION > 0
+	QImage separation(image->size(), QImage::Format_ARGB32_Premultiplied);
 	separation.fill(Qt::GlobalColor(Qt::transparent));
 	QPainter p(&separation);
 	p.setRenderHints(hints);
@@ -409,16 +474,14 @@ void MapRenderables::drawOverprintingSimulation(QPainter* painter, const RenderC
 
 void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig& config, const MapColor* separation, bool use_color) const
 {
-	painter->save();
-	
-	const QPainterPath initial_clip(painter->clipPath());
-	const QPainterPath* current_clip = nullptr;
-	
-	// As soon as the spot color is actually used for drawing (i.e. drawing_started = true),
-	// we need to take care of knockouts.
-	bool drawing_started = false;
+	drawSeparation(painter, config, separationColors(separation), use_color);
+}
+
+std::vector<MapRenderables::SeparationColor> MapRenderables::separationColors(const MapColor* separation) const
+{
+	std::vector<SeparationColor> result;
 	
-	// For each pair of color priority and its renderables collection...
+	// For each color priority which has renderables...
 	auto end_of_colors = rend();
 	auto color = rbegin();
 	while (color != end_of_colors && color->first >= map->getNumColors())
@@ -428,6 +491,7 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 	for (; color != end_of_colors; ++color)
 	{
 		SpotColorComponent drawing_color(map->getColor(color->first), 1.0f);
+		bool knockout = false;
 		
 		// Check whether the current color [priority] applies to the current separation.
 		if (color->first > MapColor::Reserved)
@@ -448,9 +512,10 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 					{
 						; // okay
 					}
-					else if (drawing_started && drawing_color.spot_color->getKnockout())
+					else if (drawing_color.spot_color->getKnockout())
 					{
 						drawing_color.factor = 0.0f;
+						knockout = true;
 					}
 					else
 					{
@@ -461,7 +526,6 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 				case MapColor::CustomColor:
 				{
 					// First, check if the renderables draw color to this separation
-					// TODO: Use an efficient data structure to avoid reiterating each time a separation is drawn
 					const SpotColorComponents& components = drawing_color.spot_color->getComponents();
 					for (const auto& component : components)
 					{
@@ -476,9 +540,10 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 					{
 						// If the renderables do not explicitly draw color to this separation,
 						// check if they need a knockout.
-						if (drawing_started && drawing_color.spot_color->getKnockout())
+						if (drawing_color.spot_color->getKnockout())
 						{
 							drawing_color = SpotColorComponent(separation, 0.0f);
+							knockout = true;
 						}
 						else
 						{
@@ -504,7 +569,6 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 				Q_ASSERT(!"Invalid reserved color!");                // in development build
 				drawing_color.spot_color = Map::getUndefinedColor(); // in release build
 			}
-			painter->setRenderHint(QPainter::Antialiasing, true);
 		}
 		else if (color->first == MapColor::Registration)
 		{
@@ -517,21 +581,49 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 			continue;
 		}
 		
+		result.push_back({ &*color, drawing_color, knockout });
+	}
+	
+	return result;
+}
+
+void MapRenderables::drawSeparation(QPainter* painter, const RenderConfig& config, const std::vector<SeparationColor>& colors, bool use_color) const
+{
+	painter->save();
+	
+	const QPainterPath initial_clip(painter->clipPath());
+	const QPainterPath* current_clip = nullptr;
+	
+	// As soon as the spot color is actually used for drawing (i.e. drawing_started = true),
+	// we need to take care of knockouts.
+	bool drawing_started = false;
+	
+	// For each color priority which applies to the separation...
+	for (const auto& separation_color : colors)
+	{
+		if (separation_color.knockout && !drawing_started)
+			continue;
+		
+		auto const color = separation_color.objects;
+		const SpotColorComponent& drawing_color = separation_color.drawing_color;
+		if (color->first < MapColor::Reserved && color->first != MapColor::Registration)
+			painter->setRenderHint(QPainter::Antialiasing, true);
+		
 		// For each pair of object and its renderables [states] for a particular map color...
-		for (const auto& object : color->second)
+		for (const auto object : objectsInRect(color->first, color->second, config.bounding_box))
 		{
 			// Check whether the symbol and object is to be drawn at all.
-			const Symbol* symbol = object.first->getSymbol();
+			const Symbol* symbol = object->first->getSymbol();
 			if (!config.testFlag(RenderConfig::HelperSymbols) && symbol->isHelperSymbol())
 				continue;
 			if (symbol->isHidden())
 				continue;
 			
-			if (!object.first->getExtent().intersects(config.bounding_box))
+			if (!object->first->getExtent().intersects(config.bounding_box))
 				continue;
 			
 			// For each pair of common rendering attributes and collection of renderables...
-			for (const auto& renderables : *object.second)
+			for (const auto& renderables : *object->second)
 			{
 				const PainterConfig& state = renderables.first;
 				
@@ -572,7 +664,7 @@ void MapRenderables::drawColorSeparation(QPainter* painter, const RenderConfig&
 			
 		} // each object
 		
-	} // each map color
+	} // each separation color
 	
 	painter->restore();
 }
@@ -584,6 +676,7 @@ void MapRenderables::insertRenderablesOfObject(const Object* object)
 	for (; color != end_of_colors; ++color)
 	{
 		operator[](color->first)[object] = color->second;
+		spatial_index[color->first].insert(object, object->getExtent());
 	}
 }
 
@@ -613,6 +706,13 @@ void MapRenderables::removeRenderablesOfObject(const Object* object, bool mark_a
 			}
 			
 			color.second.erase(obj);
+			auto index = spatial_index.find(color.first);
+			if (index != spatial_index.end())
+			{
+				index->second.remove(object);
+				if (index->second.empty())
+					spatial_index.erase(index);
+			}
 		}
 	}
 }
@@ -636,6 +736,35 @@ void MapRenderables::clear(bool mark_area_as_dirty)
 		}
 	}
 	std::map<int, ObjectRenderablesMap>::clear();
+	spatial_index.clear();
+}
+
+std::vector<MapRenderables::ObjectRenderablesRef> MapRenderables::objectsInRect(int color_priority, const ObjectRenderablesMap& objects, const QRectF& rect) const
+{
+	std::vector<ObjectRenderablesRef> result;
+	
+	auto index = spatial_index.find(color_priority);
+	if (index == spatial_index.end() || rect.contains(index->second.bounds()))
+	{
+		// Everything is visible, no need to ask the index.
+		result.reserve(objects.size());
+		for (const auto& object : objects)
+			result.push_back(&object);
+	}
+	else
+	{
+		// The candidates are sorted like the keys of the ObjectRenderablesMap.
+		auto candidates = index->second.query(rect);
+		result.reserve(candidates.size());
+		for (const auto candidate : candidates)
+		{
+			auto object = objects.find(candidate);
+			if (object != objects.end())
+				result.push_back(&*object);
+		}
+	}
+	
+	return result;
 }
 
 // ### PainterConfig ###
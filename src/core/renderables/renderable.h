@@ -31,6 +31,7 @@
 #include <QExplicitlySharedDataPointer>
 
 #include "core/map_color.h"
+#include "util/spatial_grid.h"
 
 class QColor;
 class QPainter;
@@ -369,7 +370,44 @@ public:
 	inline bool empty() const;
 	
 private:
+	using ObjectRenderablesRef = const ObjectRenderablesMap::value_type*;
+	
+	/**
+	 * A color priority which contributes to a particular separation.
+	 */
+	struct SeparationColor
+	{
+		const value_type* objects;          ///< The color priority and its renderables
+		SpotColorComponent drawing_color;   ///< The spot color and halftone to draw with
+		bool knockout;                      ///< True if only needed after drawing has started
+	};
+	
+	/**
+	 * Returns the color priorities which contribute to the given separation,
+	 * in drawing order.
+	 */
+	std::vector<SeparationColor> separationColors(const MapColor* separation) const;
+	
+	/**
+	 * Draws the renderables of the given separation colors.
+	 * 
+	 * @see drawColorSeparation()
+	 */
+	void drawSeparation(QPainter* painter, const RenderConfig& config,
+		const std::vector<SeparationColor>& colors, bool use_color) const;
+	
+	/**
+	 * Returns the objects of the given color which may intersect the rect.
+	 * 
+	 * The objects are returned in the order of the ObjectRenderablesMap.
+	 * The result may contain objects which do not actually intersect the rect.
+	 */
+	std::vector<ObjectRenderablesRef> objectsInRect(int color_priority, const ObjectRenderablesMap& objects, const QRectF& rect) const;
+	
 	Map* const map;
+	
+	/** A spatial index of the objects for each color priority. */
+	std::map<int, SpatialGrid<const Object*>> spatial_index;
 };
 
 
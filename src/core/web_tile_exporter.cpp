@@ -0,0 +1,443 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifdef QT_PRINTSUPPORT_LIB
+
+#include "web_tile_exporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include <QtMath>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QImage>
+#include <QLatin1Char>
+#include <QLatin1String>
+#include <QPointF>
+#include <QPolygonF>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#ifdef QT_SQL_LIB
+#  include <QSqlDatabase>
+#  include <QSqlError>
+#  include <QSqlQuery>
+#  include <QVariant>
+#endif
+
+#include "core/georeferencing.h"
+#include "core/map.h"
+#include "core/map_coord.h"
+
+
+namespace OpenOrienteering {
+
+constexpr int WebTileExporter::tile_size;
+constexpr int WebTileExporter::max_zoom_level;
+
+
+namespace {
+
+/// The latitude limit of the Web Mercator projection
+constexpr double max_latitude = 85.0511287798;
+
+double tileLongitude(int x, int zoom)
+{
+	return std::ldexp(x, -zoom) * 360.0 - 180.0;
+}
+
+double tileLatitude(int y, int zoom)
+{
+	return qRadiansToDegrees(std::atan(std::sinh(M_PI * (1.0 - 2.0 * std::ldexp(y, -zoom)))));
+}
+
+int tileX(double longitude, int zoom)
+{
+	auto const x = int(std::floor((longitude + 180.0) / 360.0 * (1 << zoom)));
+	return qBound(0, x, (1 << zoom) - 1);
+}
+
+int tileY(double latitude, int zoom)
+{
+	auto const lat = qDegreesToRadians(qBound(-max_latitude, latitude, max_latitude));
+	auto const y = int(std::floor((1.0 - std::log(std::tan(lat) + 1.0 / std::cos(lat)) / M_PI) / 2.0 * (1 << zoom)));
+	return qBound(0, y, (1 << zoom) - 1);
+}
+
+/**
+ * Returns the transformation from map coordinates to tile pixels,
+ * given the map coordinates of three corners of the tile.
+ *
+ * Within a tile, the transformation from map coordinates to Web Mercator
+ * is approximated by an affine transformation.
+ */
+QTransform tileTransform(const QPointF& top_left, const QPointF& top_right, const QPointF& bottom_left)
+{
+	auto const dx = (top_right - top_left) / WebTileExporter::tile_size;
+	auto const dy = (bottom_left - top_left) / WebTileExporter::tile_size;
+	return QTransform(dx.x(), dx.y(), dy.x(), dy.y(), top_left.x(), top_left.y()).inverted();
+}
+
+
+}  // namespace
+
+
+
+WebTileExporter::WebTileExporter(Map& map, const MapView* view)
+: map(map)
+, view(view)
+, map_printer(map, view)
+{
+	map_printer.setTarget(MapPrinter::imageTarget());
+	map_printer.setMode(MapPrinterOptions::Raster);
+}
+
+WebTileExporter::~WebTileExporter() = default;
+
+
+MapPrinter& WebTileExporter::printer()
+{
+	return map_printer;
+}
+
+
+void WebTileExporter::setZoomRange(int min_zoom, int max_zoom)
+{
+	this->min_zoom = qBound(0, std::min(min_zoom, max_zoom), max_zoom_level);
+	this->max_zoom = qBound(0, std::max(min_zoom, max_zoom), max_zoom_level);
+}
+
+
+qint64 WebTileExporter::tileCount()
+{
+	if (!prepare())
+		return -1;
+	
+	qint64 count = 0;
+	std::vector<Tile> tiles;
+	for (int zoom = min_zoom; zoom <= max_zoom; ++zoom)
+	{
+		tiles.clear();
+		if (!collectTiles(zoom, tiles))
+			return -1;
+		count += qint64(tiles.size());
+	}
+	return count;
+}
+
+
+bool WebTileExporter::exportToDirectory(const QString& path)
+{
+	QDir dir(path);
+	return exportTiles([this, &dir](const Tile& tile) {
+		auto const tile_dir = QString::number(tile.zoom) + QLatin1Char('/') + QString::number(tile.x);
+		if (!dir.mkpath(tile_dir))
+			return setError(tr("Cannot create the directory %1").arg(dir.filePath(tile_dir)));
+		
+		QFile file(dir.filePath(tile_dir + QLatin1Char('/') + QString::number(tile.y) + QLatin1String(".png")));
+		if (!file.open(QIODevice::WriteOnly) || file.write(tile.data) != tile.data.size())
+			return setError(tr("Cannot save file\n%1:\n%2").arg(file.fileName(), file.errorString()));
+		
+		return true;
+	});
+}
+
+
+bool WebTileExporter::exportToMBTiles(const QString& path)
+{
+#ifdef QT_SQL_LIB
+	if (QFile::exists(path) && !QFile::remove(path))
+		return setError(tr("Cannot replace the file %1").arg(path));
+	
+	// Each exporter uses its own database connection.
+	auto const connection_name = QString::fromLatin1("WebTileExporter-%1").arg(quintptr(this), 0, 16);
+	auto success = false;
+	{
+		auto db = QSqlDatabase::addDatabase(QString::fromLatin1("QSQLITE"), connection_name);
+		db.setDatabaseName(path);
+		if (!db.open())
+		{
+			setError(tr("Cannot save file\n%1:\n%2").arg(path, db.lastError().text()));
+		}
+		else
+		{
+			success = writeMBTiles(db, QFileInfo(path).completeBaseName());
+			db.close();
+		}
+	}
+	QSqlDatabase::removeDatabase(connection_name);
+	
+	if (!success)
+		QFile::remove(path);
+	return success;
+#else
+	Q_UNUSED(path)
+	return setError(tr("The MBTiles format is not supported by this program."));
+#endif
+}
+
+
+QString WebTileExporter::errorString() const
+{
+	return error_string;
+}
+
+
+QTransform WebTileExporter::mapToTile(int zoom, int x, int y) const
+{
+	LatLon const lat_lon[3] = {
+	    { tileLatitude(y, zoom), tileLongitude(x, zoom) },
+	    { tileLatitude(y, zoom), tileLongitude(x + 1, zoom) },
+	    { tileLatitude(y + 1, zoom), tileLongitude(x, zoom) },
+	};
+	MapCoordF corners[3];
+	if (!map.getGeoreferencing().toMapCoordF(lat_lon, corners, 3))
+		return QTransform(0, 0, 0, 0, 0, 0);
+	
+	return tileTransform(corners[0], corners[1], corners[2]);
+}
+
+
+bool WebTileExporter::prepare()
+{
+	error_string.clear();
+	
+	const auto& georef = map.getGeoreferencing();
+	if (georef.isLocal())
+		return setError(tr("The map is not georeferenced."));
+	
+	extent = map.calculateExtent(false, map_printer.getOptions().show_templates, view);
+	if (extent.isEmpty())
+		return setError(tr("The map is empty."));
+	
+	map_printer.setPrintArea(extent);
+	
+	// The geographic bounds are determined from points on the boundary
+	// of the extent, because the map may be rotated relative to the meridians.
+	constexpr int steps = 8;
+	std::vector<MapCoordF> boundary;
+	boundary.reserve(4 * steps);
+	for (int i = 0; i < steps; ++i)
+	{
+		auto const t = double(i) / steps;
+		boundary.emplace_back(extent.left() + t * extent.width(), extent.top());
+		boundary.emplace_back(extent.right(), extent.top() + t * extent.height());
+		boundary.emplace_back(extent.right() - t * extent.width(), extent.bottom());
+		boundary.emplace_back(extent.left(), extent.bottom() - t * extent.height());
+	}
+	std::vector<LatLon> lat_lon(boundary.size());
+	if (!georef.toGeographicCoords(boundary.data(), lat_lon.data(), boundary.size()))
+		return setError(tr("Failed to transform the map extent to geographic coordinates."));
+	
+	auto const latitude = std::minmax_element(begin(lat_lon), end(lat_lon), [](const LatLon& a, const LatLon& b) {
+		return a.latitude() < b.latitude();
+	});
+	auto const longitude = std::minmax_element(begin(lat_lon), end(lat_lon), [](const LatLon& a, const LatLon& b) {
+		return a.longitude() < b.longitude();
+	});
+	south_west = { latitude.first->latitude(), longitude.first->longitude() };
+	north_east = { latitude.second->latitude(), longitude.second->longitude() };
+	return true;
+}
+
+
+bool WebTileExporter::collectTiles(int zoom, std::vector<Tile>& tiles)
+{
+	auto const left = tileX(south_west.longitude(), zoom);
+	auto const right = tileX(north_east.longitude(), zoom);
+	auto const top = tileY(north_east.latitude(), zoom);
+	auto const bottom = tileY(south_west.latitude(), zoom);
+	
+	// The corners of all tiles, transformed in a single call
+	auto const columns = right - left + 2;
+	auto const rows = bottom - top + 2;
+	std::vector<LatLon> lat_lon;
+	lat_lon.reserve(std::size_t(columns) * std::size_t(rows));
+	for (int y = top; y < top + rows; ++y)
+	{
+		for (int x = left; x < left + columns; ++x)
+			lat_lon.emplace_back(tileLatitude(y, zoom), tileLongitude(x, zoom));
+	}
+	std::vector<MapCoordF> corners(lat_lon.size());
+	if (!map.getGeoreferencing().toMapCoordF(lat_lon.data(), corners.data(), lat_lon.size()))
+		return setError(tr("Failed to transform the tiles of zoom level %1 to map coordinates.").arg(zoom));
+	
+	auto const corner = [&corners, left, top, columns](int x, int y) -> const MapCoordF& {
+		return corners[std::size_t((y - top) * columns + (x - left))];
+	};
+	
+	auto const extent_polygon = QPolygonF(extent);
+	for (int y = top; y <= bottom; ++y)
+	{
+		for (int x = left; x <= right; ++x)
+		{
+			// Skip tiles which do not overlap the map extent.
+			QPolygonF quad;
+			quad << corner(x, y) << corner(x + 1, y) << corner(x + 1, y + 1) << corner(x, y + 1);
+			auto const bounds = quad.boundingRect();
+			if (!bounds.intersects(extent)
+			    || (!extent.contains(bounds) && quad.intersected(extent_polygon).isEmpty()))
+				continue;
+			
+			tiles.push_back({ zoom, x, y, tileTransform(corner(x, y), corner(x + 1, y), corner(x, y + 1)), {} });
+		}
+	}
+	
+	return true;
+}
+
+
+bool WebTileExporter::exportTiles(const std::function<bool (const Tile&)>& write_tile)
+{
+	if (!prepare())
+		return false;
+	
+	// The tiles are drawn without modifying the map.
+	map.updateObjects();
+	
+	// Templates are drawn on this thread, one tile at a time.
+	auto const batch_size = map_printer.getOptions().show_templates ? 1 : 4 * std::max(1, QThread::idealThreadCount());
+	auto const render_tile = [this](Tile& tile) { renderTile(tile); };
+	
+	std::vector<Tile> tiles;
+	for (int zoom = min_zoom; zoom <= max_zoom; ++zoom)
+	{
+		tiles.clear();
+		if (!collectTiles(zoom, tiles))
+			return false;
+		
+		for (auto tile = begin(tiles); tile != end(tiles); )
+		{
+			auto const batch_end = tile + std::min(std::ptrdiff_t(batch_size), std::distance(tile, end(tiles)));
+			if (batch_size == 1)
+				render_tile(*tile);
+			else
+				QtConcurrent::blockingMap(tile, batch_end, render_tile);
+			
+			for (; tile != batch_end; ++tile)
+			{
+				if (tile->data.isEmpty())
+					return setError(tr("Failed to render the tile %1/%2/%3.").arg(tile->zoom).arg(tile->x).arg(tile->y));
+				if (!write_tile(*tile))
+					return false;
+				tile->data = {};
+			}
+		}
+	}
+	
+	return true;
+}
+
+
+void WebTileExporter::renderTile(Tile& tile) const
+{
+	QImage image(tile_size, tile_size, QImage::Format_ARGB32_Premultiplied);
+	if (!map_printer.drawTransformed(image, tile.map_to_tile))
+		return;
+	
+	QBuffer buffer(&tile.data);
+	buffer.open(QIODevice::WriteOnly);
+	if (!image.convertToFormat(QImage::Format_RGB32).save(&buffer, "PNG"))
+		tile.data.clear();
+}
+
+
+#ifdef QT_SQL_LIB
+
+bool WebTileExporter::writeMBTiles(QSqlDatabase& db, const QString& name)
+{
+	QSqlQuery query(db);
+	auto const sql_error = [this, &query]() { return setError(query.lastError().text()); };
+	
+	for (auto statement : { "CREATE TABLE metadata (name TEXT, value TEXT)",
+	                        "CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)",
+	                        "CREATE UNIQUE INDEX tile_index ON tiles (zoom_level, tile_column, tile_row)" })
+	{
+		if (!query.exec(QString::fromLatin1(statement)))
+			return sql_error();
+	}
+	
+	if (!db.transaction())
+		return setError(db.lastError().text());
+	
+	auto success = query.prepare(QString::fromLatin1("INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)"));
+	if (!success)
+		sql_error();
+	else
+		success = exportTiles([&query, &sql_error](const Tile& tile) {
+			query.addBindValue(tile.zoom);
+			query.addBindValue(tile.x);
+			query.addBindValue((1 << tile.zoom) - 1 - tile.y);  // MBTiles rows count from the south.
+			query.addBindValue(tile.data);
+			return query.exec() || sql_error();
+		});
+	
+	if (success)
+	{
+		// The bounds are determined by exportTiles().
+		const std::pair<const char*, QString> metadata[] = {
+		    { "name",    name },
+		    { "format",  QString::fromLatin1("png") },
+		    { "type",    QString::fromLatin1("baselayer") },
+		    { "minzoom", QString::number(min_zoom) },
+		    { "maxzoom", QString::number(max_zoom) },
+		    { "bounds",  QString::fromLatin1("%1,%2,%3,%4").arg(south_west.longitude()).arg(south_west.latitude())
+		                                                    .arg(north_east.longitude()).arg(north_east.latitude()) },
+		};
+		success = query.prepare(QString::fromLatin1("INSERT INTO metadata (name, value) VALUES (?, ?)"));
+		for (auto entry = std::begin(metadata); success && entry != std::end(metadata); ++entry)
+		{
+			query.addBindValue(QString::fromLatin1(entry->first));
+			query.addBindValue(entry->second);
+			success = query.exec();
+		}
+		if (!success)
+			sql_error();
+	}
+	
+	if (!success)
+	{
+		db.rollback();
+		return false;
+	}
+	
+	return db.commit() || setError(db.lastError().text());
+}
+
+#endif  // QT_SQL_LIB
+
+
+bool WebTileExporter::setError(const QString& message)
+{
+	error_string = message;
+	return false;
+}
+
+
+}  // namespace OpenOrienteering
+
+#endif  // QT_PRINTSUPPORT_LIB
@@ -0,0 +1,195 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_WEB_TILE_EXPORTER_H
+#define OPENORIENTEERING_WEB_TILE_EXPORTER_H
+
+#ifdef QT_PRINTSUPPORT_LIB
+
+#include <functional>
+#include <vector>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QRectF>
+#include <QString>
+#include <QTransform>
+
+#include "core/latlon.h"
+#include "core/map_printer.h"
+
+class QSqlDatabase;
+
+namespace OpenOrienteering {
+
+class Map;
+class MapView;
+
+
+/**
+ * An exporter for web map tiles.
+ *
+ * The map is rendered to PNG tiles of the Web Mercator tile pyramid which is
+ * used by OpenStreetMap and most web maps (XYZ scheme), for a range of zoom
+ * levels. The tiles are written either to a directory tree (zoom/x/y.png) or
+ * to an MBTiles file, i.e. an SQLite database.
+ *
+ * Rendering uses a MapPrinter with the map's print configuration in raster
+ * mode, so templates and grid are drawn according to that configuration.
+ * Only tiles which overlap the map extent are rendered. Unless templates are
+ * printed, several tiles are rendered concurrently.
+ *
+ * The map must be georeferenced.
+ */
+class WebTileExporter
+{
+	Q_DECLARE_TR_FUNCTIONS(OpenOrienteering::WebTileExporter)
+
+public:
+	/// The width and height of the tiles, in pixels
+	static constexpr int tile_size = 256;
+	
+	/// The highest supported zoom level
+	static constexpr int max_zoom_level = 24;
+	
+	
+	/**
+	 * Constructs an exporter for the given map.
+	 *
+	 * If a view is given, it determines the visibility of map and templates.
+	 */
+	WebTileExporter(Map& map, const MapView* view);
+	
+	WebTileExporter(const WebTileExporter&) = delete;
+	~WebTileExporter();
+	
+	WebTileExporter& operator=(const WebTileExporter&) = delete;
+	
+	
+	/**
+	 * Returns the map printer which renders the tiles.
+	 *
+	 * Its options may be changed before exporting.
+	 */
+	MapPrinter& printer();
+	
+	/**
+	 * Sets the range of zoom levels, including both limits.
+	 */
+	void setZoomRange(int min_zoom, int max_zoom);
+	
+	/**
+	 * Returns the number of tiles which overlap the map extent, for all
+	 * zoom levels.
+	 *
+	 * Returns -1 if the map is empty or not georeferenced.
+	 */
+	qint64 tileCount();
+	
+	
+	/**
+	 * Writes the tiles to a directory tree.
+	 *
+	 * Tile x at row y of zoom level z is written to path/z/x/y.png.
+	 */
+	bool exportToDirectory(const QString& path);
+	
+	/**
+	 * Writes the tiles to an MBTiles file.
+	 *
+	 * An existing file is replaced. This requires Qt's SQLite driver.
+	 */
+	bool exportToMBTiles(const QString& path);
+	
+	/**
+	 * Returns the error string of the last failed operation.
+	 */
+	QString errorString() const;
+	
+	
+	/**
+	 * Returns the transformation from map coordinates to the pixels of a tile.
+	 *
+	 * Returns an invalid transformation if the map is not georeferenced.
+	 */
+	QTransform mapToTile(int zoom, int x, int y) const;
+
+
+private:
+	struct Tile
+	{
+		int zoom;
+		int x;
+		int y;
+		QTransform map_to_tile;
+		QByteArray data;    ///< The PNG encoded image
+	};
+	
+	/**
+	 * Determines the map extent and its geographic bounds.
+	 */
+	bool prepare();
+	
+	/**
+	 * Returns the tiles of the zoom level which overlap the map extent.
+	 */
+	bool collectTiles(int zoom, std::vector<Tile>& tiles);
+	
+	/**
+	 * Renders all tiles and passes them to write_tile, in order of zoom level.
+	 */
+	bool exportTiles(const std::function<bool (const Tile&)>& write_tile);
+	
+	/**
+	 * Renders a single tile to PNG data.
+	 * 
+	 * This does not modify the map, so it may run concurrently after
+	 * Map::updateObjects().
+	 */
+	void renderTile(Tile& tile) const;
+
+#ifdef QT_SQL_LIB
+	/**
+	 * Creates the MBTiles tables and writes metadata and tiles.
+	 */
+	bool writeMBTiles(QSqlDatabase& db, const QString& name);
+#endif
+
+	bool setError(const QString& message);
+	
+	
+	Map& map;
+	const MapView* view;
+	MapPrinter map_printer;
+	QString error_string;
+	QRectF extent;
+	LatLon south_west;
+	LatLon north_east;
+	int min_zoom = 0;
+	int max_zoom = 16;
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif  // QT_PRINTSUPPORT_LIB
+
+#endif
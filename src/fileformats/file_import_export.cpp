@@ -21,6 +21,7 @@
 
 #include "file_import_export.h"
 
+#include <QIODevice>
 #include <QLatin1Char>
 
 #include "core/map.h"
@@ -56,10 +57,19 @@ Importer::~Importer() = default;
 
 
 void Importer::doImport(bool load_symbols_only, const QString& map_path)
+{
+	doImportData(load_symbols_only);
+	loadTemplates(map_path);
+}
+
+void Importer::doImportData(bool load_symbols_only)
 {
 	if (view)
 		view->setTemplateLoadingBlocked(true);
 	
+	if (progress)
+		progress->size = stream->size();
+	
 	import(load_symbols_only);
 	
 	// Object post processing:
@@ -111,7 +121,10 @@ void Importer::doImport(bool load_symbols_only, const QString& map_path)
 		if (!map->getSymbol(i)->loadFinished(map))
 			throw FileFormatException(::OpenOrienteering::Importer::tr("Error during symbol post-processing."));
 	}
-	
+}
+
+void Importer::loadTemplates(const QString& map_path)
+{
 	// Template loading: try to find all template files
 	if (view)
 		view->setTemplateLoadingBlocked(false);
@@ -124,6 +137,11 @@ void Importer::doImport(bool load_symbols_only, const QString& map_path)
 		{
 			have_lost_template = true;
 		}
+		else if (view && view->templateLoadingAsync() && view->getTemplateVisibility(temp).visible)
+		{
+			// Errors will be shown in the template list.
+			temp->loadTemplateFileAsync();
+		}
 		else if (!view || view->getTemplateVisibility(temp).visible)
 		{
 			if (!temp->loadTemplateFile(false))
@@ -168,6 +186,29 @@ void Importer::finishImport()
 	// Nothing, not inlined
 }
 
+void Importer::setProgress(ImportProgress* progress)
+{
+	this->progress = progress;
+}
+
+void Importer::updateProgress(int parts, int objects)
+{
+	if (progress)
+		updateProgress(stream->pos(), parts, objects);
+}
+
+void Importer::updateProgress(qint64 position, int parts, int objects)
+{
+	if (!progress)
+		return;
+	
+	progress->position = position;
+	progress->parts = parts;
+	progress->objects = objects;
+	if (progress->canceled)
+		throw FileFormatException(::OpenOrienteering::Importer::tr("Canceled"));
+}
+
 
 
 // ### Exporter ###
@@ -20,8 +20,10 @@
 #ifndef OPENORIENTEERING_IMPORT_EXPORT_H
 #define OPENORIENTEERING_IMPORT_EXPORT_H
 
+#include <atomic>
 #include <vector>
 
+#include <QtGlobal>
 #include <QCoreApplication>
 #include <QHash>
 #include <QString>
@@ -108,6 +110,30 @@ class ImportAction
 };
 
 
+/** The progress of an import which may run on another thread.
+ *
+ *  The importer updates the counters while reading the file. Any thread may
+ *  read the counters, and request the import to stop by setting canceled.
+ */
+struct ImportProgress
+{
+	/// The number of bytes read from the file
+	std::atomic<qint64> position { 0 };
+	
+	/// The size of the file, in bytes
+	std::atomic<qint64> size { 0 };
+	
+	/// The number of map parts read so far
+	std::atomic<int> parts { 0 };
+	
+	/// The number of objects read so far
+	std::atomic<int> objects { 0 };
+	
+	/// Set to true to stop the import
+	std::atomic<bool> canceled { false };
+};
+
+
 /** Base class for all importers. An Importer has the following lifecycle:
  *  -# The Importer is constructed, with pointers to the map and view. The Importer
  *     should also set default values for any options it will read. The base class
@@ -120,6 +146,9 @@ class ImportAction
  *     action item will have its satisfy() method called with the user's choice.
  *  -# finishImport() will be called. If any action items were created, this method
  *     should finish the import based on the values supplied by the user.
+ *
+ *  doImport() may be replaced by doImportData() and loadTemplates(). This allows to
+ *  read the file on a worker thread, and to load the templates on the GUI thread.
  */
 class Importer : public ImportExport
 {
@@ -149,6 +178,20 @@ public:
 	 */
 	void doImport(bool load_symbols_only, const QString& map_path = QString());
 	
+	/** Reads the file and populates the map and view, without loading templates.
+	 *  This method does not interact with the user, so it may run on a worker thread.
+	 */
+	void doImportData(bool load_symbols_only);
+	
+	/** Tries to find and load the map's templates, as the final part of doImport().
+	 */
+	void loadTemplates(const QString& map_path = QString());
+	
+	/** Sets an object which receives the progress of the import.
+	 *  The object must remain valid until the import is finished.
+	 */
+	void setProgress(ImportProgress* progress);
+	
 	/** Once all action items are satisfied, this method should be called to complete the
 	 *  import process. This class defines a default implementation, that does nothing.
 	 */
@@ -163,7 +206,23 @@ protected:
 	 */
 	inline void addAction(const ImportAction &action);
 	
+	/** Reports the current position in the stream, and the given counts of
+	 *  map parts and objects. If the import was canceled, a FileFormatException
+	 *  is thrown.
+	 */
+	void updateProgress(int parts, int objects);
+	
+	/** Reports the given position and counts of map parts and objects.
+	 *  Unlike the other overload, this function does not access the stream,
+	 *  so it may be called concurrently from worker threads.
+	 */
+	void updateProgress(qint64 position, int parts, int objects);
+
 private:
+	/// The receiver of progress information, or nullptr
+	ImportProgress* progress = nullptr;
+	
+	
 	/// A list of action items that must be resolved before the import can be completed
 	std::vector<ImportAction> act;
 };
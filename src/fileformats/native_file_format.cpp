@@ -306,6 +306,7 @@ void NativeFileImport::import(bool load_symbols_only)
     int num_symbols;
     stream->read((char*)&num_symbols, sizeof(int));
     map->symbols.resize(num_symbols);
+    map->symbol_positions.clear();
 
     for (int i = 0; i < num_symbols; ++i)
     {
@@ -326,6 +327,7 @@ void NativeFileImport::import(bool load_symbols_only)
             throw FileFormatException(::OpenOrienteering::Importer::tr("Error while loading a symbol."));
         }
         map->symbols[i] = symbol;
+        map->symbol_positions.clear();
     }
 
     if (!load_symbols_only)
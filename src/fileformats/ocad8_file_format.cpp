@@ -265,6 +265,7 @@ void OCAD8FileImport::import(bool load_symbols_only)
 						map->symbols.push_back(rect->inner_line);
 						map->symbols.push_back(rect->text);
 					}
+					map->symbol_positions.clear();
 					continue;
                 }
 				
@@ -272,6 +273,7 @@ void OCAD8FileImport::import(bool load_symbols_only)
 				if (symbol)
 				{
 					map->symbols.push_back(symbol);
+					map->symbol_positions.clear();
 					symbol_index[ocad_symbol->number] = symbol;
                 }
                 else
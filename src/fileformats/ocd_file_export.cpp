@@ -22,13 +22,192 @@
 
 #include "ocd_file_export.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include <QtMath>
+#include <QColor>
+#include <QFileInfo>
+#include <QFontMetricsF>
+#include <QImage>
+#include <QIODevice>
+#include <QLatin1Char>
+#include <QLatin1String>
+#include <QPointF>
+#include <QRectF>
+#include <QTransform>
+
+#include "core/georeferencing.h"
+#include "core/map.h"
+#include "core/map_color.h"
+#include "core/map_grid.h"
+#include "core/map_part.h"
+#include "core/map_view.h"
+#include "core/objects/object.h"
+#include "core/objects/text_object.h"
+#include "core/symbols/area_symbol.h"
+#include "core/symbols/combined_symbol.h"
+#include "core/symbols/line_symbol.h"
+#include "core/symbols/point_symbol.h"
+#include "core/symbols/symbol.h"
+#include "core/symbols/text_symbol.h"
+#include "fileformats/file_format.h"
 #include "fileformats/ocad8_file_format_p.h"
+#include "fileformats/ocd_types.h"
+#include "fileformats/ocd_types_v11.h"
+#include "fileformats/ocd_types_v12.h"
+#include "templates/template.h"
+#include "util/util.h"
 
 
 namespace OpenOrienteering {
 
-OcdFileExport::OcdFileExport(QIODevice* stream, Map* map, MapView* view)
+namespace {
+
+/// The number of entries in an OCD index block
+constexpr std::size_t index_block_size = 256;
+
+/**
+ * Converts a native coordinate (1/1000 mm) to an OCD coordinate (1/100 mm)
+ * in the upper 24 bits, rounding half up.
+ *
+ * \see OCAD8FileExport
+ */
+constexpr qint32 convertPointMember(qint32 value)
+{
+	return (value < -5) ? qint32(0x80000000u | ((0x7fffffu & quint32((value-4)/10)) << 8)) : qint32((0x7fffffu & quint32((value+5)/10)) << 8);
+}
+
+Ocd::OcdPoint32 convertPoint(const MapCoord& coord)
+{
+	return { convertPointMember(coord.nativeX()), convertPointMember(-coord.nativeY()) };
+}
+
+/**
+ * Converts a length from 1/1000 mm to 1/100 mm.
+ */
+constexpr qint32 convertSize(qint32 size)
+{
+	return (size + 5) / 10;
+}
+
+/**
+ * Converts an angle from radians to tenths of a degree.
+ */
+qint16 convertRotation(qreal angle)
+{
+	return qint16(qRound(10 * qRadiansToDegrees(angle)));
+}
+
+template< std::size_t N >
+void convertString(const QString& text, Ocd::Utf8PascalString<N>& target)
+{
+	auto data = text.toUtf8();
+	// Don't cut multi-byte characters.
+	auto length = std::min(std::size_t(data.size()), N);
+	while (length < std::size_t(data.size()) && length > 0 && (quint8(data[int(length)]) & 0xc0) == 0x80)
+		--length;
+	target.length = static_cast<unsigned char>(length);
+	std::memcpy(target.data, data.constData(), length);
+}
+
+template< std::size_t N >
+void convertString(const QString& text, Ocd::Utf16PascalString<N>& target)
+{
+	auto length = std::min(std::size_t(text.size()), N - 1);
+	std::copy(text.constData(), text.constData() + length, target.data);
+	target.data[length] = QChar::Null;
+}
+
+/**
+ * Returns an OCD parameter string for the given text.
+ *
+ * OCD parameter strings are zero-terminated, and UTF-8 encoded since V11.
+ */
+QByteArray parameterString(const QString& text)
+{
+	auto data = text.toUtf8();
+	data.append('\0');
+	return data;
+}
+
+/**
+ * Returns OCD index blocks for the given entities, followed by the entities.
+ *
+ * The make_entry function is called with the index and position of each
+ * entity, and it must return the index entry for this entity.
+ * At least one (empty) index block is created.
+ */
+template< class Entry, class EntryFunction >
+QByteArray indexedData(quint32 first_block_pos, const std::vector<QByteArray>& entities, EntryFunction make_entry)
+{
+	using IndexBlock = Ocd::IndexBlock<Entry>;
+	
+	auto const num_blocks = std::max(std::size_t(1), (entities.size() + index_block_size - 1) / index_block_size);
+	auto blocks = std::vector<IndexBlock>(num_blocks);
+	for (std::size_t i = 1; i < num_blocks; ++i)
+		blocks[i-1].next_block = first_block_pos + quint32(i * sizeof(IndexBlock));
+	
+	auto const data_pos = first_block_pos + quint32(num_blocks * sizeof(IndexBlock));
+	auto data = QByteArray{};
+	for (std::size_t i = 0; i < entities.size(); ++i)
+	{
+		blocks[i / index_block_size].entries[i % index_block_size] = make_entry(i, data_pos + quint32(data.size()));
+		data.append(entities[i]);
+	}
+	
+	auto result = QByteArray(reinterpret_cast<const char*>(blocks.data()), int(num_blocks * sizeof(IndexBlock)));
+	result.append(data);
+	return result;
+}
+
+/**
+ * Returns the palette index for the given color in an OCD V9+ symbol icon.
+ *
+ * This is an approximation by the 6x6x6 color cube of the palette.
+ */
+quint8 getPaletteColorV9(QRgb rgb)
+{
+	auto component = [](int value) { return (value + 25) / 51; };
+	return quint8(36 * component(qRed(rgb)) + 6 * component(qGreen(rgb)) + component(qBlue(rgb)));
+}
+
+/**
+ * Exports the symbol icon for OCD V9 and later.
+ *
+ * The icon has 22x22 pixels with 8 bit color indices, origin at bottom left.
+ */
+void exportSymbolIconV9(const Map& map, const Symbol* symbol, quint8 icon_bits[])
+{
+	constexpr int icon_size = 22;
+	auto image = symbol->createIcon(map, icon_size, false)
+	             .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+	for (int y = icon_size - 1; y >= 0; --y)
+	{
+		for (int x = 0; x < icon_size; ++x)
+		{
+			// Apply premultiplied pixel on white background
+			auto premultiplied = image.pixel(x, y);
+			auto alpha = qAlpha(premultiplied);
+			auto pixel = qRgb(255 - alpha + qRed(premultiplied),
+			                  255 - alpha + qGreen(premultiplied),
+			                  255 - alpha + qBlue(premultiplied));
+			*(icon_bits++) = getPaletteColorV9(pixel);
+		}
+	}
+}
+
+}  // namespace
+
+
+
+OcdFileExport::OcdFileExport(QIODevice* stream, Map* map, MapView* view, quint16 version)
 : Exporter { stream, map, view }
+, ocd_version { version }
 {
 	// nothing else
 }
@@ -39,13 +218,1107 @@ OcdFileExport::~OcdFileExport() = default;
 
 void OcdFileExport::doExport()
 {
-	OCAD8FileExport delegate { stream, map, view };
-	delegate.doExport();
-	for (auto&& w : delegate.warnings())
+	switch (ocd_version)
 	{
-		addWarning(w);
+	case 11:
+		exportImplementation<Ocd::FormatV11>();
+		break;
+	case 12:
+		exportImplementation<Ocd::FormatV12>();
+		break;
+	case 8:
+		{
+			OCAD8FileExport delegate { stream, map, view };
+			delegate.doExport();
+			for (auto&& w : delegate.warnings())
+			{
+				addWarning(w);
+			}
+		}
+		break;
+	default:
+		throw FileFormatException(tr("Unsupported OCD version: %1").arg(ocd_version));
 	}
 }
 
 
+
+template< class Format >
+void OcdFileExport::exportImplementation()
+{
+	uses_registration_color = map->isColorUsedByASymbol(map->getRegistrationColor());
+	symbol_index.clear();
+	text_format_index.clear();
+	symbol_numbers.clear();
+	
+	// The object index needs the current object extents.
+	map->updateObjects();
+	
+	auto extent = map->calculateExtent();
+	if (extent.isValid() && !QRectF(QPointF(-83000, -83000), QPointF(83000, 83000)).contains(extent))
+		addWarning(tr("Some coordinates are outside of the OCD drawing area. They might be unreachable in OCAD."));
+	
+	// Parameter strings
+	std::vector<QByteArray> strings;
+	std::vector<qint32> string_types;
+	exportGeoreferencing(strings, string_types);
+	exportColors(strings, string_types);
+	exportExtras(strings, string_types);
+	
+	// Symbols
+	std::vector<QByteArray> symbols;
+	exportSymbols<Format>(symbols);
+	
+	// Layout: header, string index and strings, symbol index and symbols, objects
+	typename Format::FileHeader header = {};
+	header.vendor_mark = 0x0cad;
+	header.file_type = Ocd::Map;
+	header.version = ocd_version;
+	
+	header.first_string_block = sizeof(header);
+	auto const string_data = indexedData<Ocd::ParameterStringIndexEntry>(header.first_string_block, strings, [&strings, &string_types](std::size_t i, quint32 pos) {
+		return Ocd::ParameterStringIndexEntry { pos, quint32(strings[i].size()), string_types[i], 0 };
+	});
+	header.first_symbol_block = header.first_string_block + quint32(string_data.size());
+	auto const symbol_data = indexedData<quint32>(header.first_symbol_block, symbols, [](std::size_t /*i*/, quint32 pos) {
+		return pos;
+	});
+	header.first_object_block = header.first_symbol_block + quint32(symbol_data.size());
+	
+	writeData(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeData(string_data);
+	writeData(symbol_data);
+	exportObjects<Format>(header.first_object_block);
+}
+
+
+
+void OcdFileExport::exportGeoreferencing(std::vector<QByteArray>& strings, std::vector<qint32>& types)
+{
+	const auto& georef = map->getGeoreferencing();
+	auto const ref_point = georef.toProjectedCoords(MapCoordF{});
+	auto string = QString { QLatin1String("\tm") + QString::number(georef.getScaleDenominator())
+	                        + QLatin1String("\ta") + QString::number(georef.getGrivation(), 'f', 8)
+	                        + QLatin1String("\tx") + QString::number(ref_point.x(), 'f', 3)
+	                        + QLatin1String("\ty") + QString::number(ref_point.y(), 'f', 3) };
+	
+	const auto& grid = map->getGrid();
+	if (grid.getUnit() == MapGrid::MetersInTerrain)
+		string += QLatin1String("\td") + QString::number(grid.getHorizontalSpacing());
+	
+	// Cf. OcdFileImport::applyGridAndZone()
+	auto grid_and_zone = QString{};
+	auto const crs_id = georef.getProjectedCRSId();
+	const auto& crs_parameters = georef.getProjectedCRSParameters();
+	if (georef.isLocal())
+	{
+		grid_and_zone = QStringLiteral("1000");
+	}
+	else if (crs_id == QLatin1String("UTM") && crs_parameters.size() == 1
+	         && !crs_parameters.front().endsWith(QLatin1String(" S")))
+	{
+		auto zone = crs_parameters.front().left(2).trimmed().toUInt();
+		if (zone >= 1 && zone <= 60)
+			grid_and_zone = QString::number(2000 + zone);
+	}
+	else if (crs_id == QLatin1String("Gauss-Krueger, datum: Potsdam") && crs_parameters.size() == 1)
+	{
+		auto zone = crs_parameters.front().toUInt();
+		if (zone >= 1 && zone <= 99)
+			grid_and_zone = QString::number(8000 + zone);
+	}
+	else if (crs_id == QLatin1String("EPSG") && crs_parameters.size() == 1)
+	{
+		if (crs_parameters.front() == QLatin1String("3067"))
+			grid_and_zone = QStringLiteral("6005");
+		else if (crs_parameters.front() == QLatin1String("21781"))
+			grid_and_zone = QStringLiteral("14001");
+	}
+	
+	if (!grid_and_zone.isEmpty())
+		string += QLatin1String("\ti") + grid_and_zone;
+	else
+		addWarning(tr("The coordinate reference system cannot be exported to this format."));
+	
+	strings.push_back(parameterString(string));
+	types.push_back(1039);
+}
+
+
+void OcdFileExport::exportColors(std::vector<QByteArray>& strings, std::vector<qint32>& types)
+{
+	auto add_color = [&strings, &types](const QString& name, int number, const MapColor* color)
+	{
+		auto percent = [](float value) { return QString::number(qRound(value * 1000) / 10.0); };
+		const auto& cmyk = color->getCmyk();
+		auto string = QString { name };
+		string.remove(QLatin1Char('\t'));
+		string += QLatin1String("\tn") + QString::number(number)
+		          + QLatin1String("\tc") + percent(cmyk.c)
+		          + QLatin1String("\tm") + percent(cmyk.m)
+		          + QLatin1String("\ty") + percent(cmyk.y)
+		          + QLatin1String("\tk") + percent(cmyk.k)
+		          + QLatin1String("\to") + QString::number(color->getKnockout() ? 0 : 1)
+		          + QLatin1String("\tt") + percent(color->getOpacity());
+		strings.push_back(parameterString(string));
+		types.push_back(9);
+	};
+	
+	auto number = 0;
+	if (uses_registration_color)
+	{
+		addWarning(tr("Registration black is exported as a regular color."));
+		add_color(QStringLiteral("Registration black"), number, Map::getRegistrationColor()); // not translated
+		++number;
+	}
+	for (int i = 0; i < map->getNumColors(); ++i)
+	{
+		auto color = map->getColor(i);
+		add_color(color->getName(), number, color);
+		++number;
+	}
+}
+
+
+void OcdFileExport::exportExtras(std::vector<QByteArray>& strings, std::vector<qint32>& types)
+{
+	// Map notes
+	if (!map->getMapNotes().isEmpty())
+	{
+		strings.push_back(parameterString(map->getMapNotes()));
+		types.push_back(1061);
+	}
+	
+	// View
+	if (view)
+	{
+		auto const center = view->center();
+		auto string = QString { QLatin1String("\tx") + QString::number(center.x())
+		                        + QLatin1String("\ty") + QString::number(-center.y())
+		                        + QLatin1String("\tz") + QString::number(view->getZoom()) };
+		strings.push_back(parameterString(string));
+		types.push_back(1030);
+	}
+	
+	// Templates, cf. OcdFileImport::importTemplate()
+	for (int i = map->getNumTemplates() - 1; i >= 0; --i)
+	{
+		const auto temp = map->getTemplate(i);
+		auto template_path = temp->getTemplatePath();
+		if (qstrcmp(temp->getTemplateType(), "TemplateImage") != 0
+		    && QFileInfo(template_path).suffix().compare(QLatin1String("ocd"), Qt::CaseInsensitive) != 0)
+		{
+			addWarning(tr("Unable to export template: file type of \"%1\" is not supported yet").arg(temp->getTemplateFilename()));
+			continue;
+		}
+		
+		auto visible = 1;
+		auto dimming = 0;
+		if (view)
+		{
+			auto visibility = view->getTemplateVisibility(temp);
+			visible = visibility.visible ? 1 : 0;
+			dimming = qRound(100 * (1 - visibility.opacity));
+		}
+		
+		template_path.replace(QLatin1Char('/'), QLatin1Char('\\'));
+		auto const angle = QString::number(qRadiansToDegrees(temp->getTemplateRotation()), 'f', 8);
+		auto string = QString { template_path
+		                        + QLatin1String("\ts") + QString::number(visible)
+		                        + QLatin1String("\tx") + QString::number(temp->getTemplateX() / 1000.0, 'f', 3)
+		                        + QLatin1String("\ty") + QString::number(-temp->getTemplateY() / 1000.0, 'f', 3)
+		                        + QLatin1String("\ta") + angle
+		                        + QLatin1String("\tb") + angle
+		                        + QLatin1String("\tu") + QString::number(temp->getTemplateScaleX(), 'g', 10)
+		                        + QLatin1String("\tv") + QString::number(temp->getTemplateScaleY(), 'g', 10)
+		                        + QLatin1String("\td") + QString::number(dimming) };
+		strings.push_back(parameterString(string));
+		types.push_back(8);
+	}
+}
+
+
+
+template< class Format >
+void OcdFileExport::exportSymbols(std::vector<QByteArray>& symbols)
+{
+	// Text symbols are exported once for each alignment used by text objects.
+	for (int l = 0; l < map->getNumParts(); ++l)
+	{
+		auto part = map->getPart(l);
+		for (int o = 0; o < part->getNumObjects(); ++o)
+		{
+			auto object = part->getObject(o);
+			if (object->getType() == Object::Text && object->getSymbol()->getType() == Symbol::Text)
+				text_format_index[object->getSymbol()->asText()].insert(textAlignment(object->asText()), 0);
+		}
+	}
+	
+	auto add_symbol = [this, &symbols](const Symbol* symbol, QByteArray&& data, quint8 object_type)
+	{
+		auto number = reinterpret_cast<const typename Format::BaseSymbol*>(data.constData())->number;
+		symbol_index[symbol] = { { number, object_type } };
+		symbols.push_back(std::move(data));
+	};
+	
+	for (int i = 0; i < map->getNumSymbols(); ++i)
+	{
+		auto symbol = map->getSymbol(i);
+		switch (symbol->getType())
+		{
+		case Symbol::Point:
+			add_symbol(symbol, exportPointSymbol<typename Format::PointSymbol>(symbol->asPoint()), 1);
+			break;
+		case Symbol::Line:
+			add_symbol(symbol, exportLineSymbol<typename Format::LineSymbol>(symbol->asLine()), 2);
+			break;
+		case Symbol::Area:
+			add_symbol(symbol, exportAreaSymbol<typename Format::AreaSymbol>(symbol->asArea()), 3);
+			break;
+		case Symbol::Text:
+			exportTextSymbol<typename Format::TextSymbol>(symbol->asText(), symbols);
+			break;
+		case Symbol::Combined:
+			// Combined symbols are handled in a second pass,
+			// after all their public parts are in the symbol index.
+			break;
+		default:
+			Q_ASSERT(false);
+		}
+	}
+	
+	for (int i = 0; i < map->getNumSymbols(); ++i)
+	{
+		auto symbol = map->getSymbol(i);
+		if (symbol->getType() == Symbol::Combined)
+			symbol_index[symbol] = exportCombinedSymbol<Format>(symbol->asCombined(), symbols);
+	}
+}
+
+
+quint32 OcdFileExport::makeSymbolNumber(const Symbol* symbol)
+{
+	auto number = quint32(std::max(0, symbol->getNumberComponent(0))) * 1000;
+	if (symbol->getNumberComponent(1) >= 0)
+		number += quint32(symbol->getNumberComponent(1) % 1000);
+	// Symbol number 0.0 is not valid
+	if (number == 0)
+		number = 1;
+	// Ensure uniqueness of the symbol number
+	while (symbol_numbers.find(number) != symbol_numbers.end())
+		++number;
+	symbol_numbers.insert(number);
+	return number;
+}
+
+
+template< class OcdBaseSymbol >
+void OcdFileExport::setupBaseSymbol(const Symbol* symbol, OcdBaseSymbol& ocd_base_symbol)
+{
+	ocd_base_symbol.number = makeSymbolNumber(symbol);
+	convertString(symbol->getPlainTextName(), ocd_base_symbol.description);
+	
+	if (symbol->isProtected())
+		ocd_base_symbol.status |= Ocd::SymbolProtected;
+	if (symbol->isHidden())
+		ocd_base_symbol.status |= Ocd::SymbolHidden;
+	
+	// Used colors, limited by the size of the array
+	auto const max_colors = std::extent<decltype(ocd_base_symbol.colors)>::value;
+	for (int c = 0; c < map->getNumColors() && ocd_base_symbol.num_colors < max_colors; ++c)
+	{
+		auto color = map->getColor(c);
+		if (symbol->containsColor(color))
+			ocd_base_symbol.colors[ocd_base_symbol.num_colors++] = convertColor(color);
+	}
+	
+	exportSymbolIconV9(*map, symbol, ocd_base_symbol.icon_bits);
+}
+
+
+template< class OcdPointSymbol >
+QByteArray OcdFileExport::exportPointSymbol(const PointSymbol* point_symbol)
+{
+	OcdPointSymbol ocd_symbol = {};
+	setupBaseSymbol(point_symbol, ocd_symbol.base);
+	ocd_symbol.base.type = Ocd::SymbolTypePoint;
+	if (point_symbol->isRotatable())
+		ocd_symbol.base.flags |= 1;
+	ocd_symbol.base.extent = getPointSymbolExtent(point_symbol);
+	if (ocd_symbol.base.extent <= 0)
+		ocd_symbol.base.extent = 100;
+	
+	auto header_size = int(sizeof(OcdPointSymbol) - sizeof(typename OcdPointSymbol::Element));
+	auto data = QByteArray(reinterpret_cast<const char*>(&ocd_symbol), header_size);
+	auto pattern_size = exportPattern(point_symbol, data);
+	
+	auto result = reinterpret_cast<OcdPointSymbol*>(data.data());
+	result->base.size = decltype(ocd_symbol.base.size)(data.size());
+	result->data_size = pattern_size;
+	return data;
+}
+
+
+template< class OcdLineSymbol >
+QByteArray OcdFileExport::exportLineSymbol(const LineSymbol* line_symbol)
+{
+	OcdLineSymbol ocd_symbol = {};
+	setupBaseSymbol(line_symbol, ocd_symbol.base);
+	ocd_symbol.base.type = Ocd::SymbolTypeLine;
+	
+	auto extent = convertSize(line_symbol->getLineWidth() / 2);
+	if (line_symbol->hasBorder())
+		extent = std::max(extent, convertSize(line_symbol->getLineWidth() / 2 + line_symbol->getBorder().shift + line_symbol->getBorder().width / 2));
+	extent = std::max(extent, getPointSymbolExtent(line_symbol->getStartSymbol()));
+	extent = std::max(extent, getPointSymbolExtent(line_symbol->getEndSymbol()));
+	extent = std::max(extent, getPointSymbolExtent(line_symbol->getMidSymbol()));
+	extent = std::max(extent, getPointSymbolExtent(line_symbol->getDashSymbol()));
+	ocd_symbol.base.extent = extent;
+	
+	auto& common = ocd_symbol.common;
+	common.line_color = convertColor(line_symbol->getColor());
+	if (line_symbol->getColor())
+		common.line_width = quint16(convertSize(line_symbol->getLineWidth()));
+	
+	// Cap and join
+	using LineStyle = Ocd::LineSymbolCommonV8;
+	auto const cap_style = line_symbol->getCapStyle();
+	auto const join_style = line_symbol->getJoinStyle();
+	if (cap_style == LineSymbol::FlatCap && join_style == LineSymbol::BevelJoin)
+		common.line_style = LineStyle::BevelJoin_FlatCap;
+	else if (cap_style == LineSymbol::RoundCap && join_style == LineSymbol::RoundJoin)
+		common.line_style = LineStyle::RoundJoin_RoundCap;
+	else if (cap_style == LineSymbol::PointedCap && join_style == LineSymbol::BevelJoin)
+		common.line_style = LineStyle::BevelJoin_PointedCap;
+	else if (cap_style == LineSymbol::PointedCap && join_style == LineSymbol::RoundJoin)
+		common.line_style = LineStyle::RoundJoin_PointedCap;
+	else if (cap_style == LineSymbol::FlatCap && join_style == LineSymbol::MiterJoin)
+		common.line_style = LineStyle::MiterJoin_FlatCap;
+	else if (cap_style == LineSymbol::PointedCap && join_style == LineSymbol::MiterJoin)
+		common.line_style = LineStyle::MiterJoin_PointedCap;
+	else
+	{
+		addWarning(tr("In line symbol \"%1\", cannot represent cap/join combination.").arg(line_symbol->getPlainTextName()));
+		// Decide based on the caps
+		if (cap_style == LineSymbol::RoundCap)
+			common.line_style = LineStyle::RoundJoin_RoundCap;
+		else if (cap_style == LineSymbol::PointedCap)
+			common.line_style = LineStyle::RoundJoin_PointedCap;
+		else
+			common.line_style = LineStyle::BevelJoin_FlatCap;
+	}
+	
+	if (cap_style == LineSymbol::PointedCap)
+	{
+		common.dist_from_start = qint16(convertSize(line_symbol->getPointedCapLength()));
+		common.dist_from_end = common.dist_from_start;
+	}
+	
+	// Dash pattern
+	if (line_symbol->isDashed())
+	{
+		if (line_symbol->getMidSymbol() && !line_symbol->getMidSymbol()->isEmpty())
+		{
+			if (line_symbol->getDashesInGroup() > 1)
+				addWarning(tr("In line symbol \"%1\", neglecting the dash grouping.").arg(line_symbol->getPlainTextName()));
+			
+			common.main_length = qint16(convertSize(line_symbol->getDashLength() + line_symbol->getBreakLength()));
+			common.end_length = common.main_length / 2;
+			common.sec_gap = qint16(convertSize(line_symbol->getBreakLength()));
+		}
+		else if (line_symbol->getDashesInGroup() > 1)
+		{
+			if (line_symbol->getDashesInGroup() > 2)
+				addWarning(tr("In line symbol \"%1\", the number of dashes in a group has been reduced to 2.").arg(line_symbol->getPlainTextName()));
+			
+			common.main_length = qint16(convertSize(2 * line_symbol->getDashLength() + line_symbol->getInGroupBreakLength()));
+			common.end_length = common.main_length;
+			common.main_gap = qint16(convertSize(line_symbol->getBreakLength()));
+			common.sec_gap = qint16(convertSize(line_symbol->getInGroupBreakLength()));
+			common.end_gap = common.sec_gap;
+		}
+		else
+		{
+			common.main_length = qint16(convertSize(line_symbol->getDashLength()));
+			common.end_length = common.main_length / (line_symbol->getHalfOuterDashes() ? 2 : 1);
+			common.main_gap = qint16(convertSize(line_symbol->getBreakLength()));
+		}
+	}
+	else
+	{
+		common.main_length = qint16(convertSize(line_symbol->getSegmentLength()));
+		common.end_length = qint16(convertSize(line_symbol->getEndLength()));
+	}
+	
+	common.min_sym = line_symbol->getShowAtLeastOneSymbol() ? 0 : -1;
+	
+	// Double line
+	const auto& border = line_symbol->getBorder();
+	const auto& right_border = line_symbol->getRightBorder();
+	if (line_symbol->hasBorder() && (border.isVisible() || right_border.isVisible()))
+	{
+		common.double_width = qint16(convertSize(line_symbol->getLineWidth() - border.width + 2 * border.shift));
+		if (border.dashed && !right_border.dashed)
+			common.double_mode = 2;
+		else
+			common.double_mode = border.dashed ? 3 : 1;
+		
+		common.double_left_width = qint16(convertSize(border.width));
+		common.double_right_width = qint16(convertSize(right_border.width));
+		common.double_left_color = convertColor(border.color);
+		common.double_right_color = convertColor(right_border.color);
+		
+		if (border.dashed)
+		{
+			common.double_length = qint16(convertSize(border.dash_length));
+			common.double_gap = qint16(convertSize(border.break_length));
+		}
+		else if (right_border.dashed)
+		{
+			common.double_length = qint16(convertSize(right_border.dash_length));
+			common.double_gap = qint16(convertSize(right_border.break_length));
+		}
+		
+		if ((border.dashed && right_border.dashed
+		     && (border.dash_length != right_border.dash_length || border.break_length != right_border.break_length))
+		    || (!border.dashed && right_border.dashed))
+		{
+			addWarning(tr("In line symbol \"%1\", cannot export the borders correctly.").arg(line_symbol->getPlainTextName()));
+		}
+	}
+	
+	auto header_size = int(sizeof(OcdLineSymbol) - sizeof(typename OcdLineSymbol::Element));
+	auto data = QByteArray(reinterpret_cast<const char*>(&ocd_symbol), header_size);
+	
+	// Mid symbol; no secondary symbol; dash symbol as corner symbol; start and end symbol
+	auto primary_data_size = exportPattern(line_symbol->getMidSymbol(), data);
+	auto corner_data_size = exportPattern(line_symbol->getDashSymbol(), data);
+	auto start_data_size = exportPattern(line_symbol->getStartSymbol(), data);
+	auto end_data_size = exportPattern(line_symbol->getEndSymbol(), data);
+	
+	auto result = reinterpret_cast<OcdLineSymbol*>(data.data());
+	result->base.size = decltype(ocd_symbol.base.size)(data.size());
+	result->common.num_prim_sym = qint16(line_symbol->getMidSymbolsPerSpot());
+	result->common.prim_sym_dist = qint16(convertSize(line_symbol->getMidSymbolDistance()));
+	result->common.primary_data_size = primary_data_size;
+	result->common.corner_data_size = corner_data_size;
+	result->common.start_data_size = start_data_size;
+	result->common.end_data_size = end_data_size;
+	return data;
+}
+
+
+template< class OcdAreaSymbol >
+QByteArray OcdFileExport::exportAreaSymbol(const AreaSymbol* area_symbol)
+{
+	OcdAreaSymbol ocd_symbol = {};
+	setupBaseSymbol(area_symbol, ocd_symbol.base);
+	ocd_symbol.base.type = Ocd::SymbolTypeArea;
+	
+	auto& common = ocd_symbol.common;
+	if (area_symbol->getColor())
+	{
+		common.fill_on_V9 = 1;
+		common.fill_color = convertColor(area_symbol->getColor());
+	}
+	
+	// Hatching. Since V9, the hatch distance is measured between the line centers.
+	for (int i = 0, end = area_symbol->getNumFillPatterns(); i < end; ++i)
+	{
+		const auto& pattern = area_symbol->getFillPattern(i);
+		if (pattern.type != AreaSymbol::FillPattern::LinePattern)
+			continue;
+		
+		if ((common.hatch_mode == Ocd::HatchSingle && common.hatch_color != convertColor(pattern.line_color))
+		    || common.hatch_mode == Ocd::HatchCross)
+		{
+			addWarning(tr("In area symbol \"%1\", skipping a fill pattern.").arg(area_symbol->getPlainTextName()));
+			continue;
+		}
+		
+		if (pattern.rotatable())
+			ocd_symbol.base.flags |= 1;
+		
+		if (common.hatch_mode == Ocd::HatchNone)
+		{
+			common.hatch_mode = Ocd::HatchSingle;
+			common.hatch_color = convertColor(pattern.line_color);
+			common.hatch_line_width = quint16(convertSize(pattern.line_width));
+			common.hatch_dist = quint16(convertSize(pattern.line_spacing));
+			common.hatch_angle_1 = convertRotation(pattern.angle);
+		}
+		else
+		{
+			common.hatch_mode = Ocd::HatchCross;
+			common.hatch_line_width = (common.hatch_line_width + quint16(convertSize(pattern.line_width))) / 2;
+			common.hatch_dist = (common.hatch_dist + quint16(convertSize(pattern.line_spacing))) / 2;
+			common.hatch_angle_2 = convertRotation(pattern.angle);
+		}
+	}
+	
+	// Structure
+	const PointSymbol* point_pattern = nullptr;
+	for (int i = 0, end = area_symbol->getNumFillPatterns(); i < end; ++i)
+	{
+		const auto& pattern = area_symbol->getFillPattern(i);
+		if (pattern.type != AreaSymbol::FillPattern::PointPattern)
+			continue;
+		
+		if (pattern.rotatable())
+			ocd_symbol.base.flags |= 1;
+		
+		if (common.structure_mode == Ocd::StructureNone)
+		{
+			common.structure_mode = Ocd::StructureAlignedRows;
+			common.structure_width = quint16(convertSize(pattern.point_distance));
+			common.structure_height = quint16(convertSize(pattern.line_spacing));
+			common.structure_angle = convertRotation(pattern.angle);
+			point_pattern = pattern.point;
+		}
+		else
+		{
+			// NOTE: This is only a heuristic which works for the orienteering symbol sets,
+			//       not a real conversion, which would be impossible in most cases.
+			addWarning(tr("In area symbol \"%1\", assuming a \"shifted rows\" point pattern. This might be correct as well as incorrect.").arg(area_symbol->getPlainTextName()));
+			common.structure_mode = Ocd::StructureShiftedRows;
+			if (pattern.line_offset != 0)
+				common.structure_height /= 2;
+			else
+				common.structure_width /= 2;
+			break;
+		}
+	}
+	
+	auto header_size = int(sizeof(OcdAreaSymbol) - sizeof(typename OcdAreaSymbol::Element));
+	auto data = QByteArray(reinterpret_cast<const char*>(&ocd_symbol), header_size);
+	auto pattern_size = exportPattern(point_pattern, data);
+	
+	auto result = reinterpret_cast<OcdAreaSymbol*>(data.data());
+	result->base.size = decltype(ocd_symbol.base.size)(data.size());
+	result->data_size = pattern_size;
+	return data;
+}
+
+
+template< class OcdTextSymbol >
+void OcdFileExport::exportTextSymbol(const TextSymbol* text_symbol, std::vector<QByteArray>& symbols)
+{
+	OcdTextSymbol ocd_symbol = {};
+	
+	convertString(text_symbol->getFontFamily(), ocd_symbol.font_name);
+	
+	auto& basic = ocd_symbol.basic;
+	basic.color = convertColor(text_symbol->getColor());
+	basic.font_size = quint16(qRound(10 * text_symbol->getFontSize() / 25.4 * 72.0));
+	basic.font_weight = text_symbol->isBold() ? 700 : 400;
+	basic.font_italic = text_symbol->isItalic() ? 1 : 0;
+	basic.char_spacing = quint16(qRound(100000 * text_symbol->getCharacterSpacing()));  // cf. OcdFileImport
+	if (basic.char_spacing != 0)
+		addWarning(tr("In text symbol %1: custom character spacing is set, its implementation does not match OCAD's behavior yet").arg(text_symbol->getPlainTextName()));
+	basic.word_spacing = 100;
+	
+	if (text_symbol->isUnderlined())
+		addWarning(tr("In text symbol %1: ignoring underlining").arg(text_symbol->getPlainTextName()));
+	if (text_symbol->usesKerning())
+		addWarning(tr("In text symbol %1: ignoring kerning").arg(text_symbol->getPlainTextName()));
+	
+	auto& special = ocd_symbol.special;
+	auto absolute_line_spacing = text_symbol->getLineSpacing() * (text_symbol->getFontMetrics().lineSpacing() / text_symbol->calculateInternalScaling());
+	special.line_spacing = quint16(qRound(absolute_line_spacing / (text_symbol->getFontSize() * 0.01)));
+	special.para_spacing = qint16(convertSize(qRound(1000 * text_symbol->getParagraphSpacing())));
+	special.line_below_on = text_symbol->hasLineBelow() ? 1 : 0;
+	special.line_below_color = convertColor(text_symbol->getLineBelowColor());
+	special.line_below_width = quint16(convertSize(qRound(1000 * text_symbol->getLineBelowWidth())));
+	special.line_below_offset = quint16(convertSize(qRound(1000 * text_symbol->getLineBelowDistance())));
+	special.num_tabs = quint16(std::min(text_symbol->getNumCustomTabs(), int(std::extent<decltype(special.tab_pos)>::value)));
+	for (int i = 0; i < special.num_tabs; ++i)
+		special.tab_pos[i] = quint32(convertSize(text_symbol->getCustomTab(i)));
+	
+	auto& framing = ocd_symbol.framing;
+	if (text_symbol->getFramingMode() != TextSymbol::NoFraming && text_symbol->getFramingColor())
+	{
+		framing.color = convertColor(text_symbol->getFramingColor());
+		if (text_symbol->getFramingMode() == TextSymbol::ShadowFraming)
+		{
+			framing.mode = Ocd::FramingShadow;
+			framing.offset_x = quint16(convertSize(text_symbol->getFramingShadowXOffset()));
+			framing.offset_y = quint16(-convertSize(text_symbol->getFramingShadowYOffset()));
+		}
+		else if (text_symbol->getFramingMode() == TextSymbol::LineFraming)
+		{
+			framing.mode = Ocd::FramingLine;
+			framing.line_width = quint16(convertSize(text_symbol->getFramingLineHalfWidth()));
+		}
+	}
+	
+	// One OCD symbol for each alignment which is used by text objects
+	auto& formats = text_format_index[text_symbol];
+	if (formats.isEmpty())
+		formats.insert(Ocd::HAlignLeft | Ocd::VAlignBottom, 0);
+	for (auto format = formats.begin(); format != formats.end(); ++format)
+	{
+		// The first variant keeps the symbol's number.
+		ocd_symbol.base = {};
+		setupBaseSymbol(text_symbol, ocd_symbol.base);
+		ocd_symbol.base.type = Ocd::SymbolTypeText;
+		ocd_symbol.base.size = decltype(ocd_symbol.base.size)(sizeof(ocd_symbol));
+		basic.alignment = format.key();
+		format.value() = ocd_symbol.base.number;
+		if (format == formats.begin())
+			symbol_index[text_symbol] = { { ocd_symbol.base.number, 4 } };
+		symbols.emplace_back(reinterpret_cast<const char*>(&ocd_symbol), int(sizeof(ocd_symbol)));
+	}
+}
+
+
+template< class Format >
+std::vector<OcdFileExport::SymbolEntry> OcdFileExport::exportCombinedSymbol(const CombinedSymbol* combined_symbol, std::vector<QByteArray>& symbols)
+{
+	// Public parts
+	std::vector<bool> map_bitfield(std::size_t(map->getNumSymbols()), false);
+	map_bitfield[std::size_t(map->findSymbolIndex(combined_symbol))] = true;
+	map->determineSymbolUseClosure(map_bitfield);
+	
+	std::vector<SymbolEntry> result;
+	for (std::size_t i = 0; i < map_bitfield.size(); ++i)
+	{
+		auto symbol = map->getSymbol(int(i));
+		if (map_bitfield[i] && symbol->getType() != Symbol::Combined)
+		{
+			auto const entries = symbol_index.value(symbol);
+			result.insert(end(result), begin(entries), end(entries));
+		}
+	}
+	
+	// Private parts
+	for (int i = 0; i < combined_symbol->getNumParts(); ++i)
+	{
+		if (!combined_symbol->isPartPrivate(i))
+			continue;
+		
+		auto part = combined_symbol->getPart(i);
+		auto data = QByteArray{};
+		quint8 object_type = 0;
+		switch (part->getType())
+		{
+		case Symbol::Line:
+			data = exportLineSymbol<typename Format::LineSymbol>(part->asLine());
+			object_type = 2;
+			break;
+		case Symbol::Area:
+			data = exportAreaSymbol<typename Format::AreaSymbol>(part->asArea());
+			object_type = 3;
+			break;
+		default:
+			Q_ASSERT(false);
+			continue;
+		}
+		result.push_back({ reinterpret_cast<const typename Format::BaseSymbol*>(data.constData())->number, object_type });
+		symbols.push_back(std::move(data));
+	}
+	
+	return result;
+}
+
+
+quint16 OcdFileExport::exportPattern(const PointSymbol* point_symbol, QByteArray& byte_array)
+{
+	if (!point_symbol)
+		return 0;
+	
+	static const auto origin = MapCoordVector { MapCoord{} };
+	auto num_coords = exportSubPattern(origin, point_symbol, byte_array);
+	for (int i = 0; i < point_symbol->getNumElements(); ++i)
+	{
+		num_coords += exportSubPattern(point_symbol->getElementObject(i)->getRawCoordinateVector(), point_symbol->getElementSymbol(i), byte_array);
+	}
+	return num_coords;
+}
+
+
+quint16 OcdFileExport::exportSubPattern(const MapCoordVector& coords, const Symbol* symbol, QByteArray& byte_array)
+{
+	quint16 num_coords = 0;
+	auto add_element = [&](Ocd::PointSymbolElementV8& element)
+	{
+		element.num_coords = quint16(coords.size());
+		byte_array.append(reinterpret_cast<const char*>(&element), int(sizeof(element)));
+		exportCoordinates(coords, symbol, byte_array);
+		num_coords += 2 + element.num_coords;
+	};
+	
+	switch (symbol->getType())
+	{
+	case Symbol::Point:
+		{
+			auto point_symbol = symbol->asPoint();
+			if (point_symbol->getInnerRadius() > 0 && point_symbol->getInnerColor())
+			{
+				Ocd::PointSymbolElementV8 element = {};
+				element.type = Ocd::PointSymbolElementV8::TypeDot;
+				element.color = convertColor(point_symbol->getInnerColor());
+				element.diameter = qint16(convertSize(2 * point_symbol->getInnerRadius()));
+				add_element(element);
+			}
+			if (point_symbol->getOuterWidth() > 0 && point_symbol->getOuterColor())
+			{
+				// Since V9, the diameter is measured at the center of the line.
+				Ocd::PointSymbolElementV8 element = {};
+				element.type = Ocd::PointSymbolElementV8::TypeCircle;
+				element.color = convertColor(point_symbol->getOuterColor());
+				element.line_width = qint16(convertSize(point_symbol->getOuterWidth()));
+				element.diameter = qint16(convertSize(2 * point_symbol->getInnerRadius() + point_symbol->getOuterWidth()));
+				add_element(element);
+			}
+		}
+		break;
+	case Symbol::Line:
+		{
+			auto line_symbol = symbol->asLine();
+			Ocd::PointSymbolElementV8 element = {};
+			element.type = Ocd::PointSymbolElementV8::TypeLine;
+			if (line_symbol->getCapStyle() == LineSymbol::RoundCap)
+				element.flags = Ocd::PointSymbolElementV8::RoundStyle;
+			else if (line_symbol->getJoinStyle() == LineSymbol::MiterJoin)
+				element.flags = Ocd::PointSymbolElementV8::FlatMiterStyle;
+			element.color = convertColor(line_symbol->getColor());
+			element.line_width = qint16(convertSize(line_symbol->getLineWidth()));
+			add_element(element);
+		}
+		break;
+	case Symbol::Area:
+		{
+			Ocd::PointSymbolElementV8 element = {};
+			element.type = Ocd::PointSymbolElementV8::TypeArea;
+			element.color = convertColor(symbol->asArea()->getColor());
+			add_element(element);
+		}
+		break;
+	default:
+		Q_ASSERT(false);
+	}
+	
+	return num_coords;
+}
+
+
+qint32 OcdFileExport::getPointSymbolExtent(const PointSymbol* point_symbol) const
+{
+	if (!point_symbol)
+		return 0;
+	
+	QRectF extent;
+	for (int i = 0; i < point_symbol->getNumElements(); ++i)
+	{
+		std::unique_ptr<Object> object(point_symbol->getElementObject(i)->duplicate());
+		object->setSymbol(point_symbol->getElementSymbol(i), true);
+		object->update();
+		rectIncludeSafe(extent, object->getExtent());
+		object->clearRenderables();
+	}
+	auto float_extent = 0.5 * std::max(extent.width(), extent.height());
+	if (point_symbol->getInnerColor())
+		float_extent = std::max(float_extent, 0.001 * point_symbol->getInnerRadius());
+	if (point_symbol->getOuterColor())
+		float_extent = std::max(float_extent, 0.001 * (point_symbol->getInnerRadius() + point_symbol->getOuterWidth()));
+	return convertSize(qRound(1000 * float_extent));
+}
+
+
+
+template< class Format >
+void OcdFileExport::exportObjects(quint32 first_block_pos)
+{
+	using OcdObject = typename Format::Object;
+	using IndexBlock = Ocd::IndexBlock<typename OcdObject::IndexEntryType>;
+	
+	// The current block, and the records of the objects it refers to
+	auto block = std::make_unique<IndexBlock>();
+	auto num_entries = std::size_t(0);
+	auto records = QByteArray{};
+	auto block_pos = first_block_pos;
+	
+	auto flush_block = [&](bool last)
+	{
+		auto const next_block = block_pos + quint32(sizeof(IndexBlock)) + quint32(records.size());
+		block->next_block = last ? 0 : next_block;
+		writeData(reinterpret_cast<const char*>(block.get()), sizeof(IndexBlock));
+		writeData(records);
+		*block = {};
+		num_entries = 0;
+		records.clear();
+		block_pos = next_block;
+	};
+	
+	for (int l = 0; l < map->getNumParts(); ++l)
+	{
+		auto part = map->getPart(l);
+		for (int o = 0; o < part->getNumObjects(); ++o)
+		{
+			auto object = part->getObject(o);
+			
+			auto entries = symbol_index.value(object->getSymbol());
+			if (object->getType() == Object::Text)
+			{
+				// The symbol variant depends on the object's alignment,
+				// the object type on the anchor.
+				auto text = object->asText();
+				auto number = entries.empty() ? quint32(-1) : entries.front().number;
+				if (object->getSymbol()->getType() == Symbol::Text)
+					number = text_format_index[object->getSymbol()->asText()].value(textAlignment(text), number);
+				entries = { { number, quint8(text->hasSingleAnchor() ? 4 : 5) } };
+			}
+			else if (entries.empty())
+			{
+				// Export as undefined symbol
+				entries = { { quint32(-1), quint8(object->getType() == Object::Point ? 1 : 2) } };
+			}
+			
+			for (const auto& entry : entries)
+			{
+				if (num_entries == index_block_size)
+					flush_block(false);
+				
+				auto const record = exportObject<OcdObject>(object, entry);
+				auto const extent = object->getExtent();
+				auto& index_entry = block->entries[num_entries];
+				index_entry.bottom_left_bound = convertPoint(MapCoord(extent.bottomLeft()));
+				index_entry.top_right_bound = convertPoint(MapCoord(extent.topRight()));
+				index_entry.pos = block_pos + quint32(sizeof(IndexBlock)) + quint32(records.size());
+				index_entry.size = quint32(record.size());
+				index_entry.symbol = qint32(entry.number);
+				index_entry.type = entry.object_type;
+				index_entry.status = Ocd::ObjectNormal;
+				
+				records.append(record);
+				++num_entries;
+			}
+		}
+	}
+	
+	flush_block(true);
+}
+
+
+template< class OcdObject >
+QByteArray OcdFileExport::exportObject(const Object* object, const SymbolEntry& entry)
+{
+	OcdObject ocd_object = {};
+	ocd_object.symbol = entry.number;
+	ocd_object.type = entry.object_type;
+	
+	auto coords = QByteArray{};
+	switch (object->getType())
+	{
+	case Object::Point:
+		ocd_object.angle = convertRotation(object->asPoint()->getRotation());
+		ocd_object.num_items = exportCoordinates(object->getRawCoordinateVector(), object->getSymbol(), coords);
+		break;
+	case Object::Path:
+		{
+			auto path = object->asPath();
+			auto symbol = path->getSymbol();
+			if (symbol->getType() == Symbol::Area)
+			{
+				// Known issue: In OCD format, pattern rotatability is all
+				// or nothing. In Mapper, it is an option per pattern.
+				if (symbol->asArea()->hasRotatableFillPattern())
+					ocd_object.angle = convertRotation(path->getPatternRotation());
+				if (path->getPatternOrigin() != MapCoord(0, 0))
+					addWarning(tr("Unable to export fill pattern shift for an area object"));
+			}
+			ocd_object.num_items = exportCoordinates(path->getRawCoordinateVector(), symbol, coords);
+		}
+		break;
+	case Object::Text:
+		{
+			auto text = object->asText();
+			ocd_object.angle = convertRotation(text->getRotation());
+			ocd_object.num_items = exportTextCoordinates(text, coords);
+			ocd_object.num_text = quint16(exportTextData(text, coords));
+		}
+		break;
+	default:
+		Q_ASSERT(false);
+	}
+	
+	auto header_size = int(sizeof(OcdObject) - sizeof(Ocd::OcdPoint32));
+	auto data = QByteArray(reinterpret_cast<const char*>(&ocd_object), header_size);
+	data.append(coords);
+	return data;
+}
+
+
+quint32 OcdFileExport::exportCoordinates(const MapCoordVector& coords, const Symbol* symbol, QByteArray& byte_array)
+{
+	auto dash_flag = Ocd::OcdPoint32::FlagCorner;
+	if (symbol && symbol->getType() == Symbol::Line)
+	{
+		auto line_symbol = symbol->asLine();
+		if ((!line_symbol->getDashSymbol() || line_symbol->getDashSymbol()->isEmpty()) && line_symbol->isDashed())
+			dash_flag = Ocd::OcdPoint32::FlagDash;
+	}
+	
+	quint32 num_points = 0;
+	bool curve_start = false;
+	bool hole_point = false;
+	bool curve_continue = false;
+	for (const auto& point : coords)
+	{
+		auto p = convertPoint(point);
+		if (point.isDashPoint())
+			p.y |= dash_flag;
+		if (curve_start)
+			p.x |= Ocd::OcdPoint32::FlagCtl1;
+		if (hole_point)
+			p.y |= Ocd::OcdPoint32::FlagHole;
+		if (curve_continue)
+			p.x |= Ocd::OcdPoint32::FlagCtl2;
+		
+		curve_continue = curve_start;
+		curve_start = point.isCurveStart();
+		hole_point = point.isHolePoint();
+		
+		byte_array.append(reinterpret_cast<const char*>(&p), int(sizeof(p)));
+		++num_points;
+	}
+	return num_points;
+}
+
+
+quint32 OcdFileExport::exportTextCoordinates(const TextObject* object, QByteArray& byte_array)
+{
+	if (object->getNumLines() == 0)
+		return 0;
+	
+	auto add_point = [&byte_array](QPointF point)
+	{
+		auto p = convertPoint(MapCoord(point));
+		byte_array.append(reinterpret_cast<const char*>(&p), int(sizeof(p)));
+	};
+	
+	QTransform text_to_map = object->calcTextToMapTransform();
+	QTransform map_to_text = object->calcMapToTextTransform();
+	
+	if (object->hasSingleAnchor())
+	{
+		// Create 5 coordinates:
+		// 0 - baseline anchor point
+		// 1 - bottom left
+		// 2 - bottom right
+		// 3 - top right
+		// 4 - top left
+		auto anchor_text = map_to_text.map(QPointF(object->getAnchorCoordF()));
+		add_point(text_to_map.map(QPointF(anchor_text.x(), object->getLineInfo(0)->line_y)));
+		
+		QRectF bounding_box_text;
+		for (int i = 0; i < object->getNumLines(); ++i)
+		{
+			auto info = object->getLineInfo(i);
+			rectIncludeSafe(bounding_box_text, QPointF(info->line_x, info->line_y - info->ascent));
+			rectIncludeSafe(bounding_box_text, QPointF(info->line_x + info->width, info->line_y + info->descent));
+		}
+		add_point(text_to_map.map(bounding_box_text.bottomLeft()));
+		add_point(text_to_map.map(bounding_box_text.bottomRight()));
+		add_point(text_to_map.map(bounding_box_text.topRight()));
+		add_point(text_to_map.map(bounding_box_text.topLeft()));
+		return 5;
+	}
+	
+	// Box text: The top coordinates are the top coordinates of the first line.
+	auto text_symbol = object->getSymbol()->asText();
+	QFontMetricsF metrics = text_symbol->getFontMetrics();
+	auto internal_scaling = text_symbol->calculateInternalScaling();
+	auto line0 = object->getLineInfo(0);
+	
+	auto new_top = (object->getVerticalAlignment() == TextObject::AlignTop) ? (-object->getBoxHeight() / 2) : ((line0->line_y - line0->ascent) / internal_scaling);
+	// Account for extra internal leading
+	auto top_adjust = -text_symbol->getFontSize() + (metrics.ascent() + metrics.descent() + 0.5) / internal_scaling;
+	new_top = new_top - top_adjust;
+	
+	QTransform transform;
+	transform.rotate(-qRadiansToDegrees(object->getRotation()));
+	auto anchor = QPointF(object->getAnchorCoordF());
+	add_point(transform.map(QPointF(-object->getBoxWidth() / 2, object->getBoxHeight() / 2)) + anchor);
+	add_point(transform.map(QPointF(object->getBoxWidth() / 2, object->getBoxHeight() / 2)) + anchor);
+	add_point(transform.map(QPointF(object->getBoxWidth() / 2, new_top)) + anchor);
+	add_point(transform.map(QPointF(-object->getBoxWidth() / 2, new_top)) + anchor);
+	return 4;
+}
+
+
+quint32 OcdFileExport::exportTextData(const TextObject* object, QByteArray& byte_array)
+{
+	// Windows line endings; a leading line break needs to be doubled.
+	auto text = object->getText();
+	if (text.startsWith(QLatin1Char('\n')))
+		text.prepend(QLatin1Char('\n'));
+	text.replace(QLatin1Char('\n'), QLatin1String("\r\n"));
+	
+	// UTF-16, zero-terminated, padded to full OCD points
+	auto const text_size = 2 * text.size();
+	auto const num_text = quint32(text_size + 2 + int(sizeof(Ocd::OcdPoint32)) - 1) / sizeof(Ocd::OcdPoint32);
+	byte_array.append(reinterpret_cast<const char*>(text.utf16()), text_size);
+	byte_array.append(int(num_text * sizeof(Ocd::OcdPoint32)) - text_size, '\0');
+	return num_text;
+}
+
+
+
+quint16 OcdFileExport::convertColor(const MapColor* color) const
+{
+	auto index = map->findColorIndex(color);
+	if (index >= 0)
+		return quint16(uses_registration_color ? (index + 1) : index);
+	return 0;
+}
+
+
+quint16 OcdFileExport::textAlignment(const TextObject* text_object) const
+{
+	quint16 alignment = 0;
+	switch (text_object->getHorizontalAlignment())
+	{
+	case TextObject::AlignLeft:
+		alignment = Ocd::HAlignLeft;
+		break;
+	case TextObject::AlignHCenter:
+		alignment = Ocd::HAlignCenter;
+		break;
+	case TextObject::AlignRight:
+		alignment = Ocd::HAlignRight;
+		break;
+	}
+	
+	switch (text_object->getVerticalAlignment())
+	{
+	case TextObject::AlignTop:
+		alignment |= Ocd::VAlignTop;
+		break;
+	case TextObject::AlignVCenter:
+		alignment |= Ocd::VAlignMiddle;
+		break;
+	case TextObject::AlignBaseline:
+	case TextObject::AlignBottom:
+		alignment |= Ocd::VAlignBottom;
+		break;
+	}
+	
+	return alignment;
+}
+
+
+void OcdFileExport::writeData(const QByteArray& data)
+{
+	writeData(data.constData(), quint32(data.size()));
+}
+
+
+void OcdFileExport::writeData(const char* data, quint32 size)
+{
+	if (stream->write(data, size) != qint64(size))
+		throw FileFormatException(::OpenOrienteering::Exporter::tr("Could not write file: %1").arg(stream->errorString()));
+}
+
+
 }  // namespace OpenOrienteering
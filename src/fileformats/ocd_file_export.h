@@ -23,37 +23,158 @@
 #ifndef OPENORIENTEERING_OCD_FILE_EXPORT_H
 #define OPENORIENTEERING_OCD_FILE_EXPORT_H
 
+#include <set>
+#include <vector>
+
+#include <QtGlobal>
+#include <QByteArray>
 #include <QCoreApplication>
+#include <QHash>
+#include <QMap>
+#include <QString>
 
+#include "core/map_coord.h"
 #include "fileformats/file_import_export.h"
 
 class QIODevice;
 
 namespace OpenOrienteering {
 
+class AreaSymbol;
+class CombinedSymbol;
+class LineSymbol;
 class Map;
+class MapColor;
 class MapView;
+class Object;
+class PointSymbol;
+class Symbol;
+class TextObject;
+class TextSymbol;
 
 
 /**
  * An exporter for OCD files.
+ *
+ * Version 8 files are written by the OCAD8FileExport class.
+ * Version 11 and 12 files are written by a native implementation which
+ * streams the object index blocks and object records directly to the device.
  */
 class OcdFileExport : public Exporter
 {
 	Q_DECLARE_TR_FUNCTIONS(OpenOrienteering::OcdFileExport)
-	
+
 public:
-	OcdFileExport(QIODevice* stream, Map *map, MapView *view);
+	/**
+	 * Constructs an exporter for the given OCD format version.
+	 *
+	 * Supported versions are 8, 11 and 12.
+	 */
+	OcdFileExport(QIODevice* stream, Map *map, MapView *view, quint16 version = 8);
 	
 	~OcdFileExport() override;
 	
 	/**
 	 * Exports an OCD file.
-	 * 
-	 * For now, this simply uses the OCAD8FileExport class.
 	 */
 	void doExport() override;
+
+protected:
+	/**
+	 * The OCD symbol number and object type of an exported symbol.
+	 *
+	 * A single Mapper symbol may be exported to multiple OCD symbols.
+	 */
+	struct SymbolEntry
+	{
+		quint32 number;
+		quint8  object_type;
+	};
+	
+	/**
+	 * The native export implementation for a particular OCD format.
+	 */
+	template< class Format >
+	void exportImplementation();
+	
+	
+	void exportColors(std::vector<QByteArray>& strings, std::vector<qint32>& types);
+	
+	void exportGeoreferencing(std::vector<QByteArray>& strings, std::vector<qint32>& types);
+	
+	void exportExtras(std::vector<QByteArray>& strings, std::vector<qint32>& types);
+	
+	
+	template< class Format >
+	void exportSymbols(std::vector<QByteArray>& symbols);
+	
+	template< class OcdBaseSymbol >
+	void setupBaseSymbol(const Symbol* symbol, OcdBaseSymbol& ocd_base_symbol);
+	
+	template< class OcdPointSymbol >
+	QByteArray exportPointSymbol(const PointSymbol* point_symbol);
+	
+	template< class OcdLineSymbol >
+	QByteArray exportLineSymbol(const LineSymbol* line_symbol);
+	
+	template< class OcdAreaSymbol >
+	QByteArray exportAreaSymbol(const AreaSymbol* area_symbol);
+	
+	template< class OcdTextSymbol >
+	void exportTextSymbol(const TextSymbol* text_symbol, std::vector<QByteArray>& symbols);
+	
+	template< class Format >
+	std::vector<SymbolEntry> exportCombinedSymbol(const CombinedSymbol* combined_symbol, std::vector<QByteArray>& symbols);
+	
+	quint32 makeSymbolNumber(const Symbol* symbol);
+	
+	quint16 exportPattern(const PointSymbol* point_symbol, QByteArray& byte_array);
+	
+	quint16 exportSubPattern(const MapCoordVector& coords, const Symbol* symbol, QByteArray& byte_array);
+	
+	qint32 getPointSymbolExtent(const PointSymbol* point_symbol) const;
+	
+	
+	/**
+	 * Writes the object index blocks and the object records.
+	 *
+	 * Each index block is immediately followed by the records of the objects
+	 * which it refers to. Thus at most 256 object records are held in memory.
+	 */
+	template< class Format >
+	void exportObjects(quint32 first_block_pos);
+	
+	template< class OcdObject >
+	QByteArray exportObject(const Object* object, const SymbolEntry& entry);
+	
+	quint32 exportCoordinates(const MapCoordVector& coords, const Symbol* symbol, QByteArray& byte_array);
+	
+	quint32 exportTextCoordinates(const TextObject* object, QByteArray& byte_array);
+	
+	quint32 exportTextData(const TextObject* object, QByteArray& byte_array);
+	
+	
+	quint16 convertColor(const MapColor* color) const;
+	
+	quint16 textAlignment(const TextObject* text_object) const;
+	
+	void writeData(const QByteArray& data);
+	
+	void writeData(const char* data, quint32 size);
+
+private:
+	/// Exported symbols: OCD symbol numbers and object types.
+	QHash<const Symbol*, std::vector<SymbolEntry>> symbol_index;
+	
+	/// OCD symbol numbers of text symbol variants, by OCD alignment.
+	QHash<const TextSymbol*, QMap<quint16, quint32>> text_format_index;
+	
+	/// All OCD symbol numbers which are already in use.
+	std::set<quint32> symbol_numbers;
+	
+	quint16 ocd_version;
 	
+	bool uses_registration_color = false;
 };
 
 
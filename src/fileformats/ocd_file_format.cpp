@@ -34,11 +34,45 @@
 
 namespace OpenOrienteering {
 
+namespace {
+
+const char* formatId(quint16 version)
+{
+	switch (version)
+	{
+	case 11:
+		return "OCD11";
+	case 12:
+		return "OCD12";
+	default:
+		Q_ASSERT(version == 0);
+		return "OCD";
+	}
+}
+
+QString formatDescription(quint16 version)
+{
+	if (version == 0)
+		return ::OpenOrienteering::ImportExport::tr("OCAD");
+	return ::OpenOrienteering::ImportExport::tr("OCAD version %1").arg(version);
+}
+
+FileFormat::FormatFeatures formatFeatures(quint16 version)
+{
+	if (version == 0)
+		return FileFormat::ImportSupported | FileFormat::ExportSupported | FileFormat::ExportLossy;
+	return FileFormat::ExportSupported | FileFormat::ExportLossy;
+}
+
+}  // namespace
+
+
+
 // ### OcdFileFormat ###
 
-OcdFileFormat::OcdFileFormat()
-: FileFormat { MapFile, "OCD", ::OpenOrienteering::ImportExport::tr("OCAD"), QString::fromLatin1("ocd"),
-               ImportSupported | ExportSupported | ExportLossy }
+OcdFileFormat::OcdFileFormat(quint16 version)
+: FileFormat { MapFile, formatId(version), formatDescription(version), QString::fromLatin1("ocd"), formatFeatures(version) }
+, version { version }
 {
 	// Nothing
 }
@@ -58,7 +92,7 @@ Importer* OcdFileFormat::createImporter(QIODevice* stream, Map *map, MapView *vi
 
 Exporter* OcdFileFormat::createExporter(QIODevice* stream, Map* map, MapView* view) const
 {
-	return new OcdFileExport(stream, map, view);
+	return new OcdFileExport(stream, map, view, version ? version : 8);
 }
 
 
@@ -22,6 +22,8 @@
 
 #include <cstddef>
 
+#include <QtGlobal>
+
 #include "fileformats/file_format.h"
 
 class QIODevice;
@@ -36,14 +38,21 @@ class MapView;
 
 /**
  * The map file format known as OC*D.
+ *
+ * The default format imports all supported versions and exports version 8.
+ * Additional instances may be created for exporting to particular versions.
  */
 class OcdFileFormat : public FileFormat
 {
 public:
 	/**
 	 * Constructs a new OcdFileFormat.
+	 * 
+	 * When the version is 0, the format offers import of all supported
+	 * versions and export of version 8. Otherwise, the format offers export
+	 * of the given version only.
 	 */
-	OcdFileFormat();
+	explicit OcdFileFormat(quint16 version = 0);
 	
 	/**
 	 * Detects whether the buffer may be the start of a valid OCD file.
@@ -58,6 +67,9 @@ public:
 	
 	/// \copydoc FileFormat::createExporter()
 	Exporter* createExporter(QIODevice* stream, Map* map, MapView* view) const override;
+
+private:
+	quint16 version;
 };
 
 
@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <type_traits>
 #include <vector>
@@ -34,6 +35,7 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFileDevice>
 #include <QFileInfo>
 #include <QFontMetricsF>
 #include <QIODevice>
@@ -45,6 +47,7 @@
 #include <QStringRef>
 #include <QTextDecoder>
 #include <QVariant>
+#include <QtConcurrentMap>
 
 #include "settings.h"
 #include "core/crs_template.h"
@@ -615,37 +618,65 @@ void OcdFileImport::resolveSubsymbols()
 
 void OcdFileImport::importObjects(const OcdFile<Ocd::FormatV8>& file)
 {
-	auto ocd_version = file.header()->version;
-	MapPart* part = map->getCurrentPart();
-	Q_ASSERT(part);
-	
+	std::vector<const Ocd::FormatV8::Object*> ocd_objects;
 	for (const auto& object_entry : file.objects())
 	{
 		if (object_entry.symbol)
-		{
-			if (auto object = importObject(file[object_entry], part, ocd_version))
-				part->addObject(object, part->getNumObjects());
-		}
+			ocd_objects.push_back(&file[object_entry]);
 	}
+	importObjects(ocd_objects, file.header()->version);
 }
 
 template< class F >
 void OcdFileImport::importObjects(const OcdFile< F >& file)
 {
-	auto ocd_version = file.header()->version;
-	MapPart* part = map->getCurrentPart();
-	Q_ASSERT(part);
-	
+	std::vector<const typename F::Object*> ocd_objects;
 	for (const auto& object_entry : file.objects())
 	{
 		if ( object_entry.symbol
 		     && object_entry.status != Ocd::ObjectDeleted
 		     && object_entry.status != Ocd::ObjectDeletedForUndo )
 		{
-			if (auto object = importObject(file[object_entry], part, ocd_version))
-				part->addObject(object, part->getNumObjects());
+			ocd_objects.push_back(&file[object_entry]);
 		}
 	}
+	importObjects(ocd_objects, file.header()->version);
+}
+
+template< class O >
+void OcdFileImport::importObjects(const std::vector<const O*>& ocd_objects, int ocd_version)
+{
+	MapPart* part = map->getCurrentPart();
+	Q_ASSERT(part);
+	
+	// Plain path objects are converted concurrently.
+	// All other objects are imported sequentially while merging,
+	// because their import may add warnings, modify symbols,
+	// or add additional objects to the map part.
+	std::vector<Object*> objects(ocd_objects.size(), nullptr);
+	std::vector<std::size_t> path_objects;
+	path_objects.reserve(ocd_objects.size());
+	for (std::size_t i = 0; i < ocd_objects.size(); ++i)
+	{
+		if (pathObjectSymbol(*ocd_objects[i]))
+			path_objects.push_back(i);
+	}
+	QtConcurrent::blockingMap(path_objects, [this, &ocd_objects, &objects](std::size_t i) {
+		auto const& ocd_object = *ocd_objects[i];
+		objects[i] = importPathObject(ocd_object, pathObjectSymbol(ocd_object));
+	});
+	
+	// Merge in file order
+	for (std::size_t i = 0; i < ocd_objects.size(); ++i)
+	{
+		auto object = objects[i];
+		if (object)
+			object->setMap(map);
+		else
+			object = importObject(*ocd_objects[i], part, ocd_version);
+		if (object)
+			part->addObject(object, part->getNumObjects());
+	}
 }
 
 
@@ -1592,7 +1623,7 @@ Object* OcdFileImport::importObject(const O& ocd_object, MapPart* part, int ocd_
 	Symbol* symbol = nullptr;
 	if (ocd_object.symbol >= 0)
 	{
-		symbol = symbol_index[ocd_object.symbol];
+		symbol = symbol_index.value(ocd_object.symbol);
 	}
 	
 	if (!symbol)
@@ -1672,12 +1703,7 @@ Object* OcdFileImport::importObject(const O& ocd_object, MapPart* part, int ocd_
 	}
 	else if (symbol->getType() == Symbol::Line || symbol->getType() == Symbol::Area || symbol->getType() == Symbol::Combined)
 	{
-		auto p = new OcdImportedPathObject(symbol);
-		p->setPatternRotation(convertAngle(ocd_object.angle));
-		
-		// Normal path
-		fillPathCoords(p, symbol->getType() == Symbol::Area, ocd_object.num_items, reinterpret_cast<const Ocd::OcdPoint32 *>(ocd_object.coords));
-		p->recalculateParts();
+		auto p = importPathObject(ocd_object, symbol);
 		p->setMap(map);
 		return p;
 	}
@@ -1685,6 +1711,42 @@ Object* OcdFileImport::importObject(const O& ocd_object, MapPart* part, int ocd_
 	return nullptr;
 }
 
+template< class O >
+Symbol* OcdFileImport::pathObjectSymbol(const O& ocd_object) const
+{
+	if (ocd_object.symbol < 0)
+		return nullptr;
+	
+	auto symbol = symbol_index.value(ocd_object.symbol);
+	if (!symbol)
+		return nullptr;
+	
+	switch (symbol->getType())
+	{
+	case Symbol::Line:
+		if (rectangle_info.contains(ocd_object.symbol))
+			return nullptr;
+		return symbol;
+	case Symbol::Area:
+	case Symbol::Combined:
+		return symbol;
+	default:
+		return nullptr;
+	}
+}
+
+template< class O >
+Object* OcdFileImport::importPathObject(const O& ocd_object, Symbol* symbol)
+{
+	auto p = new OcdImportedPathObject(symbol);
+	p->setPatternRotation(convertAngle(ocd_object.angle));
+	
+	// Normal path
+	fillPathCoords(p, symbol->getType() == Symbol::Area, ocd_object.num_items, reinterpret_cast<const Ocd::OcdPoint32 *>(ocd_object.coords));
+	p->recalculateParts();
+	return p;
+}
+
 QString OcdFileImport::getObjectText(const Ocd::ObjectV8& ocd_object, int ocd_version) const
 {
 	auto input  = ocd_object.coords + ocd_object.num_items;
@@ -2086,8 +2148,29 @@ void OcdFileImport::import(bool load_symbols_only)
 {
 	Q_ASSERT(buffer.isEmpty());
 	
+	// Files are mapped into memory if possible, so that the buffer refers
+	// to the file contents without reading and copying them in advance.
+	// The mapping is released when leaving this function.
+	auto const file = qobject_cast<QFileDevice*>(stream);
+	auto const mapped_data = mapFile(file);
+	struct BufferGuard
+	{
+		QByteArray& buffer;
+		QFileDevice* file;
+		uchar* mapped_data;
+		~BufferGuard()
+		{
+			buffer = {};
+			if (mapped_data)
+				file->unmap(mapped_data);
+		}
+	} const buffer_guard { buffer, file, mapped_data };
+	
 	buffer.clear();
-	buffer.append(stream->readAll());
+	if (mapped_data)
+		buffer = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped_data), int(file->size() - file->pos()));
+	else
+		buffer.append(stream->readAll());
 	if (buffer.isEmpty())
 		throw FileFormatException(::OpenOrienteering::Importer::tr("Could not read file: %1").arg(stream->errorString()));
 	
@@ -2132,6 +2215,18 @@ void OcdFileImport::import(bool load_symbols_only)
 	}
 }
 
+uchar* OcdFileImport::mapFile(QFileDevice* file)
+{
+	if (!file || file->isSequential())
+		return nullptr;
+	
+	auto const size = file->size() - file->pos();
+	if (size <= 0 || size > std::numeric_limits<int>::max())
+		return nullptr;
+	
+	return file->map(file->pos(), size);
+}
+
 void OcdFileImport::finishImport()
 {
 	if (delegate)
@@ -26,6 +26,7 @@
 #include <cstddef>
 #include <initializer_list>
 #include <limits>
+#include <vector>
 
 #include <QtGlobal>
 #include <QtMath>
@@ -49,6 +50,7 @@
 #include "fileformats/ocd_types_v8.h" // IWYU pragma: keep
 
 class QChar;
+class QFileDevice;
 class QIODevice;
 
 namespace OpenOrienteering {
@@ -173,6 +175,13 @@ public:
 protected:
 	void import(bool load_symbols_only) override;
 	
+	/**
+	 * Maps the remaining contents of the file into memory.
+	 * 
+	 * Returns nullptr if the file is not given, or if it cannot be mapped.
+	 */
+	static uchar* mapFile(QFileDevice* file);
+	
 	void importImplementationLegacy(bool load_symbols_only);
 	
 	template< class F >
@@ -221,6 +230,14 @@ protected:
 	template< class F >
 	void importObjects(const OcdFile< F >& file);
 	
+	/**
+	 * Imports the given objects into the current map part, in the given order.
+	 * 
+	 * Plain path objects are converted concurrently.
+	 */
+	template< class O >
+	void importObjects(const std::vector<const O*>& ocd_objects, int ocd_version);
+	
 	
 	template< class F >
 	void importTemplates(const OcdFile< F >& file);
@@ -300,6 +317,24 @@ protected:
 	template< class O >
 	Object* importObject(const O& ocd_object, MapPart* part, int ocd_version);
 	
+	/**
+	 * Returns the symbol if the object is to be imported as a plain path object.
+	 * 
+	 * Returns nullptr for objects which need the special handling in importObject().
+	 */
+	template< class O >
+	Symbol* pathObjectSymbol(const O& ocd_object) const;
+	
+	/**
+	 * Creates a path object with the given symbol.
+	 * 
+	 * This function doesn't modify the importer, the symbol, or the map,
+	 * so it may be called concurrently. The object's map must be set by
+	 * the caller.
+	 */
+	template< class O >
+	Object* importPathObject(const O& ocd_object, Symbol* symbol);
+	
 	QString getObjectText(const Ocd::ObjectV8& ocd_object, int ocd_version) const;
 	
 	template< class O >
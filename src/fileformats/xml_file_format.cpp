@@ -22,6 +22,10 @@
 #include "xml_file_format.h"
 #include "xml_file_format_p.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
 #include <memory>
 #include <vector>
 
@@ -40,9 +44,11 @@
 #include <QScopedValueRollback>
 #include <QString>
 #include <QStringRef>
+#include <QThreadPool>
 #include <QVariant>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
+#include <QtConcurrentMap>
 
 #include "settings.h"
 #include "core/georeferencing.h"
@@ -53,6 +59,7 @@
 #include "core/map_part.h"
 #include "core/map_printer.h"  // IWYU pragma: keep
 #include "core/map_view.h"
+#include "core/objects/object.h"
 #include "core/symbols/line_symbol.h"
 #include "core/symbols/point_symbol.h"
 #include "core/symbols/symbol.h"
@@ -67,7 +74,7 @@ namespace OpenOrienteering {
 // ### XMLFileFormat definition ###
 
 constexpr int XMLFileFormat::minimum_version = 2;
-constexpr int XMLFileFormat::current_version = 7;
+constexpr int XMLFileFormat::current_version = 8;
 
 int XMLFileFormat::active_version = 5; // updated by XMLFileExporter::doExport()
 
@@ -191,6 +198,10 @@ XMLFileExporter::XMLFileExporter(QIODevice* stream, Map *map, MapView *view)
 	auto file = qobject_cast<const QFileDevice*>(stream);
 	bool auto_formatting = (file && file->fileName().contains(QLatin1String(".xmap")));
 	setOption(QString::fromLatin1("autoFormatting"), auto_formatting);
+	
+	// The compact coordinates encoding requires Mapper 0.9.0 or later.
+	bool compact_coordinates = Settings::getInstance().getSetting(Settings::General_CompactCoordinates).toBool();
+	setOption(QString::fromLatin1("compactCoordinates"), compact_coordinates);
 }
 
 void XMLFileExporter::doExport()
@@ -211,6 +222,18 @@ void XMLFileExporter::doExport()
 	XMLFileFormat::active_version = XMLFileFormat::current_version;
 #endif
 	
+	// Version 8 only adds the compact coordinates encoding. Without it,
+	// version 7 files can be read by older versions of Mapper.
+	if (XMLFileFormat::active_version >= 8
+	    && (xml.autoFormatting() || !option(QString::fromLatin1("compactCoordinates")).toBool()))
+	{
+		XMLFileFormat::active_version = 7;
+	}
+	
+	// Prevent older versions of Mapper from reading data they cannot handle.
+	auto const barrier_version = (XMLFileFormat::active_version >= 8) ? 8 : 6;
+	auto const barrier_required = (XMLFileFormat::active_version >= 8) ? "0.9.0" : "0.6.0";
+	
 	xml.writeDefaultNamespace(mapperNamespace());
 	xml.writeStartDocument();
 	writeLineBreak(xml);
@@ -233,9 +256,10 @@ void XMLFileExporter::doExport()
 			// Prevent Mapper versions < 0.6.0 from crashing
 			// when compatibilty mode is NOT activated
 			// Incompatible feature: dense coordinates
+			// Incompatible feature: compact coordinates (version 8)
 			barrier = new XmlElementWriter(xml, literal::barrier);
-			barrier->writeAttribute(literal::version, 6);
-			barrier->writeAttribute(literal::required, "0.6.0");
+			barrier->writeAttribute(literal::version, barrier_version);
+			barrier->writeAttribute(literal::required, barrier_required);
 			writeLineBreak(xml);
 		}
 		exportSymbols();
@@ -256,9 +280,10 @@ void XMLFileExporter::doExport()
 				// Prevent Mapper versions < 0.6.0 from crashing
 				// when compatibilty mode IS activated
 				// Incompatible feature: new undo step types
+				// Incompatible feature: compact coordinates (version 8)
 				XmlElementWriter barrier(xml, literal::barrier);
-				barrier.writeAttribute(literal::version, 6);
-				barrier.writeAttribute(literal::required, "0.6.0");
+				barrier.writeAttribute(literal::version, barrier_version);
+				barrier.writeAttribute(literal::required, barrier_required);
 				writeLineBreak(xml);
 				exportUndo();
 				exportRedo();
@@ -480,11 +505,95 @@ void XMLFileExporter::exportRedo()
 
 // ### XMLFileImporter definition ###
 
+namespace {
+
+/// The approximate size of the data which is loaded by a single task
+constexpr int objects_chunk_size = 256 * 1024;
+
+/**
+ * Returns the offset of the '>' which ends the tag starting at pos, or -1.
+ */
+int findTagEnd(const QByteArray& data, int pos)
+{
+	char quote = 0;
+	for (auto const size = data.size(); pos < size; ++pos)
+	{
+		auto const c = data.at(pos);
+		if (quote)
+		{
+			if (c == quote)
+				quote = 0;
+		}
+		else if (c == '"' || c == '\'')
+		{
+			quote = c;
+		}
+		else if (c == '>')
+		{
+			return pos;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Returns true if the data between begin and end equals name.
+ */
+bool hasName(const QByteArray& data, int begin, int end, const char* name)
+{
+	auto const length = qstrlen(name);
+	return uint(end - begin) == length && qstrncmp(data.constData() + begin, name, length) == 0;
+}
+
+/**
+ * Loads the objects from a part of the content of an objects element.
+ * 
+ * Errors are reported by the reader.
+ */
+void loadObjects(QXmlStreamReader& xml, const QByteArray& data, const SymbolDictionary& symbol_dict, std::vector<std::unique_ptr<Object>>& objects)
+{
+	objects.clear();
+	xml.clear();
+	xml.addData("<objects>");
+	xml.addData(data);
+	xml.addData("</objects>");
+	xml.readNextStartElement();
+	while (xml.readNextStartElement())
+	{
+		if (xml.name() == XmlStreamLiteral::object)
+			objects.emplace_back(Object::load(xml, nullptr, symbol_dict));
+		else
+			xml.skipCurrentElement(); // unknown
+	}
+}
+
+/**
+ * Returns a copy of the data without the control characters which are
+ * invalid in XML.
+ * 
+ * \see XmlRecoveryHelper
+ */
+QByteArray removeInvalidCharacters(const QByteArray& data)
+{
+	QByteArray result;
+	result.reserve(data.size());
+	std::remove_copy_if(data.begin(), data.end(), std::back_inserter(result), [](char c) {
+		auto const value = static_cast<unsigned char>(c);
+		return value < 0x20 && value != 0x9 && value != 0xa && value != 0xd;
+	});
+	return result;
+}
+
+}  // namespace
+
+
+
 XMLFileImporter::XMLFileImporter(QIODevice* stream, Map *map, MapView *view)
 : Importer(stream, map, view),
   xml(stream)
 {
-	//NOP
+	// Smaller files are loaded sequentially.
+	setOption(QString::fromLatin1("concurrentObjectsMinimumSize"), qlonglong(4 * 1024 * 1024));
 }
 
 void XMLFileImporter::addWarningUnsupportedElement()
@@ -498,6 +607,9 @@ void XMLFileImporter::addWarningUnsupportedElement()
 
 void XMLFileImporter::import(bool load_symbols_only)
 {
+	if (!load_symbols_only)
+		prepareObjectsImport();
+	
 	if (!xml.readNextStartElement() || xml.name() != literal::map)
 	{
 		xml.raiseError(::OpenOrienteering::Importer::tr("Unsupported file format."));
@@ -843,6 +955,7 @@ void XMLFileImporter::importSymbols()
 		if (xml.name() == literal::symbol)
 		{
 			map->symbols.push_back(Symbol::load(xml, *map, symbol_dict));
+			map->symbol_positions.clear();
 		}
 		else
 		{
@@ -866,19 +979,49 @@ void XMLFileImporter::importMapParts()
 	map->parts.clear();
 	map->parts.reserve(qMin(num_parts, std::size_t(20))); // 20 is not a limit
 	
+	int num_objects = 0;
+	auto const object_loaded = [this, &num_objects]() {
+		++num_objects;
+		if (num_objects % 64 == 0)
+			updateProgress(int(map->parts.size()), num_objects);
+	};
+	
+	// Objects which were located by prepareObjectsImport()
+	auto section_objects = importObjects();
+	auto section = std::size_t(0);
+	
 	while (xml.readNextStartElement())
 	{
 		if (xml.name() == literal::part)
 		{
 			auto recovery = XmlRecoveryHelper(xml);
-			auto part = MapPart::load(xml, *map, symbol_dict);
+			auto const objects_before = num_objects;
+			auto part = MapPart::load(xml, *map, symbol_dict, object_loaded);
 			if (xml.hasError() && recovery())
 			{
 				addWarning(tr("Some invalid characters had to be removed."));
 				delete part;
-				part = MapPart::load(xml, *map, symbol_dict);
+				num_objects = objects_before;
+				part = MapPart::load(xml, *map, symbol_dict, object_loaded);
+			}
+			for (; section < objects_sections.size() && objects_sections[section].part == map->parts.size(); ++section)
+			{
+				auto& objects = section_objects[section];
+				part->objects.reserve(part->objects.size() + objects.size());
+				for (auto& loaded : objects)
+				{
+					// Cf. Object::load
+					auto object = loaded.release();
+					part->objects.push_back(object);
+					object->setMap(map);
+					auto const& coords = object->getRawCoordinateVector();
+					if (coords.empty() || !coords.front().isRegular() || !coords.back().isRegular())
+						map->markAsIrregular(object);
+				}
+				num_objects += int(objects.size());
 			}
 			map->parts.push_back(part);
+			updateProgress(int(map->parts.size()), num_objects);
 		}
 		else
 		{
@@ -887,6 +1030,8 @@ void XMLFileImporter::importMapParts()
 		}
 	}
 	
+	objects_sections.clear();
+	
 	if (current_part_index < map->parts.size())
 		map->current_part_index = current_part_index;
 	
@@ -900,6 +1045,218 @@ void XMLFileImporter::importMapParts()
 	emit map->currentMapPartChanged(map->getPart(map->current_part_index));
 }
 
+void XMLFileImporter::prepareObjectsImport()
+{
+	auto const start = stream->pos();
+	if (stream->isSequential()
+	    || stream->size() - start < option(QString::fromLatin1("concurrentObjectsMinimumSize")).toLongLong()
+	    || QThreadPool::globalInstance()->maxThreadCount() < 2)
+	{
+		return;
+	}
+	
+	raw_data = stream->readAll();
+	
+	// Chunks of objects are loaded without the XML declaration,
+	// so they must use the default encoding.
+	QXmlStreamReader probe(raw_data);
+	probe.readNext();
+	auto const encoding = probe.documentEncoding();
+	if ((encoding.isEmpty() || encoding.compare(QLatin1String("UTF-8"), Qt::CaseInsensitive) == 0)
+	    && scanObjects(raw_data, objects_sections)
+	    && !objects_sections.empty())
+	{
+		QByteArray data;
+		auto pos = 0;
+		for (auto const& section : objects_sections)
+		{
+			data.append(raw_data.constData() + pos, section.begin - pos);
+			pos = section.end;
+		}
+		data.append(raw_data.constData() + pos, raw_data.size() - pos);
+		
+		skeleton.setData(data);
+		skeleton.open(QIODevice::ReadOnly);
+		xml.setDevice(&skeleton);
+	}
+	else
+	{
+		raw_data.clear();
+		objects_sections.clear();
+		stream->seek(start);
+	}
+}
+
+bool XMLFileImporter::scanObjects(const QByteArray& data, std::vector<ObjectsSection>& sections)
+{
+	// This is not an XML parser. It relies on the fact that '<' cannot occur
+	// in text and attribute values. But comments, CDATA sections, DTDs and
+	// processing instructions may hide or imitate tags.
+	if (data.contains("<!") || data.indexOf("<?", 1) >= 0)
+		return false;
+	
+	auto const is_name_end = [](char c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '/' || c == '>';
+	};
+	
+	auto pos = data.indexOf("<parts");
+	if (pos < 0 || pos + 6 >= data.size() || !is_name_end(data.at(pos + 6)))
+		return false;
+	auto end = findTagEnd(data, pos);
+	if (end < 0 || data.at(end - 1) == '/')
+		return false;
+	
+	auto depth = 0;  // the number of open elements inside the parts element
+	auto num_parts = std::size_t(0);
+	auto in_part = false;
+	auto in_objects = false;
+	for (pos = data.indexOf('<', end); pos >= 0; pos = data.indexOf('<', end))
+	{
+		end = findTagEnd(data, pos);
+		if (end < 0)
+			return false;
+		
+		auto const closing = data.at(pos + 1) == '/';
+		auto const name_begin = pos + (closing ? 2 : 1);
+		auto name_end = name_begin;
+		while (name_end < end && !is_name_end(data.at(name_end)))
+			++name_end;
+		
+		if (closing)
+		{
+			if (depth == 0)
+				return hasName(data, name_begin, name_end, "parts");
+			
+			--depth;
+			if (in_objects && depth == 1)
+			{
+				sections.back().end = pos;
+				in_objects = false;
+			}
+		}
+		else
+		{
+			auto const empty = data.at(end - 1) == '/';
+			if (depth == 0)
+			{
+				in_part = hasName(data, name_begin, name_end, "part");
+				if (in_part)
+					++num_parts;
+			}
+			else if (depth == 1 && in_part && !empty && hasName(data, name_begin, name_end, "objects"))
+			{
+				sections.push_back({ num_parts - 1, end + 1, -1, {} });
+				in_objects = true;
+			}
+			else if (depth == 2 && in_objects && hasName(data, name_begin, name_end, "object"))
+			{
+				sections.back().objects.push_back(pos);
+			}
+			
+			if (!empty)
+				++depth;
+		}
+	}
+	return false;
+}
+
+std::vector<std::vector<std::unique_ptr<Object>>> XMLFileImporter::importObjects()
+{
+	if (objects_sections.empty())
+		return {};
+	
+	struct Chunk
+	{
+		std::size_t section;
+		int begin;
+		int end;
+		std::vector<std::unique_ptr<Object>> objects;
+		std::exception_ptr exception;
+		bool recovered;
+	};
+	
+	std::vector<Chunk> chunks;
+	for (std::size_t i = 0; i < objects_sections.size(); ++i)
+	{
+		auto const& offsets = objects_sections[i].objects;
+		for (auto first = begin(offsets); first != end(offsets); )
+		{
+			auto const last = std::lower_bound(first + 1, end(offsets), *first + objects_chunk_size);
+			auto const chunk_end = (last == end(offsets)) ? objects_sections[i].end : *last;
+			chunks.push_back({ i, *first, chunk_end, {}, {}, false });
+			first = last;
+		}
+	}
+	
+	auto const num_parts = int(objects_sections.back().part + 1);
+	std::atomic<qint64> position { objects_sections.front().begin };
+	std::atomic<int> num_objects { 0 };
+	auto const load_chunk = [this, num_parts, &position, &num_objects](Chunk& chunk) {
+		try
+		{
+			auto data = QByteArray::fromRawData(raw_data.constData() + chunk.begin, chunk.end - chunk.begin);
+			QXmlStreamReader xml;
+			loadObjects(xml, data, symbol_dict, chunk.objects);
+			if (xml.error() == QXmlStreamReader::NotWellFormedError)
+			{
+				auto const size = data.size();
+				data = removeInvalidCharacters(data);
+				if (data.size() < size)
+				{
+					chunk.recovered = true;
+					loadObjects(xml, data, symbol_dict, chunk.objects);
+				}
+			}
+			if (xml.hasError())
+			{
+				auto const line = QByteArray::fromRawData(raw_data.constData(), chunk.begin).count('\n') + xml.lineNumber();
+				throw FileFormatException(
+				        tr("Error at line %1 column %2: %3")
+				        .arg(line)
+				        .arg(xml.columnNumber())
+				        .arg(xml.errorString()) );
+			}
+			
+			auto const current_position = position += chunk.end - chunk.begin;
+			auto const current_objects = num_objects += int(chunk.objects.size());
+			updateProgress(current_position, num_parts, current_objects);
+		}
+		catch (...)
+		{
+			chunk.exception = std::current_exception();
+		}
+	};
+	
+	// The first coordinates determine the bounds offset for all objects.
+	auto next = begin(chunks);
+	for (; next != end(chunks) && MapCoord::boundsOffset().check_for_offset; ++next)
+		load_chunk(*next);
+	
+	auto const bounds_offset = MapCoord::boundsOffset();
+	QtConcurrent::blockingMap(next, end(chunks), [&load_chunk, bounds_offset](Chunk& chunk) {
+		QScopedValueRollback<MapCoord::BoundsOffset> rollback { MapCoord::boundsOffset(), bounds_offset };
+		load_chunk(chunk);
+	});
+	raw_data.clear();
+	
+	// Assemble in document order.
+	std::vector<std::vector<std::unique_ptr<Object>>> section_objects(objects_sections.size());
+	auto recovered = false;
+	for (auto& chunk : chunks)
+	{
+		if (chunk.exception)
+			std::rethrow_exception(chunk.exception);
+		
+		recovered |= chunk.recovered;
+		auto& objects = section_objects[chunk.section];
+		std::move(begin(chunk.objects), end(chunk.objects), std::back_inserter(objects));
+	}
+	if (recovered)
+		addWarning(tr("Some invalid characters had to be removed."));
+	
+	return section_objects;
+}
+
 void XMLFileImporter::importTemplates()
 {
 	Q_ASSERT(xml.name() == literal::templates);
@@ -21,6 +21,12 @@
 #ifndef OPENORIENTEERING_FILE_FORMAT_XML_P_H
 #define OPENORIENTEERING_FILE_FORMAT_XML_P_H
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <QBuffer>
+#include <QByteArray>
 #include <QCoreApplication>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
@@ -30,6 +36,9 @@
 
 namespace OpenOrienteering {
 
+class Object;
+
+
 /** Map exporter for the xml based map format. */
 class XMLFileExporter : public Exporter
 {
@@ -83,9 +92,46 @@ protected:
 	void importUndo();
 	void importRedo();
 	
+	/** The location of an objects element of a map part in the raw data. */
+	struct ObjectsSection
+	{
+		std::size_t part;          ///< The index of the part element
+		int begin;                 ///< The offset of the element's content
+		int end;                   ///< The offset of the element's end tag
+		std::vector<int> objects;  ///< The offsets of the object start tags
+	};
+	
+	/** Prepares the concurrent loading of map objects.
+	 * 
+	 * For large files, this function reads all data from the stream and
+	 * locates the objects of the map parts. The XML reader is redirected to
+	 * a copy of the data without the objects. The objects are loaded
+	 * concurrently by importObjects() when the map parts are imported.
+	 * 
+	 * If the data cannot be handled this way, the stream is rewound, and
+	 * the file is imported sequentially.
+	 */
+	void prepareObjectsImport();
+	
+	/** Locates the objects elements of the map parts in the raw data.
+	 * 
+	 * Returns false if the data cannot be handled by this simple scanner.
+	 */
+	static bool scanObjects(const QByteArray& data, std::vector<ObjectsSection>& sections);
+	
+	/** Loads the objects which were located by prepareObjectsImport().
+	 * 
+	 * Returns the objects of each section, in document order.
+	 */
+	std::vector<std::vector<std::unique_ptr<Object>>> importObjects();
+	
 	QXmlStreamReader xml;
 	SymbolDictionary symbol_dict;
 	bool georef_offset_adjusted;
+	
+	QByteArray raw_data;
+	QBuffer skeleton;
+	std::vector<ObjectsSection> objects_sections;
 };
 
 
@@ -21,6 +21,7 @@
 #include "ogr_file_format_p.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <iterator>
 #include <memory>
 #include <vector>
@@ -829,9 +830,9 @@ PathObject* OgrFileImport::importLineStringGeometry(OGRFeatureH feature, OGRGeom
 	
 	auto style = OGR_F_GetStyleString(feature);
 	auto object = new PathObject(getSymbol(Symbol::Line, style));
-	for (int i = 0; i < num_points; ++i)
+	for (auto const& coord : toMapCoords(geometry))
 	{
-		object->addCoordinate(toMapCoord(OGR_G_GetX(geometry, i), OGR_G_GetY(geometry, i)));
+		object->addCoordinate(coord);
 	}
 	return object;
 }
@@ -861,19 +862,18 @@ PathObject* OgrFileImport::importPolygonGeometry(OGRFeatureH feature, OGRGeometr
 	
 	auto style = OGR_F_GetStyleString(feature);
 	auto object = new PathObject(getSymbol(Symbol::Area, style));
-	for (int i = 0; i < num_points; ++i)
+	for (auto const& coord : toMapCoords(outline))
 	{
-		object->addCoordinate(toMapCoord(OGR_G_GetX(outline, i), OGR_G_GetY(outline, i)));
+		object->addCoordinate(coord);
 	}
 	
 	for (int g = 1; g < num_geometries; ++g)
 	{
 		bool start_new_part = true;
 		auto hole = /*OGR_G_ForceToLineString*/(OGR_G_GetGeometryRef(geometry, g));
-		auto num_points = OGR_G_GetPointCount(hole);
-		for (int i = 0; i < num_points; ++i)
+		for (auto const& coord : toMapCoords(hole))
 		{
-			object->addCoordinate(toMapCoord(OGR_G_GetX(hole, i), OGR_G_GetY(hole, i)), start_new_part);
+			object->addCoordinate(coord, start_new_part);
 			start_new_part = false;
 		}
 	}
@@ -1276,6 +1276,31 @@ AreaSymbol* OgrFileImport::getSymbolForBrush(OGRStyleToolH tool, const QByteArra
 }
 
 
+MapCoordVector OgrFileImport::toMapCoords(OGRGeometryH geometry) const
+{
+	auto const num_points = OGR_G_GetPointCount(geometry);
+	auto result = MapCoordVector();
+	result.reserve(std::size_t(std::max(0, num_points)));
+	if (to_map_coord == &OgrFileImport::fromProjected)
+	{
+		auto projected_coords = std::vector<QPointF>();
+		projected_coords.reserve(result.capacity());
+		for (int i = 0; i < num_points; ++i)
+			projected_coords.emplace_back(OGR_G_GetX(geometry, i), OGR_G_GetY(geometry, i));
+		
+		auto map_coords = std::vector<MapCoordF>(projected_coords.size());
+		map->getGeoreferencing().toMapCoordF(projected_coords.data(), map_coords.data(), projected_coords.size());
+		for (auto const& coord : map_coords)
+			result.push_back(MapCoord::load(coord, MapCoord::Flags{}));
+	}
+	else
+	{
+		for (int i = 0; i < num_points; ++i)
+			result.push_back(toMapCoord(OGR_G_GetX(geometry, i), OGR_G_GetY(geometry, i)));
+	}
+	return result;
+}
+
 MapCoord OgrFileImport::fromDrawing(double x, double y) const
 {
 	return MapCoord::load(x, -y, MapCoord::Flags{});
@@ -206,6 +206,13 @@ protected:
 	
 	MapCoord toMapCoord(double x, double y) const;
 	
+	/**
+	 * Returns the map coordinates of all points of the given geometry.
+	 * 
+	 * Projected coordinates are transformed as a single batch.
+	 */
+	MapCoordVector toMapCoords(OGRGeometryH geometry) const;
+	
 	/**
 	 * A MapCoordConstructor which interpretes the given coordinates in millimeters on paper.
 	 */
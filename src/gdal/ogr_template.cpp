@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <utility>
 
 #include <Qt>
 #include <QtGlobal>
@@ -256,11 +257,47 @@ catch (FileFormatException& e)
 
 bool OgrTemplate::loadTemplateFileImpl(bool configuring)
 try
+{
+	ImportedData data;
+	data.map = createTemplateMap(configuring);
+	importFile(template_path, data, use_real_coords);
+	setImportedData(std::move(data));
+	return true;
+}
+catch (FileFormatException& e)
+{
+	setErrorString(e.message());
+	return false;
+}
+
+
+Template::ReadFileFunction OgrTemplate::templateFileReader()
+try
+{
+	auto const path = template_path;
+	auto const real_coords = use_real_coords;
+	// The map is created and georeferenced on the template's thread.
+	auto data = std::make_shared<ImportedData>();
+	data->map = createTemplateMap(false);
+	return [this, path, data, real_coords]() -> FinishLoadingFunction {
+		importFile(path, *data, real_coords);
+		return [this, data]() {
+			setImportedData(std::move(*data));
+			return true;
+		};
+	};
+}
+catch (FileFormatException&)
+{
+	// Synchronous loading will report the error.
+	return {};
+}
+
+
+std::unique_ptr<Map> OgrTemplate::createTemplateMap(bool configuring)
 {
 	QFile file{ template_path };
-	auto new_template_map = std::make_unique<Map>();
-	auto unit_type = use_real_coords ? OgrFileImport::UnitOnGround : OgrFileImport::UnitOnPaper;
-	OgrFileImport importer{ &file, new_template_map.get(), nullptr, unit_type };
+	auto template_map = std::make_unique<Map>();
 	
 	const auto& map_georef = map->getGeoreferencing();
 	
@@ -336,29 +373,46 @@ try
 	
 	if (is_georeferenced || !explicit_georef)
 	{
-		new_template_map->setGeoreferencing(map_georef);
+		template_map->setGeoreferencing(map_georef);
 	}
 	else
 	{
-		new_template_map->setGeoreferencing(*explicit_georef);
+		template_map->setGeoreferencing(*explicit_georef);
 	}
 	
-	const auto pp0 = new_template_map->getGeoreferencing().getProjectedRefPoint();
+	return template_map;
+}
+
+
+void OgrTemplate::importFile(const QString& path, ImportedData& data, bool use_real_coords)
+{
+	QFile file{ path };
+	auto unit_type = use_real_coords ? OgrFileImport::UnitOnGround : OgrFileImport::UnitOnPaper;
+	OgrFileImport importer{ &file, data.map.get(), nullptr, unit_type };
+	
+	const auto pp0 = data.map->getGeoreferencing().getProjectedRefPoint();
 	importer.setGeoreferencingImportEnabled(false);
-	importer.doImport(false, template_path);
+	importer.doImport(false, path);
 	
 	// MapCoord bounds handling may have moved the paper position of the
 	// template data during import. The template position might need to be
 	// adjusted accordingly.
-	// However, this will happen again the next time the template is loaded.
-	// So this adjustment must not affect the saved configuration.
-	const auto pm0 = new_template_map->getGeoreferencing().toMapCoords(pp0);
-	const auto pm1 = new_template_map->getGeoreferencing().getMapRefPoint();
-	setTemplatePositionOffset(pm1 - pm0);
+	const auto pm0 = data.map->getGeoreferencing().toMapCoords(pp0);
+	const auto pm1 = data.map->getGeoreferencing().getMapRefPoint();
+	data.position_offset = pm1 - pm0;
+	data.warnings = importer.warnings();
+}
+
+
+void OgrTemplate::setImportedData(ImportedData&& data)
+{
+	// The position adjustment will happen again the next time the template
+	// is loaded. So it must not affect the saved configuration.
+	setTemplatePositionOffset(data.position_offset);
 	
-	setTemplateMap(std::move(new_template_map));
+	setTemplateMap(std::move(data.map));
 	
-	const auto& warnings = importer.warnings();
+	const auto& warnings = data.warnings;
 	if (!warnings.empty())
 	{
 		QString message;
@@ -371,13 +425,6 @@ try
 		message.chop(1);
 		setErrorString(message);
 	}
-	
-	return true;
-}
-catch (FileFormatException& e)
-{
-	setErrorString(e.message());
-	return false;
 }
 
 
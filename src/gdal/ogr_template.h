@@ -26,6 +26,7 @@
 #include <QObject>
 #include <QString>
 
+#include "core/map_coord.h"
 #include "templates/template_map.h"
 
 class QByteArray;
@@ -78,6 +79,8 @@ public:
 	 */
 	bool loadTemplateFileImpl(bool configuring) override;
 	
+	ReadFileFunction templateFileReader() override;
+	
 	bool postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view) override;
 	
 protected:
@@ -97,6 +100,35 @@ protected:
 	
 	void saveTypeSpecificTemplateConfiguration(QXmlStreamWriter& xml) const override;
 	
+	/**
+	 * Geospatial vector data imported into a map, cf. importFile().
+	 */
+	struct ImportedData
+	{
+		std::unique_ptr<Map> map;
+		MapCoord position_offset;
+		std::vector<QString> warnings;
+	};
+	
+	/**
+	 * Creates the map which receives the data, with the georeferencing
+	 * described for loadTemplateFileImpl().
+	 */
+	std::unique_ptr<Map> createTemplateMap(bool configuring);
+	
+	/**
+	 * Imports the geospatial vector data into the given data's map.
+	 * 
+	 * This function doesn't access any template, so it can be used on a
+	 * worker thread. It may throw FileFormatException.
+	 */
+	static void importFile(const QString& path, ImportedData& data, bool use_real_coords);
+	
+	/**
+	 * Takes over the imported data.
+	 */
+	void setImportedData(ImportedData&& data);
+
 private:
 	std::unique_ptr<Georeferencing> explicit_georef;
 	QString track_crs_spec;           // (limited) TemplateTrack compatibility
@@ -38,6 +38,8 @@ void doStaticInitializations()
 	FileFormats.registerFormat(new XMLFileFormat());
 #ifndef MAPPER_BIG_ENDIAN
 	FileFormats.registerFormat(new OcdFileFormat());
+	FileFormats.registerFormat(new OcdFileFormat(11));
+	FileFormats.registerFormat(new OcdFileFormat(12));
 #endif
 #ifdef MAPPER_USE_GDAL
 	FileFormats.registerFormat(new OgrFileFormat());
@@ -29,6 +29,7 @@
 #include <QLabel>
 #include <QMessageBox>
 #include <QMenuBar>
+#include <QPointer>
 #include <QSettings>
 #include <QStackedWidget>
 #include <QStatusBar>
@@ -66,6 +67,17 @@
 
 namespace OpenOrienteering {
 
+namespace {
+
+/// The settings key which blocks immediate re-opening of crashing files.
+QString reopenBlocker()
+{
+	return QString::fromLatin1("open_in_progress");
+}
+
+}  // namespace
+
+
 constexpr int MainWindow::max_recent_files;
 
 int MainWindow::num_open_files = 0;
@@ -800,9 +812,8 @@ bool MainWindow::openPath(const QString &path)
 	
 	// Check a blocker that prevents immediate re-opening of crashing files.
 	// Needed for stopping auto-loading a crashing file on startup.
-	static const QString reopen_blocker = QString::fromLatin1("open_in_progress");
 	QSettings settings;
-	const QString open_in_progress(settings.value(reopen_blocker).toString());
+	const QString open_in_progress(settings.value(reopenBlocker()).toString());
 	if (open_in_progress == path)
 	{
 		int result = QMessageBox::warning(this, tr("Crash warning"), 
@@ -811,19 +822,19 @@ bool MainWindow::openPath(const QString &path)
 		     "Really retry to open it?")
 		  .arg(appName(), path),
 		  QMessageBox::Yes | QMessageBox::No);
-		settings.remove(reopen_blocker);
+		settings.remove(reopenBlocker());
 		if (result == QMessageBox::No)
 			return false;
 	}
 	
-	settings.setValue(reopen_blocker, path);
+	settings.setValue(reopenBlocker(), path);
 	settings.sync();
 	
 	MainWindowController* const new_controller = MainWindowController::controllerForFile(path);
 	if (!new_controller)
 	{
 		QMessageBox::warning(this, tr("Error"), tr("Cannot open file:\n%1\n\nFile format not recognized.").arg(path));
-		settings.remove(reopen_blocker);
+		settings.remove(reopenBlocker());
 		return false;
 	}
 	
@@ -844,13 +855,30 @@ bool MainWindow::openPath(const QString &path)
 #endif
 	}
 	
-	if (new_actual_path.isEmpty() || !new_controller->load(new_actual_path, this))
+	if (new_actual_path.isEmpty())
 	{
 		delete new_controller;
-		settings.remove(reopen_blocker);
+		settings.remove(reopenBlocker());
 		return false;
 	}
 	
+	// The controller may finish loading after returning to the event loop.
+	QPointer<MainWindow> self(this);
+	new_controller->loadAsync(new_actual_path, this, [self, new_controller, path, new_actual_path, new_autosave_conflict](bool loaded) {
+		if (self && loaded)
+		{
+			self->finishOpenPath(new_controller, path, new_actual_path, new_autosave_conflict);
+			return;
+		}
+		
+		new_controller->deleteLater();
+		QSettings().remove(reopenBlocker());
+	});
+	return true;
+}
+
+void MainWindow::finishOpenPath(MainWindowController* new_controller, const QString& path, const QString& new_actual_path, bool new_autosave_conflict)
+{
 	MainWindow* open_window = this;
 #if !defined(Q_OS_ANDROID)
 	if (has_opened_file)
@@ -865,14 +893,14 @@ bool MainWindow::openPath(const QString &path)
 	open_window->setVisible(true); // Respect the window flags set by new_controller.
 	open_window->raise();
 	num_open_files++;
-	settings.remove(reopen_blocker);
+	QSettings().remove(reopenBlocker());
 	setMostRecentlyUsedFile(path);
 	
 #if !defined(Q_OS_ANDROID)
 	// Assuming large screen. Android handled above.
 	if (new_autosave_conflict)
 	{
-		auto autosave_dialog = new AutosaveDialog(path, autosave_path, new_actual_path, open_window, Qt::WindowTitleHint | Qt::CustomizeWindowHint);
+		auto autosave_dialog = new AutosaveDialog(path, Autosave::autosavePath(path), new_actual_path, open_window, Qt::WindowTitleHint | Qt::CustomizeWindowHint);
 		autosave_dialog->move(open_window->rect().right() - autosave_dialog->width(), open_window->rect().top());
 		autosave_dialog->show();
 		autosave_dialog->raise();
@@ -884,8 +912,6 @@ bool MainWindow::openPath(const QString &path)
 #endif
 	
 	open_window->activateWindow();
-	
-	return true;
 }
 
 void MainWindow::switchActualPath(const QString& path)
@@ -908,11 +934,29 @@ void MainWindow::switchActualPath(const QString& path)
 	{
 		const QString& current_path = currentPath();
 		MainWindowController* const new_controller = MainWindowController::controllerForFile(current_path);
-		if (new_controller && new_controller->load(path, this))
+		if (new_controller)
 		{
-			setController(new_controller, current_path);
-			actual_path = path;
-			setHasUnsavedChanges(false);
+			// The controller may finish loading after returning to the event loop.
+			QPointer<MainWindow> self(this);
+			new_controller->loadAsync(path, this, [self, new_controller, current_path, path](bool loaded) {
+				if (self && loaded)
+				{
+					self->setController(new_controller, current_path);
+					self->actual_path = path;
+					self->setHasUnsavedChanges(false);
+				}
+				else
+				{
+					new_controller->deleteLater();
+				}
+				
+				if (self)
+				{
+					emit self->actualPathChanged(self->actual_path);
+					self->activateWindow();
+				}
+			});
+			return;
 		}
 	}
 	
@@ -279,9 +279,10 @@ public slots:
 	 * 
 	 * May open a new main window.
 	 * If loading is successful, the selected path will become
-	 * the [new] window's current path.
+	 * the [new] window's current path. Loading may finish after
+	 * this function returned.
 	 * 
-	 * @return true if loading was succesful, false otherwise
+	 * @return false if the file cannot be opened, true otherwise
 	 */
 	bool openPath(const QString &path);
 	
@@ -457,6 +458,13 @@ private:
 
 	static MainWindow* findMainWindow(const QString& file_name);
 	
+	/**
+	 * Shows a controller which has loaded the file with the given path.
+	 * 
+	 * This is the second part of openPath().
+	 */
+	void finishOpenPath(MainWindowController* new_controller, const QString& path, const QString& new_actual_path, bool new_autosave_conflict);
+	
 	
 	/// The active controller
 	MainWindowController* controller;
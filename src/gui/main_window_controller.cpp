@@ -53,6 +53,11 @@ bool MainWindowController::load(const QString& path, QWidget* dialog_parent)
 	return false;
 }
 
+void MainWindowController::loadAsync(const QString& path, QWidget* dialog_parent, const std::function<void (bool)>& finished)
+{
+	finished(load(path, dialog_parent));
+}
+
 void MainWindowController::detach()
 {
 	// nothing
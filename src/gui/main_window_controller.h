@@ -22,6 +22,8 @@
 #ifndef OPENORIENTEERING_MAIN_WINDOW_CONTROLLER_H
 #define OPENORIENTEERING_MAIN_WINDOW_CONTROLLER_H
 
+#include <functional>
+
 #include <QObject>
 #include <QString>
 
@@ -67,6 +69,17 @@ public:
 	 */
 	virtual bool load(const QString& path, QWidget* dialog_parent = nullptr);
 	
+	/** Load from a file, possibly without blocking the event loop.
+	 *  When loading has finished, the given function is called with the
+	 *  result of loading. It is not called if the controller is destroyed
+	 *  before. The default implementation calls load() and then the given
+	 *  function.
+	 *  @param path the path to load from
+	 *  @param dialog_parent Alternative parent widget for all dialogs.
+	 *  @param finished the function which receives the result of load()
+	 */
+	virtual void loadAsync(const QString& path, QWidget* dialog_parent, const std::function<void (bool)>& finished);
+	
 	/** Attach the controller to a main window. 
 	 *  The controller should create its user interface here.
 	 */
@@ -27,6 +27,7 @@
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <memory>
 #include <set>
 #include <vector>
 // IWYU pragma: no_include <ext/alloc_traits.h>
@@ -34,6 +35,7 @@
 #include <Qt>
 #include <QtGlobal>
 #include <QtMath>
+#include <QtConcurrentRun>
 #include <QAbstractButton>
 #include <QAction>
 #include <QActionGroup>
@@ -51,6 +53,7 @@
 #include <QFlags>
 #include <QFont>
 #include <QFontMetrics>
+#include <QFutureWatcher>
 #include <QFrame>
 #include <QHBoxLayout>
 #include <QIcon>
@@ -72,6 +75,8 @@
 #include <QPainter>
 #include <QPixmap>
 #include <QPoint>
+#include <QPointer>
+#include <QProgressDialog>
 #include <QPushButton>
 #include <QRect>
 #include <QRectF>
@@ -85,6 +90,7 @@
 #include <QStatusBar>
 #include <QStringList>
 #include <QTextEdit>
+#include <QTimer>
 #include <QToolBar>
 #include <QToolButton>
 #include <QVariant>
@@ -110,6 +116,7 @@
 #include "core/symbols/symbol_icon_decorator.h"
 #include "fileformats/file_format.h"
 #include "fileformats/file_format_registry.h"
+#include "fileformats/file_import_export.h"
 #include "gui/configure_grid_dialog.h"
 #include "gui/file_dialog.h"
 #include "gui/georeferencing_dialog.h"
@@ -581,6 +588,7 @@ bool MapEditorController::load(const QString& path, QWidget* dialog_parent)
 		main_view = new MapView(this, map);
 	}
 	
+	main_view->setTemplateLoadingAsync(true);
 	bool success = map->loadFrom(path, dialog_parent, main_view);
 	if (success)
 	{
@@ -596,6 +604,88 @@ bool MapEditorController::load(const QString& path, QWidget* dialog_parent)
 	return success;
 }
 
+void MapEditorController::loadAsync(const QString& path, QWidget* dialog_parent, const std::function<void (bool)>& finished)
+{
+	if (map)
+	{
+		MainWindowController::loadAsync(path, dialog_parent, finished);
+		return;
+	}
+	
+	if (!dialog_parent)
+		dialog_parent = window;
+	
+	// The file is read on a worker thread, into a new map and view.
+	// When done, they are moved to this thread, and the templates are loaded.
+	struct LoadResult
+	{
+		std::unique_ptr<Map> map;
+		MapView* view;
+		std::unique_ptr<Importer> importer;
+		QString error_message;
+	};
+	auto progress = std::make_shared<ImportProgress>();
+	auto const target_thread = thread();
+	
+	const auto label = tr("Loading %1...").arg(QFileInfo(path).fileName());
+	// The dialog is application modal, so that the user cannot trigger
+	// actions meanwhile. Its parent may still be destroyed, so it is
+	// tracked by a QPointer.
+	QPointer<QProgressDialog> progress_dialog = new QProgressDialog(label, tr("Cancel"), 0, 1000, dialog_parent);
+	progress_dialog->setWindowModality(Qt::ApplicationModal);
+	progress_dialog->setMinimumDuration(0);
+	progress_dialog->setValue(0);
+	progress_dialog->show();
+	auto* progress_timer = new QTimer(progress_dialog);
+	connect(progress_timer, &QTimer::timeout, progress_dialog, [dialog = progress_dialog.data(), label, progress]() {
+		if (dialog->wasCanceled())
+			return;
+		auto const size = progress->size.load();
+		if (size > 0)
+			dialog->setValue(int(qMin(qint64(999), 1000 * progress->position.load() / size)));
+		dialog->setLabelText(label + QLatin1Char('\n')
+		                     + tr("%n map part(s)", nullptr, progress->parts.load()) + QLatin1String(", ")
+		                     + tr("%n object(s)", nullptr, progress->objects.load()));
+	});
+	connect(progress_dialog, &QProgressDialog::canceled, progress_dialog, [progress]() {
+		progress->canceled = true;
+	});
+	progress_timer->start(100);
+	
+	// The watcher is destroyed with the controller, dropping the result.
+	auto* watcher = new QFutureWatcher<std::shared_ptr<LoadResult>>(this);
+	QPointer<QWidget> parent_guard(dialog_parent);
+	connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, path, progress, progress_dialog, parent_guard, finished]() {
+		auto result = watcher->result();
+		watcher->deleteLater();
+		delete progress_dialog;
+		
+		if (!result->importer)
+		{
+			if (!progress->canceled)
+				QMessageBox::warning(parent_guard, tr("Error"), result->error_message);
+			finished(false);
+			return;
+		}
+		
+		map = result->map.release();
+		main_view = result->view;
+		main_view->setParent(this);
+		main_view->setTemplateLoadingAsync(true);
+		map->finishLoading(*result->importer, path);
+		setMapAndView(map, main_view);
+		finished(true);
+	});
+	watcher->setFuture(QtConcurrent::run([path, progress, target_thread]() {
+		auto result = std::make_shared<LoadResult>();
+		result->map = std::make_unique<Map>();
+		result->view = new MapView(result->map.get());
+		result->importer = result->map->importFrom(path, result->view, false, progress.get(), result->error_message);
+		result->map->moveAllToThread(target_thread);
+		return result;
+	}));
+}
+
 void MapEditorController::attach(MainWindow* window)
 {
 	print_dock_widget = nullptr;
@@ -2720,11 +2810,9 @@ void MapEditorController::selectObjectsClicked(bool select_exclusively)
 	}
 
 	bool object_selected = false;	
-	MapPart* part = map->getCurrentPart();
-	for (int i = 0, size = part->getNumObjects(); i < size; ++i)
+	for (auto object : objectsWithSelectedSymbols())
 	{
-		Object* object = part->getObject(i);
-		if (symbol_widget->isSymbolSelected(object->getSymbol()) && !(!select_exclusively && map->isObjectSelected(object)))
+		if (!(!select_exclusively && map->isObjectSelected(object)))
 		{
 			map->addObjectToSelection(object, false);
 			object_selected = true;
@@ -2750,11 +2838,9 @@ void MapEditorController::deselectObjectsClicked()
 {
 	bool selection_changed = false;
 	
-	MapPart* part = map->getCurrentPart();
-	for (int i = 0, size = part->getNumObjects(); i < size; ++i)
+	for (auto object : objectsWithSelectedSymbols())
 	{
-		Object* object = part->getObject(i);
-		if (symbol_widget->isSymbolSelected(object->getSymbol()) && map->isObjectSelected(object))
+		if (map->isObjectSelected(object))
 		{
 			map->removeObjectFromSelection(object, false);
 			selection_changed = true;
@@ -2770,6 +2856,24 @@ void MapEditorController::deselectObjectsClicked()
 	}
 }
 
+std::vector<Object*> MapEditorController::objectsWithSelectedSymbols() const
+{
+	std::vector<Object*> objects;
+	MapPart* part = map->getCurrentPart();
+	for (int i = 0, size = map->getNumSymbols(); i < size; ++i)
+	{
+		if (symbol_widget->isSymbolSelected(map->getSymbol(i)))
+		{
+			auto const symbol_objects = part->objectsWithSymbol(map->getSymbol(i));
+			objects.insert(end(objects), begin(symbol_objects), end(symbol_objects));
+		}
+	}
+	std::sort(begin(objects), end(objects), [part](const Object* a, const Object* b) {
+		return part->findObjectIndex(a) < part->findObjectIndex(b);
+	});
+	return objects;
+}
+
 void MapEditorController::selectAll()
 {
 	auto num_selected_objects = map->getNumSelectedObjects();
@@ -22,7 +22,9 @@
 #ifndef OPENORIENTEERING_MAP_EDITOR_H
 #define OPENORIENTEERING_MAP_EDITOR_H
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <QClipboard>
 #include <QHash>
@@ -65,6 +67,7 @@ class MapEditorTool;
 class MapFindFeature;
 class MapView;
 class MapWidget;
+class Object;
 class PrintWidget;
 class ReopenTemplateDialog;
 class Symbol;
@@ -234,6 +237,8 @@ public:
 	bool exportTo(const QString& path, const FileFormat* format = nullptr) override;
 	/** Override from MainWindowController */
 	bool load(const QString& path, QWidget* dialog_parent = nullptr) override;
+	/** Override from MainWindowController */
+	void loadAsync(const QString& path, QWidget* dialog_parent, const std::function<void (bool)>& finished) override;
 	
 	/** Override from MainWindowController */
 	void attach(MainWindow* window) override;
@@ -590,6 +595,9 @@ private:
 	
 	void createTagEditor();
 	
+	/// Returns the objects in the current part which have one of the selected symbols, in z-order.
+	std::vector<Object*> objectsWithSelectedSymbols() const;
+	
 	QAction* newAction(const char* id, const QString& tr_text, QObject* receiver, const char* slot, const char* icon = nullptr, const QString& tr_tip = QString{}, const char* whats_this_link = nullptr);
 	QAction* newCheckAction(const char* id, const QString& tr_text, QObject* receiver, const char* slot, const char* icon = nullptr, const QString& tr_tip = QString{}, const char* whats_this_link = nullptr);
 	QAction* newToolAction(const char* id, const QString& tr_text, QObject* receiver, const char* slot, const char* icon = nullptr, const QString& tr_tip = QString{}, const char* whats_this_link = nullptr);
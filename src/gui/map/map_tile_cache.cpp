@@ -0,0 +1,221 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "map_tile_cache.h"
+
+#include <cmath>
+
+
+namespace OpenOrienteering {
+
+constexpr int MapTileCache::tile_size;
+
+
+bool MapTileCache::Parameters::operator==(const Parameters& other) const
+{
+	return map_revision == other.map_revision
+	       && qFuzzyCompare(1.0 + rotation, 1.0 + other.rotation)
+	       && options == other.options
+	       && overprinting_simulation == other.overprinting_simulation
+	       && grid_visible == other.grid_visible
+	       && use_background == other.use_background;
+}
+
+bool MapTileCache::Parameters::operator!=(const Parameters& other) const
+{
+	return !(*this == other);
+}
+
+
+
+MapTileCache::MapTileCache(std::size_t capacity)
+: parameters{}
+, capacity(capacity)
+{
+	// nothing else
+}
+
+MapTileCache::~MapTileCache() = default;
+
+
+std::size_t MapTileCache::size() const
+{
+	return usage.size();
+}
+
+
+void MapTileCache::setParameters(const Parameters& parameters)
+{
+	if (parameters != this->parameters)
+	{
+		clear();
+		this->parameters = parameters;
+	}
+}
+
+
+const QImage* MapTileCache::find(qreal zoom, const QTransform& transform, QPoint index)
+{
+	auto const level = levels.find(levelKey(zoom));
+	if (level == levels.end() || !isAligned(level->second.transform, transform))
+		return nullptr;
+	
+	auto const tile = level->second.tiles.find(tileKey(index));
+	if (tile == level->second.tiles.end())
+		return nullptr;
+	
+	// Move to the front of the usage list
+	usage.splice(usage.begin(), usage, tile->second.usage);
+	return &tile->second.image;
+}
+
+
+void MapTileCache::insert(qreal zoom, const QTransform& transform, QPoint index, const QImage& image)
+{
+	auto const level_key = levelKey(zoom);
+	auto const tile_key = tileKey(index);
+	
+	auto const level_it = levels.emplace(level_key, Level{}).first;
+	auto& level = level_it->second;
+	if (!level.tiles.empty() && !isAligned(level.transform, transform))
+	{
+		while (!level.tiles.empty())
+			erase(level_it, level.tiles.begin());
+	}
+	if (level.tiles.empty())
+		level.transform = transform;
+	
+	auto tile = level.tiles.find(tile_key);
+	if (tile == level.tiles.end())
+	{
+		usage.emplace_front(level_key, tile_key);
+		level.tiles.emplace(tile_key, Tile{ image, usage.begin() });
+	}
+	else
+	{
+		tile->second.image = image;
+		usage.splice(usage.begin(), usage, tile->second.usage);
+	}
+	
+	while (usage.size() > capacity)
+	{
+		auto const oldest = usage.back();
+		auto const oldest_level = levels.find(oldest.first);
+		erase(oldest_level, oldest_level->second.tiles.find(oldest.second));
+		if (oldest_level->second.tiles.empty())
+			levels.erase(oldest_level);
+	}
+}
+
+
+void MapTileCache::invalidate(const QRectF& map_rect)
+{
+	for (auto level = levels.begin(); level != levels.end(); )
+	{
+		// One extra pixel for antialiasing
+		auto const pixel_rect = level->second.transform.mapRect(map_rect).adjusted(-1, -1, 1, 1);
+		auto const range = tileRange(pixel_rect);
+		auto& tiles = level->second.tiles;
+		if (qint64(range.width()) * range.height() <= qint64(tiles.size()))
+		{
+			for (int y = range.top(); y <= range.bottom(); ++y)
+			{
+				for (int x = range.left(); x <= range.right(); ++x)
+				{
+					auto const tile = tiles.find(tileKey({x, y}));
+					if (tile != tiles.end())
+						erase(level, tile);
+				}
+			}
+		}
+		else
+		{
+			for (auto tile = tiles.begin(); tile != tiles.end(); )
+			{
+				auto const current = tile++;
+				if (range.contains(tileIndex(current->first)))
+					erase(level, current);
+			}
+		}
+		
+		if (tiles.empty())
+			level = levels.erase(level);
+		else
+			++level;
+	}
+}
+
+
+void MapTileCache::clear()
+{
+	levels.clear();
+	usage.clear();
+}
+
+
+QRect MapTileCache::tileRange(const QRectF& pixel_rect)
+{
+	// Tiles which only touch the right or bottom edge are not included.
+	return QRect(QPoint(int(std::floor(pixel_rect.left() / tile_size)), int(std::floor(pixel_rect.top() / tile_size))),
+	             QPoint(int(std::ceil(pixel_rect.right() / tile_size)) - 1, int(std::ceil(pixel_rect.bottom() / tile_size)) - 1));
+}
+
+
+QRect MapTileCache::tileRect(QPoint index)
+{
+	return QRect(index.x() * tile_size, index.y() * tile_size, tile_size, tile_size);
+}
+
+
+MapTileCache::LevelKey MapTileCache::levelKey(qreal zoom)
+{
+	// Zoom factors which differ by less than 1/65536 octave share a level.
+	return qRound64(std::log2(zoom) * 65536);
+}
+
+
+bool MapTileCache::isAligned(const QTransform& first, const QTransform& second)
+{
+	// A deviation of less than 1/32 pixel is not visible.
+	return std::abs(first.dx() - second.dx()) < 1.0/32
+	       && std::abs(first.dy() - second.dy()) < 1.0/32;
+}
+
+
+MapTileCache::TileKey MapTileCache::tileKey(QPoint index)
+{
+	return (TileKey(quint32(index.x())) << 32) | TileKey(quint32(index.y()));
+}
+
+
+QPoint MapTileCache::tileIndex(TileKey key)
+{
+	return { int(quint32(key >> 32)), int(quint32(key)) };
+}
+
+
+void MapTileCache::erase(std::map<LevelKey, Level>::iterator level, std::unordered_map<TileKey, Tile>::iterator tile)
+{
+	usage.erase(tile->second.usage);
+	level->second.tiles.erase(tile);
+}
+
+
+}  // namespace OpenOrienteering
@@ -0,0 +1,181 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_MAP_TILE_CACHE_H
+#define OPENORIENTEERING_MAP_TILE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include <QtGlobal>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QRectF>
+#include <QTransform>
+
+#include "core/renderables/renderable.h"
+
+namespace OpenOrienteering {
+
+
+/**
+ * A cache of rendered map tiles, for multiple zoom levels.
+ *
+ * The tiles form a grid in "global" pixel coordinates, i.e. in the
+ * coordinates of the view's world transform without integer translation.
+ * Thus tiles do not depend on the position of the view, and they can be
+ * reused after panning by whole pixels, and when returning to a previous
+ * zoom level. The subpixel part of the translation is kept in the transform
+ * so that the tiles align exactly with other layers of the view.
+ *
+ * Tiles which intersect a changed area of the map are removed by
+ * invalidate(). Parameters which affect all tiles are set by
+ * setParameters(). The least recently used tiles are discarded when the
+ * number of tiles exceeds the capacity.
+ */
+class MapTileCache
+{
+public:
+	/// The width and height of the tiles, in pixels
+	static constexpr int tile_size = 256;
+	
+	/**
+	 * The rendering parameters which are common to all tiles.
+	 */
+	struct Parameters
+	{
+		quint64 map_revision;          ///< The map's revision, cf. Map::revision()
+		qreal rotation;                ///< The rotation of the view
+		RenderConfig::Options options; ///< The rendering options
+		bool overprinting_simulation;  ///< Whether overprinting simulation is enabled
+		bool grid_visible;             ///< Whether the map grid is drawn
+		bool use_background;           ///< Whether the tiles have a white background
+		
+		bool operator==(const Parameters& other) const;
+		bool operator!=(const Parameters& other) const;
+	};
+	
+	
+	/**
+	 * Constructs an empty cache.
+	 *
+	 * @param capacity The maximum number of tiles to be kept in the cache.
+	 */
+	explicit MapTileCache(std::size_t capacity = 256);
+	
+	MapTileCache(const MapTileCache&) = delete;
+	~MapTileCache();
+	
+	MapTileCache& operator=(const MapTileCache&) = delete;
+	
+	
+	/**
+	 * Returns the number of tiles in the cache.
+	 */
+	std::size_t size() const;
+	
+	/**
+	 * Sets the parameters for all tiles.
+	 *
+	 * If the parameters differ from the current ones, the cache is cleared.
+	 */
+	void setParameters(const Parameters& parameters);
+	
+	/**
+	 * Returns the cached tile at the given zoom level and index, or nullptr.
+	 *
+	 * Tiles which were rendered with a different subpixel translation
+	 * are not returned.
+	 */
+	const QImage* find(qreal zoom, const QTransform& transform, QPoint index);
+	
+	/**
+	 * Adds a tile to the cache.
+	 *
+	 * @param zoom       The final zoom factor of the view.
+	 * @param transform  The transformation from map coordinates to global pixels.
+	 * @param index      The tile's column and row in global pixels, divided by tile_size.
+	 * @param image      The rendered tile.
+	 *
+	 * If the zoom level holds tiles for a different subpixel translation,
+	 * these tiles are discarded.
+	 */
+	void insert(qreal zoom, const QTransform& transform, QPoint index, const QImage& image);
+	
+	/**
+	 * Removes all tiles which intersect the given area of the map.
+	 */
+	void invalidate(const QRectF& map_rect);
+	
+	/**
+	 * Removes all tiles.
+	 */
+	void clear();
+	
+	
+	/**
+	 * Returns the range of tile indices which intersect the given rectangle of global pixels.
+	 */
+	static QRect tileRange(const QRectF& pixel_rect);
+	
+	/**
+	 * Returns the rectangle of global pixels covered by the tile with the given index.
+	 */
+	static QRect tileRect(QPoint index);
+
+
+private:
+	using LevelKey = qint64;
+	using TileKey = quint64;
+	using Usage = std::list<std::pair<LevelKey, TileKey>>;
+	
+	struct Tile
+	{
+		QImage image;
+		Usage::iterator usage;
+	};
+	
+	struct Level
+	{
+		QTransform transform;
+		std::unordered_map<TileKey, Tile> tiles;
+	};
+	
+	static LevelKey levelKey(qreal zoom);
+	static bool isAligned(const QTransform& first, const QTransform& second);
+	static TileKey tileKey(QPoint index);
+	static QPoint tileIndex(TileKey key);
+	
+	void erase(std::map<LevelKey, Level>::iterator level, std::unordered_map<TileKey, Tile>::iterator tile);
+	
+	std::map<LevelKey, Level> levels;
+	Usage usage;  ///< Tiles in the order of use, most recent first
+	Parameters parameters;
+	std::size_t capacity;
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif
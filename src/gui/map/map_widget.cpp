@@ -21,12 +21,18 @@
 
 #include "map_widget.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <iterator>
 #include <stdexcept>
+#include <vector>
 
+#include <QtConcurrentMap>
 #include <QApplication>
 #include <QColor>
 #include <QContextMenuEvent>
+#include <QElapsedTimer>
 #include <QEvent>
 #include <QFlags>
 #include <QFont>
@@ -36,6 +42,7 @@
 #include <QLatin1String>
 #include <QList>
 #include <QLocale>
+#include <QMetaObject>
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPaintEvent>
@@ -43,6 +50,7 @@
 #include <QPixmap>
 #include <QResizeEvent>
 #include <QSizePolicy>
+#include <QThread>
 #include <QTimer>
 #include <QTouchEvent>
 #include <QTransform>
@@ -72,6 +80,25 @@ class QGesture;
 
 namespace OpenOrienteering {
 
+namespace {
+
+/// The time after which a partially updated map cache is shown, in milliseconds
+constexpr int map_cache_time_budget = 100;
+
+/**
+ * A tile of the map cache which needs to be rendered.
+ */
+struct MapCacheTile
+{
+	QPoint index;  ///< The index of the tile, cf. MapTileCache
+	QImage image;  ///< The rendered tile
+};
+
+
+}  // namespace
+
+
+
 MapWidget::MapWidget(bool show_help, bool force_antialiasing, QWidget* parent)
  : QWidget(parent)
  , view(nullptr)
@@ -439,6 +466,7 @@ void MapWidget::markTemplateCacheDirty(const QRectF& view_rect, int pixel_border
 
 void MapWidget::markObjectAreaDirty(const QRectF& map_rect)
 {
+	map_tile_cache.invalidate(map_rect);
 	updateMapRect(map_rect, 0, map_cache_dirty_rect);
 }
 
@@ -1261,6 +1289,12 @@ void MapWidget::updateTemplateCache(QImage& cache, QRect& dirty_rect, int first_
 
 void MapWidget::updateMapCache(bool use_background)
 {
+	Map* map = view->getMap();
+	// Updating objects may mark more areas as dirty.
+	// After this update, drawing doesn't modify the map,
+	// so the tiles can be rendered concurrently.
+	map->updateObjects();
+	
 	if (map_cache.isNull())
 	{
 		// Lazy allocation of cache image
@@ -1273,47 +1307,104 @@ void MapWidget::updateMapCache(bool use_background)
 		map_cache_dirty_rect = map_cache_dirty_rect.intersected(rect());
 	}
 	
-	// Start drawing
+	RenderConfig::Options options(RenderConfig::Screen | RenderConfig::HelperSymbols);
+	bool use_antialiasing = force_antialiasing || Settings::getInstance().getSettingCached(Settings::MapDisplay_Antialiasing).toBool();
+	if (!use_antialiasing)
+		options |= RenderConfig::DisableAntialiasing | RenderConfig::ForceMinSize;
+	
+	bool draw_overprinting = false;
+#ifndef Q_OS_ANDROID
+	draw_overprinting = view->isOverprintingSimulationEnabled();
+#endif
+	const bool draw_grid = view->isGridVisible();
+	const double zoom_factor = view->calculateFinalZoomFactor();
+	map_tile_cache.setParameters({ map->revision(), view->getRotation(), options, draw_overprinting, draw_grid, use_background });
+	
+	// Tiles are aligned to the view's transformation without integer translation,
+	// so that they can be reused after panning and zooming. The subpixel part
+	// of the translation is rendered into the tiles, so that the map stays
+	// aligned with templates and overlays which use the full transformation.
+	const QTransform& world_transform = view->worldTransform();
+	const QPointF offset(world_transform.dx() + width() / 2.0, world_transform.dy() + height() / 2.0);
+	const QPoint tile_offset(int(std::floor(offset.x())), int(std::floor(offset.y())));
+	const QTransform tile_transform(world_transform.m11(), world_transform.m12(), world_transform.m21(), world_transform.m22(),
+	                                offset.x() - tile_offset.x(), offset.y() - tile_offset.y());
+	const QTransform tile_to_map = tile_transform.inverted();
+	
+	// Fill with background color (TODO: make configurable)
+	// Tiles which are not yet rendered will show this color.
+	auto const background = use_background ? Qt::white : Qt::transparent;
+	const QRect dirty_rect = map_cache_dirty_rect;
 	QPainter painter;
 	painter.begin(&map_cache);
-	painter.setClipRect(map_cache_dirty_rect);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.setClipRect(dirty_rect);
+	painter.fillRect(dirty_rect, background);
 	
-	// Fill with background color (TODO: make configurable)
-	if (use_background)
-	{
-		painter.fillRect(map_cache_dirty_rect, Qt::white);
-	}
-	else
+	// Draw the cached tiles, and collect the missing ones.
+	std::vector<MapCacheTile> tiles;
+	const QRect range = MapTileCache::tileRange(dirty_rect.translated(-tile_offset));
+	for (int y = range.top(); y <= range.bottom(); ++y)
 	{
-		QPainter::CompositionMode mode = painter.compositionMode();
-		painter.setCompositionMode(QPainter::CompositionMode_Clear);
-		painter.fillRect(map_cache_dirty_rect, Qt::transparent);
-		painter.setCompositionMode(mode);
+		for (int x = range.left(); x <= range.right(); ++x)
+		{
+			const QPoint index(x, y);
+			if (auto cached_tile = map_tile_cache.find(zoom_factor, tile_transform, index))
+				painter.drawImage(MapTileCache::tileRect(index).topLeft() + tile_offset, *cached_tile);
+			else
+				tiles.push_back({ index, {} });
+		}
 	}
 	
-	RenderConfig::Options options(RenderConfig::Screen | RenderConfig::HelperSymbols);
-	bool use_antialiasing = force_antialiasing || Settings::getInstance().getSettingCached(Settings::MapDisplay_Antialiasing).toBool();
-	if (use_antialiasing)
-		painter.setRenderHint(QPainter::Antialiasing);
-	else
-		options |= RenderConfig::DisableAntialiasing | RenderConfig::ForceMinSize;
+	auto const render_tile = [&](MapCacheTile& tile) {
+		const QRect tile_rect = MapTileCache::tileRect(tile.index);
+		tile.image = QImage(tile_rect.size(), QImage::Format_ARGB32_Premultiplied);
+		tile.image.fill(background);
 		
-	Map* map = view->getMap();
-	QRectF map_view_rect = view->calculateViewedRect(viewportToView(map_cache_dirty_rect));
-
-	RenderConfig config = { *map, map_view_rect, view->calculateFinalZoomFactor(), options, 1.0 };
+		QPainter tile_painter(&tile.image);
+		if (use_antialiasing)
+			tile_painter.setRenderHint(QPainter::Antialiasing);
+		tile_painter.setWorldTransform(tile_transform * QTransform::fromTranslate(-tile_rect.left(), -tile_rect.top()));
+		
+		QRectF map_view_rect = tile_to_map.mapRect(QRectF(tile_rect)).adjusted(-0.001, -0.001, +0.001, +0.001);
+		RenderConfig config = { *map, map_view_rect, zoom_factor, options, 1.0 };
+		// Objects were updated above. Workers must not modify the map.
+		if (draw_overprinting)
+			map->drawOverprintingSimulationWithoutUpdate(&tile_painter, config);
+		else
+			map->drawWithoutUpdate(&tile_painter, config);
+		
+		if (draw_grid)
+			map->drawGrid(&tile_painter, map_view_rect, true);
+	};
 	
-	painter.translate(width() / 2.0, height() / 2.0);
-	painter.setWorldTransform(view->worldTransform(), true);
-#ifndef Q_OS_ANDROID
-	if (view->isOverprintingSimulationEnabled())
-		map->drawOverprintingSimulation(&painter, config);
-	else
-#endif
-		map->draw(&painter, config);
+	QElapsedTimer timer;
+	timer.start();
 	
-	if (view->isGridVisible())
-		map->drawGrid(&painter, map_view_rect, true);
+	// Render the missing tiles in batches, with at least one tile per thread.
+	const auto batch_size = std::max(1, QThread::idealThreadCount());
+	for (auto tile = begin(tiles); tile != end(tiles); )
+	{
+		auto const batch_end = tile + std::min(std::ptrdiff_t(batch_size), std::distance(tile, end(tiles)));
+		QtConcurrent::blockingMap(tile, batch_end, render_tile);
+		for (; tile != batch_end; ++tile)
+		{
+			painter.drawImage(MapTileCache::tileRect(tile->index).topLeft() + tile_offset, tile->image);
+			map_tile_cache.insert(zoom_factor, tile_transform, tile->index, tile->image);
+		}
+		
+		if (tile != end(tiles) && timer.elapsed() > map_cache_time_budget)
+		{
+			// Show the progress, and continue with the remaining tiles later.
+			QRect remaining_rect;
+			for (; tile != end(tiles); ++tile)
+				rectIncludeSafe(remaining_rect, MapTileCache::tileRect(tile->index).translated(tile_offset));
+			painter.end();
+			map_cache_dirty_rect = remaining_rect.intersected(dirty_rect);
+			QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+			return;
+		}
+	}
 	
 	// Finish drawing
 	painter.end();
@@ -43,6 +43,7 @@
 
 #include "core/map_coord.h"
 #include "core/map_view.h"
+#include "gui/map/map_tile_cache.h"
 
 class QContextMenuEvent;
 class QEvent;
@@ -408,6 +409,12 @@ private:
 	void updateTemplateCache(QImage& cache, QRect& dirty_rect, int first_template, int last_template, bool use_background);
 	/**
 	 * Redraws the map cache in the map cache dirty rect.
+	 * 
+	 * The dirty rect is covered by tiles from the map tile cache. Missing
+	 * tiles are rendered concurrently and added to the cache. When this
+	 * takes longer than a short time budget, the remaining tiles are left
+	 * dirty and another repaint is scheduled, so that the progress is shown.
+	 * 
 	 * @param use_background If set to true, fills the cache with white before
 	 *     drawing the map, else makes it transparent.
 	 */
@@ -506,6 +513,9 @@ private:
 	QImage map_cache;
 	QRect map_cache_dirty_rect;
 	
+	/** Rendered tiles of the map layer, for different zoom levels */
+	MapTileCache map_tile_cache;
+	
 	// Dirty regions for drawings (tools) and activities
 	/** Dirty rect for the current tool, in viewport coordinates (pixels). */
 	QRect drawing_dirty_rect;
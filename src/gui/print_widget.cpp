@@ -80,6 +80,7 @@
 #include <printer_properties.h>
 
 #include "core/georeferencing.h"
+#include "core/image_band_writer.h"
 #include "core/map.h"
 #include "core/map_coord.h"
 #include "core/map_printer.h"
@@ -1181,41 +1182,65 @@ void PrintWidget::exportToImage()
 		path.append(QString::fromLatin1(".png"));
 	}
 	
-	qreal pixel_per_mm = map_printer->getOptions().resolution / 25.4;
-	int print_width = qRound(map_printer->getPrintAreaPaperSize().width() * pixel_per_mm);
-	int print_height = qRound(map_printer->getPrintAreaPaperSize().height() * pixel_per_mm);
-	QImage image(print_width, print_height, QImage::Format_ARGB32_Premultiplied);
-	if (image.isNull())
+	int dots_per_meter = qRound(map_printer->getOptions().resolution / 0.0254);
+	if (ImageBandWriter::supportsFormat(path) && ImageBandWriter::isStreamingNeeded(map_printer->imageSize()))
 	{
-		QMessageBox::warning(this, tr("Error"), tr("Failed to prepare the image. Not enough memory."));
-		return;
-	}
-	
-	int dots_per_meter = qRound(pixel_per_mm * 1000);
-	image.setDotsPerMeterX(dots_per_meter);
-	image.setDotsPerMeterY(dots_per_meter);
-	
-#if 0  // Pointless unless drawPage drives the event loop and sends progress
-	PrintProgressDialog progress(map_printer, main_window);
-	progress.setWindowTitle(tr("Export map ..."));
-#endif
-	
-	// Export the map
-	QPainter p(&image);
-	map_printer->drawPage(&p, map_printer->getOptions().resolution, map_printer->getPrintArea(), true, &image);
-	p.end();
-	if (!image.save(path))
-	{
-		QMessageBox::warning(this, tr("Error"), tr("Failed to save the image. Does the path exist? Do you have sufficient rights?"));
+		// Render and write the image in bands, so that memory usage is bounded.
+		ImageBandWriter writer(path, map_printer->imageSize(), dots_per_meter);
+		if (!writer.open())
+		{
+			QMessageBox::warning(this, tr("Error"), tr("Failed to save the image. Does the path exist? Do you have sufficient rights?"));
+			return;
+		}
+		
+		bool canceled = false;
+		PrintProgressDialog progress(map_printer, main_window);
+		progress.setWindowTitle(tr("Export map ..."));
+		connect(&progress, &PrintProgressDialog::canceled, this, [&canceled]() { canceled = true; });
+		
+		if (!map_printer->drawBands([&writer](const QImage& band) { return writer.write(band); }))
+		{
+			if (!canceled && writer.errorString().isEmpty())
+				QMessageBox::warning(this, tr("Error"), tr("Failed to prepare the image. Not enough memory."));
+			else if (!canceled)
+				QMessageBox::warning(this, tr("Error"), tr("Failed to save the image. Does the path exist? Do you have sufficient rights?"));
+			return;
+		}
+		if (!writer.close())
+		{
+			QMessageBox::warning(this, tr("Error"), tr("Failed to save the image. Does the path exist? Do you have sufficient rights?"));
+			return;
+		}
 	}
 	else
 	{
-		main_window->showStatusBarMessage(tr("Exported successfully to %1").arg(path), 4000);
-		if (world_file_check->isChecked())
-			exportWorldFile(path);  /// \todo Handle errors
-		emit finished(0);
+		// Other formats and smaller images use the full image.
+		auto const size = map_printer->imageSize();
+		QImage image(size, QImage::Format_ARGB32_Premultiplied);
+		if (image.isNull())
+		{
+			QMessageBox::warning(this, tr("Error"), tr("Failed to prepare the image. Not enough memory."));
+			return;
+		}
+		
+		image.setDotsPerMeterX(dots_per_meter);
+		image.setDotsPerMeterY(dots_per_meter);
+		
+		// Export the map
+		QPainter p(&image);
+		map_printer->drawPage(&p, map_printer->getOptions().resolution, map_printer->getPrintArea(), true, &image);
+		p.end();
+		if (!image.save(path))
+		{
+			QMessageBox::warning(this, tr("Error"), tr("Failed to save the image. Does the path exist? Do you have sufficient rights?"));
+			return;
+		}
 	}
-	return;
+	
+	main_window->showStatusBarMessage(tr("Exported successfully to %1").arg(path), 4000);
+	if (world_file_check->isChecked())
+		exportWorldFile(path);  /// \todo Handle errors
+	emit finished(0);
 }
 
 void PrintWidget::exportWorldFile(const QString& path) const
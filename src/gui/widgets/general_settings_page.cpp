@@ -133,6 +133,9 @@ GeneralSettingsPage::GeneralSettingsPage(QWidget* parent)
 	connect(this, &QObject::destroyed, compatibility_check, &QObject::deleteLater);
 #endif
 	
+	compact_coordinates_check = new QCheckBox(tr("Save coordinates in compact format (requires Mapper %1)").arg(QLatin1String("0.9")));
+	layout->addRow(compact_coordinates_check);
+	
 	undo_check = new QCheckBox(tr("Save undo/redo history"));
 	layout->addRow(undo_check);
 	
@@ -233,6 +236,7 @@ void GeneralSettingsPage::apply()
 	setSetting(Settings::HomeScreen_TipsVisible, tips_visible_check->isChecked());
 	setSetting(Settings::General_NewOcd8Implementation, ocd_importer_check->isChecked());
 	setSetting(Settings::General_RetainCompatiblity, compatibility_check->isChecked());
+	setSetting(Settings::General_CompactCoordinates, compact_coordinates_check->isChecked());
 	setSetting(Settings::General_SaveUndoRedo, undo_check->isChecked());
 	setSetting(Settings::General_PixelsPerInch, ppi_edit->value());
 	
@@ -293,6 +297,7 @@ void GeneralSettingsPage::updateWidgets()
 	open_mru_check->setChecked(getSetting(Settings::General_OpenMRUFile).toBool());
 	tips_visible_check->setChecked(getSetting(Settings::HomeScreen_TipsVisible).toBool());
 	compatibility_check->setChecked(getSetting(Settings::General_RetainCompatiblity).toBool());
+	compact_coordinates_check->setChecked(getSetting(Settings::General_CompactCoordinates).toBool());
 	undo_check->setChecked(getSetting(Settings::General_SaveUndoRedo).toBool());
 	int autosave_interval = getSetting(Settings::General_AutosaveInterval).toInt();
 	autosave_check->setChecked(autosave_interval > 0);
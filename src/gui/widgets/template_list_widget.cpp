@@ -313,6 +313,7 @@ TemplateListWidget::TemplateListWidget(Map* map, MapView* main_view, MapEditorCo
 	//connect(more_button_menu, SIGNAL(triggered(QAction*)), this, SLOT(moreActionClicked(QAction*)));
 	
 	connect(main_view, &MapView::visibilityChanged, this, &TemplateListWidget::updateVisibility);
+	connect(map, &Map::templateChanged, this, &TemplateListWidget::templateChanged);
 	connect(controller, &MapEditorController::templatePositionDockWidgetClosed, this, &TemplateListWidget::templatePositionDockWidgetClosed);
 }
 
@@ -421,6 +422,13 @@ std::unique_ptr<Template> TemplateListWidget::showOpenTemplateDialog(QWidget* di
 		new_temp->setTemplatePosition(view_pos - offset);
 	}
 	
+	if (new_temp && !new_temp->errorString().isEmpty())
+	{
+		QMessageBox::warning(dialog_parent, tr("Warning"),
+		                     qApp->translate("OpenOrienteering::Importer", "Warnings when loading template '%1':\n%2")
+		                     .arg(new_temp->getTemplateFilename(), new_temp->errorString()) );
+	}
+	
 	return new_temp;
 }
 
@@ -701,7 +709,8 @@ void TemplateListWidget::cellChange(int row, int column)
 						if (state != Template::Loaded)
 						{
 							QToolTip::hideText();
-							if (temp->getTemplateState() != Template::Loaded)
+							auto const new_state = temp->getTemplateState();
+							if (new_state != Template::Loaded && new_state != Template::Loading)
 							{
 								QMessageBox::warning(this,
 								                     qApp->translate("OpenOrienteering::MainWindow", "Error"),
@@ -1066,6 +1075,13 @@ void TemplateListWidget::templateAdded(int pos, const Template* temp)
 	template_table->setCurrentCell(row, 0);
 }
 
+void TemplateListWidget::templateChanged(int pos, const Template* temp)
+{
+	Q_UNUSED(temp);
+	updateRow(rowFromPos(pos));
+	updateButtons();
+}
+
 void TemplateListWidget::templatePositionDockWidgetClosed(Template* temp)
 {
 	auto current_temp = getCurrentTemplate();
@@ -1141,6 +1157,7 @@ void TemplateListWidget::updateRow(int row)
 	QString name;
 	QString path;
 	bool valid = true;
+	bool loading = false;
 	
 	TemplateVisibility vis;
 	
@@ -1158,6 +1175,7 @@ void TemplateListWidget::updateRow(int row)
 		name = temp->getTemplateFilename();
 		path = temp->getTemplatePath();
 		valid = temp->getTemplateState() != Template::Invalid;
+		loading = temp->getTemplateState() == Template::Loading;
 		/// @todo Get visibility values from the MapView of the active MapWidget (instead of always main_view)
 		vis = main_view->getTemplateVisibility(temp);
 	}
@@ -1205,6 +1223,15 @@ void TemplateListWidget::updateRow(int row)
 			text_color = QPalette().color(QPalette::Disabled, QPalette::Foreground);
 		}
 		decoration = QVariant{ opacity_color };
+		
+		if (loading)
+		{
+			// Placeholder until the template file is loaded
+			check_state    = Qt::PartiallyChecked;
+			text_color     = QPalette().color(QPalette::Disabled, QPalette::Foreground);
+			editable       = Qt::NoItemFlags;
+			group_editable = Qt::NoItemFlags;
+		}
 	}
 	else
 	{
@@ -105,6 +105,7 @@ protected slots:
 	void moreActionClicked(QAction* action);
 	
 	void templateAdded(int pos, const Template* temp);
+	void templateChanged(int pos, const Template* temp);
 	void templatePositionDockWidgetClosed(Template* temp);
 	
 	void changeTemplateFile(int pos);
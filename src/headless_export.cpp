@@ -0,0 +1,507 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "headless_export.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QLatin1Char>
+#include <QLatin1String>
+#include <QObject>
+#include <QProcess>
+#include <QSaveFile>
+
+#ifdef QT_PRINTSUPPORT_LIB
+#  include <QFile>
+#  include <QImage>
+#  include <QPainter>
+#  include <QPrinter>
+#endif
+
+#include <mapper_config.h>
+
+#include "core/map.h"
+#include "core/map_view.h"
+#include "fileformats/file_format.h"
+#include "fileformats/file_format_registry.h"
+#include "fileformats/file_import_export.h"
+
+#ifdef QT_PRINTSUPPORT_LIB
+#  include "core/image_band_writer.h"
+#  include "core/map_printer.h"
+#  include "core/web_tile_exporter.h"
+#endif
+
+
+namespace OpenOrienteering {
+
+namespace {
+
+/**
+ * Returns the first map file format which can export files with the given extension.
+ */
+const FileFormat* findExportFormat(const QString& extension)
+{
+	for (auto format : FileFormats.formats())
+	{
+		if (format->supportsExport() && format->fileExtensions().contains(extension, Qt::CaseInsensitive))
+			return format;
+	}
+	return nullptr;
+}
+
+
+}  // namespace
+
+
+
+HeadlessExport::HeadlessExport()
+: err(stderr)
+{
+	// nothing else
+}
+
+HeadlessExport::~HeadlessExport() = default;
+
+
+// static
+bool HeadlessExport::isRequested(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (qstrcmp(argv[i], "--") == 0)
+			break;
+		if (qstrcmp(argv[i], "--export") == 0)
+			return true;
+	}
+	return false;
+}
+
+
+int HeadlessExport::run(const QStringList& arguments)
+{
+	QCommandLineParser parser;
+	parser.setApplicationDescription(tr("Exports or converts map files without user interaction."));
+	auto const help_option = parser.addHelpOption();
+	
+	QCommandLineOption export_option(QString::fromLatin1("export"),
+	                                 tr("Run the headless export."));
+	QCommandLineOption format_option({ QString::fromLatin1("f"), QString::fromLatin1("format") },
+	                                 tr("The output format: pdf, png, tif, bmp, jpg, xyz (a directory of web map tiles), "
+	                                    "mbtiles, or the extension of a map file format."),
+	                                 tr("format"), QString::fromLatin1("pdf"));
+	QCommandLineOption output_option({ QString::fromLatin1("o"), QString::fromLatin1("output") },
+	                                 tr("The output file, or the output directory for multiple input files. "
+	                                    "By default, the output is written next to the input file."),
+	                                 tr("path"));
+	QCommandLineOption resolution_option({ QString::fromLatin1("r"), QString::fromLatin1("resolution") },
+	                                     tr("The resolution in dpi, instead of the map's print configuration."),
+	                                     tr("dpi"));
+	QCommandLineOption zoom_option({ QString::fromLatin1("z"), QString::fromLatin1("zoom") },
+	                               tr("The range of zoom levels for web map tiles, e.g. 12-17."),
+	                               tr("min-max"));
+	QCommandLineOption jobs_option({ QString::fromLatin1("j"), QString::fromLatin1("jobs") },
+	                               tr("The number of files which are processed at the same time. "
+	                                  "Each file is already rendered by multiple threads."),
+	                               tr("n"), QString::fromLatin1("1"));
+	parser.addOptions({ export_option, format_option, output_option, resolution_option, zoom_option, jobs_option });
+	parser.addPositionalArgument(QString::fromLatin1("files"), tr("The map files to be exported."), tr("files..."));
+	if (!parser.parse(arguments))
+	{
+		err << parser.errorText() << endl;
+		return InvalidArguments;
+	}
+	if (parser.isSet(help_option))
+	{
+		QTextStream(stdout) << parser.helpText();
+		return Success;
+	}
+	
+	format = parser.value(format_option).toLower();
+	if (!isPrintFormat() && !isTileFormat() && !findExportFormat(format))
+	{
+		err << tr("Unsupported output format: %1").arg(format) << endl;
+		return InvalidArguments;
+	}
+	
+	if (parser.isSet(resolution_option))
+	{
+		auto ok = false;
+		resolution = parser.value(resolution_option).toInt(&ok);
+		if (!ok || resolution <= 0)
+		{
+			err << tr("Invalid resolution: %1").arg(parser.value(resolution_option)) << endl;
+			return InvalidArguments;
+		}
+	}
+	
+	if (parser.isSet(zoom_option))
+	{
+		auto const range = parser.value(zoom_option).split(QLatin1Char('-'));
+		auto ok = range.size() <= 2;
+		if (ok)
+			min_zoom = max_zoom = range.front().toInt(&ok);
+		if (ok && range.size() == 2)
+			max_zoom = range.back().toInt(&ok);
+		if (!ok || min_zoom < 0 || max_zoom < min_zoom)
+		{
+			err << tr("Invalid zoom range: %1").arg(parser.value(zoom_option)) << endl;
+			return InvalidArguments;
+		}
+	}
+	
+	auto ok = false;
+	auto jobs = parser.value(jobs_option).toInt(&ok);
+	if (!ok || jobs <= 0)
+	{
+		err << tr("Invalid number of jobs: %1").arg(parser.value(jobs_option)) << endl;
+		return InvalidArguments;
+	}
+	
+	auto const inputs = parser.positionalArguments();
+	if (inputs.isEmpty())
+	{
+		err << tr("No input files.") << endl;
+		return InvalidArguments;
+	}
+	
+	output = parser.value(output_option);
+	output_is_dir = !output.isEmpty() && (inputs.size() > 1 || QFileInfo(output).isDir());
+	if (output_is_dir && !QDir().mkpath(output))
+	{
+		err << tr("Cannot create the output directory %1").arg(output) << endl;
+		return ExportFailed;
+	}
+	
+	auto success = true;
+	if (jobs > 1 && inputs.size() > 1)
+	{
+		success = runWorkers(inputs, jobs);
+	}
+	else
+	{
+		for (auto const& input : inputs)
+			success = exportFile(input) && success;
+	}
+	return success ? Success : ExportFailed;
+}
+
+
+bool HeadlessExport::runWorkers(const QStringList& inputs, int jobs)
+{
+	auto const program = QCoreApplication::applicationFilePath();
+	auto success = true;
+	
+	// The loop is left whenever a worker finishes.
+	QEventLoop loop;
+	std::vector<std::unique_ptr<QProcess>> workers;
+	auto next = inputs.begin();
+	while (next != inputs.end() || !workers.empty())
+	{
+		for (; next != inputs.end() && int(workers.size()) < jobs; ++next)
+		{
+			auto worker = std::unique_ptr<QProcess>(new QProcess());
+			worker->setProcessChannelMode(QProcess::ForwardedChannels);
+			QObject::connect(worker.get(), static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+			                 &loop, &QEventLoop::quit);
+			worker->start(program, workerArguments(*next));
+			if (!worker->waitForStarted())
+			{
+				err << tr("Cannot start the export of %1: %2").arg(*next, worker->errorString()) << endl;
+				success = false;
+				continue;
+			}
+			workers.push_back(std::move(worker));
+		}
+		
+		// Workers may have finished while others were started.
+		auto is_running = [](const std::unique_ptr<QProcess>& worker) {
+			return worker->state() != QProcess::NotRunning;
+		};
+		if (!workers.empty() && std::all_of(begin(workers), end(workers), is_running))
+			loop.exec();
+		
+		for (auto it = begin(workers); it != end(workers); )
+		{
+			if (is_running(*it))
+			{
+				++it;
+				continue;
+			}
+			success = success && (*it)->exitStatus() == QProcess::NormalExit && (*it)->exitCode() == 0;
+			it = workers.erase(it);
+		}
+	}
+	
+	return success;
+}
+
+
+QStringList HeadlessExport::workerArguments(const QString& input) const
+{
+	auto arguments = QStringList {
+	    QString::fromLatin1("--export"),
+	    QString::fromLatin1("--jobs"), QString::fromLatin1("1"),
+	    QString::fromLatin1("--format"), format,
+	    QString::fromLatin1("--output"), outputPath(input)
+	};
+	if (resolution > 0)
+		arguments << QString::fromLatin1("--resolution") << QString::number(resolution);
+	if (min_zoom >= 0)
+		arguments << QString::fromLatin1("--zoom") << QString::number(min_zoom) + QLatin1Char('-') + QString::number(max_zoom);
+	arguments << QString::fromLatin1("--") << input;
+	return arguments;
+}
+
+
+QString HeadlessExport::outputPath(const QString& input) const
+{
+	auto const input_info = QFileInfo(input);
+	auto filename = input_info.completeBaseName();
+	if (format != QLatin1String("xyz"))
+		filename += QLatin1Char('.') + format;
+	if (output.isEmpty())
+		return input_info.dir().filePath(filename);
+	if (output_is_dir)
+		return QDir(output).filePath(filename);
+	return output;
+}
+
+
+bool HeadlessExport::isPrintFormat() const
+{
+#ifdef QT_PRINTSUPPORT_LIB
+	for (auto extension : { "pdf", "png", "tif", "tiff", "bmp", "jpg", "jpeg" })
+	{
+		if (format == QLatin1String(extension))
+			return true;
+	}
+#endif
+	return false;
+}
+
+
+bool HeadlessExport::isTileFormat() const
+{
+#ifdef QT_PRINTSUPPORT_LIB
+	return format == QLatin1String("xyz") || format == QLatin1String("mbtiles");
+#else
+	return false;
+#endif
+}
+
+
+bool HeadlessExport::needsTemplates(Map& map) const
+{
+#ifdef QT_PRINTSUPPORT_LIB
+	// Converted maps keep their template configuration without loading the files.
+	return (isPrintFormat() || isTileFormat()) && map.printerConfig().options.show_templates;
+#else
+	Q_UNUSED(map)
+	return false;
+#endif
+}
+
+
+bool HeadlessExport::exportFile(const QString& input)
+{
+	Map map;
+	MapView view{ &map };
+	
+	QString error_message;
+	auto importer = map.importFrom(input, &view, false, nullptr, error_message);
+	if (!importer)
+	{
+		err << error_message << endl;
+		return false;
+	}
+	if (needsTemplates(map))
+	{
+		// Template loading reports problems as warnings, without dialogs.
+		map.finishLoading(*importer, input, false);
+	}
+	for (auto const& warning : importer->warnings())
+		err << input << QLatin1String(": ") << warning << endl;
+	
+	auto const path = outputPath(input);
+	auto success = false;
+#ifdef QT_PRINTSUPPORT_LIB
+	if (format == QLatin1String("pdf"))
+		success = exportPdf(map, view, path);
+	else if (isPrintFormat())
+		success = exportImage(map, view, path);
+	else if (isTileFormat())
+		success = exportTiles(map, view, path);
+	else
+#endif
+		success = exportMap(map, view, path);
+	
+	if (success)
+		err << tr("Exported %1 to %2").arg(input, path) << endl;
+	return success;
+}
+
+
+#ifdef QT_PRINTSUPPORT_LIB
+
+bool HeadlessExport::exportPdf(Map& map, const MapView& view, const QString& path)
+{
+	MapPrinter map_printer(map, &view);
+	map_printer.setTarget(MapPrinter::pdfTarget());
+	map_printer.setResolution(resolution);
+	
+	auto printer = map_printer.makePrinter();
+	if (!printer)
+	{
+		err << tr("Failed to prepare the PDF export.") << endl;
+		return false;
+	}
+	
+	printer->setOutputFormat(QPrinter::PdfFormat);
+	printer->setCreator(APP_NAME);
+	printer->setDocName(QFileInfo(path).baseName());
+	printer->setOutputFileName(path);
+	if (!map_printer.printMap(printer.get()))
+	{
+		QFile(path).remove();
+		err << tr("Failed to finish the PDF export of %1").arg(path) << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+bool HeadlessExport::exportImage(Map& map, const MapView& view, const QString& path)
+{
+	MapPrinter map_printer(map, &view);
+	map_printer.setTarget(MapPrinter::imageTarget());
+	map_printer.setMode(MapPrinterOptions::Raster);
+	map_printer.setResolution(resolution);
+	
+	auto const dots_per_meter = qRound(map_printer.getOptions().resolution / 0.0254);
+	if (ImageBandWriter::supportsFormat(path) && ImageBandWriter::isStreamingNeeded(map_printer.imageSize()))
+	{
+		// Render and write the image in bands, so that memory usage is bounded.
+		ImageBandWriter writer(path, map_printer.imageSize(), dots_per_meter);
+		if (!writer.open()
+		    || !map_printer.drawBands([&writer](const QImage& band) { return writer.write(band); })
+		    || !writer.close())
+		{
+			auto error_string = writer.errorString();
+			if (error_string.isEmpty())
+				error_string = tr("Not enough memory.");
+			err << tr("Failed to save the image %1: %2").arg(path, error_string) << endl;
+			return false;
+		}
+		return true;
+	}
+	
+	// Other formats and smaller images use the full image.
+	QImage image(map_printer.imageSize(), QImage::Format_ARGB32_Premultiplied);
+	if (image.isNull())
+	{
+		err << tr("Failed to prepare the image %1: %2").arg(path, tr("Not enough memory.")) << endl;
+		return false;
+	}
+	
+	image.setDotsPerMeterX(dots_per_meter);
+	image.setDotsPerMeterY(dots_per_meter);
+	
+	QPainter p(&image);
+	map_printer.drawPage(&p, map_printer.getOptions().resolution, map_printer.getPrintArea(), true, &image);
+	p.end();
+	if (!image.save(path))
+	{
+		err << tr("Failed to save the image %1").arg(path) << endl;
+		return false;
+	}
+	
+	return true;
+}
+
+
+bool HeadlessExport::exportTiles(Map& map, const MapView& view, const QString& path)
+{
+	WebTileExporter exporter(map, &view);
+	if (min_zoom >= 0)
+		exporter.setZoomRange(min_zoom, max_zoom);
+	
+	auto const success = format == QLatin1String("mbtiles") ? exporter.exportToMBTiles(path)
+	                                                        : exporter.exportToDirectory(path);
+	if (!success)
+		err << tr("Failed to export the tiles of %1: %2").arg(path, exporter.errorString()) << endl;
+	return success;
+}
+
+#endif  // QT_PRINTSUPPORT_LIB
+
+
+bool HeadlessExport::exportMap(Map& map, MapView& view, const QString& path)
+{
+	// Like Map::exportTo(), but without message boxes.
+	auto const file_format = findExportFormat(format);
+	Q_ASSERT(file_format);
+	
+	QSaveFile file(path);
+	std::unique_ptr<Exporter> exporter(file_format->createExporter(&file, &map, &view));
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		err << tr("Cannot save file\n%1:\n%2").arg(path, file.errorString()) << endl;
+		return false;
+	}
+	
+	try
+	{
+		exporter->doExport();
+	}
+	catch (std::exception& e)
+	{
+		file.cancelWriting();
+		err << tr("Internal error while saving %1:\n%2").arg(path, QString::fromLocal8Bit(e.what())) << endl;
+		return false;
+	}
+	
+	if (!file.commit())
+	{
+		err << tr("Cannot save file\n%1:\n%2").arg(path, file.errorString()) << endl;
+		return false;
+	}
+	
+	for (auto const& warning : exporter->warnings())
+		err << path << QLatin1String(": ") << warning << endl;
+	return true;
+}
+
+
+}  // namespace OpenOrienteering
@@ -0,0 +1,145 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_HEADLESS_EXPORT_H
+#define OPENORIENTEERING_HEADLESS_EXPORT_H
+
+#include <QCoreApplication>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+namespace OpenOrienteering {
+
+class Map;
+class MapView;
+
+
+/**
+ * The command line mode for exporting and converting maps without GUI.
+ *
+ * This mode is selected by the --export option. Each of the given map files
+ * is loaded and written either as PDF, raster image or web map tiles, using
+ * the print configuration which is saved in the map, or in another map file
+ * format.
+ * Resolution and output location may be given on the command line.
+ *
+ * Several files are processed by concurrent worker processes. Each worker
+ * runs this program again with a single input file.
+ */
+class HeadlessExport
+{
+	Q_DECLARE_TR_FUNCTIONS(OpenOrienteering::HeadlessExport)
+
+public:
+	/**
+	 * The exit codes of the headless export.
+	 */
+	enum ExitCode
+	{
+		Success          = 0,  ///< All files were exported.
+		InvalidArguments = 1,  ///< The command line could not be processed.
+		ExportFailed     = 2,  ///< At least one file could not be loaded or exported.
+	};
+	
+	HeadlessExport();
+	
+	HeadlessExport(const HeadlessExport&) = delete;
+	~HeadlessExport();
+	
+	HeadlessExport& operator=(const HeadlessExport&) = delete;
+	
+	
+	/**
+	 * Returns true if the program arguments request the headless mode.
+	 *
+	 * This must be checked before the application object is created.
+	 */
+	static bool isRequested(int argc, char** argv);
+	
+	/**
+	 * Processes the given program arguments.
+	 *
+	 * Returns the exit code of the program, cf. ExitCode.
+	 */
+	int run(const QStringList& arguments);
+
+
+private:
+	/**
+	 * Runs a worker process for each input file, with at most jobs processes
+	 * at the same time.
+	 */
+	bool runWorkers(const QStringList& inputs, int jobs);
+	
+	/**
+	 * Returns the arguments for a worker process which exports a single file.
+	 */
+	QStringList workerArguments(const QString& input) const;
+	
+	/**
+	 * Returns the path of the file which is written for the given input.
+	 */
+	QString outputPath(const QString& input) const;
+	
+	/**
+	 * Returns true if the export needs the templates of the map.
+	 *
+	 * Templates are loaded only for printing them. Their loading must not
+	 * need any user interaction: problems are reported as warnings.
+	 */
+	bool needsTemplates(Map& map) const;
+	
+	bool exportFile(const QString& input);
+
+#ifdef QT_PRINTSUPPORT_LIB
+	bool exportPdf(Map& map, const MapView& view, const QString& path);
+	
+	bool exportImage(Map& map, const MapView& view, const QString& path);
+	
+	bool exportTiles(Map& map, const MapView& view, const QString& path);
+#endif
+
+	bool exportMap(Map& map, MapView& view, const QString& path);
+	
+	/**
+	 * Returns true if the format is handled by the map printer.
+	 */
+	bool isPrintFormat() const;
+	
+	/**
+	 * Returns true if the format is handled by the web tile exporter.
+	 */
+	bool isTileFormat() const;
+	
+	
+	QTextStream err;
+	QString format;
+	QString output;
+	bool output_is_dir = false;
+	int resolution = 0;
+	int min_zoom = -1;
+	int max_zoom = -1;
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif
@@ -46,6 +46,7 @@
 #endif
 
 #include "global.h"
+#include "headless_export.h"
 #include "mapper_resource.h"
 #include "gui/home_screen_controller.h"
 #include "gui/main_window.h"
@@ -99,6 +100,23 @@ void resetActivationWindow()
 
 int main(int argc, char** argv)
 {
+	if (HeadlessExport::isRequested(argc, argv))
+	{
+		// No windows, and no interaction with a running instance.
+		if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+		QApplication qapp(argc, argv);
+		Q_INIT_RESOURCE(resources);
+		QApplication::setOrganizationName(QString::fromLatin1("OpenOrienteering.org"));
+		QApplication::setApplicationName(QString::fromLatin1("Mapper"));
+		MapperResource::setSeachPaths();
+		setlocale(LC_NUMERIC, "C");
+		doStaticInitializations();
+		
+		HeadlessExport exporter;
+		return exporter.run(qapp.arguments());
+	}
+
 #if MAPPER_USE_QTSINGLEAPPLICATION
 	// Create single-instance application.
 	// Use "oo-mapper" instead of the executable as identifier, in case we launch from different paths.
@@ -21,10 +21,13 @@
 
 #include "gps_track.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
 #include <QApplication>
 #include <QFile>
-#include <QHash>
-#include <QMessageBox>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 // IWYU pragma: no_include <qxmlstream.h>
@@ -97,6 +100,9 @@ Track::Track(const Track& other)
 	
 	map_georef = other.map_georef;
 	
+	loading_area = other.loading_area;
+	loaded_area  = other.loaded_area;
+	
 	if (other.track_crs)
 	{
 		track_crs = new Georeferencing(*other.track_crs);
@@ -128,6 +134,9 @@ Track& Track::operator=(const Track& rhs)
 	
 	map_georef = rhs.map_georef;
 	
+	loading_area = rhs.loading_area;
+	loaded_area  = rhs.loaded_area;
+	
 	if (rhs.track_crs)
 	{
 		track_crs = new Georeferencing(*rhs.track_crs);
@@ -147,6 +156,7 @@ void Track::clear()
 	element_tags.clear();
 	delete track_crs;
 	track_crs = nullptr;
+	++point_revision;
 }
 
 bool Track::loadFrom(const QString& path, bool project_points, QWidget* dialog_parent)
@@ -156,6 +166,8 @@ bool Track::loadFrom(const QString& path, bool project_points, QWidget* dialog_p
 		return false;
 	
 	clear();
+	error_string.clear();
+	loaded_area = {};
 
 	if (path.endsWith(QLatin1String(".gpx"), Qt::CaseInsensitive))
 	{
@@ -171,6 +183,7 @@ bool Track::loadFrom(const QString& path, bool project_points, QWidget* dialog_p
 	{
 		if (!loadFromOSM(&file, project_points, dialog_parent))
 			return false;
+		loaded_area = loading_area;
 	}
 	else
 		return false;
@@ -227,6 +240,7 @@ void Track::appendTrackPoint(TrackPoint& point)
 {
 	point.map_coord = map_georef.toMapCoordF(point.gps_coord, nullptr); // TODO: check for errors
 	segment_points.push_back(point);
+	++point_revision;
 	
 	if (current_segment_finished)
 	{
@@ -361,8 +375,6 @@ bool Track::loadFromGPX(QFile* file, bool project_points, QWidget* dialog_parent
 			{
 				point = TrackPoint(LatLon(stream.attributes().value(QLatin1String("lat")).toDouble(),
 				                          stream.attributes().value(QLatin1String("lon")).toDouble()));
-				if (project_points)
-					point.map_coord = map_georef.toMapCoordF(point.gps_coord); // TODO: check for errors
 				point_name.clear();
 			}
 			else if (stream.name().compare(QLatin1String("trkseg"), Qt::CaseInsensitive) == 0
@@ -406,17 +418,22 @@ bool Track::loadFromGPX(QFile* file, bool project_points, QWidget* dialog_parent
 		segment_starts.pop_back();
 	}
 	
+	if (project_points)
+		projectPoints();
+	
 	return true;
 }
 
 bool Track::loadFromDXF(QFile* file, bool project_points, QWidget* dialog_parent)
 {
+	Q_UNUSED(dialog_parent);
+	
 	DXFParser* parser = new DXFParser();
 	parser->setData(file);
 	QString result = parser->parse();
 	if (!result.isEmpty())
 	{
-		QMessageBox::critical(dialog_parent, OpenOrienteering::TemplateTrack::tr("Error reading"), OpenOrienteering::TemplateTrack::tr("There was an error reading the DXF file %1:\n\n%2").arg(file->fileName(), result));
+		error_string = OpenOrienteering::TemplateTrack::tr("There was an error reading the DXF file %1:\n\n%2").arg(file->fileName(), result);
 		delete parser;
 		return false;
 	}
@@ -478,6 +495,8 @@ bool Track::loadFromDXF(QFile* file, bool project_points, QWidget* dialog_parent
 
 bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent)
 {
+	Q_UNUSED(dialog_parent);
+	
 	track_crs = new Georeferencing();
 	track_crs->setProjectedCRS({}, Georeferencing::geographic_crs_spec);
 	track_crs->setTransformationDirectly(QTransform());
@@ -486,15 +505,32 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 	// Reference: http://wiki.openstreetmap.org/wiki/OSM_XML
 	const double min_supported_version = 0.5;
 	const double max_supported_version = 0.6;
-	QHash<QString, TrackPoint> nodes;
 	int node_problems = 0;
 	
+	// The nodes are kept in a compact array, sorted by id.
+	// OSM files normally list the nodes in this order.
+	struct OsmNode
+	{
+		qint64 id;
+		LatLon coord;
+		float elevation;
+		bool inside;
+	};
+	std::vector<OsmNode> nodes;
+	bool nodes_sorted = true;
+	auto const compare_id = [](const OsmNode& node, qint64 id) { return node.id < id; };
+	
+	auto const inside = [this](const LatLon& coord) {
+		return loading_area.isNull()
+		       || loading_area.contains(coord.longitude(), coord.latitude());
+	};
+	
 	QXmlStreamReader xml(file);
 	if (xml.readNextStartElement())
 	{
 		if (xml.name() != QLatin1String("osm"))
 		{
-			QMessageBox::critical(dialog_parent, OpenOrienteering::TemplateTrack::tr("Error"), OpenOrienteering::TemplateTrack::tr("%1:\nNot an OSM file."));
+			error_string = OpenOrienteering::TemplateTrack::tr("%1:\nNot an OSM file.").arg(file->fileName());
 			return false;
 		}
 		else
@@ -503,16 +539,14 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 			const double osm_version = attributes.value(QLatin1String("version")).toDouble();
 			if (osm_version < min_supported_version)
 			{
-				QMessageBox::critical(dialog_parent, OpenOrienteering::TemplateTrack::tr("Error"),
-				                      OpenOrienteering::TemplateTrack::tr("The OSM file has version %1.\nThe minimum supported version is %2.").arg(
-				                          attributes.value(QLatin1String("version")).toString(), QString::number(min_supported_version, 'g', 1)));
+				error_string = OpenOrienteering::TemplateTrack::tr("The OSM file has version %1.\nThe minimum supported version is %2.").arg(
+				                   attributes.value(QLatin1String("version")).toString(), QString::number(min_supported_version, 'g', 1));
 				return false;
 			}
 			if (osm_version > max_supported_version)
 			{
-				QMessageBox::critical(dialog_parent, OpenOrienteering::TemplateTrack::tr("Error"),
-				                      OpenOrienteering::TemplateTrack::tr("The OSM file has version %1.\nThe maximum supported version is %2.").arg(
-				                          attributes.value(QLatin1String("version")).toString(), QString::number(max_supported_version, 'g', 1)));
+				error_string = OpenOrienteering::TemplateTrack::tr("The OSM file has version %1.\nThe maximum supported version is %2.").arg(
+				                   attributes.value(QLatin1String("version")).toString(), QString::number(max_supported_version, 'g', 1));
 				return false;
 			}
 		}
@@ -529,6 +563,8 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 			continue;
 		}
 		
+		bool has_numeric_id = false;
+		const qint64 numeric_id = attributes.value(QLatin1String("id")).toLongLong(&has_numeric_id);
 		QString id(attributes.value(QLatin1String("id")).toString());
 		if (id.isEmpty())
 		{
@@ -548,16 +584,17 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 				continue;
 			}
 			
-			TrackPoint point(LatLon(lat, lon));
-			if (project_points)
+			OsmNode node = { numeric_id, LatLon(lat, lon), -9999.0f, inside(LatLon(lat, lon)) };
+			if (has_numeric_id)
 			{
-				point.map_coord = map_georef.toMapCoordF(point.gps_coord); // TODO: check for errors
+				if (!nodes.empty() && nodes.back().id >= numeric_id)
+					nodes_sorted = false;
+				nodes.push_back(node);
 			}
-			nodes.insert(id, point);
 			
 			while (xml.readNextStartElement())
 			{
-				if (xml.name() == QLatin1String("tag"))
+				if (xml.name() == QLatin1String("tag") && node.inside)
 				{
 					const QString k(xml.attributes().value(QLatin1String("k")).toString());
 					const QString v(xml.attributes().value(QLatin1String("v")).toString());
@@ -567,13 +604,18 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 					{
 						bool ok;
 						double elevation = v.toDouble(&ok);
-						if (ok) nodes[id].elevation = elevation;
+						if (ok)
+						{
+							node.elevation = float(elevation);
+							if (has_numeric_id)
+								nodes.back().elevation = node.elevation;
+						}
 					}
 					else if (k == QLatin1String("name"))
 					{
-						if (!v.isEmpty() && !nodes.contains(v)) 
+						if (!v.isEmpty())
 						{
-							waypoints.push_back(point);
+							waypoints.push_back(TrackPoint(node.coord));
 							waypoint_names.push_back(v);
 						}
 					}
@@ -583,26 +625,64 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 		}
 		else if (name == QLatin1String("way"))
 		{
-			segment_starts.push_back(segment_points.size());
-			segment_names.push_back(id);
+			if (!nodes_sorted)
+			{
+				std::stable_sort(begin(nodes), end(nodes), [](const OsmNode& a, const OsmNode& b) { return a.id < b.id; });
+				nodes_sorted = true;
+			}
+			
+			// Ways are split where they leave the loading area. The nodes
+			// next to the area are kept, so that the border is crossed.
+			Tags tags;
+			const OsmNode* outside_node = nullptr;
+			bool segment_open = false;
+			auto const append_point = [this, &segment_open, &id](const OsmNode& node) {
+				if (!segment_open)
+				{
+					segment_starts.push_back(segment_points.size());
+					segment_names.push_back(id);
+					segment_open = true;
+				}
+				segment_points.push_back(TrackPoint(node.coord, {}, node.elevation));
+			};
+			
 			while (xml.readNextStartElement())
 			{
 				if (xml.name() == QLatin1String("nd"))
 				{
-					QString ref = xml.attributes().value(QLatin1String("ref")).toString();
-					if (ref.isEmpty() || !nodes.contains(ref))
+					bool ok;
+					const qint64 ref = xml.attributes().value(QLatin1String("ref")).toLongLong(&ok);
+					auto const node = ok ? std::lower_bound(begin(nodes), end(nodes), ref, compare_id) : end(nodes);
+					if (node == end(nodes) || node->id != ref)
+					{
 						node_problems++;
+					}
+					else if (node->inside)
+					{
+						if (outside_node)
+							append_point(*outside_node);
+						outside_node = nullptr;
+						append_point(*node);
+					}
 					else
-						segment_points.push_back(nodes[ref]);
+					{
+						if (segment_open)
+							append_point(*node);
+						segment_open = false;
+						outside_node = &*node;
+					}
 				}
 				else if (xml.name() == QLatin1String("tag"))
 				{
 					const QString k(xml.attributes().value(QLatin1String("k")).toString());
 					const QString v(xml.attributes().value(QLatin1String("v")).toString());
-					element_tags[id][k] = v;
+					tags[k] = v;
 				}
 				xml.skipCurrentElement();
 			}
+			
+			if (!tags.isEmpty() && !segment_names.empty() && segment_names.back() == id)
+				element_tags[id] = tags;
 		}
 		else
 		{
@@ -611,33 +691,47 @@ bool Track::loadFromOSM(QFile* file, bool project_points, QWidget* dialog_parent
 	}
 	
 	if (node_problems > 0)
-		QMessageBox::warning(dialog_parent, OpenOrienteering::TemplateTrack::tr("Problems"), OpenOrienteering::TemplateTrack::tr("%1 nodes could not be processed correctly.").arg(node_problems));
+		error_string = OpenOrienteering::TemplateTrack::tr("%1 nodes could not be processed correctly.").arg(node_problems);
+	
+	if (project_points)
+		projectPoints();
 	
 	return true;
 }
 
 void Track::projectPoints()
 {
+	++point_revision;
+	
+	// Transform all points in a single batch.
+	auto const num_waypoints = waypoints.size();
+	auto const size = num_waypoints + segment_points.size();
+	auto map_coords = std::vector<MapCoordF>(size);
 	if (track_crs->getProjectedCRSSpec() == Georeferencing::geographic_crs_spec)
 	{
-		int size = waypoints.size();
-		for (int i = 0; i < size; ++i)
-			waypoints[i].map_coord = map_georef.toMapCoordF(waypoints[i].gps_coord, nullptr); // FIXME: check for errors
-			
-		size = segment_points.size();
-		for (int i = 0; i < size; ++i)
-			segment_points[i].map_coord = map_georef.toMapCoordF(segment_points[i].gps_coord, nullptr); // FIXME: check for errors
+		auto gps_coords = std::vector<LatLon>();
+		gps_coords.reserve(size);
+		for (auto const& point : waypoints)
+			gps_coords.push_back(point.gps_coord);
+		for (auto const& point : segment_points)
+			gps_coords.push_back(point.gps_coord);
+		map_georef.toMapCoordF(gps_coords.data(), map_coords.data(), size); // FIXME: check for errors
 	}
 	else
 	{
-		int size = waypoints.size();
-		for (int i = 0; i < size; ++i)
-			waypoints[i].map_coord = map_georef.toMapCoordF(track_crs, fakeMapCoordF(waypoints[i].gps_coord), nullptr); // FIXME: check for errors
-			
-		size = segment_points.size();
-		for (int i = 0; i < size; ++i)
-			segment_points[i].map_coord = map_georef.toMapCoordF(track_crs, fakeMapCoordF(segment_points[i].gps_coord), nullptr); // FIXME: check for errors
+		auto track_coords = std::vector<MapCoordF>();
+		track_coords.reserve(size);
+		for (auto const& point : waypoints)
+			track_coords.push_back(fakeMapCoordF(point.gps_coord));
+		for (auto const& point : segment_points)
+			track_coords.push_back(fakeMapCoordF(point.gps_coord));
+		map_georef.toMapCoordF(track_crs, track_coords.data(), map_coords.data(), size); // FIXME: check for errors
 	}
+	
+	for (std::size_t i = 0; i < num_waypoints; ++i)
+		waypoints[i].map_coord = map_coords[i];
+	for (std::size_t i = num_waypoints; i < size; ++i)
+		segment_points[i - num_waypoints].map_coord = map_coords[i];
 }
 
 
@@ -23,8 +23,10 @@
 
 #include <vector>
 
+#include <QtGlobal>
 #include <QDateTime>
 #include <QHash>
+#include <QRectF>
 #include <QString>
 
 #include "core/georeferencing.h"
@@ -83,6 +85,32 @@ public:
 	/// Attempts to save the track to the given file
 	bool saveTo(const QString& path) const;
 	
+	/**
+	 * Restricts loading to an area given in geographic coordinates.
+	 * 
+	 * The rectangle's x and y denote longitude and latitude, in degrees.
+	 * When loading an OSM file, nodes outside this area are not imported,
+	 * and ways are split where they leave the area. A null rectangle
+	 * disables the restriction. This is the default.
+	 */
+	void setLoadingArea(const QRectF& area);
+	
+	/**
+	 * Returns the area to which the loaded data is restricted.
+	 * 
+	 * This is the loading area of the last call to loadFrom(), if the file
+	 * format supports it. A null rectangle means that the file was loaded
+	 * completely.
+	 */
+	QRectF loadedArea() const;
+	
+	/**
+	 * Returns a description of the problems found by the last call to loadFrom().
+	 * 
+	 * The string is empty if there were no problems.
+	 */
+	QString errorString() const;
+	
 	// Modifiers
 	
 	/**
@@ -130,6 +158,14 @@ public:
 	/// Averages all track coordinates
 	LatLon calcAveragePosition() const;
 	
+	/**
+	 * Returns a number which changes whenever the points or their map
+	 * coordinates are modified.
+	 * 
+	 * This can be used to validate data derived from the track.
+	 */
+	quint64 revision() const { return point_revision; }
+	
 	/** A collection of key:value tags. Cf. Object::Tags. */
 	typedef QHash<QString, QString> Tags;
 	
@@ -165,11 +201,35 @@ private:
 	
 	Georeferencing* track_crs;
 	Georeferencing map_georef;
+	
+	QRectF loading_area;
+	QRectF loaded_area;
+	QString error_string;
+	
+	quint64 point_revision = 0;
 };
 
 
 // ### Track inline code ###
 
+inline
+void Track::setLoadingArea(const QRectF& area)
+{
+	loading_area = area;
+}
+
+inline
+QRectF Track::loadedArea() const
+{
+	return loaded_area;
+}
+
+inline
+QString Track::errorString() const
+{
+	return error_string;
+}
+
 inline
 const Track::ElementTags& Track::tags() const
 {
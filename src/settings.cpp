@@ -125,11 +125,14 @@ Settings::Settings()
 	registerSetting(RectangleTool_PreviewLineWidth, "RectangleTool/preview_line_with", true);
 	
 	registerSetting(Templates_KeepSettingsOfClosed, "Templates/keep_settings_of_closed_templates", true);
+	registerSetting(Templates_ImageCacheSizeMB, "Templates/image_cache_size_mb", 256);
+	registerSetting(Templates_PersistImageTiles, "Templates/persist_image_tiles", false);
 	
 	registerSetting(ActionGridBar_ButtonSizeMM, "ActionGridBar/button_size_mm", touch_button_minimum_size_default);
 	registerSetting(SymbolWidget_IconSizeMM, "SymbolWidget/icon_size_mm", symbol_widget_icon_size_mm_default);
 	
 	registerSetting(General_RetainCompatiblity, "retainCompatiblity", false);
+	registerSetting(General_CompactCoordinates, "compactCoordinates", false);
 	registerSetting(General_SaveUndoRedo, "saveUndoRedo", true);
 	registerSetting(General_AutosaveInterval, "autosave", 15); // unit: minutes
 	registerSetting(General_Language, "language", QLocale::system().name().left(2));
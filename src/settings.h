@@ -56,9 +56,12 @@ public:
 		RectangleTool_HelperCrossRadiusMM,
 		RectangleTool_PreviewLineWidth,
 		Templates_KeepSettingsOfClosed,
+		Templates_ImageCacheSizeMB,
+		Templates_PersistImageTiles,
 		SymbolWidget_IconSizeMM,
 		ActionGridBar_ButtonSizeMM,
 		General_RetainCompatiblity,
+		General_CompactCoordinates,
 		General_SaveUndoRedo,
 		General_AutosaveInterval,
 		General_Language,
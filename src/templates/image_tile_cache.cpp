@@ -0,0 +1,234 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "image_tile_cache.h"
+
+#include <algorithm>
+
+#include <Qt>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QLatin1Char>
+#include <QLatin1String>
+#include <QMutexLocker>
+
+
+namespace OpenOrienteering {
+
+constexpr int ImageTileCache::tile_size;
+
+
+ImageTileCache::ImageTileCache(const QString& path, std::size_t memory_budget)
+: path(path)
+, memory_budget(memory_budget)
+{
+	QImageReader reader(path);
+	image_size = reader.size();
+	if (image_size.isEmpty())
+	{
+		error_string = reader.errorString();
+		return;
+	}
+	
+	num_levels = 1;
+	while (true)
+	{
+		auto const size = levelSize(num_levels - 1);
+		if (std::max(size.width(), size.height()) <= tile_size)
+			break;
+		++num_levels;
+	}
+}
+
+ImageTileCache::~ImageTileCache() = default;
+
+
+bool ImageTileCache::canDecodeTiles(const QString& path)
+{
+	// Without native support, QImageReader would decode the full image for each tile.
+	QImageReader reader(path);
+	return reader.supportsOption(QImageIOHandler::ClipRect)
+	       && reader.supportsOption(QImageIOHandler::ScaledSize);
+}
+
+
+QSize ImageTileCache::size() const
+{
+	return image_size;
+}
+
+
+int ImageTileCache::numLevels() const
+{
+	return num_levels;
+}
+
+
+QSize ImageTileCache::levelSize(int level) const
+{
+	if (image_size.isEmpty())
+		return {};
+	
+	// Rounding up, so that no pixels are lost at the right and bottom edge.
+	return { ((image_size.width() - 1) >> level) + 1, ((image_size.height() - 1) >> level) + 1 };
+}
+
+
+QRect ImageTileCache::tileRect(int level, QPoint index) const
+{
+	auto const level_rect = QRect(index * tile_size, QSize(tile_size, tile_size)).intersected(QRect(QPoint(0, 0), levelSize(level)));
+	if (level_rect.isEmpty())
+		return {};
+	
+	auto const left = level_rect.left() << level;
+	auto const top = level_rect.top() << level;
+	auto const right = std::min(image_size.width(), (level_rect.left() + level_rect.width()) << level);
+	auto const bottom = std::min(image_size.height(), (level_rect.top() + level_rect.height()) << level);
+	return { left, top, right - left, bottom - top };
+}
+
+
+QImage ImageTileCache::tile(int level, QPoint index)
+{
+	QMutexLocker locker(&mutex);
+	auto const key = tileKey(level, index);
+	auto const found = tiles.find(key);
+	if (found != tiles.end())
+	{
+		// Move to the front of the usage list
+		usage.splice(usage.begin(), usage, found->second.usage);
+		return found->second.image;
+	}
+	
+	auto image = decodeTile(level, index);
+	if (image.isNull())
+		return image;
+	
+	usage.push_front(key);
+	tiles.emplace(key, Tile{ image, usage.begin() });
+	memory_usage += byteSize(image);
+	
+	// Keep at least the new tile.
+	while (memory_usage > memory_budget && usage.size() > 1)
+	{
+		auto const oldest = tiles.find(usage.back());
+		memory_usage -= byteSize(oldest->second.image);
+		tiles.erase(oldest);
+		usage.pop_back();
+	}
+	
+	return image;
+}
+
+
+std::size_t ImageTileCache::memoryUsage() const
+{
+	QMutexLocker locker(&mutex);
+	return memory_usage;
+}
+
+
+void ImageTileCache::setPersistent(bool persistent)
+{
+	QMutexLocker locker(&mutex);
+	this->persistent = persistent;
+}
+
+
+QString ImageTileCache::persistentPath() const
+{
+	return path + QLatin1String(".tiles");
+}
+
+
+QString ImageTileCache::errorString() const
+{
+	QMutexLocker locker(&mutex);
+	return error_string;
+}
+
+
+ImageTileCache::TileKey ImageTileCache::tileKey(int level, QPoint index)
+{
+	return (TileKey(quint8(level)) << 56) | (TileKey(quint32(index.x()) & 0xfffffffu) << 28) | TileKey(quint32(index.y()) & 0xfffffffu);
+}
+
+
+std::size_t ImageTileCache::byteSize(const QImage& image)
+{
+	return std::size_t(image.bytesPerLine()) * std::size_t(image.height());
+}
+
+
+QImage ImageTileCache::decodeTile(int level, QPoint index)
+{
+	auto const source_rect = tileRect(level, index);
+	if (source_rect.isEmpty())
+		return {};
+	
+	auto const level_rect = QRect(index * tile_size, QSize(tile_size, tile_size)).intersected(QRect(QPoint(0, 0), levelSize(level)));
+	auto const tile_path = tilePath(level, index);
+	if (persistent)
+	{
+		// Stored tiles are used unless the image file has been modified later.
+		auto const tile_info = QFileInfo(tile_path);
+		if (tile_info.exists() && tile_info.lastModified() >= QFileInfo(path).lastModified())
+		{
+			auto image = QImage(tile_path);
+			if (image.size() == level_rect.size())
+				return image;
+		}
+	}
+	
+	QImageReader reader(path);
+	reader.setClipRect(source_rect);
+	if (level > 0)
+		reader.setScaledSize(level_rect.size());
+	auto image = reader.read();
+	if (image.isNull())
+	{
+		error_string = reader.errorString();
+		return image;
+	}
+	
+	if (persistent)
+	{
+		QDir().mkpath(QFileInfo(tile_path).path());
+		if (!image.save(tile_path, "PNG"))
+			QFile::remove(tile_path);
+	}
+	
+	return image;
+}
+
+
+QString ImageTileCache::tilePath(int level, QPoint index) const
+{
+	return persistentPath() + QLatin1Char('/') + QString::number(level)
+	       + QLatin1Char('/') + QString::number(index.x()) + QLatin1Char('_') + QString::number(index.y())
+	       + QLatin1String(".png");
+}
+
+
+}  // namespace OpenOrienteering
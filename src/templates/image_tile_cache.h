@@ -0,0 +1,170 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_IMAGE_TILE_CACHE_H
+#define OPENORIENTEERING_IMAGE_TILE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+#include <QtGlobal>
+#include <QImage>
+#include <QMutex>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+namespace OpenOrienteering {
+
+
+/**
+ * A cache of tiles of a raster image file, for multiple resolutions.
+ *
+ * The tiles are decoded from the file on demand, using the clip rect and
+ * scaled size options of QImageReader. Thus the full image is never held in
+ * memory. The resolutions form a pyramid: each level has half the width and
+ * height of the previous level, until the level fits into a single tile.
+ *
+ * The least recently used tiles are discarded when the size of the decoded
+ * tiles exceeds the memory budget.
+ *
+ * Optionally, the tiles of the pyramid are stored in a directory next to
+ * the image file, so that they don't need to be decoded again when the
+ * image is opened again.
+ *
+ * Templates are drawn from const functions, possibly from multiple threads,
+ * so access to the decoded tiles is serialized by a mutex.
+ */
+class ImageTileCache
+{
+public:
+	/// The width and height of the tiles, in pixels
+	static constexpr int tile_size = 512;
+	
+	/**
+	 * Constructs a cache for the given image file.
+	 *
+	 * @param path           The path of the image file.
+	 * @param memory_budget  The maximum number of bytes used by decoded tiles.
+	 */
+	ImageTileCache(const QString& path, std::size_t memory_budget);
+	
+	ImageTileCache(const ImageTileCache&) = delete;
+	~ImageTileCache();
+	
+	ImageTileCache& operator=(const ImageTileCache&) = delete;
+	
+	
+	/**
+	 * Returns true if the image file can be decoded in tiles.
+	 *
+	 * This requires an image format which natively supports reading
+	 * a part of the image.
+	 */
+	static bool canDecodeTiles(const QString& path);
+	
+	
+	/**
+	 * Returns the size of the image at full resolution.
+	 *
+	 * The size is empty if the file cannot be read.
+	 */
+	QSize size() const;
+	
+	/**
+	 * Returns the number of levels of the pyramid.
+	 */
+	int numLevels() const;
+	
+	/**
+	 * Returns the size of the image at the given level.
+	 */
+	QSize levelSize(int level) const;
+	
+	/**
+	 * Returns the area of the full resolution image which is covered by a tile.
+	 */
+	QRect tileRect(int level, QPoint index) const;
+	
+	/**
+	 * Returns the tile at the given level and index, decoding it if necessary.
+	 *
+	 * Returns a null image if the tile cannot be decoded.
+	 */
+	QImage tile(int level, QPoint index);
+	
+	
+	/**
+	 * Returns the number of bytes used by the decoded tiles.
+	 */
+	std::size_t memoryUsage() const;
+	
+	/**
+	 * Sets whether decoded tiles are stored next to the image file.
+	 */
+	void setPersistent(bool persistent);
+	
+	/**
+	 * Returns the directory where decoded tiles are stored.
+	 */
+	QString persistentPath() const;
+	
+	/**
+	 * Returns the error string of the last failed operation.
+	 */
+	QString errorString() const;
+
+
+private:
+	using TileKey = quint64;
+	using Usage = std::list<TileKey>;
+	
+	struct Tile
+	{
+		QImage image;
+		Usage::iterator usage;
+	};
+	
+	static TileKey tileKey(int level, QPoint index);
+	
+	static std::size_t byteSize(const QImage& image);
+	
+	QImage decodeTile(int level, QPoint index);
+	
+	QString tilePath(int level, QPoint index) const;
+	
+	QString path;
+	QString error_string;
+	QSize image_size;
+	int num_levels = 0;
+	std::unordered_map<TileKey, Tile> tiles;
+	Usage usage;  ///< Tiles in the order of use, most recent first
+	std::size_t memory_budget;
+	std::size_t memory_usage = 0;
+	bool persistent = false;
+	mutable QMutex mutex;  ///< Protects the tiles, the usage and the error string
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif
@@ -22,16 +22,20 @@
 #include "template.h"
 
 #include <cmath>
+#include <exception>
 #include <new>
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QFileInfo>
+#include <QFuture>
+#include <QFutureWatcher>
 #include <QMessageBox>
 #include <QPainter>
 #include <QScopedValueRollback>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
+#include <QtConcurrentRun>
 
 #include "core/map_view.h"
 #include "core/map.h"
@@ -205,7 +209,7 @@ Template* Template::duplicate() const
 	copy->template_path = template_path;
 	copy->template_relative_path = template_relative_path;
 	copy->template_file = template_file;
-	copy->template_state = template_state;
+	copy->template_state = (template_state == Loading) ? Unloaded : template_state;
 	copy->is_georeferenced = is_georeferenced;
 	
 	// Prevent saving the changes twice (if has_unsaved_changes == true)
@@ -599,14 +603,86 @@ bool Template::loadTemplateFile(bool configuring)
 	const State old_state = template_state;
 	
 	setErrorString(QString());
-	try
+	if (!QFileInfo::exists(template_path))
+	{
+		template_state = Invalid;
+		setErrorString(tr("No such file."));
+		if (old_state != template_state)
+			emit templateStateChanged();
+		return false;
+	}
+	
+	return finishLoading(old_state, [this, configuring]() {
+		return loadTemplateFileImpl(configuring);
+	});
+}
+
+void Template::loadTemplateFileAsync()
+{
+	Q_ASSERT(template_state != Loaded);
+	Q_ASSERT(template_state != Loading);
+	
+	auto read_file = QFileInfo::exists(template_path) ? templateFileReader() : ReadFileFunction{};
+	if (!read_file)
 	{
-		if (!QFileInfo::exists(template_path))
+		loadTemplateFile(false);
+		return;
+	}
+	
+	setErrorString(QString());
+	template_state = Loading;
+	emit templateStateChanged();
+	
+	// The watcher is destroyed with the template, dropping the result.
+	auto* watcher = new QFutureWatcher<FinishLoadingFunction>(this);
+	connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]() {
+		auto finish = watcher->result();
+		watcher->deleteLater();
+		
+		// loadTemplateFile() may have been called in the meantime.
+		if (template_state != Loading)
+			return;
+		
+		auto const loaded = finishLoading(Loading, finish);
+		for (int i = 0; i < map->getNumTemplates(); ++i)
 		{
-			template_state = Invalid;
-			setErrorString(tr("No such file."));
+			if (map->getTemplate(i) == this)
+			{
+				if (loaded)
+					map->setTemplateAreaDirty(i);
+				map->emitTemplateChanged(this);
+				return;
+			}
+		}
+		
+		// The template was closed while loading.
+		if (loaded)
+			unloadTemplateFile();
+	});
+	watcher->setFuture(QtConcurrent::run([read_file]() -> FinishLoadingFunction {
+		try
+		{
+			return read_file();
+		}
+		catch (...)
+		{
+			// Rethrown by finishLoading() on the template's thread
+			auto exception = std::current_exception();
+			return [exception]() -> bool { std::rethrow_exception(exception); };
 		}
-		else if (loadTemplateFileImpl(configuring))
+	}));
+}
+
+Template::ReadFileFunction Template::templateFileReader()
+{
+	return {};
+}
+
+bool Template::finishLoading(State old_state, const FinishLoadingFunction& load)
+{
+	try
+	{
+		if (load())
 		{
 			template_state = Loaded;
 		}
@@ -22,6 +22,7 @@
 #ifndef OPENORIENTEERING_TEMPLATE_H
 #define OPENORIENTEERING_TEMPLATE_H
 
+#include <functional>
 #include <memory>
 
 #include <QtGlobal>
@@ -127,7 +128,9 @@ public:
 		Unloaded,
 		/// A required resource cannot be found (e.g. missing image or font),
 		/// so the template is invalid
-		Invalid
+		Invalid,
+		/// The template file is being loaded on a worker thread
+		Loading
 	};
 	
 	/**
@@ -291,6 +294,22 @@ public:
 	 */
 	bool loadTemplateFile(bool configuring);
 	
+	/**
+	 * Loads the template file on a worker thread.
+	 * 
+	 * This function can be called if the template state is Invalid or Unloaded.
+	 * The state changes to Loading until the template file is read. Then the
+	 * state changes to Loaded or Invalid, templateStateChanged() is emitted,
+	 * and the area of the template is marked as dirty.
+	 * 
+	 * Template types which do not support reading on a worker thread are
+	 * loaded synchronously, as by loadTemplateFile(false).
+	 * 
+	 * Calling loadTemplateFile() while the template is loading supersedes
+	 * the asynchronous loading.
+	 */
+	void loadTemplateFileAsync();
+	
 	/**
 	 * Does configuration after the actual template is loaded.
 	 * 
@@ -605,6 +624,32 @@ protected:
 	 */
 	virtual bool loadTemplateFileImpl(bool configuring) = 0;
 	
+	/**
+	 * A function which completes loading on the template's thread.
+	 * 
+	 * It has the same semantics as loadTemplateFileImpl(false).
+	 */
+	using FinishLoadingFunction = std::function<bool ()>;
+	
+	/**
+	 * A function which reads the template file on a worker thread.
+	 * 
+	 * It must not access the template. It may throw the same exceptions as
+	 * loadTemplateFileImpl().
+	 */
+	using ReadFileFunction = std::function<FinishLoadingFunction ()>;
+	
+	/**
+	 * Hook for loading the template file on a worker thread.
+	 * 
+	 * This function is called on the template's thread. The returned function
+	 * must capture everything it needs from the template's configuration.
+	 * 
+	 * The default implementation returns an empty function, indicating that
+	 * the template file must be loaded synchronously.
+	 */
+	virtual ReadFileFunction templateFileReader();
+	
 	/**
 	 * Hook for unloading the template file.
 	 */
@@ -654,6 +699,11 @@ protected:
 	bool is_georeferenced;
 	
 private:	
+	/**
+	 * Runs the given loading function, and updates the template state.
+	 */
+	bool finishLoading(State old_state, const FinishLoadingFunction& load);
+	
 	// Properties for non-georeferenced templates (invalid if is_georeferenced is true) 
 	
 	/// Bounds correction offset for map templates. Must be masked out when saving.
@@ -21,7 +21,12 @@
 
 #include "template_image.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <iterator>
+#include <memory>
+#include <utility>
 
 #include <Qt>
 #include <QtGlobal>
@@ -59,6 +64,8 @@
 #include "gui/georeferencing_dialog.h"
 #include "gui/select_crs_dialog.h"
 #include "gui/util_gui.h"
+#include "settings.h"
+#include "templates/image_tile_cache.h"
 #include "templates/world_file.h"
 #include "util/transformation.h"
 #include "util/util.h"
@@ -69,6 +76,30 @@
 
 namespace OpenOrienteering {
 
+namespace {
+
+/// The size of the source tiles which are drawn, in pixels
+constexpr int tile_size = 512;
+
+/// The minimum width and height of downsampled images, in pixels
+constexpr int min_downsampled_size = 16;
+
+/// The memory budget for decoded images, in bytes
+std::size_t imageCacheBudget()
+{
+	return std::size_t(Settings::getInstance().getSettingCached(Settings::Templates_ImageCacheSizeMB).toInt()) << 20;
+}
+
+/// Whether tiles of large images are stored next to the image file
+bool persistImageTiles()
+{
+	return Settings::getInstance().getSettingCached(Settings::Templates_PersistImageTiles).toBool();
+}
+
+}  // namespace
+
+
+
 const std::vector<QByteArray>& TemplateImage::supportedExtensions()
 {
 	static std::vector<QByteArray> extensions;
@@ -99,6 +130,9 @@ TemplateImage::~TemplateImage()
 
 bool TemplateImage::saveTemplateFile() const
 {
+	// Tiled images cannot be drawn onto, so there is nothing to save.
+	if (tile_cache)
+		return true;
 	return image.save(template_path);
 }
 
@@ -145,30 +179,79 @@ bool TemplateImage::loadTypeSpecificTemplateConfiguration(QXmlStreamReader& xml)
 
 bool TemplateImage::loadTemplateFileImpl(bool configuring)
 {
-	QImageReader reader(template_path);
+	return setImageFile(readImageFile(template_path, imageCacheBudget(), persistImageTiles()), configuring);
+}
+
+Template::ReadFileFunction TemplateImage::templateFileReader()
+{
+	auto const path = template_path;
+	auto const memory_budget = imageCacheBudget();
+	auto const persistent_tiles = persistImageTiles();
+	return [this, path, memory_budget, persistent_tiles]() -> FinishLoadingFunction {
+		auto file = std::make_shared<ImageFile>(readImageFile(path, memory_budget, persistent_tiles));
+		return [this, file]() { return setImageFile(std::move(*file), false); };
+	};
+}
+
+TemplateImage::ImageFile TemplateImage::readImageFile(const QString& path, std::size_t memory_budget, bool persistent_tiles)
+{
+	ImageFile file;
+	
+	QImageReader reader(path);
 	const QSize size = reader.size();
 	const QImage::Format format = reader.imageFormat();
-	if (size.isEmpty() || format == QImage::Format_Invalid)
+	if (!size.isEmpty() && std::size_t(size.width()) * std::size_t(size.height()) * 4 > memory_budget
+	    && ImageTileCache::canDecodeTiles(path))
+	{
+		// Decode tiles on demand instead of holding the full image in memory
+		file.tile_cache = std::make_unique<ImageTileCache>(path, memory_budget);
+		file.tile_cache->setPersistent(persistent_tiles);
+		if (file.tile_cache->size().isEmpty())
+		{
+			file.error_string = file.tile_cache->errorString();
+			file.tile_cache.reset();
+			return file;
+		}
+	}
+	else if (size.isEmpty() || format == QImage::Format_Invalid)
 	{
 		// Leave memory allocation to QImageReader
-		image = reader.read();
+		file.image = reader.read();
 	}
 	else
 	{
 		// Pre-allocate the memory in order to catch errors
-		image = QImage(size, format);
-		if (image.isNull())
+		file.image = QImage(size, format);
+		if (file.image.isNull())
 		{
-			setErrorString(tr("Not enough free memory (image size: %1x%2 pixels)").arg(size.width()).arg(size.height()));
-			return false;
+			file.error_string = tr("Not enough free memory (image size: %1x%2 pixels)").arg(size.width()).arg(size.height());
+			return file;
 		}
 		// Read into pre-allocated image
-		reader.read(&image);
+		reader.read(&file.image);
 	}
 	
-	if (image.isNull())
+	if (!file.tile_cache && file.image.isNull())
 	{
-		setErrorString(reader.errorString());
+		file.error_string = reader.errorString();
+		return file;
+	}
+	
+	WorldFile world_file;
+	file.has_world_file = world_file.tryToLoadForImage(path);
+	
+	return file;
+}
+
+bool TemplateImage::setImageFile(ImageFile&& file, bool configuring)
+{
+	image = std::move(file.image);
+	createDownsampledImages();
+	tile_cache = std::move(file.tile_cache);
+	image_size = tile_cache ? tile_cache->size() : image.size();
+	if (image_size.isEmpty())
+	{
+		setErrorString(file.error_string);
 		return false;
 	}
 	
@@ -177,8 +260,7 @@ bool TemplateImage::loadTemplateFileImpl(bool configuring)
 	
 	// TODO: GeoTIFF
 	
-	WorldFile world_file;
-	if (available_georef == Georeferencing_None && world_file.tryToLoadForImage(template_path))
+	if (available_georef == Georeferencing_None && file.has_world_file)
 		available_georef = Georeferencing_WorldFile;
 	
 	if (!configuring && is_georeferenced)
@@ -194,6 +276,7 @@ bool TemplateImage::loadTemplateFileImpl(bool configuring)
 	
 	return true;
 }
+
 bool TemplateImage::postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view)
 {
 	Q_UNUSED(out_center_in_view);
@@ -213,7 +296,7 @@ bool TemplateImage::postLoadConfiguration(QWidget* dialog_parent, bool& out_cent
 			// Make sure that the map is georeferenced;
 			// use the center coordinates of the image as initial reference point.
 			calculateGeoreferencing();
-			QPointF template_coords_center = georef->toProjectedCoords(MapCoordF(0.5 * (image.width() - 1), 0.5 * (image.height() - 1)));
+			QPointF template_coords_center = georef->toProjectedCoords(MapCoordF(0.5 * (image_size.width() - 1), 0.5 * (image_size.height() - 1)));
 			bool template_coords_probably_geographic =
 				template_coords_center.x() >= -90 && template_coords_center.x() <= 90 &&
 				template_coords_center.y() >= -90 && template_coords_center.y() <= 90;
@@ -270,27 +353,164 @@ bool TemplateImage::postLoadConfiguration(QWidget* dialog_parent, bool& out_cent
 void TemplateImage::unloadTemplateFileImpl()
 {
 	image = QImage();
+	downsampled_images.clear();
+	tile_cache.reset();
+	image_size = {};
 }
 
 void TemplateImage::drawTemplate(QPainter* painter, const QRectF& clip_rect, double scale, bool on_screen, float opacity) const
 {
-	Q_UNUSED(clip_rect);
 	Q_UNUSED(scale);
 	Q_UNUSED(on_screen);
 	
+	if (image_size.isEmpty())
+		return;
+	
 	applyTemplateTransform(painter);
 	
+	// The visible part of the image, in pixels
+	QRectF visible_rect;
+	rectIncludeSafe(visible_rect, mapToTemplate(MapCoordF(clip_rect.topLeft())));
+	rectIncludeSafe(visible_rect, mapToTemplate(MapCoordF(clip_rect.topRight())));
+	rectIncludeSafe(visible_rect, mapToTemplate(MapCoordF(clip_rect.bottomLeft())));
+	rectIncludeSafe(visible_rect, mapToTemplate(MapCoordF(clip_rect.bottomRight())));
+	visible_rect.translate(image_size.width() * 0.5, image_size.height() * 0.5);
+	
+	// The scale parameter doesn't account for the device resolution.
+	auto const device_scale = std::sqrt(std::abs(painter->worldTransform().determinant()));
+	if (tile_cache)
+	{
+		painter->setOpacity(opacity);
+		drawTiles(painter, visible_rect, device_scale);
+		return;
+	}
+	
+	int level;
+	auto const& level_image = imageForScale(device_scale, level);
+	auto const factor_x = qreal(image.width()) / level_image.width();
+	auto const factor_y = qreal(image.height()) / level_image.height();
+	
+	// The tiles of the level image which intersect the visible part,
+	// with an extra pixel for smooth transformation.
+	auto source_rect = QRectF(visible_rect.left() / factor_x, visible_rect.top() / factor_y,
+	                          visible_rect.width() / factor_x, visible_rect.height() / factor_y).toAlignedRect();
+	source_rect = source_rect.adjusted(-1, -1, 1, 1).intersected(level_image.rect());
+	if (source_rect.isEmpty())
+		return;
+	source_rect.setLeft(source_rect.left() / tile_size * tile_size);
+	source_rect.setTop(source_rect.top() / tile_size * tile_size);
+	source_rect.setRight(std::min(level_image.width(), (source_rect.right() / tile_size + 1) * tile_size) - 1);
+	source_rect.setBottom(std::min(level_image.height(), (source_rect.bottom() / tile_size + 1) * tile_size) - 1);
+	
+	auto const target_rect = QRectF(source_rect.left() * factor_x - image.width() * 0.5,
+	                                source_rect.top() * factor_y - image.height() * 0.5,
+	                                source_rect.width() * factor_x,
+	                                source_rect.height() * factor_y);
+	
 	painter->setRenderHint(QPainter::SmoothPixmapTransform);
 	painter->setOpacity(opacity);
-	painter->drawImage(QPointF(-image.width() * 0.5, -image.height() * 0.5), image);
+	painter->drawImage(target_rect, level_image, source_rect);
 	painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
 }
+
+void TemplateImage::drawTiles(QPainter* painter, const QRectF& visible_rect, qreal device_scale) const
+{
+	// Use a lower resolution level as long as its pixels are not larger than the device pixels.
+	int level = 0;
+	while (device_scale <= 0.5 && level + 1 < tile_cache->numLevels())
+	{
+		device_scale *= 2;
+		++level;
+	}
+	
+	// The range of tiles which intersect the visible part
+	auto const span = std::ldexp(qreal(ImageTileCache::tile_size), level);
+	auto const level_size = tile_cache->levelSize(level);
+	auto const first_x = std::max(0, int(std::floor(visible_rect.left() / span)));
+	auto const first_y = std::max(0, int(std::floor(visible_rect.top() / span)));
+	auto const last_x = std::min((level_size.width() - 1) / ImageTileCache::tile_size, int(std::floor(visible_rect.right() / span)));
+	auto const last_y = std::min((level_size.height() - 1) / ImageTileCache::tile_size, int(std::floor(visible_rect.bottom() / span)));
+	
+	auto const offset = QPointF(image_size.width() * 0.5, image_size.height() * 0.5);
+	painter->setRenderHint(QPainter::SmoothPixmapTransform);
+	// Antialiased edges would leave visible seams between the tiles.
+	painter->setRenderHint(QPainter::Antialiasing, false);
+	for (int y = first_y; y <= last_y; ++y)
+	{
+		for (int x = first_x; x <= last_x; ++x)
+		{
+			auto const tile = tile_cache->tile(level, { x, y });
+			if (!tile.isNull())
+				painter->drawImage(QRectF(tile_cache->tileRect(level, { x, y })).translated(-offset), tile);
+		}
+	}
+	painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+}
+
+std::unique_ptr<ImageTileCache> TemplateImage::createTileCache() const
+{
+	auto cache = std::make_unique<ImageTileCache>(template_path, imageCacheBudget());
+	cache->setPersistent(persistImageTiles());
+	return cache;
+}
+
+const QImage& TemplateImage::imageForScale(qreal device_scale, int& level) const
+{
+	// Use a smaller image as long as its pixels are not larger than the device pixels.
+	const QImage* result = &image;
+	level = 0;
+	while (device_scale <= 0.5 && std::size_t(level) < downsampled_images.size())
+	{
+		result = &downsampled_images[std::size_t(level)];
+		device_scale *= 2;
+		++level;
+	}
+	return *result;
+}
+
+void TemplateImage::createDownsampledImages()
+{
+	downsampled_images.clear();
+	const QImage* source = &image;
+	while (std::min(source->width(), source->height()) >= 2 * min_downsampled_size)
+	{
+		downsampled_images.push_back(source->scaled(source->width() / 2, source->height() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+		source = &downsampled_images.back();
+	}
+}
+
+void TemplateImage::updateDownsampledImages(const QRect& changed_rect)
+{
+	auto rect = changed_rect;
+	const QImage* source = &image;
+	for (auto& downsampled : downsampled_images)
+	{
+		// The pixels of the downsampled image which depend on the changed pixels
+		rect = QRect(QPoint(rect.left() / 2, rect.top() / 2), QPoint(rect.right() / 2, rect.bottom() / 2))
+		       .adjusted(-1, -1, 1, 1)
+		       .intersected(downsampled.rect());
+		if (rect.isEmpty())
+			break;
+		
+		auto const factor_x = qreal(source->width()) / downsampled.width();
+		auto const factor_y = qreal(source->height()) / downsampled.height();
+		auto const source_rect = QRectF(rect.left() * factor_x, rect.top() * factor_y,
+		                                rect.width() * factor_x, rect.height() * factor_y);
+		QPainter painter(&downsampled);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.setRenderHint(QPainter::SmoothPixmapTransform);
+		painter.drawImage(QRectF(rect), *source, source_rect);
+		painter.end();
+		
+		source = &downsampled;
+	}
+}
 QRectF TemplateImage::getTemplateExtent() const
 {
     // If the image is invalid, the extent is an empty rectangle.
-    if (image.isNull())
+    if (image_size.isEmpty())
 		return QRectF();
-	return QRectF(-image.width() * 0.5, -image.height() * 0.5, image.width(), image.height());
+	return QRectF(-image_size.width() * 0.5, -image_size.height() * 0.5, image_size.width(), image_size.height());
 }
 
 QPointF TemplateImage::calcCenterOfGravity(QRgb background_color)
@@ -330,6 +550,10 @@ Template* TemplateImage::duplicateImpl() const
 {
 	auto new_template = new TemplateImage(template_path, map);
 	new_template->image = image;
+	new_template->downsampled_images = downsampled_images;
+	if (tile_cache)
+		new_template->tile_cache = createTileCache();
+	new_template->image_size = image_size;
 	new_template->available_georef = available_georef;
 	return new_template;
 }
@@ -420,6 +644,11 @@ void TemplateImage::drawOntoTemplateImpl(MapCoordF* coords, int num_coords, QCol
 	
 	painter.end();
 	delete[] points;
+	
+	if (image.format() != undo_step.image.format())
+		createDownsampledImages();
+	else
+		updateDownsampledImages(radius_bbox);
 }
 
 void TemplateImage::drawOntoTemplateUndo(bool redo)
@@ -444,6 +673,8 @@ void TemplateImage::drawOntoTemplateUndo(bool redo)
 	QPainter painter(&image);
 	painter.setCompositionMode(QPainter::CompositionMode_Source);
 	painter.drawImage(step.x, step.y, undo_image);
+	painter.end();
+	updateDownsampledImages(QRect(step.x, step.y, undo_image.width(), undo_image.height()));
 	
 	undo_index += redo ? 1 : -1;
 	
@@ -521,13 +752,13 @@ void TemplateImage::updatePosFromGeoreferencing()
 		qDebug() << "updatePosFromGeoreferencing() failed";
 		return; // TODO: proper error message?
 	}
-	MapCoordF top_right = map->getGeoreferencing().toMapCoordF(georef.data(), MapCoordF(image.width() - 0.5, -0.5), &ok);
+	MapCoordF top_right = map->getGeoreferencing().toMapCoordF(georef.data(), MapCoordF(image_size.width() - 0.5, -0.5), &ok);
 	if (!ok)
 	{
 		qDebug() << "updatePosFromGeoreferencing() failed";
 		return; // TODO: proper error message?
 	}
-	MapCoordF bottom_left = map->getGeoreferencing().toMapCoordF(georef.data(), MapCoordF(-0.5, image.height() - 0.5), &ok);
+	MapCoordF bottom_left = map->getGeoreferencing().toMapCoordF(georef.data(), MapCoordF(-0.5, image_size.height() - 0.5), &ok);
 	if (!ok)
 	{
 		qDebug() << "updatePosFromGeoreferencing() failed";
@@ -538,13 +769,13 @@ void TemplateImage::updatePosFromGeoreferencing()
 	PassPointList pp_list;
 	
 	PassPoint pp;
-	pp.src_coords = MapCoordF(-0.5 * image.width(), -0.5 * image.height());
+	pp.src_coords = MapCoordF(-0.5 * image_size.width(), -0.5 * image_size.height());
 	pp.dest_coords = top_left;
 	pp_list.push_back(pp);
-	pp.src_coords = MapCoordF(0.5 * image.width(), -0.5 * image.height());
+	pp.src_coords = MapCoordF(0.5 * image_size.width(), -0.5 * image_size.height());
 	pp.dest_coords = top_right;
 	pp_list.push_back(pp);
-	pp.src_coords = MapCoordF(-0.5 * image.width(), 0.5 * image.height());
+	pp.src_coords = MapCoordF(-0.5 * image_size.width(), 0.5 * image_size.height());
 	pp.dest_coords = bottom_left;
 	pp_list.push_back(pp);
 	
@@ -567,8 +798,8 @@ TemplateImageOpenDialog::TemplateImageOpenDialog(TemplateImage* templ, QWidget*
 	setWindowTitle(tr("Opening %1").arg(templ->getTemplateFilename()));
 	
 	QLabel* size_label = new QLabel(QLatin1String("<b>") + tr("Image size:") + QLatin1String("</b> ")
-	                                + QString::number(templ->getImage().width()) + QLatin1String(" x ")
-	                                + QString::number(templ->getImage().height()));
+	                                + QString::number(templ->getImageSize().width()) + QLatin1String(" x ")
+	                                + QString::number(templ->getImageSize().height()));
 	QLabel* desc_label = new QLabel(tr("Specify how to position or scale the image:"));
 	
 	bool use_meters_per_pixel;
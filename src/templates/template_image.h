@@ -22,6 +22,8 @@
 #ifndef OPENORIENTEERING_TEMPLATE_IMAGE_H
 #define OPENORIENTEERING_TEMPLATE_IMAGE_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 #include <QColor>
@@ -32,6 +34,7 @@
 #include <QRectF>
 #include <QRgb>
 #include <QScopedPointer>
+#include <QSize>
 #include <QString>
 
 #include "templates/template.h"
@@ -43,6 +46,7 @@ class QPainter;
 class QPointF;
 class QPushButton;
 class QRadioButton;
+class QRect;
 class QRectF;
 class QWidget;
 class QXmlStreamReader;
@@ -51,6 +55,7 @@ class QXmlStreamWriter;
 namespace OpenOrienteering {
 
 class Georeferencing;
+class ImageTileCache;
 class Map;
 class MapCoordF;
 
@@ -88,12 +93,13 @@ public:
 	bool loadTypeSpecificTemplateConfiguration(QXmlStreamReader& xml) override;
 
 	bool loadTemplateFileImpl(bool configuring) override;
+	ReadFileFunction templateFileReader() override;
 	bool postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view) override;
 	void unloadTemplateFileImpl() override;
 	
     void drawTemplate(QPainter* painter, const QRectF& clip_rect, double scale, bool on_screen, float opacity) const override;
 	QRectF getTemplateExtent() const override;
-	bool canBeDrawnOnto() const override {return true;}
+	bool canBeDrawnOnto() const override {return !tile_cache;}
 
 	/**
 	 * Calculates the image's center of gravity in template coordinates by
@@ -101,9 +107,17 @@ public:
 	 */
 	QPointF calcCenterOfGravity(QRgb background_color);
 	
-	/** Returns the internal QImage. */
+	/**
+	 * Returns the internal QImage.
+	 * 
+	 * The image is null when the template is drawn from tiles which are
+	 * decoded on demand.
+	 */
 	inline const QImage& getImage() const {return image;}
 	
+	/** Returns the size of the image in pixels. */
+	inline const QSize& getImageSize() const {return image_size;}
+	
 	/**
 	 * Returns which georeferencing method (if any) is available.
 	 * (This does not mean that the image is in georeferenced mode)
@@ -133,9 +147,78 @@ protected:
 	void addUndoStep(const DrawOnImageUndoStep& new_step);
 	void calculateGeoreferencing();
 	void updatePosFromGeoreferencing();
+	
+	/**
+	 * Returns the image to be drawn at the given number of device pixels per image pixel.
+	 * 
+	 * This is either the image itself or a downsampled copy, each copy having
+	 * half the width and height of the previous one. The level is set to the
+	 * number of halvings.
+	 */
+	const QImage& imageForScale(qreal device_scale, int& level) const;
+	
+	/**
+	 * Creates the downsampled copies of the image.
+	 * 
+	 * The copies are created when the image is set, not when drawing,
+	 * so that drawing does not modify the template.
+	 */
+	void createDownsampledImages();
+	
+	/**
+	 * Updates the downsampled copies after the given area of the image has changed.
+	 */
+	void updateDownsampledImages(const QRect& changed_rect);
+	
+	/**
+	 * Draws the tiles which intersect the given rect of image pixels.
+	 */
+	void drawTiles(QPainter* painter, const QRectF& visible_rect, qreal device_scale) const;
+	
+	/**
+	 * The contents of an image file, as read by readImageFile().
+	 */
+	struct ImageFile
+	{
+		QImage image;
+		std::unique_ptr<ImageTileCache> tile_cache;
+		QString error_string;
+		bool has_world_file = false;
+	};
+	
+	/**
+	 * Reads an image file.
+	 * 
+	 * Large images are opened in a tile cache instead of being decoded, if the
+	 * format allows. This function doesn't access any template, so it can be
+	 * used on a worker thread.
+	 */
+	static ImageFile readImageFile(const QString& path, std::size_t memory_budget, bool persistent_tiles);
+	
+	/**
+	 * Takes over the contents of an image file which was read by readImageFile().
+	 * 
+	 * Returns true on success, like loadTemplateFileImpl().
+	 */
+	bool setImageFile(ImageFile&& file, bool configuring);
+	
+	/**
+	 * Creates a cache for decoding the template file in tiles.
+	 * 
+	 * The memory budget and persistence are taken from the settings.
+	 */
+	std::unique_ptr<ImageTileCache> createTileCache() const;
 
 	QImage image;
 	
+	/// Downsampled copies of the image, cf. createDownsampledImages().
+	std::vector<QImage> downsampled_images;
+	
+	/// Tiles of large images which are decoded on demand, instead of image.
+	std::unique_ptr<ImageTileCache> tile_cache;
+	
+	QSize image_size;
+	
 	std::vector< DrawOnImageUndoStep > undo_steps;
 	/// Current index in undo_steps, where 0 means before the first item.
 	int undo_index;
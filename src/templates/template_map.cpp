@@ -22,12 +22,17 @@
 #include "template_map.h"
 
 #include <algorithm>
+#include <memory>
+#include <utility>
 
 #include <QtGlobal>
 #include <QByteArray>
+#include <QMessageBox>
 #include <QPainter>
 #include <QRectF>
+#include <QString>
 #include <QStringList>
+#include <QThread>
 #include <QTransform>
 #include <QVariant>
 
@@ -36,14 +41,13 @@
 #include "core/map.h"
 #include "core/map_coord.h"
 #include "core/renderables/renderable.h"
+#include "fileformats/file_import_export.h"
 #include "util/transformation.h"
 #include "util/util.h"
 
 
 namespace OpenOrienteering {
 
-QStringList TemplateMap::locked_maps;
-
 const std::vector<QByteArray>& TemplateMap::supportedExtensions()
 {
 	static std::vector<QByteArray> extensions = { "ocd", "omap", "xmap" };
@@ -74,28 +78,53 @@ bool TemplateMap::isRasterGraphics() const
 
 bool TemplateMap::loadTemplateFileImpl(bool configuring)
 {
-	// Prevent unbounded recursive template loading
-	if (locked_maps.contains(template_path))
-		return true;
-	
-	locked_maps.append(template_path);
 	std::unique_ptr<Map> new_template_map{ new Map() };
-	bool new_template_valid = new_template_map->loadFrom(template_path, nullptr, nullptr, false, configuring);
-	locked_maps.removeAll(template_path);
+	QString error_message;
+	auto importer = importTemplateMap(template_path, *new_template_map, error_message);
+	if (!importer)
+	{
+		if (configuring)
+			QMessageBox::warning(nullptr, tr("Error"), error_message);
+		return false;
+	}
 	
-	if (new_template_valid)
+	// Without templates, this only shows the warnings.
+	new_template_map->finishLoading(*importer, template_path, configuring);
+	template_map = std::move(new_template_map);
+	return true;
+}
+
+Template::ReadFileFunction TemplateMap::templateFileReader()
+{
+	auto const path = template_path;
+	auto const target_thread = thread();
+	return [this, path, target_thread]() -> FinishLoadingFunction {
+		auto new_template_map = std::make_shared<std::unique_ptr<Map>>(new Map());
+		QString error_message;
+		if (!importTemplateMap(path, **new_template_map, error_message))
+			return []() { return false; };
+		
+		(*new_template_map)->moveAllToThread(target_thread);
+		return [this, new_template_map]() {
+			template_map = std::move(*new_template_map);
+			return true;
+		};
+	};
+}
+
+std::unique_ptr<Importer> TemplateMap::importTemplateMap(const QString& path, Map& map, QString& error_message)
+{
+	auto importer = map.importFrom(path, nullptr, false, nullptr, error_message);
+	if (importer)
 	{
-		// Remove all template's templates from memory
-		// TODO: prevent loading and/or let user decide
-		for (int i = new_template_map->getNumTemplates()-1; i >= 0; i--)
+		// The map's own templates are never loaded. Their entries are
+		// removed, so that nothing can load them later.
+		for (int i = map.getNumTemplates()-1; i >= 0; i--)
 		{
-			new_template_map->deleteTemplate(i);
+			map.deleteTemplate(i);
 		}
-		
-		template_map = std::move(new_template_map);
 	}
-	
-	return new_template_valid;
+	return importer;
 }
 
 bool TemplateMap::postLoadConfiguration(QWidget* /* dialog_parent */, bool& out_center_in_view)
@@ -37,6 +37,7 @@ class QWidget;
 
 namespace OpenOrienteering {
 
+class Importer;
 class Map;
 
 
@@ -65,6 +66,8 @@ public:
 	
 	bool loadTemplateFileImpl(bool configuring) override;
 	
+	ReadFileFunction templateFileReader() override;
+	
 	bool postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view) override;
 	
 	void unloadTemplateFileImpl() override;
@@ -86,10 +89,17 @@ protected:
 	
 	void calculateTransformation();
 	
+	/**
+	 * Imports a map file for use as a template.
+	 * 
+	 * The map's own templates are removed without being loaded. This function
+	 * may run on a worker thread, for a map which belongs to this thread.
+	 * On failure, returns nullptr and sets the error message.
+	 */
+	static std::unique_ptr<Importer> importTemplateMap(const QString& path, Map& map, QString& error_message);
+	
 private:
 	std::unique_ptr<Map> template_map;
-	
-	static QStringList locked_maps;
 };
 
 
@@ -21,13 +21,26 @@
 
 #include "template_track.h"
 
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <Qt>
 #include <QCommandLinkButton>
+#include <QLatin1String>
 #include <QMessageBox>
+#include <QMutexLocker>
 #include <QPainter>
+#include <QPainterPath>
+#include <QPen>
+#include <QPointF>
+#include <QRectF>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
 #include "core/georeferencing.h"
+#include "core/latlon.h"
 #include "core/map.h"
 #include "core/objects/object.h"
 #include "core/symbols/line_symbol.h"
@@ -42,6 +55,14 @@
 
 namespace OpenOrienteering {
 
+namespace {
+
+/// The highest level of track simplification
+constexpr int max_simplification_level = 16;
+
+}  // namespace
+
+
 const std::vector<QByteArray>& TemplateTrack::supportedExtensions()
 {
 	static std::vector<QByteArray> extensions = { "dxf", "gpx", "osm" };
@@ -59,6 +80,8 @@ TemplateTrack::TemplateTrack(const QString& path, Map* map)
 	connect(&georef, &Georeferencing::transformationChanged, this, &TemplateTrack::updateGeoreferencing);
 	connect(&georef, &Georeferencing::stateChanged, this, &TemplateTrack::updateGeoreferencing);
 	connect(&georef, &Georeferencing::declinationChanged, this, &TemplateTrack::updateGeoreferencing);
+	connect(map, &Map::objectSelectionChanged, this, &TemplateTrack::updateLoadedArea);
+	connect(map, &Map::selectedObjectEdited, this, &TemplateTrack::updateLoadedArea);
 }
 
 TemplateTrack::~TemplateTrack()
@@ -142,32 +165,121 @@ bool TemplateTrack::loadTemplateFileImpl(bool configuring)
 		return false;
 	}
 	
+	track.setLoadingArea(loadingArea(configuring));
 	if (!track.loadFrom(template_path, false))
+	{
+		setErrorString(track.errorString());
 		return false;
+	}
+	
+	// Problems are reported as warnings by the caller.
+	setErrorString(track.errorString());
 	
 	if (!configuring)
-	{
-		Georeferencing* track_crs = new Georeferencing();
-		if (!track_crs_spec.isEmpty())
-			track_crs->setProjectedCRS(QString{}, track_crs_spec);
-		track_crs->setTransformationDirectly(QTransform());
-		track.setTrackCRS(track_crs);
-		
-		bool crs_is_geographic = track_crs_spec.contains(QLatin1String("+proj=latlong"));
-		if (!is_georeferenced && crs_is_geographic)
-		{
-			if (projected_crs_spec.isEmpty())
-				projected_crs_spec = calculateLocalGeoreferencing();
-			applyProjectedCrsSpec();
-		}
-		else
+		setupTrackCRS();
+	
+	return true;
+}
+
+Template::ReadFileFunction TemplateTrack::templateFileReader()
+{
+	if (preserved_georef)
+		return {};
+	
+	auto const path = template_path;
+	auto new_track = std::make_shared<Track>();
+	new_track->setLoadingArea(loadingArea(false));
+	return [this, path, new_track]() -> FinishLoadingFunction {
+		if (!new_track->loadFrom(path, false))
 		{
-			projected_crs_spec.clear();
-			track.changeMapGeoreferencing(map->getGeoreferencing());
+			return [this, new_track]() {
+				setErrorString(new_track->errorString());
+				return false;
+			};
 		}
-	}
+		
+		return [this, new_track]() {
+			setErrorString(new_track->errorString());
+			track = *new_track;
+			setupTrackCRS();
+			return true;
+		};
+	};
+}
+
+QRectF TemplateTrack::loadingArea(bool configuring) const
+{
+	// New templates are loaded completely, and so are tracks which are
+	// not georeferenced: their position is not yet related to the map.
+	auto const& georef = map->getGeoreferencing();
+	if (configuring || !is_georeferenced || georef.isLocal() || !georef.isValid())
+		return {};
+	
+	auto extent = map->calculateExtent();
+	if (extent.isEmpty())
+		return {};
+	
+	// Keep the surroundings of the map's objects.
+	extent.adjust(-extent.width(), -extent.height(), extent.width(), extent.height());
+	return geographicArea(extent);
+}
+
+QRectF TemplateTrack::geographicArea(const QRectF& map_rect) const
+{
+	const MapCoordF corners[4] = {
+	    MapCoordF(map_rect.topLeft()), MapCoordF(map_rect.topRight()),
+	    MapCoordF(map_rect.bottomRight()), MapCoordF(map_rect.bottomLeft())
+	};
+	LatLon lat_lon[4];
+	if (!map->getGeoreferencing().toGeographicCoords(corners, lat_lon, 4))
+		return {};
+	
+	QRectF area;
+	for (auto const& corner : lat_lon)
+		rectIncludeSafe(area, QPointF(corner.longitude(), corner.latitude()));
+	return area;
+}
+
+bool TemplateTrack::hasLoadedArea(const QRectF& map_rect) const
+{
+	auto const loaded_area = track.loadedArea();
+	if (loaded_area.isNull() || map_rect.isNull())
+		return true;
 	
-	return true;
+	auto const area = geographicArea(map_rect);
+	return !area.isNull() && loaded_area.contains(area);
+}
+
+void TemplateTrack::reloadForArea(const QRectF& map_rect)
+{
+	if (template_state != Template::Loaded || hasUnsavedChanges() || hasLoadedArea(map_rect))
+		return;
+	
+	// The track file is read again for the map's current extent.
+	unloadTemplateFile();
+	loadTemplateFileAsync();
+}
+
+void TemplateTrack::setupTrackCRS()
+{
+	Georeferencing* track_crs = new Georeferencing();
+	if (!track_crs_spec.isEmpty())
+		track_crs->setProjectedCRS(QString{}, track_crs_spec);
+	track_crs->setTransformationDirectly(QTransform());
+	track.setTrackCRS(track_crs);
+	
+	bool crs_is_geographic = track_crs_spec.contains(QLatin1String("+proj=latlong"));
+	if (!is_georeferenced && crs_is_geographic)
+	{
+		if (projected_crs_spec.isEmpty())
+			projected_crs_spec = calculateLocalGeoreferencing();
+		applyProjectedCrsSpec();
+	}
+	else
+	{
+		projected_crs_spec.clear();
+		track.changeMapGeoreferencing(map->getGeoreferencing());
+	}
 }
 
 bool TemplateTrack::postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view)
@@ -282,17 +394,16 @@ void TemplateTrack::unloadTemplateFileImpl()
 
 void TemplateTrack::drawTemplate(QPainter* painter, const QRectF& clip_rect, double scale, bool on_screen, float opacity) const
 {
-	Q_UNUSED(clip_rect);
 	Q_UNUSED(scale);
 	
 	painter->save();
 	painter->setOpacity(opacity);
-	drawTracks(painter, on_screen);
+	drawTracks(painter, clip_rect, on_screen);
 	drawWaypoints(painter);
 	painter->restore();
 }
 
-void TemplateTrack::drawTracks(QPainter* painter, bool on_screen) const
+void TemplateTrack::drawTracks(QPainter* painter, const QRectF& clip_rect, bool on_screen) const
 {
 	painter->save();
 	if (!is_georeferenced)
@@ -307,22 +418,73 @@ void TemplateTrack::drawTracks(QPainter* painter, bool on_screen) const
 	painter->setPen(pen);
 	painter->setBrush(Qt::NoBrush);
 	
-	// TODO: could speed that up by storing the template coords of the GPS points in a separate vector or caching the painter paths
+	// The clip rect in track coordinates
+	QRectF track_clip_rect;
+	if (is_georeferenced)
+	{
+		track_clip_rect = clip_rect;
+	}
+	else
+	{
+		rectIncludeSafe(track_clip_rect, mapToTemplate(MapCoordF(clip_rect.topLeft())));
+		rectIncludeSafe(track_clip_rect, mapToTemplate(MapCoordF(clip_rect.topRight())));
+		rectIncludeSafe(track_clip_rect, mapToTemplate(MapCoordF(clip_rect.bottomLeft())));
+		rectIncludeSafe(track_clip_rect, mapToTemplate(MapCoordF(clip_rect.bottomRight())));
+	}
+	
+	// The size of a device pixel in track coordinates. Unlike the scale
+	// parameter of drawTemplate(), the painter's transform accounts for the
+	// device resolution and for the template transform.
+	auto const pixel_size = 1.0 / std::sqrt(std::abs(painter->worldTransform().determinant()));
+	auto const margin = on_screen ? pixel_size : pen.widthF();
+	track_clip_rect.adjust(-margin, -margin, margin, margin);
+	
+	// Simplify as long as the error stays below half a pixel.
+	int level = 0;
+	if (on_screen)
+	{
+		while (level < max_simplification_level && simplificationTolerance(level + 1) <= 0.5 * pixel_size)
+			++level;
+	}
+	
+	QMutexLocker locker(&segment_paths_mutex);
+	auto const& paths = segmentPaths();
+	for (int i = 0; i < int(paths.size()); ++i)
+	{
+		if (paths[i].bounds.intersects(track_clip_rect))
+			painter->drawPath(segmentPath(i, level));
+	}
+	
+	painter->restore();
+}
+
+std::vector<TemplateTrack::SegmentPath>& TemplateTrack::segmentPaths() const
+{
+	if (segment_paths_built && segment_paths_revision == track.revision())
+		return segment_paths;
+	
+	segment_paths.clear();
+	segment_paths.resize(std::size_t(track.getNumSegments()));
 	for (int i = 0; i < track.getNumSegments(); ++i)
 	{
-		QPainterPath path;
+		auto& segment_path = segment_paths[std::size_t(i)];
+		auto& path = segment_path.path;
 		int size = track.getSegmentPointCount(i);
 		for (int k = 0; k < size; ++k)
 		{
 			const TrackPoint& point = track.getSegmentPoint(i, k);
+			rectIncludeSafe(segment_path.bounds, point.map_coord);
 			
 			if (k > 0)
 			{
-				if (track.getSegmentPoint(i, k - 1).is_curve_start && k < track.getSegmentPointCount(i) - 2)
+				if (track.getSegmentPoint(i, k - 1).is_curve_start && k < size - 2)
 				{
 					path.cubicTo(point.map_coord,
 					             track.getSegmentPoint(i, k + 1).map_coord,
 					             track.getSegmentPoint(i, k + 2).map_coord);
+					rectIncludeSafe(segment_path.bounds, track.getSegmentPoint(i, k + 1).map_coord);
+					rectIncludeSafe(segment_path.bounds, track.getSegmentPoint(i, k + 2).map_coord);
+					segment_path.has_curves = true;
 					k += 2;
 				}
 				else
@@ -331,10 +493,47 @@ void TemplateTrack::drawTracks(QPainter* painter, bool on_screen) const
 			else
 				path.moveTo(point.map_coord.x(), point.map_coord.y());
 		}
-		painter->drawPath(path);
 	}
 	
-	painter->restore();
+	segment_paths_revision = track.revision();
+	segment_paths_built = true;
+	return segment_paths;
+}
+
+const QPainterPath& TemplateTrack::segmentPath(int segment, int level) const
+{
+	auto& segment_path = segmentPaths()[std::size_t(segment)];
+	if (level == 0 || segment_path.has_curves)
+		return segment_path.path;
+	
+	auto& simplified = segment_path.simplified;
+	if (simplified.size() < std::size_t(level))
+		simplified.resize(std::size_t(level));
+	
+	auto& path = simplified[std::size_t(level - 1)];
+	if (path.isEmpty())
+	{
+		auto const tolerance_squared = simplificationTolerance(level) * simplificationTolerance(level);
+		auto const size = track.getSegmentPointCount(segment);
+		auto last = track.getSegmentPoint(segment, 0).map_coord;
+		path.moveTo(last);
+		for (int k = 1; k < size; ++k)
+		{
+			auto const& point = track.getSegmentPoint(segment, k).map_coord;
+			if (k == size - 1 || point.distanceSquaredTo(last) >= tolerance_squared)
+			{
+				path.lineTo(point);
+				last = point;
+			}
+		}
+	}
+	return path;
+}
+
+qreal TemplateTrack::simplificationTolerance(int level)
+{
+	// Level 1 drops points closer than 0.01 mm (at 100%).
+	return level > 0 ? std::ldexp(0.01, level - 1) : 0.0;
 }
 
 void TemplateTrack::drawWaypoints(QPainter* painter) const
@@ -445,6 +644,23 @@ PointObject* TemplateTrack::importWaypoint(const MapCoordF& position, const QStr
 
 bool TemplateTrack::import(QWidget* dialog_parent)
 {
+	if (!track.loadedArea().isNull())
+	{
+		// Import the complete track, not only the loaded area.
+		Track complete_track;
+		if (!complete_track.loadFrom(template_path, false))
+		{
+			auto error_detail = complete_track.errorString();
+			if (error_detail.isEmpty())
+				error_detail = tr("Cannot load the complete track.");
+			QMessageBox::critical(dialog_parent, tr("Error"), error_detail);
+			return false;
+		}
+		track = complete_track;
+		setupTrackCRS();
+		map->updateAllMapWidgets();
+	}
+	
 	if (track.getNumWaypoints() == 0 && track.getNumSegments() == 0)
 	{
 		QMessageBox::critical(dialog_parent, tr("Error"), tr("The path is empty, there is nothing to import!"));
@@ -555,12 +771,26 @@ void TemplateTrack::updateGeoreferencing()
 {
 	if (is_georeferenced && template_state == Template::Loaded)
 	{
+		reloadForArea(map->calculateExtent());
+		if (template_state != Template::Loaded)
+			return;
+		
 		projected_crs_spec.clear();
 		track.changeMapGeoreferencing(map->getGeoreferencing());
 		map->updateAllMapWidgets();
 	}
 }
 
+void TemplateTrack::updateLoadedArea()
+{
+	if (map->getNumSelectedObjects() == 0)
+		return;
+	
+	QRectF selection_extent;
+	map->includeSelectionRect(selection_extent);
+	reloadForArea(selection_extent);
+}
+
 QString TemplateTrack::calculateLocalGeoreferencing() const
 {
 	LatLon proj_center = track.calcAveragePosition();
@@ -25,7 +25,9 @@
 #include <vector>
 
 #include <QtGlobal>
+#include <QMutex>
 #include <QObject>
+#include <QPainterPath>
 #include <QRectF>
 #include <QString>
 
@@ -67,6 +69,7 @@ public:
 	bool saveTemplateFile() const override;
 	
 	bool loadTemplateFileImpl(bool configuring) override;
+	ReadFileFunction templateFileReader() override;
 	bool postLoadConfiguration(QWidget* dialog_parent, bool& out_center_in_view) override;
 	void unloadTemplateFileImpl() override;
 	
@@ -76,13 +79,19 @@ public:
     int getTemplateBoundingBoxPixelBorder() override;
 	
 	
-	/// Draws all tracks.
-	void drawTracks(QPainter* painter, bool on_screen) const;
+	/**
+	 * Draws the tracks which intersect the clip rect.
+	 * 
+	 * The clip rect is in map coordinates. On screen, the tracks are
+	 * simplified according to the resolution of the painter's device.
+	 */
+	void drawTracks(QPainter* painter, const QRectF& clip_rect, bool on_screen) const;
 	
 	/// Draws all waypoints.
 	void drawWaypoints(QPainter* painter) const;
 	
 	/// Import the track as map object(s), returns true if something has been imported.
+	/// If only an area of the track file was loaded, the complete file is loaded first.
 	/// TODO: should this be moved to the Track class?
 	bool import(QWidget* dialog_parent = nullptr);
 	
@@ -96,6 +105,11 @@ public:
 public slots:
 	void updateGeoreferencing();
 	
+	/**
+	 * Reloads the track if the selected objects leave the loaded area.
+	 */
+	void updateLoadedArea();
+	
 protected:
 	Template* duplicateImpl() const override;
 #ifndef NO_NATIVE_FILE_FORMAT
@@ -107,6 +121,37 @@ protected:
 	/// Projects the track in non-georeferenced mode
 	QString calculateLocalGeoreferencing() const;
 	
+	/// Sets up the track CRS and the map positions after loading the track
+	void setupTrackCRS();
+	
+	/**
+	 * Returns the geographic area which is to be loaded from the track file.
+	 * 
+	 * This is the map's extent with a wide margin, or a null rectangle
+	 * if the whole file is to be loaded.
+	 */
+	QRectF loadingArea(bool configuring) const;
+	
+	/**
+	 * Returns the geographic bounding box of a rectangle in map coordinates.
+	 * 
+	 * Returns a null rectangle if the coordinates cannot be transformed.
+	 */
+	QRectF geographicArea(const QRectF& map_rect) const;
+	
+	/**
+	 * Returns true if the track was loaded for the given rectangle in map coordinates.
+	 */
+	bool hasLoadedArea(const QRectF& map_rect) const;
+	
+	/**
+	 * Reloads the track asynchronously if it was not loaded for the given
+	 * rectangle in map coordinates.
+	 * 
+	 * The new loading area is determined from the map's current extent.
+	 */
+	void reloadForArea(const QRectF& map_rect);
+	
 	void applyProjectedCrsSpec();
 	
 	PathObject* importPathStart();
@@ -114,12 +159,53 @@ protected:
 	PointObject* importWaypoint(const MapCoordF& position, const QString &name = QString());
 	
 	
+	/**
+	 * A cached painter path of a track segment.
+	 */
+	struct SegmentPath
+	{
+		QPainterPath path;                     ///< The path of all points
+		QRectF bounds;                         ///< The bounding box of the points
+		std::vector<QPainterPath> simplified;  ///< Simplified paths by level, created on demand
+		bool has_curves = false;               ///< Whether the path contains curves
+	};
+	
+	/**
+	 * Returns the painter paths of the track segments.
+	 * 
+	 * The paths are rebuilt when the track's revision has changed.
+	 * The caller must hold segment_paths_mutex.
+	 */
+	std::vector<SegmentPath>& segmentPaths() const;
+	
+	/**
+	 * Returns the path of a segment, simplified for the given level.
+	 * 
+	 * At level 0, the path is not simplified. At higher levels, points are
+	 * dropped when they are closer to the previous point than the level's
+	 * tolerance, cf. simplificationTolerance().
+	 * The caller must hold segment_paths_mutex.
+	 */
+	const QPainterPath& segmentPath(int segment, int level) const;
+	
+	/**
+	 * Returns the tolerance of the given level of simplification.
+	 */
+	static qreal simplificationTolerance(int level);
+	
+	
+	
 	Track track;
 	QString track_crs_spec;
 	QString projected_crs_spec;
 	friend class OgrTemplate; // for migration
 	std::unique_ptr<Georeferencing> preserved_georef;
 	
+	mutable std::vector<SegmentPath> segment_paths;
+	mutable quint64 segment_paths_revision = 0;
+	mutable bool segment_paths_built = false;
+	mutable QMutex segment_paths_mutex;  ///< Protects the segment paths, which are built while drawing
+
 private:
 	Q_DISABLE_COPY(TemplateTrack)
 };
@@ -52,6 +52,7 @@ bool ObjectSelector::selectAt(MapCoordF position, double tolerance, bool toggle)
 		single_selected_object = *map->selectedObjectsBegin();
 	
 	// Clicked - get objects below cursor
+	map->updateObjects();
 	SelectionInfoVector objects;
 	map->findObjectsAt(position, 0.001f * tolerance, false, false, false, false, objects);
 	if (objects.empty())
@@ -137,6 +138,7 @@ bool ObjectSelector::selectBox(MapCoordF corner1, MapCoordF corner2, bool toggle
 	bool selection_changed = false;
 	
 	std::vector<Object*> objects;
+	map->updateObjects();
 	map->findObjectsAtBox(corner1, corner2, false, false, objects);
 	
 	if (!toggle)
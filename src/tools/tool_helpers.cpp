@@ -340,6 +340,7 @@ MapCoord SnappingToolHelper::snapToObject(MapCoordF position, MapWidget* widget,
 	if (filter & (ObjectCorners | ObjectPaths))
 	{
 		// Find map objects at the given position
+		map->updateObjects();
 		SelectionInfoVector objects;
 		map->findAllObjectsAt(position, snap_distance, true, false, false, true, objects);
 		
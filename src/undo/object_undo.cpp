@@ -347,16 +347,14 @@ UndoStep* DeleteObjectsUndoStep::undo()
 	AddObjectsUndoStep* undo_step = new AddObjectsUndoStep(map);
 	undo_step->setPartIndex(part_index);
 	
-	// Make sure to delete the objects in the right order so the other objects' indices stay valid
-	std::sort(modified_objects.begin(), modified_objects.end(), std::greater<int>());
-	
 	MapPart* part = map->getPart(part_index);
-	int size = (int)modified_objects.size();
-	for (int i = 0; i < size; ++i)
-	{
-		undo_step->addObject(modified_objects[i], part->getObject(modified_objects[i]));
-		part->deleteObject(modified_objects[i], true);
-	}
+	auto objects_to_delete = std::vector<Object*>();
+	objects_to_delete.reserve(modified_objects.size());
+	for (auto index : modified_objects)
+		objects_to_delete.push_back(part->getObject(index));
+	
+	for (auto const& entry : part->deleteObjects(objects_to_delete, true))
+		undo_step->addObject(entry.first, entry.second);
 	
 	return undo_step;
 }
@@ -396,20 +394,21 @@ UndoStep* AddObjectsUndoStep::undo()
 	DeleteObjectsUndoStep* undo_step = new DeleteObjectsUndoStep(map);
 	undo_step->setPartIndex(part_index);
 	
-	// Make sure to add the objects in the right order so the other objects' indices stay valid
+	// Add the objects in the order of their indices so that the indices stay valid
 	std::vector< std::pair<int, int> > order;	// index into affected_objects & objects, object index
 	order.resize(modified_objects.size());
 	for (int i = 0; i < (int)modified_objects.size(); ++i)
 		order[i] = std::pair<int, int>(i, modified_objects[i]);
 	std::sort(order.begin(), order.end(), sortOrder);
 	
-	MapPart* part = map->getPart(part_index);
-	int size = (int)objects.size();
-	for (int i = 0; i < size; ++i)
+	auto objects_to_add = std::vector<std::pair<int, Object*>>();
+	objects_to_add.reserve(objects.size());
+	for (auto const& entry : order)
 	{
-		undo_step->addObject(modified_objects[order[i].first]);
-		part->addObject(objects[order[i].first], order[i].second);
+		undo_step->addObject(modified_objects[entry.first]);
+		objects_to_add.emplace_back(entry.second, objects[entry.first]);
 	}
+	map->getPart(part_index)->addObjects(objects_to_add);
 	
 	undone = true;
 	return undo_step;
@@ -417,19 +416,17 @@ UndoStep* AddObjectsUndoStep::undo()
 
 void AddObjectsUndoStep::removeContainedObjects(bool emit_selection_changed)
 {
-	MapPart* part = map->getPart(getPartIndex());
-	int size = (int)objects.size();
 	bool object_deselected = false;
-	for (int i = 0; i < size; ++i)
+	for (auto object : objects)
 	{
-		if (map->isObjectSelected(objects[i]))
+		if (map->isObjectSelected(object))
 		{
-			map->removeObjectFromSelection(objects[i], false);
+			map->removeObjectFromSelection(object, false);
 			object_deselected = true;
 		}
-		part->deleteObject(objects[i], true);
-		map->setObjectsDirty();
 	}
+	map->getPart(getPartIndex())->deleteObjects(objects, true);
+	map->setObjectsDirty();
 	if (object_deselected && emit_selection_changed)
 		map->emitSelectionChanged();
 }
@@ -0,0 +1,328 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_SPATIAL_GRID_H
+#define OPENORIENTEERING_SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <QtGlobal>
+#include <QRect>
+#include <QRectF>
+
+// IWYU pragma: no_forward_declare QRect
+// IWYU pragma: no_forward_declare QRectF
+
+namespace OpenOrienteering {
+
+
+/**
+ * A uniform grid for finding items by their bounding box.
+ *
+ * Each item is registered in all cells covered by its extent. Items whose
+ * extent covers too many cells, and items without a valid extent, are kept
+ * in a separate list which is part of every query result. This keeps the
+ * cost of insertion and removal bounded for huge objects such as area fills.
+ *
+ * Queries return a superset of the items intersecting the query rectangle.
+ * Callers must still test the actual extent if they need an exact result.
+ *
+ * The item type must be hashable by std::hash and less-than comparable.
+ * Query results are ordered by operator<, so that the order is the same as
+ * for iterating a std::map or std::set of the same items.
+ */
+template <class T>
+class SpatialGrid
+{
+public:
+	/**
+	 * Constructs an empty grid.
+	 *
+	 * @param cell_size  The width and height of the grid cells, in the units of the extents.
+	 * @param max_cells  The maximum number of cells an item is registered in.
+	 */
+	explicit SpatialGrid(qreal cell_size = 10.0, int max_cells = 64);
+	
+	SpatialGrid(const SpatialGrid&) = default;
+	SpatialGrid(SpatialGrid&&) = default;
+	~SpatialGrid() = default;
+	
+	SpatialGrid& operator=(const SpatialGrid&) = default;
+	SpatialGrid& operator=(SpatialGrid&&) = default;
+	
+	
+	/**
+	 * Returns true if the grid doesn't contain any items.
+	 */
+	bool empty() const;
+	
+	/**
+	 * Returns the number of items in the grid.
+	 */
+	std::size_t size() const;
+	
+	/**
+	 * Returns a rectangle which contains the valid extents of all items.
+	 *
+	 * The bounds only grow when items are inserted. They are not reduced
+	 * when items are removed.
+	 */
+	const QRectF& bounds() const;
+	
+	/**
+	 * Returns true if the item is registered in this grid.
+	 */
+	bool contains(const T& item) const;
+	
+	
+	/**
+	 * Registers the item with the given extent.
+	 *
+	 * If the item is already registered, its previous registration is replaced.
+	 */
+	void insert(const T& item, const QRectF& extent);
+	
+	/**
+	 * Removes the item from the grid.
+	 *
+	 * Returns true if the item was registered.
+	 */
+	bool remove(const T& item);
+	
+	/**
+	 * Removes all items from the grid.
+	 */
+	void clear();
+	
+	
+	/**
+	 * Returns the items which may intersect the given rectangle.
+	 *
+	 * The result is sorted and does not contain duplicates.
+	 */
+	std::vector<T> query(const QRectF& rect) const;
+
+
+private:
+	using Key = quint64;
+	using Cell = std::vector<T>;
+	
+	static Key key(int x, int y);
+	static int keyX(Key key);
+	static int keyY(Key key);
+	
+	/**
+	 * Returns the range of cells covered by the rectangle.
+	 */
+	QRect cellRange(const QRectF& rect) const;
+	
+	std::unordered_map<Key, Cell> cells;
+	std::unordered_map<T, QRect> items;  ///< Cell range per item; empty for unplaced items.
+	Cell unplaced;                       ///< Items which are not registered in any cell.
+	QRectF item_bounds;
+	qreal cell_size;
+	int max_cells;
+};
+
+
+
+// ### SpatialGrid inline and template code ###
+
+template <class T>
+SpatialGrid<T>::SpatialGrid(qreal cell_size, int max_cells)
+: cell_size(cell_size)
+, max_cells(max_cells)
+{
+	Q_ASSERT(cell_size > 0);
+}
+
+template <class T>
+bool SpatialGrid<T>::empty() const
+{
+	return items.empty();
+}
+
+template <class T>
+std::size_t SpatialGrid<T>::size() const
+{
+	return items.size();
+}
+
+template <class T>
+const QRectF& SpatialGrid<T>::bounds() const
+{
+	return item_bounds;
+}
+
+template <class T>
+bool SpatialGrid<T>::contains(const T& item) const
+{
+	return items.find(item) != items.end();
+}
+
+
+template <class T>
+typename SpatialGrid<T>::Key SpatialGrid<T>::key(int x, int y)
+{
+	return (Key(quint32(x)) << 32) | Key(quint32(y));
+}
+
+template <class T>
+int SpatialGrid<T>::keyX(Key key)
+{
+	return int(quint32(key >> 32));
+}
+
+template <class T>
+int SpatialGrid<T>::keyY(Key key)
+{
+	return int(quint32(key & 0xffffffffu));
+}
+
+template <class T>
+QRect SpatialGrid<T>::cellRange(const QRectF& rect) const
+{
+	auto const r = rect.normalized();
+	return QRect(QPoint(int(std::floor(r.left() / cell_size)), int(std::floor(r.top() / cell_size))),
+	             QPoint(int(std::floor(r.right() / cell_size)), int(std::floor(r.bottom() / cell_size))));
+}
+
+
+template <class T>
+void SpatialGrid<T>::insert(const T& item, const QRectF& extent)
+{
+	remove(item);
+	
+	auto range = QRect();
+	if (extent.isValid())
+	{
+		range = cellRange(extent);
+		if (qint64(range.width()) * range.height() > max_cells)
+			range = QRect();
+		
+		if (item_bounds.isValid())
+			item_bounds = item_bounds.united(extent);
+		else
+			item_bounds = extent;
+	}
+	
+	if (range.isEmpty())
+	{
+		unplaced.push_back(item);
+	}
+	else
+	{
+		for (int y = range.top(); y <= range.bottom(); ++y)
+		{
+			for (int x = range.left(); x <= range.right(); ++x)
+				cells[key(x, y)].push_back(item);
+		}
+	}
+	items.emplace(item, range);
+}
+
+template <class T>
+bool SpatialGrid<T>::remove(const T& item)
+{
+	auto const found = items.find(item);
+	if (found == items.end())
+		return false;
+	
+	auto const erase_from = [&item](Cell& cell) {
+		auto const pos = std::find(cell.begin(), cell.end(), item);
+		Q_ASSERT(pos != cell.end());
+		*pos = cell.back();
+		cell.pop_back();
+	};
+	
+	auto const& range = found->second;
+	if (range.isEmpty())
+	{
+		erase_from(unplaced);
+	}
+	else
+	{
+		for (int y = range.top(); y <= range.bottom(); ++y)
+		{
+			for (int x = range.left(); x <= range.right(); ++x)
+			{
+				auto const cell = cells.find(key(x, y));
+				Q_ASSERT(cell != cells.end());
+				erase_from(cell->second);
+				if (cell->second.empty())
+					cells.erase(cell);
+			}
+		}
+	}
+	items.erase(found);
+	return true;
+}
+
+template <class T>
+void SpatialGrid<T>::clear()
+{
+	cells.clear();
+	items.clear();
+	unplaced.clear();
+	item_bounds = QRectF();
+}
+
+
+template <class T>
+std::vector<T> SpatialGrid<T>::query(const QRectF& rect) const
+{
+	auto result = unplaced;
+	
+	auto const range = cellRange(rect);
+	if (qint64(range.width()) * range.height() <= qint64(cells.size()))
+	{
+		for (int y = range.top(); y <= range.bottom(); ++y)
+		{
+			for (int x = range.left(); x <= range.right(); ++x)
+			{
+				auto const cell = cells.find(key(x, y));
+				if (cell != cells.end())
+					result.insert(result.end(), cell->second.begin(), cell->second.end());
+			}
+		}
+	}
+	else
+	{
+		// Fewer occupied cells than cells in the query range
+		for (auto const& cell : cells)
+		{
+			if (range.contains(keyX(cell.first), keyY(cell.first)))
+				result.insert(result.end(), cell.second.begin(), cell.second.end());
+		}
+	}
+	
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+
+}  // namespace OpenOrienteering
+
+#endif
@@ -44,6 +44,126 @@
 
 namespace OpenOrienteering {
 
+namespace {
+
+/**
+ * Appends an unsigned integer as a sequence of 7-bit groups, least
+ * significant group first. All bytes but the last one have bit 7 set.
+ */
+void appendVarint(QByteArray& data, quint64 value)
+{
+	while (value >= 0x80)
+	{
+		data.append(char(0x80 | (value & 0x7f)));
+		value >>= 7;
+	}
+	data.append(char(value));
+}
+
+/**
+ * Reads an unsigned integer written by appendVarint(), and advances pos.
+ * 
+ * Throws std::invalid_argument if the data is not valid.
+ */
+quint64 readVarint(const char*& pos, const char* end)
+{
+	quint64 value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (Q_UNLIKELY(pos == end))
+			throw std::invalid_argument("Premature end of data");
+		
+		auto byte = quint8(*pos);
+		++pos;
+		value |= quint64(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	throw std::invalid_argument("Invalid data");
+}
+
+/**
+ * Maps signed integers to unsigned integers so that small magnitudes
+ * result in small values: 0, -1, 1, -2, 2, ... become 0, 1, 2, 3, 4, ...
+ */
+constexpr quint64 zigzag(qint64 value)
+{
+	return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+constexpr qint64 unzigzag(quint64 value)
+{
+	return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+
+/**
+ * Returns the compact binary encoding of the coordinates.
+ * 
+ * For each coordinate, the encoding consists of
+ * - the zigzag-encoded difference to the previous x, shifted left by one bit,
+ *   with bit 0 indicating the presence of flags,
+ * - the zigzag-encoded difference to the previous y,
+ * - the flags, as a single byte, if present.
+ * The integers are stored as varints, cf. appendVarint().
+ */
+QByteArray encodeCompact(const MapCoordVector& coords)
+{
+	QByteArray data;
+	data.reserve(int(coords.size()) * 5);
+	qint64 x = 0;
+	qint64 y = 0;
+	for (const auto& coord : coords)
+	{
+		auto flags = coord.flags();
+		Q_ASSERT(quint32(flags) <= 0xff);
+		appendVarint(data, (zigzag(coord.nativeX() - x) << 1) | (flags ? 1 : 0));
+		appendVarint(data, zigzag(coord.nativeY() - y));
+		if (flags)
+			data.append(char(flags));
+		x = coord.nativeX();
+		y = coord.nativeY();
+	}
+	return data;
+}
+
+/**
+ * Appends the coordinates from the compact binary encoding to coords.
+ * 
+ * The function before_coord is called before each coordinate is created.
+ * 
+ * Throws std::invalid_argument if the data is not valid, and std::range_error
+ * if a coordinate is out of bounds.
+ */
+template <class Function>
+void decodeCompact(const QByteArray& data, MapCoordVector& coords, Function before_coord)
+{
+	auto pos = data.constData();
+	auto const end = pos + data.size();
+	qint64 x = 0;
+	qint64 y = 0;
+	while (pos != end)
+	{
+		auto const value = readVarint(pos, end);
+		x += unzigzag(value >> 1);
+		y += unzigzag(readVarint(pos, end));
+		MapCoord::Flags::Int flags = 0;
+		if (value & 1)
+		{
+			if (Q_UNLIKELY(pos == end))
+				throw std::invalid_argument("Premature end of data");
+			flags = quint8(*pos);
+			++pos;
+		}
+		before_coord();
+		coords.push_back(MapCoord::loadNative(x, y, MapCoord::Flags{flags}));
+	}
+}
+
+}  // namespace
+
+
+
 void writeLineBreak(QXmlStreamWriter& xml)
 {
 	if (!xml.autoFormatting())
@@ -166,6 +286,12 @@ void XmlElementWriter::write(const MapCoordVector& coords)
 		for (auto& coord : coords)
 			coord.save(xml);
 	}
+	else if (XMLFileFormat::active_version >= 8)
+	{
+		// Compact format: base64-packed binary data
+		writeAttribute(literal::encoding, literal::compact);
+		xml.writeCharacters(QString::fromLatin1(encodeCompact(coords).toBase64()));
+	}
 	else
 	{
 		// Default: efficient plain text format
@@ -192,6 +318,9 @@ void XmlElementReader::read(MapCoordVector& coords)
 	const auto num_coords = attribute<unsigned int>(literal::count);
 	coords.reserve(std::min(num_coords, 500000u));
 	
+	const bool compact = attributes.value(literal::encoding) == literal::compact;
+	QByteArray compact_data;
+	
 	try
 	{
 		for( xml.readNext(); xml.tokenType() != QXmlStreamReader::EndElement; xml.readNext() )
@@ -201,6 +330,10 @@ void XmlElementReader::read(MapCoordVector& coords)
 			{
 				throw FileFormatException(::OpenOrienteering::ImportExport::tr("Could not parse the coordinates."));
 			}
+			else if (token == QXmlStreamReader::Characters && compact)
+			{
+				compact_data.append(xml.text().toLatin1());
+			}
 			else if (token == QXmlStreamReader::Characters && !xml.isWhitespace())
 			{
 				QStringRef text = xml.text();
@@ -231,6 +364,20 @@ void XmlElementReader::read(MapCoordVector& coords)
 			}
 			// otherwise: ignore element
 		}
+		
+		if (compact)
+		{
+			try
+			{
+				decodeCompact(QByteArray::fromBase64(compact_data), coords, []{});
+			}
+			catch (std::invalid_argument& e)
+			{
+				Q_UNUSED(e)
+				qDebug("Could not parse the coordinates: %s", e.what());
+				throw FileFormatException(::OpenOrienteering::ImportExport::tr("Could not parse the coordinates."));
+			}
+		}
 	}
 	catch (std::range_error &e)
 	{
@@ -255,6 +402,9 @@ void XmlElementReader::readForText(MapCoordVector& coords)
 	
 	QScopedValueRollback<MapCoord::BoundsOffset> offset{MapCoord::boundsOffset()};
 	
+	const bool compact = attributes.value(literal::encoding) == literal::compact;
+	QByteArray compact_data;
+	
 	try
 	{
 		for( xml.readNext(); xml.tokenType() != QXmlStreamReader::EndElement; xml.readNext() )
@@ -264,6 +414,10 @@ void XmlElementReader::readForText(MapCoordVector& coords)
 			{
 				throw FileFormatException(::OpenOrienteering::ImportExport::tr("Could not parse the coordinates."));
 			}
+			else if (token == QXmlStreamReader::Characters && compact)
+			{
+				compact_data.append(xml.text().toLatin1());
+			}
 			else if (token == QXmlStreamReader::Characters && !xml.isWhitespace())
 			{
 				QStringRef text = xml.text();
@@ -306,6 +460,27 @@ void XmlElementReader::readForText(MapCoordVector& coords)
 			}
 			// otherwise: ignore element
 		}
+		
+		if (compact)
+		{
+			try
+			{
+				decodeCompact(QByteArray::fromBase64(compact_data), coords, [&coords, &offset]() {
+					if (coords.size() == 1)
+					{
+						// Don't apply an offset to text box size.
+						offset.commit();
+						MapCoord::boundsOffset().reset(false);
+					}
+				});
+			}
+			catch (std::invalid_argument& e)
+			{
+				Q_UNUSED(e)
+				qDebug("Could not parse the coordinates: %s", e.what());
+				throw FileFormatException(::OpenOrienteering::ImportExport::tr("Could not parse the coordinates."));
+			}
+		}
 	}
 	catch (std::range_error &e)
 	{
@@ -244,6 +244,12 @@ public:
 	/**
 	 * Writes the coordinates vector as a simple text format.
 	 * This is much more efficient than saving each coordinate as rich XML.
+	 * 
+	 * Since format version 8, the coordinates are written in a compact
+	 * binary encoding, packed as base64 text: For each coordinate, the
+	 * differences to the previous coordinate's x and y are stored as
+	 * variable-length integers, followed by the flags if there are any.
+	 * This is smaller and faster to write and to read than the text format.
 	 */
 	void write(const MapCoordVector& coords);
 	
@@ -342,6 +348,8 @@ public:
 	/**
 	 * Reads the coordinates vector from a simple text format.
 	 * This is much more efficient than loading each coordinate from rich XML.
+	 * 
+	 * This function handles all formats written by XmlElementWriter::write(const MapCoordVector&).
 	 */
 	void read(MapCoordVector& coords);
 	
@@ -425,6 +433,8 @@ namespace XmlStreamLiteral
 	static const QLatin1String height("height");
 	
 	static const QLatin1String count("count");
+	static const QLatin1String encoding("encoding");
+	static const QLatin1String compact("compact");
 	
 	static const QLatin1String object("object");
 	static const QLatin1String tags("tags");
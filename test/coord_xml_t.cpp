@@ -371,6 +371,37 @@ void CoordXmlTest::writeFastImplementation()
 }
 
 
+void CoordXmlTest::writeCompactImplementation_data()
+{
+	common_data();
+}
+
+void CoordXmlTest::writeCompactImplementation()
+{
+	buffer.open(QBuffer::ReadWrite);
+	QXmlStreamWriter xml(&buffer);
+	xml.setAutoFormatting(false);
+	xml.writeStartDocument();
+	
+	const auto saved_version = XMLFileFormat::active_version;
+	XMLFileFormat::active_version = 8; // Activate compact binary format.
+	{
+		XmlElementWriter element(xml, QLatin1String("root"));
+		
+		QFETCH(int, num_coords);
+		MapCoordVector coords(num_coords, proto_coord);
+		QBENCHMARK
+		{
+			element.write(coords);
+		}
+	}
+	XMLFileFormat::active_version = saved_version;
+	
+	xml.writeEndDocument();
+	buffer.close();
+}
+
+
 void CoordXmlTest::readXml_data()
 {
 	common_data();
@@ -1062,6 +1093,79 @@ void CoordXmlTest::readFastImplementation()
 }
 
 
+void CoordXmlTest::readCompactImplementation_data()
+{
+	common_data();
+}
+
+void CoordXmlTest::readCompactImplementation()
+{
+	QFETCH(int, num_coords);
+	MapCoordVector coords(num_coords, proto_coord);
+	
+	buffer.buffer().truncate(0);
+	QBuffer header;
+	{
+		QXmlStreamWriter xml(&header);
+		
+		header.open(QBuffer::ReadWrite);
+		xml.setAutoFormatting(false);
+		xml.writeStartDocument();
+		
+		const auto saved_version = XMLFileFormat::active_version;
+		XMLFileFormat::active_version = 8; // Activate compact binary format.
+		
+		xml.writeStartElement(QString::fromLatin1("root"));
+		xml.writeCharacters(QString{}); // flush root start element
+		
+		buffer.open(QBuffer::ReadWrite);
+		xml.setDevice(&buffer);
+		{
+			XmlElementWriter element(xml, QLatin1String("coords"));
+			element.write(coords);
+		}
+		XMLFileFormat::active_version = saved_version;
+		
+		xml.setDevice(nullptr);
+		
+		buffer.close();
+		header.close();
+	}
+	
+	header.open(QBuffer::ReadOnly);
+	buffer.open(QBuffer::ReadOnly);
+	QXmlStreamReader xml;
+	xml.addData(header.buffer());
+	xml.readNextStartElement();
+	QCOMPARE(xml.name().toString(), QString::fromLatin1("root"));
+	
+	bool failed = false;
+	QBENCHMARK
+	{
+		// benchmark iteration overhead
+		coords.clear();
+		xml.addData(buffer.data());
+		
+		xml.readNextStartElement();
+		if (xml.name() != QLatin1String("coords"))
+		{
+			failed = true;
+			break;
+		}
+		
+		XmlElementReader element(xml);
+		element.read(coords);
+	}
+	
+	QVERIFY(!failed);
+	QCOMPARE((int)coords.size(), num_coords);
+	QVERIFY(compare_all(coords, proto_coord));
+	
+	header.close();
+	buffer.close();
+}
+
+
 bool CoordXmlTest::compare_all(MapCoordVector& coords, MapCoord& expected) const
 {
 	return std::all_of(begin(coords), end(coords), [expected](const MapCoord& coord){ return coord == expected; });
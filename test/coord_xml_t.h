@@ -62,6 +62,10 @@ private slots:
 	void writeFastImplementation();
 	void writeFastImplementation_data();
 	
+	/** Calls the actual compact binary implementation. */
+	void writeCompactImplementation();
+	void writeCompactImplementation_data();
+	
 	/** Reads rich XML. */
 	void readXml();
 	void readXml_data();
@@ -82,6 +86,10 @@ private slots:
 	void readFastImplementation();
 	void readFastImplementation_data();
 	
+	/** Calls the actual compact binary implementation. */
+	void readCompactImplementation();
+	void readCompactImplementation_data();
+
 private:
 	/** The common test data setup. */
 	void common_data();
@@ -21,22 +21,34 @@
 #include "file_format_t.h"
 
 #include <QtTest>
+#include <QImage>
+#include <QImageReader>
+#include <QTemporaryDir>
 
 #include "test_config.h"
+#include "simple_map.h"
 
 #include "global.h"
 #include "settings.h"
 #include "core/georeferencing.h"
+#include "core/image_band_writer.h"
 #include "core/map.h"
 #include "core/map_color.h"
 #include "core/map_grid.h"
+#include "core/map_part.h"
 #include "core/map_printer.h"
 #include "core/objects/object.h"
+#include "core/symbols/area_symbol.h"
+#include "core/symbols/line_symbol.h"
+#include "core/symbols/point_symbol.h"
 #include "fileformats/file_format.h"
 #include "fileformats/file_format_registry.h"
 #include "fileformats/file_import_export.h"
 #include "fileformats/ocad8_file_format.h"
+#include "fileformats/ocd_file_export.h"
+#include "fileformats/ocd_file_import.h"
 #include "fileformats/xml_file_format.h"
+#include "fileformats/xml_file_format_p.h"
 #include "templates/template.h"
 #include "undo/undo.h"
 #include "undo/undo_manager.h"
@@ -516,6 +528,246 @@ void FileFormatTest::pristineMapTest()
 
 
 
+void FileFormatTest::importProgressTest()
+{
+	auto const path = QStringLiteral("data:spotcolor_overprint.xmap");
+	
+	ImportProgress progress;
+	QString error;
+	Map map;
+	auto importer = map.importFrom(path, nullptr, false, &progress, error);
+	QVERIFY(bool(importer));
+	QVERIFY(error.isEmpty());
+	QCOMPARE(progress.parts.load(), map.getNumParts());
+	QCOMPARE(progress.objects.load(), map.getNumObjects());
+	QVERIFY(progress.size > 0);
+	QVERIFY(progress.position > 0);
+	
+	ImportProgress canceled_progress;
+	canceled_progress.canceled = true;
+	Map canceled_map;
+	QVERIFY(!canceled_map.importFrom(path, nullptr, false, &canceled_progress, error));
+	QVERIFY(!error.isEmpty());
+}
+
+
+
+void FileFormatTest::concurrentImportTest_data()
+{
+	QTest::addColumn<QString>("filename");
+	
+	QTest::newRow("issue-513-coords-outside-printable.xmap") << QStringLiteral("data:issue-513-coords-outside-printable.xmap");
+	QTest::newRow("issue-513-coords-outside-qint32.omap") << QStringLiteral("data:issue-513-coords-outside-qint32.omap");
+	QTest::newRow("spotcolor_overprint.xmap") << QStringLiteral("data:spotcolor_overprint.xmap");
+}
+
+void FileFormatTest::concurrentImportTest()
+{
+	QFETCH(QString, filename);
+	
+	Map expected;
+	QVERIFY(expected.loadFrom(filename, nullptr, nullptr, false, false));
+	
+	QFile file(filename);
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	
+	Map actual;
+	auto importer = std::unique_ptr<Importer>(XMLFileFormat().createImporter(&file, &actual, nullptr));
+	QVERIFY(bool(importer));
+	importer->setOption(QStringLiteral("concurrentObjectsMinimumSize"), 0);
+	importer->doImport(false);
+	importer->finishImport();
+	QCOMPARE(actual.getNumObjects(), expected.getNumObjects());
+	
+	QString error;
+	if (!compareMaps(actual, expected, error))
+		QFAIL(QString::fromLatin1("Concurrently loaded map differs, error: %1").arg(error).toLocal8Bit());
+}
+
+
+
+void FileFormatTest::imageBandWriterTest_data()
+{
+	QTest::addColumn<QString>("format");
+	
+	QTest::newRow("PNG") << QStringLiteral("png");
+	QTest::newRow("TIFF") << QStringLiteral("tif");
+	QTest::newRow("BMP") << QStringLiteral("bmp");
+}
+
+void FileFormatTest::imageBandWriterTest()
+{
+	QFETCH(QString, format);
+	if (!QImageReader::supportedImageFormats().contains(format.toLatin1()))
+		QSKIP("Cannot read this format");
+	
+	QImage expected(37, 23, QImage::Format_RGB32);
+	for (int y = 0; y < expected.height(); ++y)
+	{
+		for (int x = 0; x < expected.width(); ++x)
+			expected.setPixel(x, y, qRgb(x * 7, y * 11, (x + y) * 4));
+	}
+	
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	auto const path = dir.path() + QLatin1String("/image.") + format;
+	
+	ImageBandWriter writer(path, expected.size(), 3780);
+	QVERIFY(writer.open());
+	for (int top = 0; top < expected.height(); top += 10)
+		QVERIFY(writer.write(expected.copy(0, top, expected.width(), qMin(10, expected.height() - top))));
+	QVERIFY2(writer.close(), qPrintable(writer.errorString()));
+	
+	QImage actual(path);
+	QCOMPARE(actual.size(), expected.size());
+	QCOMPARE(actual.convertToFormat(QImage::Format_RGB32), expected);
+	QCOMPARE(actual.dotsPerMeterX(), 3780);
+	
+	// Such small images are normally written by QImageWriter.
+	QVERIFY(!ImageBandWriter::isStreamingNeeded(expected.size()));
+	QVERIFY(ImageBandWriter::isStreamingNeeded(QSize(20000, 20000)));
+}
+
+
+
+void FileFormatTest::ocdRoundTrip_data()
+{
+	QTest::addColumn<int>("version");
+	
+	QTest::newRow("OCD 11") << 11;
+	QTest::newRow("OCD 12") << 12;
+}
+
+void FileFormatTest::ocdRoundTrip()
+{
+	QFETCH(int, version);
+	
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	auto color = fixture.color;
+	color->setCmyk({0.5f, 0.0f, 0.8f, 0.1f});
+	color->setRgbFromCmyk();
+	
+	auto line_symbol = fixture.line;
+	line_symbol->setNumberComponent(0, 102);
+	line_symbol->setNumberComponent(1, 1);
+	
+	auto point_symbol = new PointSymbol();
+	point_symbol->setNumberComponent(0, 101);
+	point_symbol->setNumberComponent(1, 1);
+	point_symbol->setInnerRadius(500);
+	point_symbol->setInnerColor(color);
+	map.addSymbol(point_symbol, 0);
+	
+	auto area_symbol = new AreaSymbol();
+	area_symbol->setNumberComponent(0, 103);
+	area_symbol->setNumberComponent(1, 1);
+	area_symbol->setColor(color);
+	map.addSymbol(area_symbol, 2);
+	
+	auto point = new PointObject(point_symbol);
+	point->setPosition(MapCoord(5.0, -5.0));
+	map.addObject(point);
+	
+	fixture.addLine({ MapCoord(0.0, 0.0), MapCoord(10.0, 0.0), MapCoord(10.0, 20.5) });
+	
+	auto area = new PathObject(area_symbol, { MapCoord(-10.0, -10.0), MapCoord(0.0, -10.0), MapCoord(0.0, 0.0) });
+	area->closeAllParts();
+	map.addObject(area);
+	
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	OcdFileExport exporter(&buffer, &map, nullptr, quint16(version));
+	exporter.doExport();
+	QVERIFY(buffer.size() > 0);
+	
+	Map reloaded_map {};
+	buffer.seek(0);
+	OcdFileImport importer(&buffer, &reloaded_map, nullptr);
+	importer.doImport(false);
+	importer.finishImport();
+	
+	QCOMPARE(reloaded_map.getNumColors(), map.getNumColors());
+	QCOMPARE(reloaded_map.getColor(0)->getName(), color->getName());
+	QCOMPARE(reloaded_map.getColor(0)->getCmyk().c, color->getCmyk().c);
+	QCOMPARE(reloaded_map.getColor(0)->getCmyk().y, color->getCmyk().y);
+	
+	QCOMPARE(reloaded_map.getNumSymbols(), map.getNumSymbols());
+	for (int i = 0; i < map.getNumSymbols(); ++i)
+	{
+		auto expected = map.getSymbol(i);
+		auto actual = reloaded_map.getSymbol(i);
+		QCOMPARE(int(actual->getType()), int(expected->getType()));
+		QCOMPARE(actual->getNumberComponent(0), expected->getNumberComponent(0));
+		QCOMPARE(actual->getNumberComponent(1), expected->getNumberComponent(1));
+	}
+	
+	QCOMPARE(reloaded_map.getNumObjects(), map.getNumObjects());
+	auto expected_part = map.getCurrentPart();
+	auto actual_part = reloaded_map.getPart(0);
+	for (int i = 0; i < expected_part->getNumObjects(); ++i)
+	{
+		auto expected = expected_part->getObject(i);
+		auto actual = actual_part->getObject(i);
+		QCOMPARE(int(actual->getType()), int(expected->getType()));
+		QCOMPARE(map.findSymbolIndex(expected->getSymbol()), reloaded_map.findSymbolIndex(actual->getSymbol()));
+		QCOMPARE(actual->getRawCoordinateVector().size(), expected->getRawCoordinateVector().size());
+		for (std::size_t j = 0; j < expected->getRawCoordinateVector().size(); ++j)
+		{
+			QCOMPARE(actual->getRawCoordinateVector()[j].nativeX(), expected->getRawCoordinateVector()[j].nativeX());
+			QCOMPARE(actual->getRawCoordinateVector()[j].nativeY(), expected->getRawCoordinateVector()[j].nativeY());
+		}
+	}
+}
+
+
+
+void FileFormatTest::compactCoordinatesRoundTrip()
+{
+	const auto saved_version = XMLFileFormat::active_version;
+	
+	SimpleMap fixture;
+	const MapCoordVector expected = {
+	    MapCoord::fromNative(0, 0),
+	    MapCoord::fromNative(12345, -6789, MapCoord::DashPoint),
+	    MapCoord::fromNative(-12345, 6789, MapCoord::CurveStart),
+	    MapCoord::fromNative(-12300, 6800),
+	    MapCoord::fromNative(4000000, -4000000),
+	    MapCoord::fromNative(-4000000, 4000000),
+	    MapCoord::fromNative(1, -1),
+	};
+	fixture.addLine(expected);
+	
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	XMLFileExporter exporter(&buffer, &fixture.map, nullptr);
+	exporter.setOption(QString::fromLatin1("autoFormatting"), false);
+	exporter.setOption(QString::fromLatin1("compactCoordinates"), true);
+	exporter.doExport();
+	auto const written_version = XMLFileFormat::active_version;
+	XMLFileFormat::active_version = saved_version;
+	QCOMPARE(written_version, 8);
+	QVERIFY(buffer.data().contains("encoding=\"compact\""));
+	
+	Map reloaded_map {};
+	buffer.seek(0);
+	XMLFileImporter importer(&buffer, &reloaded_map, nullptr);
+	importer.doImport(false);
+	importer.finishImport();
+	
+	QCOMPARE(reloaded_map.getNumObjects(), 1);
+	auto const& actual = reloaded_map.getPart(0)->getObject(0)->getRawCoordinateVector();
+	QCOMPARE(actual.size(), expected.size());
+	for (std::size_t i = 0; i < expected.size(); ++i)
+	{
+		QCOMPARE(actual[i].nativeX(), expected[i].nativeX());
+		QCOMPARE(actual[i].nativeY(), expected[i].nativeY());
+		QCOMPARE(actual[i].flags(), expected[i].flags());
+	}
+}
+
+
+
 /*
  * We don't need a real GUI window.
  * 
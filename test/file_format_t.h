@@ -61,6 +61,37 @@ private slots:
 	 * through an implicit export-import-cycle before the test.
 	 */
 	void pristineMapTest();
+	
+	/**
+	 * Tests progress reporting and cancellation when importing a map.
+	 */
+	void importProgressTest();
+	
+	/**
+	 * Tests that loading the objects of XML maps concurrently gives the
+	 * same result as sequential loading.
+	 */
+	void concurrentImportTest();
+	void concurrentImportTest_data();
+	
+	/**
+	 * Tests that images written in bands can be read by QImage.
+	 */
+	void imageBandWriterTest();
+	void imageBandWriterTest_data();
+	
+	/**
+	 * Tests that maps exported by the native OCD exporter are loaded
+	 * correctly by the OCD importer.
+	 */
+	void ocdRoundTrip();
+	void ocdRoundTrip_data();
+	
+	/**
+	 * Tests that coordinates written by the XML exporter in the compact
+	 * encoding are loaded correctly by the XML importer.
+	 */
+	void compactCoordinatesRoundTrip();
 };
 
 #endif // OPENORIENTEERING_FILE_FORMAT_T_H
@@ -19,6 +19,11 @@
 
 #include "georeferencing_t.h"
 
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
 #include <QtTest>
 
 #include <proj_api.h>
@@ -220,5 +225,87 @@ void GeoreferencingTest::testProjection()
 }
 
 
+void GeoreferencingTest::testBatchTransformation()
+{
+	QVERIFY(georef.setProjectedCRS(utm32_spec, utm32_spec));
+	georef.setGeographicRefPoint(LatLon(50.0, 7.5));
+	
+	const std::vector<LatLon> lat_lon = {
+	    LatLon(degFromDMS(50, 21, 32.2), degFromDMS( 7, 34, 4.0)),
+	    LatLon(degFromDMS(50, 12, 36.1), degFromDMS( 6, 25, 39.6)),
+	    LatLon(degFromDMS(49, 12,  4.2), degFromDMS( 8,  7, 52.0)),
+	};
+	
+	auto map_coords = std::vector<MapCoordF>(lat_lon.size());
+	QVERIFY(georef.toMapCoordF(lat_lon.data(), map_coords.data(), lat_lon.size()));
+	for (std::size_t i = 0; i < lat_lon.size(); ++i)
+	{
+		auto const expected = georef.toMapCoordF(lat_lon[i]);
+		QVERIFY(qAbs(map_coords[i].x() - expected.x()) < 0.001);
+		QVERIFY(qAbs(map_coords[i].y() - expected.y()) < 0.001);
+	}
+	
+	auto geographic_coords = std::vector<LatLon>(map_coords.size());
+	QVERIFY(georef.toGeographicCoords(map_coords.data(), geographic_coords.data(), map_coords.size()));
+	for (std::size_t i = 0; i < map_coords.size(); ++i)
+	{
+		QVERIFY(qAbs(geographic_coords[i].latitude() - lat_lon[i].latitude()) < 0.000001);
+		QVERIFY(qAbs(geographic_coords[i].longitude() - lat_lon[i].longitude()) < 0.000001);
+	}
+	
+	auto projected_coords = std::vector<QPointF>(map_coords.size());
+	georef.toProjectedCoords(map_coords.data(), projected_coords.data(), map_coords.size());
+	auto round_trip = std::vector<MapCoordF>(map_coords.size());
+	georef.toMapCoordF(projected_coords.data(), round_trip.data(), projected_coords.size());
+	for (std::size_t i = 0; i < map_coords.size(); ++i)
+	{
+		auto const expected = georef.toProjectedCoords(map_coords[i]);
+		QVERIFY(qAbs(projected_coords[i].x() - expected.x()) < 0.001);
+		QVERIFY(qAbs(projected_coords[i].y() - expected.y()) < 0.001);
+		QVERIFY(qAbs(round_trip[i].x() - map_coords[i].x()) < 0.001);
+		QVERIFY(qAbs(round_trip[i].y() - map_coords[i].y()) < 0.001);
+	}
+	
+	Georeferencing other(georef);
+	auto other_coords = std::vector<MapCoordF>(map_coords.size());
+	QVERIFY(georef.toMapCoordF(&other, map_coords.data(), other_coords.data(), map_coords.size()));
+	for (std::size_t i = 0; i < map_coords.size(); ++i)
+	{
+		QVERIFY(qAbs(other_coords[i].x() - map_coords[i].x()) < 0.001);
+		QVERIFY(qAbs(other_coords[i].y() - map_coords[i].y()) < 0.001);
+	}
+}
+
+void GeoreferencingTest::testBatchTransformationFailure()
+{
+	// Orthographic projections cannot project the far side of the earth.
+	Georeferencing other;
+	QVERIFY(other.setProjectedCRS(QStringLiteral("ortho"), QStringLiteral("+proj=ortho +lat_0=50 +lon_0=7.5 +datum=WGS84")));
+	other.setGeographicRefPoint(LatLon(50.0, 7.5));
+	Georeferencing target;
+	QVERIFY(target.setProjectedCRS(QStringLiteral("ortho"), QStringLiteral("+proj=ortho +lat_0=0 +lon_0=110 +datum=WGS84")));
+	target.setGeographicRefPoint(LatLon(0.0, 110.0));
+	
+	// The second point is not visible in the target projection.
+	const std::vector<MapCoordF> map_coords = {
+	    other.toMapCoordF(LatLon(0.0, 80.0)),
+	    other.toMapCoordF(LatLon(50.0, 7.5)),
+	    other.toMapCoordF(LatLon(10.0, 70.0)),
+	};
+	
+	auto target_coords = std::vector<MapCoordF>(map_coords.size());
+	QVERIFY(!target.toMapCoordF(&other, map_coords.data(), target_coords.data(), map_coords.size()));
+	QVERIFY(target_coords[1].x() == HUGE_VAL);
+	QVERIFY(target_coords[1].y() == HUGE_VAL);
+	for (auto i : { 0, 2 })
+	{
+		auto ok = false;
+		auto const expected = target.toMapCoordF(&other, map_coords[i], &ok);
+		QVERIFY(ok);
+		QVERIFY(qAbs(target_coords[i].x() - expected.x()) < 0.001);
+		QVERIFY(qAbs(target_coords[i].y() - expected.y()) < 0.001);
+	}
+}
+
 
 QTEST_GUILESS_MAIN(GeoreferencingTest)
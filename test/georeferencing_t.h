@@ -70,6 +70,17 @@ private slots:
 	
 	void testProjection_data();
 	
+	/**
+	 * Tests whether batch transformations match single point transformations.
+	 */
+	void testBatchTransformation();
+	
+	/**
+	 * Tests that a point which cannot be transformed does not affect
+	 * the other points of a batch.
+	 */
+	void testBatchTransformationFailure();
+
 private:
 	Georeferencing georef;
 };
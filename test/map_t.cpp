@@ -19,21 +19,37 @@
 
 #include "map_t.h"
 
+#include <cmath>
+
+#include <QtMath>
 #include <QtTest>
 #include <QBuffer>
+#include <QFileInfo>
+#include <QImage>
 #include <QMessageBox>
+#include <QTemporaryDir>
 #include <QTextStream>
 
 #include "test_config.h"
+#include "simple_map.h"
 
 #include "global.h"
+#include "headless_export.h"
+#include "core/georeferencing.h"
+#include "core/latlon.h"
 #include "core/map.h"
 #include "core/map_color.h"
+#include "core/map_coord.h"
+#include "core/map_part.h"
 #include "core/map_printer.h" // IWYU pragma: keep
 #include "core/map_view.h"
+#include "core/objects/object.h"
 #include "core/objects/symbol_rule_set.h"
+#include "core/symbols/line_symbol.h"
 #include "core/symbols/symbol.h"
 #include "core/symbols/point_symbol.h"
+#include "core/symbols/text_symbol.h"
+#include "core/web_tile_exporter.h"
 
 using namespace OpenOrienteering;
 
@@ -177,6 +193,223 @@ void MapTest::specialColorsTest()
 	QCOMPARE(cmap.getColor(cmap.getNumColors()), static_cast<MapColor*>(nullptr));
 }
 
+void MapTest::findObjectsTest()
+{
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	auto const makeLine = [&fixture](qreal x, qreal y) {
+		return new PathObject(fixture.line, { MapCoord(x, y), MapCoord(x + 1, y) });
+	};
+	
+	auto const findInBox = [&map](qreal x, qreal y) {
+		std::vector<Object*> out;
+		map.findObjectsAtBox(MapCoordF(x, y), MapCoordF(x + 2, y + 2), false, false, out);
+		return out;
+	};
+	
+	auto a = makeLine(0, 0);
+	auto b = makeLine(100, 100);
+	auto c = makeLine(0.5, 0.5);
+	map.addObject(a);
+	map.addObject(b);
+	QCOMPARE(findInBox(-0.5, -0.5), std::vector<Object*>{ a });
+	QCOMPARE(findInBox(99.5, 99.5), std::vector<Object*>{ b });
+	QCOMPARE(map.countObjectsInRect(QRectF(-1, -1, 200, 200), false), 2);
+	
+	// Results are in z-order.
+	map.getCurrentPart()->addObject(c, 0);
+	QCOMPARE(findInBox(-0.5, -0.5), (std::vector<Object*>{ c, a }));
+	
+	SelectionInfoVector at;
+	map.findObjectsAt(MapCoordF(100.5, 100), 0.01f, false, false, false, false, at);
+	QCOMPARE(int(at.size()), 1);
+	QCOMPARE(at.front().second, b);
+	
+	// Moved objects are found at their new position.
+	b->move(MapCoord(-100, -100));
+	map.updateObjects();
+	QCOMPARE(findInBox(99.5, 99.5), std::vector<Object*>{ });
+	QCOMPARE(findInBox(-0.5, -0.5), (std::vector<Object*>{ c, a, b }));
+	
+	map.deleteObject(c, false);
+	QCOMPARE(findInBox(-0.5, -0.5), (std::vector<Object*>{ a, b }));
+	QCOMPARE(map.countObjectsInRect(QRectF(-1, -1, 200, 200), false), 2);
+}
+
+void MapTest::updateObjectsTest()
+{
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	std::vector<Object*> objects;
+	for (int i = 0; i < 100; ++i)
+		objects.push_back(fixture.addLine({ MapCoord(i, 0), MapCoord(i, 1) }));
+	map.updateObjects();
+	map.resetObjectUpdateCounters();
+	
+	map.updateObjects();
+	QCOMPARE(map.objectUpdateCounters().visited, std::size_t(0));
+	
+	objects[10]->move(MapCoord(1, 1));
+	objects[20]->move(MapCoord(1, 1));
+	objects[20]->move(MapCoord(1, 1));
+	QCOMPARE(map.objectUpdateCounters().enlisted, std::size_t(2));
+	map.updateObjects();
+	QCOMPARE(map.objectUpdateCounters().visited, std::size_t(2));
+	QCOMPARE(map.objectUpdateCounters().updated, std::size_t(2));
+	QVERIFY(!objects[10]->isOutputDirty());
+	QVERIFY(!objects[20]->isOutputDirty());
+	
+	// Deleted objects are skipped.
+	map.resetObjectUpdateCounters();
+	objects[30]->move(MapCoord(1, 1));
+	map.deleteObject(objects[30], false);
+	map.updateObjects();
+	QCOMPARE(map.objectUpdateCounters().visited, std::size_t(1));
+	QCOMPARE(map.objectUpdateCounters().updated, std::size_t(0));
+	
+	// Forced updates remove the objects from the list.
+	objects[40]->move(MapCoord(1, 1));
+	map.updateAllObjectsWithSymbol(fixture.line);
+	map.resetObjectUpdateCounters();
+	map.updateObjects();
+	QCOMPARE(map.objectUpdateCounters().visited, std::size_t(0));
+	QVERIFY(!objects[40]->isOutputDirty());
+}
+
+void MapTest::updateAllObjectsTest()
+{
+	Map map;
+	QVERIFY(map.loadFrom(examples_dir.absoluteFilePath(QStringLiteral("complete map.omap")), nullptr, nullptr, false, false));
+	QVERIFY(map.getNumObjects() > 0);
+	
+	map.updateAllObjects();
+	std::vector<QRectF> extents;
+	map.applyOnAllObjects([&extents](const Object* object) {
+		QVERIFY(!object->isOutputDirty());
+		extents.push_back(object->getExtent());
+	});
+	
+	// Loading enlisted all objects as dirty, but none is left now.
+	map.resetObjectUpdateCounters();
+	map.updateObjects();
+	QCOMPARE(map.objectUpdateCounters().visited, std::size_t(0));
+	
+	// Sequential update
+	map.applyOnAllObjects(&Object::forceUpdate);
+	auto extent = begin(extents);
+	map.applyOnAllObjects([&extent](const Object* object) {
+		QCOMPARE(object->getExtent(), *extent);
+		++extent;
+	});
+	QVERIFY(extent == end(extents));
+}
+
+void MapTest::symbolIndexTest()
+{
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	auto line = fixture.line;
+	auto point = new PointSymbol();
+	map.addSymbol(point, 1);
+	QCOMPARE(map.findSymbolIndex(line), 0);
+	QCOMPARE(map.findSymbolIndex(point), 1);
+	QCOMPARE(map.findSymbolIndex(map.getUndefinedLine()), -3);
+	
+	map.moveSymbol(1, 0);
+	QCOMPARE(map.findSymbolIndex(point), 0);
+	QCOMPARE(map.findSymbolIndex(line), 1);
+	
+	auto replacement = new PointSymbol();
+	map.setSymbol(replacement, 0);  // deletes point
+	QCOMPARE(map.findSymbolIndex(replacement), 0);
+	QCOMPARE(map.findSymbolIndex(line), 1);
+	
+	map.sortSymbols([line](const Symbol* a, const Symbol* b) { return a == line && b != line; });
+	QCOMPARE(map.findSymbolIndex(line), 0);
+	QCOMPARE(map.findSymbolIndex(replacement), 1);
+	
+	auto text = new TextSymbol();
+	map.addSymbol(text, 1);
+	QCOMPARE(map.findSymbolIndex(text), 1);
+	QCOMPARE(map.findSymbolIndex(replacement), 2);
+	
+	map.deleteSymbol(1);
+	QCOMPARE(map.findSymbolIndex(replacement), 1);
+}
+
+void MapTest::deleteObjectsTest()
+{
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	std::vector<Object*> objects;
+	for (int i = 0; i < 100; ++i)
+		objects.push_back(fixture.addLine({ MapCoord(i, 0), MapCoord(i, 1) }));
+	auto part = map.getCurrentPart();
+	QCOMPARE(part->findObjectIndex(objects[42]), 42);
+	
+	for (int i = 0; i < 100; i += 3)
+		map.addObjectToSelection(objects[std::size_t(i)], false);
+	map.deleteSelectedObjects();
+	QCOMPARE(part->getNumObjects(), 66);
+	QVERIFY(!part->containsObject(objects[3]));
+	QCOMPARE(part->findObjectIndex(objects[4]), 2);
+	QCOMPARE(part->findObjectIndex(objects[98]), 65);
+	
+	QVERIFY(map.undoManager().undo());
+	QCOMPARE(part->getNumObjects(), 100);
+	for (int i = 0; i < 100; ++i)
+	{
+		QCOMPARE(part->getObject(i), objects[std::size_t(i)]);
+		QCOMPARE(part->findObjectIndex(objects[std::size_t(i)]), i);
+	}
+	
+	QVERIFY(map.undoManager().redo());
+	QCOMPARE(part->getNumObjects(), 66);
+	QCOMPARE(part->findObjectIndex(objects[98]), 65);
+	QVERIFY(!part->deleteObject(objects[3], false));
+}
+
+void MapTest::objectsWithSymbolTest()
+{
+	SimpleMap fixture;
+	auto& map = fixture.map;
+	auto line_1 = fixture.line;
+	auto line_2 = line_1->duplicate();
+	map.addSymbol(line_2, 1);
+	auto line_3 = line_1->duplicate();
+	map.addSymbol(line_3, 2);
+	
+	std::vector<Object*> objects;
+	for (int i = 0; i < 10; ++i)
+	{
+		objects.push_back(new PathObject(i % 2 ? line_1 : line_2, { MapCoord(i, 0), MapCoord(i, 1) }));
+		map.addObject(objects.back());
+	}
+	auto part = map.getCurrentPart();
+	QVERIFY(map.existsObjectWithSymbol(line_1));
+	QVERIFY(!map.existsObjectWithSymbol(line_3));
+	QCOMPARE(part->objectsWithSymbol(line_1), (std::vector<Object*>{ objects[1], objects[3], objects[5], objects[7], objects[9] }));
+	
+	objects[3]->setSymbol(line_3, true);
+	QVERIFY(map.existsObjectWithSymbol(line_3));
+	QCOMPARE(part->objectsWithSymbol(line_3), std::vector<Object*>{ objects[3] });
+	QCOMPARE(part->objectsWithSymbol(line_1).size(), std::size_t(4));
+	
+	std::vector<bool> in_use;
+	map.determineSymbolsInUse(in_use);
+	QCOMPARE(in_use, (std::vector<bool>{ true, true, true }));
+	
+	map.changeSymbolForAllObjects(line_3, line_1);
+	QVERIFY(!map.existsObjectWithSymbol(line_3));
+	QCOMPARE(part->objectsWithSymbol(line_1).size(), std::size_t(5));
+	
+	QVERIFY(map.deleteAllObjectsWithSymbol(line_2));
+	QCOMPARE(part->getNumObjects(), 5);
+	QVERIFY(!map.existsObjectWithSymbol(line_2));
+	map.determineSymbolsInUse(in_use);
+	QCOMPARE(in_use, (std::vector<bool>{ true, false, false }));
+}
+
 void MapTest::importTest_data()
 {
 	QTest::addColumn<QString>("first_file");
@@ -325,6 +558,112 @@ void MapTest::matchQuerySymbolNumberTest()
 }
 
 
+void MapTest::webTileTest()
+{
+#ifdef QT_PRINTSUPPORT_LIB
+	Map map;
+	Georeferencing georef;
+	georef.setScaleDenominator(10000);
+	QVERIFY(georef.setProjectedCRS(QStringLiteral("UTM"), QStringLiteral("+proj=utm +zone=32 +datum=WGS84")));
+	georef.setGeographicRefPoint(LatLon(50.0, 7.5));
+	map.setGeoreferencing(georef);
+	
+	WebTileExporter exporter(map, nullptr);
+	QCOMPARE(exporter.tileCount(), qint64(-1));
+	QVERIFY(!exporter.errorString().isEmpty());
+	
+	// The tile which contains the reference point at zoom level 15
+	auto const zoom = 15;
+	auto const x = 17066;
+	auto const y = 11113;
+	auto const tile_corner = [](int tile_x, int tile_y) {
+		auto const n = double(1 << zoom);
+		return LatLon(qRadiansToDegrees(std::atan(std::sinh(M_PI * (1 - 2 * tile_y / n)))), tile_x / n * 360 - 180);
+	};
+	
+	auto const map_to_tile = exporter.mapToTile(zoom, x, y);
+	QVERIFY(map_to_tile.isInvertible());
+	
+	auto const top_left = map_to_tile.map(QPointF(map.getGeoreferencing().toMapCoordF(tile_corner(x, y))));
+	QVERIFY(std::abs(top_left.x()) < 0.01);
+	QVERIFY(std::abs(top_left.y()) < 0.01);
+	
+	// Within a tile, the transformation is approximately affine.
+	auto const bottom_right = map_to_tile.map(QPointF(map.getGeoreferencing().toMapCoordF(tile_corner(x + 1, y + 1))));
+	QVERIFY(std::abs(bottom_right.x() - WebTileExporter::tile_size) < 0.5);
+	QVERIFY(std::abs(bottom_right.y() - WebTileExporter::tile_size) < 0.5);
+	
+	auto const ref_point = map_to_tile.map(QPointF(map.getGeoreferencing().toMapCoordF(LatLon(50.0, 7.5))));
+	QVERIFY(QRectF(0, 0, WebTileExporter::tile_size, WebTileExporter::tile_size).contains(ref_point));
+#else
+	QSKIP("Web map tiles require Qt PrintSupport");
+#endif
+}
+
+
+void MapTest::headlessExportTest()
+{
+#ifdef QT_PRINTSUPPORT_LIB
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	auto const input = examples_dir.absoluteFilePath(QStringLiteral("complete map.omap"));
+	auto const arguments = QStringList {
+	    QStringLiteral("Mapper"),
+	    QStringLiteral("--export"),
+	    QStringLiteral("--resolution"), QStringLiteral("50"),
+	};
+	
+	auto const image_path = dir.filePath(QStringLiteral("complete map.png"));
+	{
+		HeadlessExport exporter;
+		QCOMPARE(exporter.run(arguments + QStringList{ QStringLiteral("--format"), QStringLiteral("png"),
+		                                              QStringLiteral("--output"), image_path, input }),
+		         int(HeadlessExport::Success));
+	}
+	QVERIFY(QFileInfo::exists(image_path));
+	
+	Map map;
+	QVERIFY(map.loadFrom(input, nullptr, nullptr, false, false));
+	MapPrinter map_printer(map, nullptr);
+	map_printer.setTarget(MapPrinter::imageTarget());
+	map_printer.setResolution(50);
+	QImage image(image_path);
+	QVERIFY(!image.isNull());
+	QCOMPARE(image.size(), map_printer.imageSize());
+	
+	auto const map_path = dir.filePath(QStringLiteral("complete map.omap"));
+	{
+		HeadlessExport exporter;
+		QCOMPARE(exporter.run(arguments + QStringList{ QStringLiteral("--format"), QStringLiteral("omap"),
+		                                              QStringLiteral("--output"), map_path, input }),
+		         int(HeadlessExport::Success));
+	}
+	Map converted_map;
+	QVERIFY(converted_map.loadFrom(map_path, nullptr, nullptr, false, false));
+	QCOMPARE(converted_map.getNumObjects(), map.getNumObjects());
+	
+	// Failures give a non-zero exit code.
+	{
+		HeadlessExport exporter;
+		QCOMPARE(exporter.run(arguments + QStringList{ QStringLiteral("--format"), QStringLiteral("png"),
+		                                              dir.filePath(QStringLiteral("missing.omap")) }),
+		         int(HeadlessExport::ExportFailed));
+	}
+	{
+		HeadlessExport exporter;
+		QCOMPARE(exporter.run(arguments + QStringList{ QStringLiteral("--format"), QStringLiteral("invalid"), input }),
+		         int(HeadlessExport::InvalidArguments));
+	}
+	{
+		HeadlessExport exporter;
+		QCOMPARE(exporter.run(arguments + QStringList{ QStringLiteral("--unknown-option"), input }),
+		         int(HeadlessExport::InvalidArguments));
+	}
+#else
+	QSKIP("The headless export requires Qt PrintSupport");
+#endif
+}
+
 
 /*
  * We don't need a real GUI window.
@@ -44,6 +44,24 @@ private slots:
 	/** Tests if special colors are correctly handled. */
 	void specialColorsTest();
 	
+	/** Tests finding objects by position, and the part's spatial index. */
+	void findObjectsTest();
+	
+	/** Tests that updating objects visits only the changed objects. */
+	void updateObjectsTest();
+	
+	/** Tests that updating all objects in parallel gives the sequential result. */
+	void updateAllObjectsTest();
+	
+	/** Tests the symbol index lookup. */
+	void symbolIndexTest();
+	
+	/** Tests the object index lookup, and deleting many objects. */
+	void deleteObjectsTest();
+	
+	/** Tests the lookup of objects by symbol. */
+	void objectsWithSymbolTest();
+	
 	/** Tests various modes of Map::importMap(). */
 	void importTest_data();
 	void importTest();
@@ -55,6 +73,12 @@ private slots:
 	void matchQuerySymbolNumberTest_data();
 	void matchQuerySymbolNumberTest();
 	
+	/** Tests the transformation and coverage of web map tiles. */
+	void webTileTest();
+	
+	/** Tests the headless export of images and maps, and its exit codes. */
+	void headlessExportTest();
+
 };
 
 #endif
@@ -0,0 +1,180 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "renderables_t.h"
+
+#include <cmath>
+#include <memory>
+
+#include <QtTest>
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+#include <QString>
+
+#include "global.h"
+#include "core/map.h"
+#include "core/map_color.h"
+#include "core/map_coord.h"
+#include "core/objects/object.h"
+#include "core/renderables/renderable.h"
+#include "core/symbols/area_symbol.h"
+#include "core/symbols/line_symbol.h"
+
+using namespace OpenOrienteering;
+
+
+namespace
+{
+	/// The number of objects per row and column in the test map
+	constexpr int grid_size = 200;
+	
+	/// The distance of the objects in the test map, in mm
+	constexpr qreal spacing = 5.0;
+	
+	/// The test map
+	std::unique_ptr<Map> map;  // clazy:exclude=non-pod-global-static
+	
+	/// The spot color of the test map
+	const MapColor* spot_color = nullptr;
+	
+	
+	void common_data()
+	{
+		QTest::addColumn<qreal>("fraction");
+		QTest::newRow("1/64 of the map")  << qreal(0.015625);
+		QTest::newRow("1/16 of the map")  << qreal(0.0625);
+		QTest::newRow("1/4 of the map")   << qreal(0.25);
+		QTest::newRow("the full map")     << qreal(1);
+	}
+	
+	QRectF boundingBox(qreal fraction)
+	{
+		auto const extent = map->calculateExtent();
+		auto const width = extent.width() * std::sqrt(fraction);
+		auto const height = extent.height() * std::sqrt(fraction);
+		return { extent.center().x() - width/2, extent.center().y() - height/2, width, height };
+	}
+
+
+}  // namespace
+
+
+
+void RenderablesTest::initTestCase()
+{
+	doStaticInitializations();
+	
+	map = std::make_unique<Map>();
+	
+	auto color = std::make_unique<MapColor>(QString::fromLatin1("spot color"), 0);
+	color->setSpotColorName(QString::fromLatin1("SPOTCOLOR"));
+	color->setCmyk({0.0f, 0.0f, 0.0f, 1.0f});
+	color->setRgbFromCmyk();
+	spot_color = color.get();
+	map->addColor(color.release(), 0);
+	
+	auto line_symbol = new LineSymbol();
+	line_symbol->setColor(spot_color);
+	line_symbol->setLineWidth(0.2);
+	map->addSymbol(line_symbol, 0);
+	
+	auto area_symbol = new AreaSymbol();
+	area_symbol->setColor(spot_color);
+	map->addSymbol(area_symbol, 1);
+	
+	// Small closed paths, as in a city map with many buildings
+	for (int y = 0; y < grid_size; ++y)
+	{
+		for (int x = 0; x < grid_size; ++x)
+		{
+			auto const left = x * spacing;
+			auto const top = y * spacing;
+			auto const size = spacing / 2;
+			auto const symbol = (x + y) % 2 ? static_cast<Symbol*>(line_symbol) : static_cast<Symbol*>(area_symbol);
+			map->addObject(new PathObject(symbol, {
+			    MapCoord(left, top),
+			    MapCoord(left + size, top),
+			    MapCoord(left + size, top + size),
+			    MapCoord(left, top + size),
+			    MapCoord(left, top, MapCoord::ClosePoint)
+			}));
+		}
+	}
+	map->updateObjects();
+	QCOMPARE(map->getNumObjects(), grid_size * grid_size);
+}
+
+
+void RenderablesTest::drawBenchmark_data()
+{
+	common_data();
+}
+
+void RenderablesTest::drawBenchmark()
+{
+	QFETCH(qreal, fraction);
+	auto const bounding_box = boundingBox(fraction);
+	
+	QImage image(512, 512, QImage::Format_ARGB32_Premultiplied);
+	QPainter painter(&image);
+	painter.scale(image.width() / bounding_box.width(), image.height() / bounding_box.height());
+	painter.translate(-bounding_box.topLeft());
+	
+	RenderConfig config = { *map, bounding_box, painter.transform().m11(), RenderConfig::Screen, 1.0 };
+	QBENCHMARK
+	{
+		map->draw(&painter, config);
+	}
+}
+
+
+void RenderablesTest::drawColorSeparationBenchmark_data()
+{
+	common_data();
+}
+
+void RenderablesTest::drawColorSeparationBenchmark()
+{
+	QFETCH(qreal, fraction);
+	auto const bounding_box = boundingBox(fraction);
+	
+	QImage image(512, 512, QImage::Format_ARGB32_Premultiplied);
+	QPainter painter(&image);
+	painter.scale(image.width() / bounding_box.width(), image.height() / bounding_box.height());
+	painter.translate(-bounding_box.topLeft());
+	
+	RenderConfig config = { *map, bounding_box, painter.transform().m11(), RenderConfig::NoOptions, 1.0 };
+	QBENCHMARK
+	{
+		map->drawColorSeparation(&painter, config, spot_color);
+	}
+}
+
+
+
+/*
+ * We don't need a real GUI window.
+ */
+namespace  {
+	auto qpa_selected = qputenv("QT_QPA_PLATFORM", "minimal");  // clazy:exclude=non-pod-global-static
+}
+
+
+QTEST_MAIN(RenderablesTest)
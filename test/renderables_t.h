@@ -0,0 +1,47 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENORIENTEERING_RENDERABLES_T_H
+#define OPENORIENTEERING_RENDERABLES_T_H
+
+#include <QObject>
+
+
+/**
+ * @test Benchmarks drawing the renderables of a large map
+ *       for different sizes of the visible area.
+ */
+class RenderablesTest : public QObject
+{
+Q_OBJECT
+private slots:
+	/** Initialization. */
+	void initTestCase();
+	
+	/** Draws a fixed number of objects, varying the bounding box. */
+	void drawBenchmark_data();
+	void drawBenchmark();
+	
+	/** Draws a color separation, varying the bounding box. */
+	void drawColorSeparationBenchmark_data();
+	void drawColorSeparationBenchmark();
+
+};
+
+#endif
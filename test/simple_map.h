@@ -0,0 +1,68 @@
+/*
+ *    Copyright 2018 Kai Pastor
+ *
+ *    This file is part of OpenOrienteering.
+ *
+ *    OpenOrienteering is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    OpenOrienteering is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with OpenOrienteering.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPENORIENTEERING_SIMPLE_MAP_H
+#define OPENORIENTEERING_SIMPLE_MAP_H
+
+#include <QString>
+
+#include "core/map.h"
+#include "core/map_color.h"
+#include "core/map_coord.h"
+#include "core/objects/object.h"
+#include "core/symbols/line_symbol.h"
+
+namespace OpenOrienteering {
+
+
+/**
+ * A map with a single black color and a line symbol.
+ *
+ * This is a fixture for tests which need some simple objects.
+ */
+struct SimpleMap
+{
+	Map map;
+	MapColor* const color = new MapColor(QString::fromLatin1("black"), 0);
+	LineSymbol* const line = new LineSymbol();
+
+	SimpleMap()
+	{
+		map.addColor(color, 0);
+		line->setColor(color);
+		line->setLineWidth(0.1);
+		map.addSymbol(line, 0);
+	}
+
+	/**
+	 * Adds a line object with the given coordinates to the current map part.
+	 */
+	PathObject* addLine(const MapCoordVector& coords)
+	{
+		auto object = new PathObject(line, coords);
+		map.addObject(object);
+		return object;
+	}
+};
+
+
+}  // namespace OpenOrienteering
+
+#endif
@@ -22,20 +22,31 @@
 #include <QtMath>
 #include <QtTest>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QImage>
 #include <QObject>
+#include <QPainter>
+#include <QRectF>
 #include <QString>
+#include <QTemporaryDir>
 #include <QTransform>
 
 #include "test_config.h"
 
 #include "global.h"
+#include "settings.h"
 #include "core/georeferencing.h"
 #include "core/map.h"
+#include "core/map_coord.h"
 #include "core/map_view.h"
 #include "fileformats/xml_file_format_p.h"
+#include "sensors/gps_track.h"
+#include "templates/image_tile_cache.h"
 #include "templates/template.h"
+#include "templates/template_image.h"
 #include "templates/world_file.h"
+#include "util/util.h"
 
 using namespace OpenOrienteering;
 
@@ -109,6 +120,202 @@ private slots:
 		QCOMPARE(rotation_template, rotation_map);
 	}
 	
+	void asyncTemplateLoadingTest()
+	{
+		Map map;
+		MapView view{ &map };
+		view.setTemplateLoadingAsync(true);
+		QVERIFY(map.loadFrom(QStringLiteral("testdata:templates/world-file.xmap"), nullptr, &view, false, false));
+		
+		QCOMPARE(map.getNumTemplates(), 1);
+		auto temp = map.getTemplate(0);
+		QVERIFY(temp->getTemplateState() == Template::Loading || temp->getTemplateState() == Template::Loaded);
+		QTRY_COMPARE(temp->getTemplateState(), Template::Loaded);
+		QVERIFY(temp->isTemplateGeoreferenced());
+		QVERIFY(!temp->getTemplateExtent().isEmpty());
+	}
+	
+	void templateImageDrawTest()
+	{
+		Map map;
+		MapView view{ &map };
+		QVERIFY(map.loadFrom(QStringLiteral("testdata:templates/world-file.xmap"), nullptr, &view, false, false));
+		QCOMPARE(map.getNumTemplates(), 1);
+		auto temp = map.getTemplate(0);
+		QCOMPARE(temp->getTemplateState(), Template::Loaded);
+		
+		auto const extent = temp->getTemplateExtent();
+		QRectF map_extent;
+		rectIncludeSafe(map_extent, temp->templateToMap(extent.topLeft()));
+		rectIncludeSafe(map_extent, temp->templateToMap(extent.topRight()));
+		rectIncludeSafe(map_extent, temp->templateToMap(extent.bottomLeft()));
+		rectIncludeSafe(map_extent, temp->templateToMap(extent.bottomRight()));
+		
+		auto const render = [temp, map_extent](int width) {
+			auto const factor = width / map_extent.width();
+			QImage canvas(width, qCeil(map_extent.height() * factor), QImage::Format_ARGB32_Premultiplied);
+			canvas.fill(Qt::transparent);
+			QPainter painter(&canvas);
+			painter.scale(factor, factor);
+			painter.translate(-map_extent.topLeft());
+			temp->drawTemplate(&painter, map_extent, 1, false, 1);
+			painter.end();
+			return canvas;
+		};
+		
+		// Drawing at a small size uses a downsampled image,
+		// but the result must match the downscaled full resolution drawing.
+		auto const small = render(25);
+		auto const reference = render(2000).scaled(small.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		auto difference = 0;
+		for (int y = 0; y < small.height(); ++y)
+		{
+			for (int x = 0; x < small.width(); ++x)
+			{
+				auto const a = small.pixel(x, y);
+				auto const b = reference.pixel(x, y);
+				difference += qAbs(qRed(a) - qRed(b)) + qAbs(qGreen(a) - qGreen(b)) + qAbs(qBlue(a) - qBlue(b)) + qAbs(qAlpha(a) - qAlpha(b));
+			}
+		}
+		QVERIFY(difference / (small.width() * small.height()) < 40);
+	}
+	
+	
+	void imageTileCacheTest()
+	{
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		auto const path = dir.filePath(QStringLiteral("tiles.jpg"));
+		QImage image(1500, 1100, QImage::Format_RGB32);
+		image.fill(Qt::white);
+		QPainter painter(&image);
+		painter.fillRect(1024, 1024, 476, 76, Qt::black);
+		painter.end();
+		QVERIFY(image.save(path));
+		if (!ImageTileCache::canDecodeTiles(path))
+			QSKIP("The JPEG image handler cannot decode parts of images.");
+		
+		ImageTileCache cache(path, 1200000);
+		QCOMPARE(cache.size(), image.size());
+		QCOMPARE(cache.numLevels(), 3);
+		QCOMPARE(cache.levelSize(1), QSize(750, 550));
+		QCOMPARE(cache.levelSize(2), QSize(375, 275));
+		QCOMPARE(cache.tileRect(0, { 2, 2 }), QRect(1024, 1024, 476, 76));
+		QCOMPARE(cache.tileRect(1, { 1, 0 }), QRect(1024, 0, 476, 1024));
+		QCOMPARE(cache.tileRect(1, { 2, 0 }), QRect());
+		
+		auto const corner = cache.tile(0, { 2, 2 });
+		QCOMPARE(corner.size(), QSize(476, 76));
+		QVERIFY(qGray(corner.pixel(200, 40)) < 64);
+		auto const top_left = cache.tile(1, { 0, 0 });
+		QCOMPARE(top_left.size(), QSize(512, 512));
+		QVERIFY(qGray(top_left.pixel(200, 200)) > 192);
+		
+		// The least recently used tiles are discarded.
+		QVERIFY(cache.memoryUsage() <= 1200000);
+		QVERIFY(!cache.tile(2, { 0, 0 }).isNull());
+		QVERIFY(cache.memoryUsage() <= 1200000);
+		
+		// Tiles can be stored next to the image.
+		cache.setPersistent(true);
+		QVERIFY(!cache.tile(0, { 1, 1 }).isNull());
+		QVERIFY(QFileInfo::exists(cache.persistentPath() + QStringLiteral("/0/1_1.png")));
+	}
+	
+	void imageTileCacheFallbackTest()
+	{
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		auto const path = dir.filePath(QStringLiteral("full.bmp"));
+		QImage image(1500, 1100, QImage::Format_RGB32);
+		image.fill(Qt::white);
+		QPainter painter(&image);
+		painter.fillRect(1024, 1024, 476, 76, Qt::black);
+		painter.end();
+		QVERIFY(image.save(path));
+		if (ImageTileCache::canDecodeTiles(path))
+			QSKIP("The BMP image handler can decode parts of images.");
+		
+		// The image exceeds the memory budget, but it must be decoded in full.
+		auto& settings = Settings::getInstance();
+		auto const budget = settings.getSettingCached(Settings::Templates_ImageCacheSizeMB);
+		settings.setSettingInCache(Settings::Templates_ImageCacheSizeMB, 1);
+		Map map;
+		TemplateImage temp(path, &map);
+		auto const loaded = temp.loadTemplateFile(false);
+		settings.setSettingInCache(Settings::Templates_ImageCacheSizeMB, budget);
+		QVERIFY(loaded);
+		QCOMPARE(temp.getTemplateState(), Template::Loaded);
+		QCOMPARE(temp.getTemplateExtent().size(), QSizeF(image.size()));
+		
+		auto const extent = temp.getTemplateExtent();
+		QRectF map_extent;
+		rectIncludeSafe(map_extent, temp.templateToMap(extent.topLeft()));
+		rectIncludeSafe(map_extent, temp.templateToMap(extent.bottomRight()));
+		auto const factor = 150 / map_extent.width();
+		QImage canvas(150, qCeil(map_extent.height() * factor), QImage::Format_ARGB32_Premultiplied);
+		canvas.fill(Qt::transparent);
+		painter.begin(&canvas);
+		painter.scale(factor, factor);
+		painter.translate(-map_extent.topLeft());
+		temp.drawTemplate(&painter, map_extent, 1, false, 1);
+		painter.end();
+		QVERIFY(qGray(canvas.pixel(20, 20)) > 192);
+		QVERIFY(qGray(canvas.pixel(140, canvas.height() - 3)) < 64);
+	}
+	
+	
+	void osmLoadingTest()
+	{
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		auto const path = dir.filePath(QStringLiteral("nodes.osm"));
+		QFile file(path);
+		QVERIFY(file.open(QIODevice::WriteOnly));
+		file.write("<?xml version='1.0' encoding='UTF-8'?>\n"
+		           "<osm version='0.6'>\n"
+		           " <node id='3' lat='50.5' lon='7.5'/>\n"
+		           " <node id='1' lat='50.6' lon='7.6'/>\n"
+		           " <node id='2' lat='50.5' lon='9.0'/>\n"
+		           " <node id='4' lat='50.7' lon='7.7'/>\n"
+		           " <node id='5' lat='9.0' lon='9.0'/>\n"
+		           " <node id='6' lat='50.2' lon='7.2'><tag k='name' v='A'/></node>\n"
+		           " <node id='7' lat='9.0' lon='7.2'><tag k='name' v='B'/></node>\n"
+		           " <way id='10'><nd ref='1'/><nd ref='2'/><nd ref='4'/><tag k='highway' v='track'/></way>\n"
+		           " <way id='11'><nd ref='5'/><nd ref='5'/></way>\n"
+		           " <way id='12'><nd ref='3'/><nd ref='99'/></way>\n"
+		           "</osm>\n");
+		file.close();
+		
+		Track track;
+		QVERIFY(track.loadFrom(path, false));
+		QCOMPARE(track.getNumWaypoints(), 2);
+		QCOMPARE(track.getNumSegments(), 3);
+		QCOMPARE(track.getSegmentPointCount(0), 3);
+		QCOMPARE(track.getSegmentPoint(0, 2).gps_coord.longitude(), 7.7);
+		QVERIFY(!track.errorString().isEmpty());  // missing node 99
+		QVERIFY(track.loadedArea().isNull());
+		
+		// Ways are split where they leave the loading area.
+		track.setLoadingArea(QRectF(7.0, 50.0, 1.0, 1.0));
+		QVERIFY(track.loadFrom(path, false));
+		QCOMPARE(track.getNumWaypoints(), 1);
+		QCOMPARE(track.getWaypointName(0), QStringLiteral("A"));
+		QCOMPARE(track.getNumSegments(), 3);
+		QCOMPARE(track.getSegmentPointCount(0), 2);
+		QCOMPARE(track.getSegmentPointCount(1), 2);
+		QCOMPARE(track.getSegmentPointCount(2), 1);
+		QCOMPARE(track.getSegmentName(1), QStringLiteral("10"));
+		QCOMPARE(track.tags().value(QStringLiteral("10")).value(QStringLiteral("highway")), QStringLiteral("track"));
+		QVERIFY(!track.tags().contains(QStringLiteral("11")));
+		QCOMPARE(track.loadedArea(), QRectF(7.0, 50.0, 1.0, 1.0));
+		
+		// Copies keep the loaded area.
+		Track copy;
+		copy = track;
+		QCOMPARE(copy.loadedArea(), track.loadedArea());
+	}
+	
 	
 	void templatePathTest()
 	{
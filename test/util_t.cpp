@@ -23,6 +23,7 @@
 #include <QPointF>
 #include <QRectF>
 
+#include "util/spatial_grid.h"
 #include "util/util.h"
 
 using namespace OpenOrienteering;
@@ -38,6 +39,7 @@ private slots:
 	void initTestCase();
 	void rectIncludeTest();
 	void rectIncludeSafeTest();
+	void spatialGridTest();
 };
 
 
@@ -119,6 +121,42 @@ void UtilTest::rectIncludeSafeTest()
 	
 }
 
+void UtilTest::spatialGridTest()
+{
+	SpatialGrid<int> grid(10.0, 16);
+	QVERIFY(grid.empty());
+	
+	grid.insert(1, { 1, 1, 2, 2 });      // single cell
+	grid.insert(2, { 5, 5, 10, 10 });    // four cells
+	grid.insert(3, { -50, -50, 100, 100 }); // too many cells
+	grid.insert(4, {});                  // invalid extent
+	QCOMPARE(grid.size(), std::size_t(4));
+	QVERIFY(grid.contains(2));
+	QCOMPARE(grid.bounds(), QRectF(-50, -50, 100, 100));
+	
+	// Unplaced items are always candidates, and results are sorted.
+	QCOMPARE(grid.query({ 1, 1, 1, 1 }), (std::vector<int>{ 1, 2, 3, 4 }));
+	QCOMPARE(grid.query({ 12, 12, 1, 1 }), (std::vector<int>{ 2, 3, 4 }));
+	QCOMPARE(grid.query({ 32, 32, 1, 1 }), (std::vector<int>{ 3, 4 }));
+	// A query covering more cells than occupied
+	QCOMPARE(grid.query({ -1000, -1000, 2000, 2000 }), (std::vector<int>{ 1, 2, 3, 4 }));
+	
+	// Inserting an existing item replaces its registration.
+	grid.insert(1, { 31, 31, 2, 2 });
+	QCOMPARE(grid.size(), std::size_t(4));
+	QCOMPARE(grid.query({ 1, 1, 1, 1 }), (std::vector<int>{ 2, 3, 4 }));
+	QCOMPARE(grid.query({ 32, 32, 1, 1 }), (std::vector<int>{ 1, 3, 4 }));
+	
+	QVERIFY(grid.remove(2));
+	QVERIFY(!grid.remove(2));
+	QVERIFY(!grid.contains(2));
+	QCOMPARE(grid.query({ 12, 12, 1, 1 }), (std::vector<int>{ 3, 4 }));
+	
+	grid.clear();
+	QVERIFY(grid.empty());
+	QVERIFY(grid.query({ 1, 1, 1, 1 }).empty());
+}
+
 
 QTEST_APPLESS_MAIN(UtilTest)
 #include "util_t.moc"  // IWYU pragma: keep